@@ -328,18 +328,18 @@ b32 actor_is_prey(Actor *actor) {
 
 
 void draw_ghost(Renderer *renderer, Resources *resources, Actor *actor, Actor *pacman, f32 cos_x, f32 sin_y) {  
-    Bmp *ghost_bitmap = nullptr;    
+    Sprite_Id ghost_sprite = Sprite_Ghost_Red;
         
     if (actor->mode == Actor_Mode_Prey) {
-        ghost_bitmap = &resources->bitmaps.ghost_as_prey;
+        ghost_sprite = Sprite_Ghost_As_Prey;
     }
     else
     {
         switch (actor->type) {
-            case Actor_Type_Ghost_Red:    { ghost_bitmap = &resources->bitmaps.ghost_red;    } break;
-            case Actor_Type_Ghost_Pink:   { ghost_bitmap = &resources->bitmaps.ghost_pink;   } break;
-            case Actor_Type_Ghost_Cyan:   { ghost_bitmap = &resources->bitmaps.ghost_cyan;   } break;
-            case Actor_Type_Ghost_Orange: { ghost_bitmap = &resources->bitmaps.ghost_orange; } break;
+            case Actor_Type_Ghost_Red:    { ghost_sprite = Sprite_Ghost_Red;    } break;
+            case Actor_Type_Ghost_Pink:   { ghost_sprite = Sprite_Ghost_Pink;   } break;
+            case Actor_Type_Ghost_Cyan:   { ghost_sprite = Sprite_Ghost_Cyan;   } break;
+            case Actor_Type_Ghost_Orange: { ghost_sprite = Sprite_Ghost_Orange; } break;
         }
     }
 
@@ -358,14 +358,15 @@ void draw_ghost(Renderer *renderer, Resources *resources, Actor *actor, Actor *p
             x_off = Pax < 0.0f ? static_cast<u32>(ceilf(-1.0f * Pax)) : 0;
             y_off = Pay < 0.0f ? static_cast<u32>(ceilf(-1.0f * Pay)) : 0;
 
-            renderer->draw_bitmap(P, ghost_bitmap, x_off, y_off, ghost_bitmap->header.width, ghost_bitmap->header.height);
-            Bmp *eye_bitmap = &resources->bitmaps.ghost_eye;
-            renderer->draw_bitmap(P, eye_bitmap, x_off, y_off, eye_bitmap->header.width, eye_bitmap->header.height);
+            Sprite *ghost = &resources->sprites.sprites[ghost_sprite];
+            draw_sprite(renderer, resources, ghost_sprite, P, x_off, y_off, ghost->width, ghost->height);
+            Sprite *eye = &resources->sprites.sprites[Sprite_Ghost_Eye];
+            draw_sprite(renderer, resources, Sprite_Ghost_Eye, P, x_off, y_off, eye->width, eye->height);
         }
         else {
             P = V2u(static_cast<u32>(Pax), static_cast<u32>(Pay));
-            renderer->draw_bitmap(P, ghost_bitmap);
-            renderer->draw_bitmap(P, &resources->bitmaps.ghost_eye);
+            draw_sprite(renderer, resources, ghost_sprite, P);
+            draw_sprite(renderer, resources, Sprite_Ghost_Eye, P);
         }
     }
                 
@@ -388,7 +389,7 @@ void draw_ghost(Renderer *renderer, Resources *resources, Actor *actor, Actor *p
             P = V2u(static_cast<u32>(Px), static_cast<u32>(Py));
         }
     }    
-    renderer->draw_bitmap(P, &resources->bitmaps.ghost_pupil);
+    draw_sprite(renderer, resources, Sprite_Ghost_Pupil, P);
 }
 
 
@@ -413,5 +414,5 @@ void draw_pacman(Renderer *renderer, Resources *resources, Actor *actor, u32 int
     
     u32 x = 64 * static_cast<u32>(actor->direction);
     u32 y = 64 * static_cast<u32>(floor(t));
-    renderer->draw_bitmap(P, &resources->bitmaps.pacman_atlas, x, y, x + 64, y + 64);
+    draw_sprite(renderer, resources, Sprite_Pacman_Atlas, P, x, y, x + 64, y + 64);
 }
@@ -0,0 +1,440 @@
+//
+// Level analysis
+//
+// How hard the levels of a level set are, for ordering and curating them. Every state that can be reached
+// from the start of a level is visited breadth first, with the solver's packed states (see solver.cpp) and its
+// table of them, and that gives for each level:
+// - the number of states that can be reached,
+// - the fewest turns to win, and the number of input sequences that win in that many,
+// - the share of the states from which it can't be won anymore (the dead ends),
+// - the average branching, how many different states a state leads to.
+//
+// The levels are analyzed on as many threads as there are cores, each with a solver of its own, and written
+// as one row each of a CSV file in the order of the level set. A level that has more states than max_nodes
+// or that takes longer than max_milliseconds is only partly visited, its status says so.
+//
+
+#define kAnalysis_Default_Max_Ms 60000  // Per level
+#define kAnalysis_No_Child       0xFFFFFFFF
+
+
+struct Analysis_Options {
+    u32 thread_count     = 0;    // 0 for one per core
+    u32 max_turns        = kSolver_Max_Turns;
+    u32 max_nodes        = kSolver_Default_Max_Nodes;
+    u32 max_milliseconds = kAnalysis_Default_Max_Ms;
+};
+
+
+struct Level_Analysis {
+    u32 level_id = 0;
+    Solve_Status status = Solve_Status_Unsolvable; // Solved or Unsolvable if every state was visited
+    u32 state_count = 0;
+    u32 optimal_turns = 0;    // 0 if it wasn't won
+    u64 solution_count = 0;   // Input sequences that win in optimal_turns, saturates
+    u32 visited_count = 0;    // The same as state_count if every state was visited
+    u32 dead_end_count = 0;   // Of the visited states, the ones it can't be won from
+    u64 move_count = 0;       // Different states the expanded ones lead to
+    u32 expanded_count = 0;
+    f64 milliseconds = 0.0;
+};
+
+
+// The graph of the states, beside the solver's nodes
+struct Level_Explorer {
+    u32 *children = nullptr;  // Four per node, one for each input, kAnalysis_No_Child if it didn't move
+    u64 *path_counts = nullptr;
+    u32 capacity = 0;
+    u32 visited_count = 0;    // Nodes taken from the queue, the ones after them have no children filled in
+};
+
+
+
+
+//
+// #_Exploring
+//
+
+static void free_level_explorer(Level_Explorer *explorer) {
+    if (explorer->children)     free(explorer->children);
+    if (explorer->path_counts)  free(explorer->path_counts);
+    explorer->children = nullptr;
+    explorer->path_counts = nullptr;
+    explorer->capacity = 0;
+}
+
+
+// Keeps up with the solver's node capacity
+static b32 fit_level_explorer(Level_Explorer *explorer, u32 node_capacity) {
+    b32 result = true;
+
+    if (explorer->capacity < node_capacity) {
+        void *new_children = realloc(explorer->children, static_cast<size_t>(node_capacity) * 4 * sizeof(u32));
+        if (new_children)  explorer->children = static_cast<u32 *>(new_children);
+        void *new_path_counts = realloc(explorer->path_counts, node_capacity * sizeof(u64));
+        if (new_path_counts)  explorer->path_counts = static_cast<u64 *>(new_path_counts);
+
+        if (!new_children || !new_path_counts) {
+            printf("%s in %s failed to reallocate memory!\n", __FUNCTION__, __FILE__);
+            result = false;
+        }
+        else {
+            explorer->capacity = node_capacity;
+        }
+    }
+
+    return result;
+}
+
+
+// Returns the node of the packed state, adding it if it is new, or kAnalysis_No_Child if there's no room
+static u32 add_explored_node(Solver *solver, Level_Explorer *explorer, Analysis_Options const *options, u8 const *packed, u32 g, u8 flags) {
+    u32 result = kAnalysis_No_Child;
+    if (!solver->slots && !grow_nodes(solver, options->max_nodes))  return result;
+
+    u64 hash = hash_solver_state(solver, packed);
+    u32 slot;
+    u32 node_index = find_node(solver, packed, hash, &slot);
+
+    if (node_index == solver->node_count) {
+        if (solver->node_count == solver->node_capacity) {
+            if (!grow_nodes(solver, options->max_nodes))  return result;
+            find_node(solver, packed, hash, &slot);
+        }
+        if (!fit_level_explorer(explorer, solver->node_capacity))  return result;
+
+        node_index = solver->node_count++;
+        memcpy(&solver->states[node_index * solver->state_size], packed, solver->state_size);
+        solver->slots[slot] = node_index + 1;
+
+        Solver_Node *node = &solver->nodes[node_index];
+        node->parent = 0;
+        node->g      = static_cast<u16>(g);
+        node->input  = static_cast<u8>(Input_None);
+        node->flags  = flags;
+        explorer->path_counts[node_index] = 0;
+    }
+    result = node_index;
+
+    return result;
+}
+
+
+// Breadth first, so the nodes are in the order of the turns it takes to reach them and the node array is
+// its own queue. Every node that is taken from it has been reached in all the ways it can be in as few turns,
+// so its path count is done.
+static void explore_level(Solver *solver, Level_Explorer *explorer, Analysis_Options const *options, Level_Analysis *analysis) {
+    solver->node_count = 0;
+    if (solver->slots)  memset(solver->slots, 0, (solver->slot_mask + 1) * sizeof(u32));
+
+    analysis->status = Solve_Status_Unsolvable;
+    explorer->visited_count = 0;
+
+    unpack_solver_state(solver, solver->root);
+    Level_State *state = solver->level.current_state;
+    u8 root_flags = state->pacman_count == 0 ? Solver_Node_Won : (level_state_is_lost(&solver->level, state) ? Solver_Node_Lost : 0);
+    u32 root = add_explored_node(solver, explorer, options, solver->root, 0, root_flags);
+    if (root == kAnalysis_No_Child) {
+        analysis->status = Solve_Status_Node_Limit;
+        return;
+    }
+    explorer->path_counts[root] = 1;
+
+    u8 *next = solver->path_states; // Scratch, nothing else is searching
+    for (u32 node_index = 0; node_index < solver->node_count; ++node_index) {
+        for (u32 input = 0; input < 4; ++input) {
+            explorer->children[(node_index * 4) + input] = kAnalysis_No_Child;
+        }
+        explorer->visited_count = node_index + 1;
+
+        Solver_Node node = solver->nodes[node_index];
+        if (node.flags & (Solver_Node_Won | Solver_Node_Lost))  continue;
+        if (node.g + 1u > options->max_turns) {
+            analysis->status = Solve_Status_Turn_Limit;
+            continue;
+        }
+        if ((node_index & 0xFF) == 0 && solver_is_out_of_time(solver)) {
+            analysis->status = Solve_Status_Time_Limit;
+            break;
+        }
+
+        ++analysis->expanded_count;
+        for (u32 input = Input_Right; input <= static_cast<u32>(Input_Down); ++input) {
+            u8 const *packed = &solver->states[node_index * solver->state_size];
+            Turn_Result turn_result = play_solver_turn(solver, packed, static_cast<Input>(input), next);
+            if (turn_result != Turn_Result_Moved && turn_result != Turn_Result_Won && turn_result != Turn_Result_Lost)  continue;
+
+            u8 flags = turn_result == Turn_Result_Won ? Solver_Node_Won : (turn_result == Turn_Result_Lost ? Solver_Node_Lost : 0);
+            u32 child = add_explored_node(solver, explorer, options, next, node.g + 1, flags);
+            if (child == kAnalysis_No_Child) {
+                analysis->status = Solve_Status_Node_Limit;
+                break;
+            }
+            explorer->children[(node_index * 4) + input] = child; // Adding it might have moved the array
+
+            // Reached in as few turns as it can be, through this input
+            if (solver->nodes[child].g == node.g + 1) {
+                u64 path_count = explorer->path_counts[child] + explorer->path_counts[node_index];
+                explorer->path_counts[child] = path_count < explorer->path_counts[child] ? ~0ULL : path_count;
+            }
+            if (turn_result == Turn_Result_Won && analysis->optimal_turns == 0) {
+                analysis->optimal_turns = node.g + 1;
+            }
+        }
+        if (analysis->status == Solve_Status_Node_Limit)  break;
+
+        u32 const *children = &explorer->children[node_index * 4];
+        for (u32 input = 0; input < 4; ++input) {
+            b32 is_new = children[input] != kAnalysis_No_Child;
+            for (u32 other = 0; other < input && is_new; ++other) {
+                is_new = children[other] != children[input];
+            }
+            if (is_new)  ++analysis->move_count;
+        }
+    }
+
+    analysis->state_count = solver->node_count;
+    if ((analysis->optimal_turns > 0 || root_flags == Solver_Node_Won) && analysis->status == Solve_Status_Unsolvable) {
+        analysis->status = Solve_Status_Solved;
+    }
+}
+
+
+// The visited states that can't be won from, found by going backwards from the ones that won. When not
+// every state was visited this is an upper bound, some of them might lead to a win through the others.
+static u32 count_dead_ends(Solver *solver, Level_Explorer *explorer) {
+    u32 result = 0;
+    u32 node_count = solver->node_count;
+    u32 visited_count = explorer->visited_count;
+
+    //
+    // The parents of every node, counted and then filled in
+    u32 *first_parent = static_cast<u32 *>(calloc(node_count + 1, sizeof(u32)));
+    u32 *parents = static_cast<u32 *>(malloc((static_cast<size_t>(visited_count) * 4 + 1) * sizeof(u32)));
+    u8 *can_win = static_cast<u8 *>(calloc(node_count, sizeof(u8)));
+    u32 *queue = static_cast<u32 *>(malloc((node_count + 1) * sizeof(u32)));
+    if (!first_parent || !parents || !can_win || !queue) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        result = visited_count;
+    }
+    else {
+        for (u32 node_index = 0; node_index < visited_count; ++node_index) {
+            for (u32 input = 0; input < 4; ++input) {
+                u32 child = explorer->children[(node_index * 4) + input];
+                if (child != kAnalysis_No_Child)  ++first_parent[child + 1];
+            }
+        }
+        for (u32 node_index = 0; node_index < node_count; ++node_index) {
+            first_parent[node_index + 1] += first_parent[node_index];
+        }
+        for (u32 node_index = 0; node_index < visited_count; ++node_index) {
+            for (u32 input = 0; input < 4; ++input) {
+                u32 child = explorer->children[(node_index * 4) + input];
+                if (child != kAnalysis_No_Child)  parents[first_parent[child]++] = node_index;
+            }
+        }
+        for (u32 node_index = node_count; node_index > 0; --node_index) {
+            first_parent[node_index] = first_parent[node_index - 1];
+        }
+        first_parent[0] = 0;
+
+        //
+        // Backwards from the wins
+        u32 queue_count = 0;
+        for (u32 node_index = 0; node_index < node_count; ++node_index) {
+            if (solver->nodes[node_index].flags & Solver_Node_Won) {
+                can_win[node_index] = 1;
+                queue[queue_count++] = node_index;
+            }
+        }
+        for (u32 queue_index = 0; queue_index < queue_count; ++queue_index) {
+            u32 node_index = queue[queue_index];
+            for (u32 parent = first_parent[node_index]; parent < first_parent[node_index + 1]; ++parent) {
+                if (!can_win[parents[parent]]) {
+                    can_win[parents[parent]] = 1;
+                    queue[queue_count++] = parents[parent];
+                }
+            }
+        }
+        for (u32 node_index = 0; node_index < visited_count; ++node_index) {
+            if (!can_win[node_index])  ++result;
+        }
+    }
+
+    if (first_parent)  free(first_parent);
+    if (parents)       free(parents);
+    if (can_win)       free(can_win);
+    if (queue)         free(queue);
+
+    return result;
+}
+
+
+static void analyze_level(Solver *solver, Level_Explorer *explorer, Analysis_Options const *options, Level *level, Level_Analysis *analysis) {
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER start;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+
+    analysis->level_id = level->id;
+    if (!init_solver(solver, level, &level->original_state)) {
+        analysis->status = Solve_Status_Unsolvable;
+        return;
+    }
+
+    solver->deadline = 0;
+    if (options->max_milliseconds > 0) {
+        solver->deadline = start.QuadPart + ((static_cast<s64>(options->max_milliseconds) * frequency.QuadPart) / 1000);
+    }
+    solver->cancel = nullptr;
+    solver->out_of_time = false;
+
+    explore_level(solver, explorer, options, analysis);
+
+    analysis->visited_count = explorer->visited_count;
+    analysis->dead_end_count = count_dead_ends(solver, explorer);
+
+    for (u32 node_index = 0; node_index < solver->node_count; ++node_index) {
+        Solver_Node *node = &solver->nodes[node_index];
+        if ((node->flags & Solver_Node_Won) && node->g == analysis->optimal_turns) {
+            u64 solution_count = analysis->solution_count + explorer->path_counts[node_index];
+            analysis->solution_count = solution_count < analysis->solution_count ? ~0ULL : solution_count;
+        }
+    }
+
+    LARGE_INTEGER end;
+    QueryPerformanceCounter(&end);
+    analysis->milliseconds = (1000.0 * static_cast<f64>(end.QuadPart - start.QuadPart)) / static_cast<f64>(frequency.QuadPart);
+}
+
+
+
+
+//
+// #_Level set
+//
+
+struct Analysis_Job {
+    Analysis_Options const *options;
+    Level **levels;            // In the order of the level set, nullptr for the ids that aren't there
+    Level_Analysis *analyzes;
+    u32 level_count;
+    std::atomic<u32> next_level{0};
+};
+
+
+static void run_analysis_thread(Analysis_Job *job) {
+    Solver solver;
+    Level_Explorer explorer;
+
+    for (u32 index = job->next_level.fetch_add(1); index < job->level_count; index = job->next_level.fetch_add(1)) {
+        if (job->levels[index]) {
+            analyze_level(&solver, &explorer, job->options, job->levels[index], &job->analyzes[index]);
+        }
+    }
+
+    free_level_explorer(&explorer);
+    free_solver(&solver);
+}
+
+
+static b32 write_level_analyzes(char const *path_and_name, Level **levels, Level_Analysis *analyzes, u32 level_count) {
+    HANDLE file_handle;
+    b32 result = win32_open_file_for_writing(path_and_name, &file_handle);
+    if (result) {
+        char buffer[512];
+        DWORD bytes_written;
+        DWORD bytes_to_write = _snprintf_s(buffer, sizeof(buffer), _TRUNCATE,
+                                           "level_id,name,status,reachable_states,optimal_turns,solutions,dead_end_ratio,average_branching,milliseconds\n");
+        result = WriteFile(file_handle, buffer, bytes_to_write, &bytes_written, nullptr);
+
+        for (u32 index = 0; index < level_count && result; ++index) {
+            Level_Analysis *analysis = &analyzes[index];
+            if (!levels[index]) {
+                bytes_to_write = _snprintf_s(buffer, sizeof(buffer), _TRUNCATE, "%u,,missing,,,,,,\n", analysis->level_id);
+            }
+            else {
+                // The names are quoted, they can have commas in them (and no quotes, see parse_level())
+                f64 dead_end_ratio = analysis->visited_count > 0 ? static_cast<f64>(analysis->dead_end_count) / analysis->visited_count : 0.0;
+                f64 branching = analysis->expanded_count > 0 ? static_cast<f64>(analysis->move_count) / analysis->expanded_count : 0.0;
+                bytes_to_write = _snprintf_s(buffer, sizeof(buffer), _TRUNCATE, "%u,\"%s\",%s,%u,%u,%llu,%.4f,%.4f,%.1f\n",
+                                             analysis->level_id, levels[index]->name, get_solve_status_name(analysis->status),
+                                             analysis->state_count, analysis->optimal_turns, static_cast<unsigned long long>(analysis->solution_count),
+                                             dead_end_ratio, branching, analysis->milliseconds);
+            }
+            result = WriteFile(file_handle, buffer, bytes_to_write, &bytes_written, nullptr);
+        }
+
+        CloseHandle(file_handle);
+    }
+
+    return result;
+}
+
+
+// Returns 0 if every level of the set was analyzed to the end
+static u32 analyze_level_set(Log *log, char const *level_set_name, char const *csv_path_and_name, Analysis_Options const *options) {
+    u32 error_code = 0;
+
+    Array_Of_Levels all_the_levels;
+    u32_darray level_set;
+
+    if (load_levels_from_disc(&all_the_levels, nullptr) == 0) {
+        LOG_ERROR_STR(log, "failed to load the levels", "data\\levels");
+        error_code = 2;
+    }
+    else if (!read_level_set_from_disc(&level_set, level_set_name) || level_set.count == 0) {
+        LOG_ERROR_STR(log, "failed to read the level set", level_set_name);
+        error_code = 3;
+    }
+    else {
+        Level **levels = static_cast<Level **>(calloc(level_set.count, sizeof(Level *)));
+        Level_Analysis *analyzes = new Level_Analysis[level_set.count];
+        for (u32 index = 0; index < level_set.count; ++index) {
+            levels[index] = get_level_with_id(&all_the_levels, level_set[index]);
+            analyzes[index].level_id = level_set[index];
+            if (!levels[index])  LOG_ERROR(log, "the level set has a level that isn't there", level_set[index]);
+        }
+
+        Analysis_Job job;
+        job.options = options;
+        job.levels = levels;
+        job.analyzes = analyzes;
+        job.level_count = level_set.count;
+
+        u32 thread_count = options->thread_count > 0 ? options->thread_count : max(1u, std::thread::hardware_concurrency());
+        thread_count = min(thread_count, level_set.count);
+        std::thread *threads = new std::thread[thread_count];
+        for (u32 index = 0; index < thread_count; ++index) {
+            threads[index] = std::thread(run_analysis_thread, &job);
+        }
+        for (u32 index = 0; index < thread_count; ++index) {
+            threads[index].join();
+        }
+        delete [] threads;
+
+        u32 complete_count = 0;
+        for (u32 index = 0; index < level_set.count; ++index) {
+            Solve_Status status = analyzes[index].status;
+            if (levels[index] && (status == Solve_Status_Solved || status == Solve_Status_Unsolvable))  ++complete_count;
+        }
+        log_u32(log, "Analyze, levels", level_set.count);
+        log_u32(log, "Analyze, levels visited to the end", complete_count);
+
+        if (!write_level_analyzes(csv_path_and_name, levels, analyzes, level_set.count)) {
+            LOG_ERROR_STR(log, "failed to write the analysis", csv_path_and_name);
+            error_code = 4;
+        }
+        else if (complete_count < level_set.count) {
+            error_code = 5;
+        }
+
+        delete [] analyzes;
+        free(levels);
+    }
+
+    free_darray(&level_set);
+    free_array_of_levels(&all_the_levels);
+
+    return error_code;
+}
@@ -0,0 +1,164 @@
+//
+// Sprite atlas
+//
+// Packs a set of bitmaps into one atlas bitmap and a table of Sprites, the sub-rectangles of the atlas that
+// hold each of them. Everything is then drawn from one pixel buffer. Every sprite also gets its Bitmap_Spans
+// (see bitmap.cpp), built at load time, so drawing only touches the pixels that aren't transparent.
+//
+// The packer puts the rectangles on shelves, tallest first, in an atlas of a power of two width. It is done
+// when the resource archive is built (see pak.cpp), and at load time only when there is no archive.
+//
+
+#define kAtlas_Max_Sprites 64
+
+
+struct Sprite {
+    u32 x = 0;
+    u32 y = 0;
+    u32 width = 0;
+    u32 height = 0;
+};
+
+
+
+
+//
+// Packing
+//
+
+// Places the rectangles, in sprites, with their width and height set. Returns the size of the atlas.
+static v2u pack_sprites(Sprite *sprites, u32 sprite_count) {
+    v2u result = v2u_00;
+    assert(sprite_count <= kAtlas_Max_Sprites);
+
+    //
+    // Sort, tallest and then widest first
+    u32 order[kAtlas_Max_Sprites];
+    u32 area = 0;
+    u32 widest = 0;
+    for (u32 index = 0; index < sprite_count; ++index) {
+        order[index] = index;
+        area += sprites[index].width * sprites[index].height;
+        widest = max(widest, sprites[index].width);
+    }
+
+    for (u32 index = 1; index < sprite_count; ++index) {
+        u32 current = order[index];
+        u32 position = index;
+        while (position > 0) {
+            Sprite *a = &sprites[order[position - 1]];
+            Sprite *b = &sprites[current];
+            b32 goes_before = b->height > a->height || (b->height == a->height && b->width > a->width);
+            if (!goes_before)  break;
+            order[position] = order[position - 1];
+            --position;
+        }
+        order[position] = current;
+    }
+
+    //
+    // Aim for a square atlas, as wide as the power of two above the square root of the area
+    u32 atlas_width = 1;
+    while (atlas_width * atlas_width < area || atlas_width < widest) {
+        atlas_width *= 2;
+    }
+
+    //
+    // Fill the shelves left to right, a new shelf starts above the tallest sprite on the current one
+    u32 shelf_x = 0;
+    u32 shelf_y = 0;
+    u32 shelf_height = 0;
+    for (u32 index = 0; index < sprite_count; ++index) {
+        Sprite *sprite = &sprites[order[index]];
+        if (shelf_x + sprite->width > atlas_width) {
+            shelf_y += shelf_height;
+            shelf_x = 0;
+            shelf_height = 0;
+        }
+
+        sprite->x = shelf_x;
+        sprite->y = shelf_y;
+        shelf_x += sprite->width;
+        shelf_height = max(shelf_height, sprite->height);
+    }
+
+    result = V2u(atlas_width, shelf_y + shelf_height);
+
+    return result;
+}
+
+
+// Packs the bitmaps, all 32 bits per pixel, into atlas. sprites[n] is where bitmaps[n] ended up.
+static b32 build_atlas(Bmp const **bitmaps, u32 bitmap_count, Bmp *atlas, Sprite *sprites) {
+    b32 result = false;
+
+    for (u32 index = 0; index < bitmap_count; ++index) {
+        if (!bitmaps[index] || !bitmaps[index]->data || bitmaps[index]->header.bits_per_pixel != 32) {
+            printf("%s() bitmap %u isn't 32 bits per pixel\n", __FUNCTION__, index);
+            return result;
+        }
+
+        sprites[index].width  = bitmaps[index]->header.width;
+        sprites[index].height = bitmaps[index]->header.height;
+    }
+
+    v2u size = pack_sprites(sprites, bitmap_count);
+
+    free_bitmap(atlas);
+    atlas->header.size           = sizeof(Bitmap_info_header);
+    atlas->header.width          = size.x;
+    atlas->header.height         = size.y;
+    atlas->header.planes         = 1;
+    atlas->header.bits_per_pixel = 32;
+    atlas->row_size  = size.x * sizeof(u32);
+    atlas->data_size = atlas->row_size * size.y;
+    atlas->header.sizeof_image = static_cast<u32>(atlas->data_size);
+    atlas->data = static_cast<u8 *>(calloc(atlas->data_size > 0 ? atlas->data_size : 1, 1));
+    if (!atlas->data) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        return result;
+    }
+
+    for (u32 index = 0; index < bitmap_count; ++index) {
+        Bmp const *bitmap = bitmaps[index];
+        Sprite const *sprite = &sprites[index];
+        for (u32 y = 0; y < sprite->height; ++y) {
+            u8 *dst = atlas->data + ((sprite->y + y) * atlas->row_size) + (sprite->x * sizeof(u32));
+            memcpy(dst, bitmap->data + (y * bitmap->row_size), sprite->width * sizeof(u32));
+        }
+    }
+
+    result = true;
+
+    return result;
+}
+
+
+
+
+//
+// Drawing
+//
+
+// Builds the spans of every sprite, so that drawing them skips the transparent pixels
+static b32 build_sprite_spans(Bmp const *atlas, Sprite const *sprites, u32 sprite_count, Bitmap_Spans *spans) {
+    b32 result = true;
+
+    for (u32 index = 0; result && index < sprite_count; ++index) {
+        Sprite const *sprite = &sprites[index];
+        result = build_bitmap_spans(atlas, sprite->x, sprite->y, sprite->width, sprite->height, &spans[index]);
+    }
+
+    return result;
+}
+
+
+static void draw_sprite(Renderer *renderer, v2u P, Bmp *atlas, Bitmap_Spans const *spans) {
+    renderer->draw_bitmap_spans(P, atlas, spans, 0, 0, spans->width, spans->height);
+}
+
+
+// [x0, x1[ and [y0, y1[ relative to the sprite, like draw_bitmap()
+static void draw_sprite(Renderer *renderer, v2u P, Bmp *atlas, Bitmap_Spans const *spans, u32 x0, u32 y0, u32 x1, u32 y1) {
+    renderer->draw_bitmap_spans(P, atlas, spans, x0, y0, x1, y1);
+}
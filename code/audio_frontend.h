@@ -0,0 +1,51 @@
+//
+// Front-end for the audio
+//
+// Every back-end plays the output of the same Mixer (see mixer.cpp), they only differ in where the mixed
+// frames end up: a sound device (win32_audio.cpp), nowhere or a wav file (headless_audio.cpp).
+//
+
+
+struct Audio {
+    virtual ~Audio() {};
+
+    virtual b32 init(Log *log) = 0;
+
+    // Called once per game frame with the time the frame took. Back-ends driven by a device ignore this,
+    // the others mix exactly as many frames as that time corresponds to, which makes their output
+    // deterministic.
+    virtual void update(u32 microseconds) = 0;
+
+    Mixer mixer;
+    Log *log = nullptr;
+    b32 is_playing = false; // Nothing is posted to the mixer unless the back-end consumes its output
+};
+
+
+
+
+//
+// Playing
+//
+
+// Decodes the wav for the mixer, so that the first play_wav() of it doesn't have to
+b32 static prepare_wav(Audio *audio, Wav *wav) {
+    b32 result = false;
+
+    if (audio && audio->is_playing && wav) {
+        result = get_mixer_sound(&audio->mixer, wav) != nullptr;
+    }
+
+    return result;
+}
+
+
+b32 static play_wav(Audio *audio, Wav *wav) {
+    b32 result = false;
+
+    if (audio && audio->is_playing && wav) {
+        result = mixer_play(&audio->mixer, wav);
+    }
+
+    return result;
+}
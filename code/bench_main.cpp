@@ -0,0 +1,771 @@
+//
+// bench_main.cpp
+//
+// Microbenchmarks of the hot kernels. Built on Linux with build_linux.sh and run from the run_tree, since
+// draw_bitmap and print use the real bitmaps and font.
+//
+// Every benchmark is sampled until it has run for at least the minimum time (or the maximum number of
+// samples). One CSV row per benchmark is written to stdout, everything else goes to stderr, so runs on
+// different commits can be compared with any diff- or spreadsheet tool:
+//
+//     benchmark,params,samples,items_per_sample,min_ns,median_ns,mean_ns,median_ns_per_item
+//
+// Usage: bench [-filter <substring>] [-min_time <milliseconds>] [-quick]
+//
+
+#include "common.h"
+#include "posix_win32_compat.h"
+
+#define kBench_Max_Samples 1000
+
+
+
+
+//
+// Includes
+//
+
+#include "log.h"
+#include "profiler.h"
+#include "wav.cpp"
+#include "mixer.cpp"
+#include "audio_frontend.h"
+#include "headless_audio.cpp"
+
+#include "tokenizer.cpp"
+#include "mathematics.cpp"
+#include "bitmap.cpp"
+#include "font.cpp"
+#include "software_renderer.cpp"
+#include "scaler.cpp"
+#include "render_thread.cpp"
+#include "atlas.cpp"
+#include "wav_convert.cpp"
+#include "pak.cpp"
+#include "resources.cpp"
+#include "actor.cpp"
+#include "tile_and_item.cpp"
+#include "distance_oracle.cpp"
+#include "level.cpp"
+#include "movement.cpp"
+#include "solver.cpp"
+
+
+
+
+//
+// Harness
+//
+
+struct Bench_Options {
+    char const *filter = nullptr;
+    u64 min_time_ns = 200 * 1000000ull;
+    b32 quick = false;
+};
+
+
+// Passed to the benchmark body, which calls begin() and end() around the part that should be timed.
+// Anything outside (resetting the input etc...) is not counted.
+struct Bench_Clock {
+    s64 started = 0;
+    s64 elapsed = 0;
+
+    void begin() {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        started = now.QuadPart;
+    }
+
+    void end() {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        elapsed += now.QuadPart - started;
+    }
+};
+
+
+static Bench_Options g_options;
+
+
+static int compare_s64(void const *a, void const *b) {
+    s64 lhs = *static_cast<s64 const *>(a);
+    s64 rhs = *static_cast<s64 const *>(b);
+    return (lhs > rhs) - (lhs < rhs);
+}
+
+
+static b32 bench_is_selected(char const *name) {
+    b32 result = !g_options.filter || strstr(name, g_options.filter);
+    return result;
+}
+
+
+// Runs body(Bench_Clock *) once to warm up, and then until min_time_ns has been measured.
+// items_per_sample is the number of "things" (pixels, tiles, actors...) one call to body handles.
+template <typename Body>
+static void run_benchmark(char const *name, char const *params, u64 items_per_sample, Body body) {
+    if (!bench_is_selected(name))  return;
+
+    fprintf(stderr, "%s %s...\n", name, params);
+
+    Bench_Clock warm_up;
+    body(&warm_up);
+
+    static s64 samples[kBench_Max_Samples];
+    u32 sample_count = 0;
+    s64 total = 0;
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    s64 min_ticks = static_cast<s64>((g_options.min_time_ns * frequency.QuadPart) / 1000000000ull);
+
+    while (sample_count < kBench_Max_Samples && (total < min_ticks || sample_count < 3)) {
+        Bench_Clock clock;
+        body(&clock);
+        samples[sample_count++] = clock.elapsed;
+        total += clock.elapsed;
+    }
+
+    qsort(samples, sample_count, sizeof(s64), compare_s64);
+
+    double ns_per_tick = 1000000000.0 / static_cast<double>(frequency.QuadPart);
+    double min_ns    = static_cast<double>(samples[0]) * ns_per_tick;
+    double median_ns = static_cast<double>(samples[sample_count / 2]) * ns_per_tick;
+    double mean_ns   = (static_cast<double>(total) / sample_count) * ns_per_tick;
+
+    printf("%s,%s,%u,%llu,%.0f,%.0f,%.0f,%.3f\n", name, params, sample_count, static_cast<unsigned long long>(items_per_sample),
+           min_ns, median_ns, mean_ns, median_ns / static_cast<double>(items_per_sample));
+    fflush(stdout);
+}
+
+
+
+
+//
+// Synthetic levels
+//
+
+struct Text_Buffer {
+    char *data = nullptr;
+    u32 size = 0;
+    u32 capacity = 0;
+};
+
+
+static void push_text(Text_Buffer *buffer, char const *format, ...) {
+    for (;;) {
+        u32 available = buffer->capacity - buffer->size;
+        va_list args;
+        va_start(args, format);
+        int written = available > 0 ? vsnprintf(buffer->data + buffer->size, available, format, args) : -1;
+        va_end(args);
+
+        if (written >= 0 && static_cast<u32>(written) < available) {
+            buffer->size += written;
+            break;
+        }
+
+        buffer->capacity = buffer->capacity == 0 ? 4096 : 2 * buffer->capacity;
+        buffer->data = static_cast<char *>(realloc(buffer->data, buffer->capacity));
+        assert(buffer->data);
+    }
+}
+
+
+static void free_text_buffer(Text_Buffer *buffer) {
+    if (buffer->data) {
+        free(buffer->data);
+    }
+    *buffer = {};
+}
+
+
+// A width x height level in the .level_txt format: walls around the edges and a wall "pillar" on every fourth
+// tile, a small dot on every floor tile (large ones in the corners), pacman in the middle and the ghosts spread
+// out on the odd rows so that no two of them will try to move to the same tile.
+static void make_synthetic_level_text(Text_Buffer *text, u32 width, u32 height, u32 ghost_count) {
+    text->size = 0;
+    push_text(text, "Name:\"Synthetic %ux%u\"\nID:%u\nWidth:%u\nHeight:%u\n", width, height, 1000 + width, width, height);
+
+    auto is_wall = [width, height](u32 x, u32 y) -> b32 {
+        b32 result = x == 0 || y == 0 || x == (width - 1) || y == (height - 1) || ((x % 4) == 2 && (y % 4) == 2);
+        return result;
+    };
+
+    push_text(text, "Layer_tiles:\n");
+    for (u32 y = 0; y < height; ++y) {
+        for (u32 x = 0; x < width; ++x) {
+            push_text(text, "%c", is_wall(x, y) ? 'W' : '-');
+        }
+        push_text(text, "\n");
+    }
+
+    push_text(text, "Layer_items:\n");
+    for (u32 y = 0; y < height; ++y) {
+        for (u32 x = 0; x < width; ++x) {
+            b32 is_corner = (x == 1 || x == (width - 2)) && (y == 1 || y == (height - 2));
+            push_text(text, "%c", is_wall(x, y) ? '.' : (is_corner ? 'X' : '+'));
+        }
+        push_text(text, "\n");
+    }
+
+    u32 pacman_x = (width / 2) | 1;
+    u32 pacman_y = (height / 2) | 1;
+    u32 ghosts_placed = 0;
+
+    push_text(text, "Layer_actors:\n");
+    for (u32 y = 0; y < height; ++y) {
+        for (u32 x = 0; x < width; ++x) {
+            char c = '.';
+            if (x == pacman_x && y == pacman_y) {
+                c = 'P';
+            }
+            else if (!is_wall(x, y) && (y % 2) == 1 && (x % 3) == 1 && ghosts_placed < ghost_count) {
+                c = static_cast<char>('1' + (ghosts_placed % 4));
+                ++ghosts_placed;
+            }
+            push_text(text, "%c", c);
+        }
+        push_text(text, "\n");
+    }
+}
+
+
+static b32 make_synthetic_level(Level *level, Resources *resources, u32 width, u32 height, u32 ghost_count) {
+    b32 result = false;
+
+    Text_Buffer text;
+    make_synthetic_level_text(&text, width, height, ghost_count);
+
+    Tokenizer tokenizer;
+    if (init_tokenizer_from_memory(&tokenizer, "synthetic", text.data, text.size)) {
+        parse_level(level, resources, &tokenizer);
+        result = !tokenizer.error;
+        if (!result) {
+            fprintf(stderr, "%s() failed to parse the level, %s\n", __FUNCTION__, tokenizer.error_string);
+        }
+        fini_tokenizer(&tokenizer);
+    }
+
+    free_text_buffer(&text);
+
+    return result;
+}
+
+
+
+
+//
+// Benchmarks
+//
+
+static void bench_tokenizer(u32 const *sizes, u32 size_count) {
+    Text_Buffer text;
+
+    //
+    // get_token() on something that looks like the char lines of a .fnt file, the levels are parsed char by char
+    for (u32 line = 0; line < 1000; ++line) {
+        push_text(&text, "char id=%u x=%u y=%u width=%u height=%u xoffset=0 yoffset=%u xadvance=%u page=0 chnl=15\n",
+                  32 + (line % 95), (line * 13) % 256, (line * 7) % 256, 8 + (line % 9), 16 + (line % 7), line % 5, 12);
+    }
+
+    run_benchmark("tokenizer_get_token", "1000_lines", text.size, [&](Bench_Clock *clock) {
+        Tokenizer tokenizer;
+        init_tokenizer_from_memory(&tokenizer, "synthetic", text.data, text.size);
+
+        clock->begin();
+        while (!tokenizer.error && !is_eof(&tokenizer)) {
+            Token token = get_token(&tokenizer);
+            if (token.type == Token_error || token.type == Token_unknown)  break;
+        }
+        clock->end();
+
+        assert(!tokenizer.error);
+        fini_tokenizer(&tokenizer);
+    });
+
+
+    //
+    // Synthetic levels
+    for (u32 index = 0; index < size_count; ++index) {
+        u32 size = sizes[index];
+        make_synthetic_level_text(&text, size, size, 4);
+
+        char params[32];
+        _snprintf_s(params, sizeof(params), _TRUNCATE, "%ux%u", size, size);
+
+        run_benchmark("parse_level", params, text.size, [&](Bench_Clock *clock) {
+            Tokenizer tokenizer;
+            init_tokenizer_from_memory(&tokenizer, "synthetic", text.data, text.size);
+            Level level;
+
+            clock->begin();
+            parse_level(&level, nullptr, &tokenizer);
+            clock->end();
+
+            fini_level(&level);
+            fini_tokenizer(&tokenizer);
+        });
+    }
+
+    free_text_buffer(&text);
+}
+
+
+static void bench_maps(u32 const *sizes, u32 size_count) {
+    for (u32 index = 0; index < size_count; ++index) {
+        u32 size = sizes[index];
+        Level level;
+        if (!make_synthetic_level(&level, nullptr, size, size, 4))  continue;
+
+        char params[32];
+        _snprintf_s(params, sizeof(params), _TRUNCATE, "%ux%u", size, size);
+        u32 tile_count = size * size;
+
+        // Seed a map the same way create_maps_off_level() does for the small dots
+        s32 *seed = static_cast<s32 *>(malloc(tile_count * sizeof(s32)));
+        s32 *map  = static_cast<s32 *>(malloc(tile_count * sizeof(s32)));
+        Tile *tiles = level.current_state->tiles;
+        for (u32 tile_index = 0; tile_index < tile_count; ++tile_index) {
+            b32 has_dot = tile_is_traversable(&tiles[tile_index]) && tiles[tile_index].item.type == Item_Type_Dot_Small;
+            seed[tile_index] = has_dot && (tile_index % 97) == 0 ? 0 : 300;
+        }
+
+        run_benchmark("process_map", params, tile_count, [&](Bench_Clock *clock) {
+            memcpy(map, seed, tile_count * sizeof(s32));
+            clock->begin();
+            process_map(map, tiles, size, size, 300);
+            clock->end();
+        });
+
+        run_benchmark("build_maps", params, tile_count, [&](Bench_Clock *clock) {
+            clock->begin();
+            create_maps_off_level(&level);
+            for (u32 map_index = 0; map_index < Map_Count; ++map_index) {
+                get_map(&level, static_cast<Map_Type>(map_index));
+            }
+            clock->end();
+        });
+
+        // What get_pacman_move() asks for, from the distance table when the level has one. Items are queries.
+        Actor *pacman = get_pacman(&level);
+        if (pacman) {
+            run_benchmark("get_shortest_direction_on_map", params, Map_Count, [&](Bench_Clock *clock) {
+                create_maps_off_level(&level);
+                clock->begin();
+                for (u32 map_index = 0; map_index < Map_Count; ++map_index) {
+                    get_shortest_direction_on_map(&level, static_cast<Map_Type>(map_index), pacman);
+                }
+                clock->end();
+            });
+        }
+
+        run_benchmark("copy_level_state", params, tile_count, [&](Bench_Clock *clock) {
+            Level_State state;
+            clock->begin();
+            copy_level_state(&state, level.current_state);
+            clock->end();
+            free_level_state(&state);
+        });
+
+        free(seed);
+        free(map);
+        fini_level(&level);
+    }
+}
+
+
+static void bench_moves(u32 const *ghost_counts, u32 ghost_count_count) {
+    for (u32 index = 0; index < ghost_count_count; ++index) {
+        u32 ghost_count = ghost_counts[index];
+        Level level;
+        if (!make_synthetic_level(&level, nullptr, 64, 64, ghost_count))  continue;
+        create_maps_off_level(&level);
+
+        char params[32];
+        _snprintf_s(params, sizeof(params), _TRUNCATE, "64x64/%u_ghosts", ghost_count);
+
+        Array_Of_Moves moves;
+        init_array_of_moves(&moves);
+        Input input = Input_Right;
+
+        run_benchmark("resolve_all_moves", params, ghost_count + 1, [&](Bench_Clock *clock) {
+            collect_all_moves(&moves, &input, &level);
+            clock->begin();
+            resolve_all_moves(&moves, &level);
+            clock->end();
+            cancel_moves(&moves, &level);
+            clear_array_of_moves(&moves);
+        });
+
+        free_array_of_moves(&moves);
+        fini_level(&level);
+    }
+}
+
+
+// A* and IDA* on synthetic levels with one ghost, items are the nodes expanded by the search
+static void bench_solver(u32 const *sizes, u32 size_count) {
+    for (u32 index = 0; index < size_count; ++index) {
+        u32 size = sizes[index];
+        Level level;
+        if (!make_synthetic_level(&level, nullptr, size, size, 1))  continue;
+
+        char params[32];
+        _snprintf_s(params, sizeof(params), _TRUNCATE, "%ux%u/1_ghost", size, size);
+
+        Solver solver;
+        Solve_Result result;
+        Solver_Options options;
+        init_solver(&solver, &level, &level.original_state);
+
+        for (u32 method = 0; method < Solver_Method_Count; ++method) {
+            if (method == Solver_Method_IDA_Star && size > 11)  continue; // Seconds a sample, see solver.cpp
+
+            options.method = static_cast<Solver_Method>(method);
+            solve_level(&solver, &options, &result);
+            fprintf(stderr, "%s %s, %u turns\n", params, get_solve_status_name(result.status), result.input_count);
+
+            run_benchmark(method == Solver_Method_A_Star ? "solve_a_star" : "solve_ida_star", params, result.nodes_expanded, [&](Bench_Clock *clock) {
+                clock->begin();
+                solve_level(&solver, &options, &result);
+                clock->end();
+            });
+        }
+
+        free_solver(&solver);
+        fini_level(&level);
+    }
+}
+
+
+static void bench_blend() {
+    u32 constexpr pixel_count = 1 << 20;
+    u32 *dst = static_cast<u32 *>(malloc(pixel_count * sizeof(u32)));
+    u32 *src = static_cast<u32 *>(malloc(pixel_count * sizeof(u32)));
+
+    u32 random = 0x12345678;
+    for (u32 index = 0; index < pixel_count; ++index) {
+        random = random * 1664525 + 1013904223; // LCG
+        src[index] = random;
+        dst[index] = random ^ 0x5A5A5A5A;
+    }
+
+    run_benchmark("fp_lerp_premul", "1M_pixels", pixel_count, [&](Bench_Clock *clock) {
+        clock->begin();
+        for (u32 index = 0; index < pixel_count; ++index)  dst[index] = fp_lerp_premul(dst[index], src[index]);
+        clock->end();
+    });
+
+    run_benchmark("fp_lerp_non_premul_src", "1M_pixels", pixel_count, [&](Bench_Clock *clock) {
+        clock->begin();
+        for (u32 index = 0; index < pixel_count; ++index)  dst[index] = fp_lerp_non_premul_src(dst[index], src[index]);
+        clock->end();
+    });
+
+    run_benchmark("fp_mul_non_premul_src", "1M_pixels", pixel_count, [&](Bench_Clock *clock) {
+        clock->begin();
+        for (u32 index = 0; index < pixel_count; ++index)  dst[index] = fp_mul_non_premul_src(dst[index], src[index]);
+        clock->end();
+    });
+
+    // Keep the compiler from throwing the loops away
+    u32 checksum = 0;
+    for (u32 index = 0; index < pixel_count; ++index)  checksum ^= dst[index];
+    fprintf(stderr, "blend checksum: %08x\n", checksum);
+
+    free(dst);
+    free(src);
+}
+
+
+static void bench_mixer(u32 const *voice_counts, u32 voice_count_count) {
+    //
+    // One second of 24-bit stereo noise, decoded like the wavs in data\audio
+    u32 constexpr frame_count = kMixer_Sample_Rate;
+    Wav wav;
+    wav.type = Wav_Type_Wave;
+    wav.format.audio_format = Wav_Audio_Format_PCM;
+    wav.format.number_of_channels = 2;
+    wav.format.sample_rate = kMixer_Sample_Rate;
+    wav.format.bits_per_sample = 24;
+    wav.format.block_align = 6;
+    wav.format.average_bytes_per_second = kMixer_Sample_Rate * 6;
+    wav.data_size = frame_count * 6;
+    wav.data = static_cast<u8 *>(malloc(wav.data_size));
+
+    u32 random = 0x12345678;
+    for (size_t index = 0; index < wav.data_size; ++index) {
+        random = random * 1664525 + 1013904223; // LCG
+        wav.data[index] = static_cast<u8>(random >> 24);
+    }
+
+    Mixer *mixer = new Mixer;
+    init_mixer(mixer, kMixer_Sample_Rate);
+
+    run_benchmark("decode_wav", "s24_stereo/1s", frame_count, [&](Bench_Clock *clock) {
+        Mixer_Sound sound;
+        clock->begin();
+        decode_wav(mixer, &wav, &sound);
+        clock->end();
+        free(sound.samples);
+    });
+
+    //
+    // The offline conversion, the same samples played at 44.1 kHz, and decoding its result
+    Wav canonical_wav;
+    wav.format.sample_rate = 44100;
+    wav.format.average_bytes_per_second = 44100 * 6;
+    run_benchmark("convert_wav", "s24_stereo_44100/1s", frame_count, [&](Bench_Clock *clock) {
+        Wav output;
+        clock->begin();
+        convert_wav_to_canonical(&wav, &output);
+        clock->end();
+        free_wav(&output);
+    });
+    convert_wav_to_canonical(&wav, &canonical_wav);
+    wav.format.sample_rate = kMixer_Sample_Rate;
+    wav.format.average_bytes_per_second = kMixer_Sample_Rate * 6;
+
+    run_benchmark("decode_wav", "canonical/1s", frame_count, [&](Bench_Clock *clock) {
+        Mixer_Sound sound;
+        clock->begin();
+        decode_wav(mixer, &canonical_wav, &sound);
+        clock->end();
+        free(sound.samples);
+    });
+    free_wav(&canonical_wav);
+
+    u32 constexpr buffer_frames = 512;
+    f32 buffer[buffer_frames * kMixer_Channel_Count];
+
+    for (u32 index = 0; index < voice_count_count; ++index) {
+        u32 voice_count = voice_counts[index];
+
+        char params[64];
+        _snprintf_s(params, sizeof(params), _TRUNCATE, "%u_frames/%u_voices", buffer_frames, voice_count);
+        run_benchmark("mix_audio", params, buffer_frames * voice_count, [&](Bench_Clock *clock) {
+            while (mixer->voice_count + (mixer->command_write - mixer->command_read) < voice_count) {
+                mixer_play(mixer, &wav, 0.25f);
+            }
+
+            clock->begin();
+            mix_audio(mixer, buffer, buffer_frames);
+            clock->end();
+        });
+
+        mixer_stop_all(mixer);
+        mix_audio(mixer, buffer, buffer_frames);
+    }
+
+    fini_mixer(mixer);
+    delete mixer;
+    free_wav(&wav);
+}
+
+
+static void bench_renderer(Log *log) {
+    Resources resources;
+    if (!init_resources(&resources)) {
+        fprintf(stderr, "failed to load the resources, skipping the renderer benchmarks (run from the run_tree)\n");
+        return;
+    }
+
+    u32 constexpr size = kLevel_Size * kCell_Size;
+    Renderer_Software_Headless renderer;
+    if (renderer.init(log, size, size)) {
+        Sprite *ghost = &resources.sprites.sprites[Sprite_Ghost_Red];
+        u32 ghost_pixels = ghost->width * ghost->height;
+
+        run_benchmark("clear", "704x704", size * size, [&](Bench_Clock *clock) {
+            clock->begin();
+            renderer.clear(v4u8_black);
+            clock->end();
+        });
+
+        run_benchmark("draw_filled_rectangle", "704x704_opaque", size * size, [&](Bench_Clock *clock) {
+            clock->begin();
+            renderer.draw_filled_rectangle(V2u(0, 0), size, size, v4u8_blue);
+            clock->end();
+        });
+
+        run_benchmark("draw_filled_rectangle", "704x704_translucent", size * size, [&](Bench_Clock *clock) {
+            clock->begin();
+            renderer.draw_filled_rectangle(V2u(0, 0), size, size, V4u8(40, 80, 120, 128));
+            clock->end();
+        });
+
+        run_benchmark("draw_bitmap", "font_256x256/9", 9 * 256 * 256, [&](Bench_Clock *clock) {
+            clock->begin();
+            for (u32 index = 0; index < 9; ++index) {
+                renderer.draw_bitmap(V2u((index % 3) * 230, (index / 3) * 230), &resources.font.bitmap);
+            }
+            clock->end();
+        });
+
+        run_benchmark("draw_sprite", "ghost_red/121_cells", 121 * ghost_pixels, [&](Bench_Clock *clock) {
+            clock->begin();
+            for (u32 y = 0; y < kLevel_Size; ++y) {
+                for (u32 x = 0; x < kLevel_Size; ++x) {
+                    draw_sprite(&renderer, &resources, Sprite_Ghost_Red, V2u(x * kCell_Size, y * kCell_Size));
+                }
+            }
+            clock->end();
+        });
+
+        // The same without the spans, every pixel is blended
+        run_benchmark("draw_bitmap_sub_rect", "ghost_red/121_cells", 121 * ghost_pixels, [&](Bench_Clock *clock) {
+            clock->begin();
+            for (u32 y = 0; y < kLevel_Size; ++y) {
+                for (u32 x = 0; x < kLevel_Size; ++x) {
+                    renderer.draw_bitmap(V2u(x * kCell_Size, y * kCell_Size), &resources.sprites.atlas, ghost->x, ghost->y, ghost->x + ghost->width, ghost->y + ghost->height);
+                }
+            }
+            clock->end();
+        });
+
+        run_benchmark("draw_sprite_sub_rect", "wall_atlas/121_cells", 121 * kCell_Size * kCell_Size, [&](Bench_Clock *clock) {
+            clock->begin();
+            for (u32 y = 0; y < kLevel_Size; ++y) {
+                for (u32 x = 0; x < kLevel_Size; ++x) {
+                    u32 x0 = kCell_Size * ((x + y) % 4);
+                    draw_sprite(&renderer, &resources, Sprite_Wall_Atlas, V2u(x * kCell_Size, y * kCell_Size), x0, 0, x0 + kCell_Size, kCell_Size);
+                }
+            }
+            clock->end();
+        });
+
+        char const *text = "Score 12345, the quick brown fox jumps over the lazy dog";
+        u32 text_length = static_cast<u32>(strlen(text));
+        run_benchmark("print", "56_chars/10_lines", 10 * text_length, [&](Bench_Clock *clock) {
+            clock->begin();
+            for (u32 line = 0; line < 10; ++line) {
+                renderer.print(&resources.font, V2u(10, 10 + line * 40), text, v4u8_yellow);
+            }
+            clock->end();
+        });
+
+        // A new string every line, so every print() misses the text cache
+        u32 score = 0;
+        run_benchmark("print_uncached", "56_chars/10_lines", 10 * text_length, [&](Bench_Clock *clock) {
+            char lines[10][64];
+            for (u32 line = 0; line < 10; ++line) {
+                _snprintf_s(lines[line], 64, _TRUNCATE, "Score %05u, the quick brown fox jumps over the lazy dog", score++ % 100000);
+            }
+
+            clock->begin();
+            for (u32 line = 0; line < 10; ++line) {
+                renderer.print(&resources.font, V2u(10, 10 + line * 40), lines[line], v4u8_yellow);
+            }
+            clock->end();
+        });
+
+        run_benchmark("print_glyphs", "56_chars/10_lines", 10 * text_length, [&](Bench_Clock *clock) {
+            clock->begin();
+            for (u32 line = 0; line < 10; ++line) {
+                renderer.print_glyphs(&resources.font, V2u(10, 10 + line * 40), text, v4u8_yellow);
+            }
+            clock->end();
+        });
+
+        //
+        // A whole level, drawn straight away and recorded for the render thread (see render_thread.cpp),
+        // items are frames
+        Array_Of_Levels levels;
+        if (load_levels_from_disc(&levels, &resources) > 0) {
+            Level *level = &levels.data[0];
+            create_maps_off_level(level);
+
+            run_benchmark("draw_level", "level_0", 1, [&](Bench_Clock *clock) {
+                clock->begin();
+                renderer.clear(v4u8_black);
+                draw_level(&renderer, level, Level_Render_Mode_All, 0);
+                clock->end();
+            });
+
+            Render_Frame frame;
+            Renderer_Recorder recorder;
+            recorder.init(log, size, size);
+            recorder.frame = &frame;
+            run_benchmark("record_render_frame", "level_0", 1, [&](Bench_Clock *clock) {
+                clock->begin();
+                frame.command_count = 0;
+                frame.text_size = 0;
+                recorder.clear(v4u8_black);
+                draw_level(&recorder, level, Level_Render_Mode_All, 0);
+                clock->end();
+            });
+            free_render_frame(&frame);
+        }
+        free_array_of_levels(&levels);
+
+        //
+        // Scaling the frame to the window, items are output pixels
+        u32 *window = static_cast<u32 *>(calloc(2560 * 1440, sizeof(u32)));
+        if (window) {
+            Scaler scaler;
+            Scale_Mode const modes[] = {Scale_Mode_Fit_Nearest, Scale_Mode_Integer, Scale_Mode_Fit_Bilinear};
+            char const *names[]      = {"704->2560x1440_fit_nearest", "704->2560x1440_integer", "704->2560x1440_fit_bilinear"};
+            for (u32 index = 0; index < Array_Count(modes); ++index) {
+                scaler.mode = modes[index];
+                Scale_Rect rect = get_scale_rect(scaler.mode, size, size, 2560, 1440);
+                run_benchmark("scale_frame", names[index], rect.width * rect.height, [&](Bench_Clock *clock) {
+                    clock->begin();
+                    scale_frame(&scaler, reinterpret_cast<u32 *>(renderer.backbuffer_memory), size, size, window, 2560, 1440);
+                    clock->end();
+                });
+            }
+            free_scaler(&scaler);
+            free(window);
+        }
+    }
+
+    free_resources(&resources);
+}
+
+
+
+
+//
+// Main
+//
+
+int main(int argc, char **argv) {
+    for (int index = 1; index < argc; ++index) {
+        if (strcmp(argv[index], "-filter") == 0 && (index + 1) < argc) {
+            g_options.filter = argv[++index];
+        }
+        else if (strcmp(argv[index], "-min_time") == 0 && (index + 1) < argc) {
+            g_options.min_time_ns = strtoull(argv[++index], nullptr, 10) * 1000000ull;
+        }
+        else if (strcmp(argv[index], "-quick") == 0) {
+            g_options.quick = true;
+            g_options.min_time_ns = 20 * 1000000ull;
+        }
+        else {
+            fprintf(stderr, "Usage: %s [-filter <substring>] [-min_time <milliseconds>] [-quick]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    Log log;
+    log.print_log = true;
+
+    u32 const sizes[] = {11, 32, 64, 128, 256, 512, 1024};
+    u32 size_count = g_options.quick ? 4 : Array_Count(sizes);
+    u32 const ghost_counts[] = {4, 16, 64, 256};
+    u32 const solver_sizes[] = {11, 31};
+    u32 const voice_counts[] = {1, 8, 64, 256};
+
+    printf("benchmark,params,samples,items_per_sample,min_ns,median_ns,mean_ns,median_ns_per_item\n");
+
+    bench_tokenizer(sizes, size_count);
+    bench_maps(sizes, size_count);
+    bench_moves(ghost_counts, Array_Count(ghost_counts));
+    bench_solver(solver_sizes, g_options.quick ? 1 : Array_Count(solver_sizes));
+    bench_blend();
+    bench_renderer(&log);
+    bench_mixer(voice_counts, Array_Count(voice_counts));
+
+    return 0;
+}
@@ -35,6 +35,7 @@ struct Bmp {
     u8 *data = nullptr;
     size_t row_size = 0;
     size_t data_size = 0;
+    b32 is_mapped = false; // data points into a memory-mapped file (see pak.cpp) and isn't ours to free
 };
 
 
@@ -43,8 +44,8 @@ b32 load_bitmap(char const *path_and_name, Bmp *output) {
 
     //
     // Load file
-    u8 *data;
-    u32 data_size;
+    u8 *data = nullptr; // Left as it is when the file can't be opened
+    u32 data_size = 0;
     result = win32_read_entire_file(path_and_name, &data, &data_size);
 
     
@@ -87,10 +88,174 @@ b32 load_bitmap(char const *path_and_name, Bmp *output) {
 
 void free_bitmap(Bmp *bmp) {
     if (bmp && bmp->data) {
-        free(bmp->data);
+        if (!bmp->is_mapped)  free(bmp->data);
         bmp->data = nullptr;
         bmp->data_size = 0;
         bmp->row_size = 0;
+        bmp->is_mapped = false;
     }    
     memset(&bmp->header, 0, sizeof(Bitmap_info_header));
 }
+
+
+// pixels is width * height, 32 bits per pixel, bottom-up
+b32 write_bitmap_to_disc(char const *path_and_name, u32 const *pixels, u32 width, u32 height) {
+    b32 result = false;
+
+    u32 image_size = width * height * sizeof(u32);
+
+    Bitmap_file_header file_header = {};
+    file_header.type = 0x4d42;
+    file_header.offset_bits = sizeof(Bitmap_file_header) + sizeof(Bitmap_info_header);
+    file_header.size = file_header.offset_bits + image_size;
+
+    Bitmap_info_header header = {};
+    header.size = sizeof(Bitmap_info_header);
+    header.width = static_cast<s32>(width);
+    header.height = static_cast<s32>(height);
+    header.planes = 1;
+    header.bits_per_pixel = 32;
+    header.sizeof_image = image_size;
+
+    HANDLE file_handle;
+    if (win32_open_file_for_writing(path_and_name, &file_handle)) {
+        DWORD bytes_written = 0;
+        result = WriteFile(file_handle, &file_header, sizeof(file_header), &bytes_written, nullptr) && bytes_written == sizeof(file_header);
+        result = result && WriteFile(file_handle, &header, sizeof(header), &bytes_written, nullptr) && bytes_written == sizeof(header);
+        result = result && WriteFile(file_handle, pixels, image_size, &bytes_written, nullptr) && bytes_written == image_size;
+
+        if (!result) {
+            printf("%s() failed to write %s\n", __FUNCTION__, path_and_name);
+        }
+
+        CloseHandle(file_handle);
+    }
+
+    return result;
+}
+
+
+
+
+//
+// Spans
+//
+// A rectangle of a 32-bit, premultiplied bitmap as runs of pixels per row, so that blitting only touches the
+// pixels that can change the destination. Pixels that are all zero add nothing and are left out, pixels
+// with full alpha replace the destination and are copied, everything else is blended.
+//
+
+enum Bitmap_Span_Type : u16 {
+    Bitmap_Span_Type_Opaque = 0,
+    Bitmap_Span_Type_Blend,
+};
+
+
+struct Bitmap_Span {
+    u16 x;      // From the left of the rectangle
+    u16 length;
+    u16 type;
+    u16 unused;
+};
+
+
+struct Bitmap_Spans {
+    u32 *row_starts = nullptr;   // height + 1 entries, the spans of row y are [row_starts[y], row_starts[y + 1][
+    Bitmap_Span *spans = nullptr;
+    u32 span_count = 0;
+    u32 x = 0;                   // The rectangle in the bitmap
+    u32 y = 0;
+    u32 width = 0;
+    u32 height = 0;
+};
+
+
+static Bitmap_Span_Type get_span_type(u32 pixel, b32 *is_skipped) {
+    *is_skipped = pixel == 0;
+    Bitmap_Span_Type result = (pixel >> 24) == 0xFF ? Bitmap_Span_Type_Opaque : Bitmap_Span_Type_Blend;
+    return result;
+}
+
+
+// Returns the number of spans in the rectangle, and writes them if row_starts and spans aren't nullptr
+static u32 encode_bitmap_spans(Bmp const *bitmap, u32 x0, u32 y0, u32 width, u32 height, u32 *row_starts, Bitmap_Span *spans) {
+    u32 result = 0;
+
+    for (u32 y = 0; y < height; ++y) {
+        u32 const *row = reinterpret_cast<u32 const *>(bitmap->data) + ((y0 + y) * bitmap->header.width) + x0;
+        if (row_starts)  row_starts[y] = result;
+
+        u32 x = 0;
+        while (x < width) {
+            b32 is_skipped;
+            Bitmap_Span_Type type = get_span_type(row[x], &is_skipped);
+            u32 start = x++;
+
+            while (x < width) {
+                b32 next_is_skipped;
+                Bitmap_Span_Type next_type = get_span_type(row[x], &next_is_skipped);
+                if (next_is_skipped != is_skipped || (!is_skipped && next_type != type))  break;
+                ++x;
+            }
+
+            if (!is_skipped) {
+                if (spans) {
+                    Bitmap_Span *span = &spans[result];
+                    span->x = static_cast<u16>(start);
+                    span->length = static_cast<u16>(x - start);
+                    span->type = static_cast<u16>(type);
+                    span->unused = 0;
+                }
+                ++result;
+            }
+        }
+    }
+
+    if (row_starts)  row_starts[height] = result;
+
+    return result;
+}
+
+
+void free_bitmap_spans(Bitmap_Spans *spans) {
+    if (spans->row_starts) {
+        free(spans->row_starts); // The spans are in the same block
+    }
+    *spans = {};
+}
+
+
+b32 build_bitmap_spans(Bmp const *bitmap, u32 x, u32 y, u32 width, u32 height, Bitmap_Spans *output) {
+    b32 result = false;
+    free_bitmap_spans(output);
+
+    if (!bitmap->data || bitmap->header.bits_per_pixel != 32 || width > 0xFFFF ||
+        (x + width) > static_cast<u32>(bitmap->header.width) || (y + height) > static_cast<u32>(bitmap->header.height)) {
+        printf("%s() the rectangle isn't in a 32-bit bitmap\n", __FUNCTION__);
+        return result;
+    }
+
+    u32 span_count = encode_bitmap_spans(bitmap, x, y, width, height, nullptr, nullptr);
+
+    size_t row_starts_size = (height + 1) * sizeof(u32);
+    row_starts_size = (row_starts_size + 7) & ~static_cast<size_t>(7);
+    u8 *memory = static_cast<u8 *>(malloc(row_starts_size + (span_count * sizeof(Bitmap_Span))));
+    if (!memory) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        return result;
+    }
+
+    output->row_starts = reinterpret_cast<u32 *>(memory);
+    output->spans = reinterpret_cast<Bitmap_Span *>(memory + row_starts_size);
+    output->span_count = span_count;
+    output->x = x;
+    output->y = y;
+    output->width = width;
+    output->height = height;
+
+    encode_bitmap_spans(bitmap, x, y, width, height, output->row_starts, output->spans);
+
+    result = true;
+
+    return result;
+}
@@ -67,7 +67,7 @@ REM ----------------------------------------------------------------------------
 REM Linker Options
 REM https://docs.microsoft.com/en-us/cpp/build/reference/linker-options?view=vs-2017
 
-SET LinkerLibs=user32.lib gdi32.lib
+SET LinkerLibs=user32.lib gdi32.lib shell32.lib
 REM Temp: winmm.lib kernel32.lib ole32.lib
 
 SET AdditionalLinkerLibs=xaudio2_9redist.lib
@@ -0,0 +1,38 @@
+#!/bin/sh
+#
+# Builds the Linux tools on Linux, the game itself is built with build.bat.
+#     bench    - microbenchmarks of the hot kernels (bench_main.cpp)
+#     headless - runs the game without a window or a sound device (headless_main.cpp)
+#     fuzz_levels, fuzz_moves - fuzz targets for the level loader and the move resolver (fuzz_main.cpp), with
+#                               libFuzzer when clang has it, otherwise with the stand-in driver in fuzz_main.cpp
+#
+# Usage (from the code directory):
+#     ./build_linux.sh
+#     cd ../run_tree && ../build/bench > bench.csv
+#     cd ../run_tree && ../build/headless -replay data/replays/<name>.replay -audio_out replay.wav
+#     cd ../run_tree && ../build/fuzz_moves -max_len=1024 fuzz/moves     (libFuzzer)
+#     cd ../run_tree && ../build/fuzz_moves -max_len 1024 -runs 100000  (the stand-in, see fuzz_main.cpp)
+#
+
+set -e
+
+CompilerOptions="-std=c++17 -O2 -g -DRELEASE=1 -pthread -fno-strict-aliasing -Wall -Wno-unused-function -Wno-unused-variable -Wno-unused-but-set-variable -Wno-write-strings -Wno-missing-braces -Wno-switch -Wno-multichar -Wno-sign-compare -Wno-class-memaccess"
+
+mkdir -p ../build
+echo "Building bench..."
+${CXX:-g++} ${CompilerOptions} bench_main.cpp -o ../build/bench
+echo "Building headless..."
+${CXX:-g++} ${CompilerOptions} headless_main.cpp -o ../build/headless
+
+FuzzOptions="${CompilerOptions} -O1 -fno-omit-frame-pointer -fsanitize=address,undefined"
+FuzzCompiler=${FUZZ_CXX:-clang++}
+if echo 'extern "C" int LLVMFuzzerTestOneInput(const unsigned char *, unsigned long) { return 0; }' | \
+   ${FuzzCompiler} -x c++ -fsanitize=fuzzer - -o /dev/null >/dev/null 2>&1; then
+    FuzzOptions="${FuzzOptions} -fsanitize=fuzzer -DFUZZ_LIBFUZZER=1"
+else
+    echo "No libFuzzer in ${FuzzCompiler}, the fuzz targets get the stand-in driver"
+    FuzzCompiler=${CXX:-g++}
+fi
+echo "Building fuzz_levels and fuzz_moves..."
+${FuzzCompiler} ${FuzzOptions} -DFUZZ_LEVELS=1 fuzz_main.cpp -o ../build/fuzz_levels
+${FuzzCompiler} ${FuzzOptions} fuzz_main.cpp -o ../build/fuzz_moves
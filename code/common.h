@@ -0,0 +1,56 @@
+//
+// Common constants and types, shared by all the platform layers
+//
+
+#define kFrame_Time 16667 // in microseconds (for some reason)
+
+#define kCell_Size 64
+#define kLevel_Size 11
+#define kLevel_Max_Size 1024 // Width and height of the levels that load, the solver has a smaller limit (see init_solver())
+
+#define kLevel_Name_Max_Length 31
+#define kLevel_Max_Actors 100 // DEBUG
+
+#define kDot_Small_Value 10
+#define kDot_Large_Value 50
+#define kGhost_Value 200
+
+#define kPredator_Mode_Duration 10
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+
+
+
+//
+// Types
+//
+
+//
+// Scalars
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+
+typedef int8_t  s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+typedef u32 b32;
+
+typedef float  f32;
+typedef double f64;
+
+f32 clamp_01(f32 a) {
+    f32 result = (a < 0.0f ? 0.0f : (a > 1.0f ? 1.0f : a));
+    return result;
+}
+
+#define Array_Count(x) sizeof(x) / sizeof(x[0])
@@ -0,0 +1,201 @@
+//
+// Distance oracle
+//
+// The walls never change during play, so the distances between the floor tiles of a level don't either.
+// The oracle holds all of them in a table, built once when the level's topology is new to it, so that
+// "how far is the nearest ghost (or dot) from here" is a minimum over the sources instead of a flood
+// fill of the whole level (see get_map_values() in level.cpp).
+//
+// Only levels with up to kDistance_Oracle_Max_Cells floor tiles get a table, it grows with the square of
+// the floor tiles. Bigger levels, which only the editor and the benchmarks make, build their maps with
+// process_map() instead. All levels get the connected areas of floor tiles, which nothing can leave.
+//
+
+#define kDistance_Oracle_Max_Cells 1024     // 2 MB of distances
+#define kDistance_Unreachable      0xFFFF   // Between tiles that aren't connected
+#define kDistance_No_Area          0xFFFFFFFF
+
+
+struct Distance_Oracle {
+    u8  *traversable  = nullptr; // Per tile, the topology the table was built for
+    s32 *cell_of_tile = nullptr; // Per tile, its index among the floor tiles, -1 for the others
+    u32 *tile_of_cell = nullptr;
+    u16 *table        = nullptr; // cell_count x cell_count, nullptr if the level is too big
+    u32 *queue        = nullptr; // cell_count, for building the table and for the queries in level.cpp
+    s32 *values       = nullptr; // cell_count, for the queries in level.cpp
+    u32 *area_of_cell = nullptr; // cell_count, the connected area of floor tiles it is in
+    u32 width      = 0;
+    u32 height     = 0;
+    u32 cell_count = 0;
+    u32 area_count = 0;
+};
+
+
+static void free_distance_oracle(Distance_Oracle *oracle) {
+    if (oracle->traversable)   free(oracle->traversable);
+    if (oracle->cell_of_tile)  free(oracle->cell_of_tile);
+    if (oracle->tile_of_cell)  free(oracle->tile_of_cell);
+    if (oracle->table)         free(oracle->table);
+    if (oracle->queue)         free(oracle->queue);
+    if (oracle->values)        free(oracle->values);
+    if (oracle->area_of_cell)  free(oracle->area_of_cell);
+    *oracle = {};
+}
+
+
+inline u32 get_distance(Distance_Oracle const *oracle, u32 cell_a, u32 cell_b) {
+    u32 result = oracle->table[(cell_a * oracle->cell_count) + cell_b];
+    return result;
+}
+
+
+// Returns true if the tiles are in the same connected area, false if either isn't a floor tile
+inline b32 tiles_are_connected(Distance_Oracle const *oracle, u32 tile_a, u32 tile_b) {
+    s32 cell_a = oracle->cell_of_tile[tile_a];
+    s32 cell_b = oracle->cell_of_tile[tile_b];
+    b32 result = cell_a >= 0 && cell_b >= 0 && oracle->area_of_cell[cell_a] == oracle->area_of_cell[cell_b];
+    return result;
+}
+
+
+// Flood fills the floor tiles that haven't got an area yet, one area at a time
+static void fill_areas(Distance_Oracle *oracle) {
+    s32 constexpr X[] = {1, 0, -1, 0};
+    s32 constexpr Y[] = {0, 1, 0, -1};
+
+    for (u32 cell = 0; cell < oracle->cell_count; ++cell) {
+        oracle->area_of_cell[cell] = kDistance_No_Area;
+    }
+    oracle->area_count = 0;
+
+    for (u32 cell = 0; cell < oracle->cell_count; ++cell) {
+        if (oracle->area_of_cell[cell] != kDistance_No_Area)  continue;
+
+        u32 area = oracle->area_count++;
+        u32 head = 0;
+        u32 tail = 0;
+        oracle->area_of_cell[cell] = area;
+        oracle->queue[tail++] = cell;
+
+        while (head < tail) {
+            u32 tile = oracle->tile_of_cell[oracle->queue[head++]];
+            s32 x = static_cast<s32>(tile % oracle->width);
+            s32 y = static_cast<s32>(tile / oracle->width);
+
+            for (u32 direction = 0; direction < 4; ++direction) {
+                s32 next_x = x + X[direction];
+                s32 next_y = y + Y[direction];
+                if (next_x < 0 || next_y < 0 || next_x >= static_cast<s32>(oracle->width) || next_y >= static_cast<s32>(oracle->height))  continue;
+
+                s32 next_cell = oracle->cell_of_tile[(next_y * oracle->width) + next_x];
+                if (next_cell >= 0 && oracle->area_of_cell[next_cell] == kDistance_No_Area) {
+                    oracle->area_of_cell[next_cell] = area;
+                    oracle->queue[tail++] = static_cast<u32>(next_cell);
+                }
+            }
+        }
+    }
+}
+
+
+// Breadth first from cell, into its row of the table
+static void fill_distance_table_row(Distance_Oracle *oracle, u32 cell) {
+    s32 constexpr X[] = {1, 0, -1, 0};
+    s32 constexpr Y[] = {0, 1, 0, -1};
+
+    u16 *row = &oracle->table[cell * oracle->cell_count];
+    for (u32 index = 0; index < oracle->cell_count; ++index) {
+        row[index] = kDistance_Unreachable;
+    }
+
+    u32 head = 0;
+    u32 tail = 0;
+    row[cell] = 0;
+    oracle->queue[tail++] = cell;
+
+    while (head < tail) {
+        u32 curr_cell = oracle->queue[head++];
+        u32 tile = oracle->tile_of_cell[curr_cell];
+        s32 x = static_cast<s32>(tile % oracle->width);
+        s32 y = static_cast<s32>(tile / oracle->width);
+
+        for (u32 direction = 0; direction < 4; ++direction) {
+            s32 next_x = x + X[direction];
+            s32 next_y = y + Y[direction];
+            if (next_x < 0 || next_y < 0 || next_x >= static_cast<s32>(oracle->width) || next_y >= static_cast<s32>(oracle->height))  continue;
+
+            s32 next_cell = oracle->cell_of_tile[(next_y * oracle->width) + next_x];
+            if (next_cell >= 0 && row[next_cell] == kDistance_Unreachable) {
+                row[next_cell] = static_cast<u16>(row[curr_cell] + 1);
+                oracle->queue[tail++] = static_cast<u32>(next_cell);
+            }
+        }
+    }
+}
+
+
+// Rebuilds the oracle if the floor tiles aren't the ones it was built for. Returns true if there is a table.
+static b32 update_distance_oracle(Distance_Oracle *oracle, Tile *tiles, u32 width, u32 height) {
+    PROFILE_FUNCTION();
+    b32 result = false;
+
+    u32 tile_count = width * height;
+    b32 is_current = oracle->traversable && oracle->width == width && oracle->height == height;
+    for (u32 index = 0; is_current && index < tile_count; ++index) {
+        is_current = (oracle->traversable[index] != 0) == (tile_is_traversable(&tiles[index]) != 0);
+    }
+
+    if (!is_current) {
+        free_distance_oracle(oracle);
+
+        oracle->width = width;
+        oracle->height = height;
+        oracle->traversable  = static_cast<u8 *>(malloc(tile_count > 0 ? tile_count : 1));
+        oracle->cell_of_tile = static_cast<s32 *>(malloc((tile_count > 0 ? tile_count : 1) * sizeof(s32)));
+        if (!oracle->traversable || !oracle->cell_of_tile) {
+            printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+            free_distance_oracle(oracle);
+            return result;
+        }
+
+        for (u32 index = 0; index < tile_count; ++index) {
+            b32 is_traversable = tile_is_traversable(&tiles[index]);
+            oracle->traversable[index] = is_traversable ? 1 : 0;
+            oracle->cell_of_tile[index] = is_traversable ? static_cast<s32>(oracle->cell_count++) : -1;
+        }
+
+        u32 cell_count = oracle->cell_count > 0 ? oracle->cell_count : 1;
+        oracle->tile_of_cell = static_cast<u32 *>(malloc(cell_count * sizeof(u32)));
+        oracle->queue        = static_cast<u32 *>(malloc(cell_count * sizeof(u32)));
+        oracle->values       = static_cast<s32 *>(malloc(cell_count * sizeof(s32)));
+        oracle->area_of_cell = static_cast<u32 *>(malloc(cell_count * sizeof(u32)));
+        if (!oracle->tile_of_cell || !oracle->queue || !oracle->values || !oracle->area_of_cell) {
+            printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+            free_distance_oracle(oracle);
+            return result;
+        }
+
+        for (u32 index = 0; index < tile_count; ++index) {
+            if (oracle->cell_of_tile[index] >= 0)  oracle->tile_of_cell[oracle->cell_of_tile[index]] = index;
+        }
+        fill_areas(oracle);
+
+        if (oracle->cell_count > 0 && oracle->cell_count <= kDistance_Oracle_Max_Cells) {
+            oracle->table = static_cast<u16 *>(malloc(cell_count * cell_count * sizeof(u16)));
+
+            if (oracle->table) {
+                for (u32 cell = 0; cell < cell_count; ++cell) {
+                    fill_distance_table_row(oracle, cell);
+                }
+            }
+            else {
+                // We can do without, the maps are built the slow way
+                printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+            }
+        }
+    }
+
+    result = oracle->table != nullptr;
+
+    return result;
+}
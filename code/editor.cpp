@@ -109,6 +109,38 @@ struct Selected_Object {
 
 
 
+//
+// Validation
+#define kLevel_Validation_Milliseconds 5000 // For a search, after that the level is "not solved yet"
+
+
+// What the background search said about the level as it is being edited, see validate_level()
+struct Level_Validation {
+    u64 hash = 0;           // hash_level_content() of the state it is for, 0 if nothing has been asked
+    b32 is_done = false;
+    Solve_Result result;
+};
+
+
+struct Level_Validator {
+    Solver solver;                 // Only used by the validation thread
+    Solve_Result result;           // Likewise
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    Level job;                     // A copy of the level to search, the editor doesn't touch it
+    u64 job_hash = 0;
+    b32 job_pending = false;
+    Level_Validation validation;   // Of the last job started, it is done when the search is
+    b32 is_running = false;        // Like everything above it, guarded by mutex
+
+    std::atomic<b32> cancel{false};
+    std::thread thread;
+};
+
+
+
+
 //
 // Level Editor
 enum Level_Editor_State {
@@ -136,6 +168,9 @@ struct Level_Editor {
     Level_Editor_Message message = Level_Editor_Message_None;
     u32 current_level_count = 0;
     b32 level_has_unsaved_changes = false;
+
+    Level_Validator validator;
+    Level_Validation validation;   // The validator's, as of the last frame it could be had
 };
 
 
@@ -326,6 +361,72 @@ static u32 get_cursor_position_in_pixels(Input_Keyboard *keyboard, Font *font, C
 
 
 
+//
+// #_Validation
+// Every change to the level starts a search for its shortest solution (see solver.cpp) on a thread of its
+// own, and cancels the one for the change before. The edit loop only ever tries the lock, so it keeps to
+// the frame rate however long a search takes.
+//
+
+static void run_validation_thread(Level_Validator *validator) {
+    std::unique_lock<std::mutex> lock(validator->mutex);
+
+    for (;;) {
+        while (!validator->job_pending && validator->is_running) {
+            validator->condition.wait(lock);
+        }
+        if (!validator->is_running)  break;
+
+        u64 hash = validator->job_hash;
+        validator->job_pending = false;
+        validator->cancel.store(false, std::memory_order_relaxed);
+        b32 can_search = init_solver(&validator->solver, &validator->job, validator->job.current_state);
+        lock.unlock();
+
+        validator->result = {};
+        if (can_search) {
+            PROFILE_SCOPE("Validate level");
+            Solver_Options options;
+            options.max_milliseconds = kLevel_Validation_Milliseconds;
+            options.cancel = &validator->cancel;
+            solve_level(&validator->solver, &options, &validator->result);
+        }
+
+        lock.lock();
+        if (validator->validation.hash == hash && validator->result.status != Solve_Status_Cancelled) {
+            validator->validation.result = validator->result;
+            validator->validation.is_done = true;
+        }
+    }
+}
+
+
+static void start_level_validator(Level_Validator *validator) {
+    validator->job_pending = false;
+    validator->validation = {};
+    validator->is_running = true;
+    validator->thread = std::thread(run_validation_thread, validator);
+}
+
+
+static void stop_level_validator(Level_Validator *validator) {
+    if (validator->thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(validator->mutex);
+            validator->is_running = false;
+            validator->cancel.store(true, std::memory_order_relaxed);
+        }
+        validator->condition.notify_all();
+        validator->thread.join();
+    }
+
+    free_solver(&validator->solver);
+    fini_level(&validator->job);
+}
+
+
+
+
 //
 // Init and fini
 //
@@ -345,11 +446,16 @@ static b32 init_editor(Level_Editor *editor) {
     
     fini_tokenizer(&tokenizer);
 
+    if (result) {
+        start_level_validator(&editor->validator);
+    }
+
     return result;
 }
 
 
 static void fini_editor(Level_Editor *editor) {   
+    stop_level_validator(&editor->validator);
     fini_level(&editor->level);   
 
 
@@ -421,8 +527,66 @@ static void clear_tile(Level_State *state, Tile *tile) {
 }
 
 
-static void validate_level(Level_State *state) {
-    
+// Asks the validator about the level's current state if it is new, and takes what it knows about it. Never
+// waits for the validation thread, if that has the lock the editor keeps the validation it has.
+static void validate_level(Level_Editor *editor, Level *level) {
+    Level_Validator *validator = &editor->validator;
+
+    std::unique_lock<std::mutex> lock(validator->mutex, std::try_to_lock);
+    if (!lock.owns_lock() || !validator->is_running)  return;
+
+    u64 hash = hash_level_content(level, level->current_state);
+    if (hash != validator->validation.hash) {
+        //
+        // The search for the state before is of no use anymore
+        init_level_as_copy_of_level(&validator->job, level, level->current_state);
+        validator->job_hash = hash;
+        validator->job_pending = true;
+        validator->validation = {};
+        validator->validation.hash = hash;
+        validator->cancel.store(true, std::memory_order_relaxed);
+        validator->condition.notify_all();
+    }
+    editor->validation = validator->validation;
+}
+
+
+static void draw_level_validation(Renderer *renderer, Font *font, Level *level, Level_Validation const *validation) {
+    Level_State *state = level->current_state;
+    Solve_Result const *result = &validation->result;
+
+    char text[128];
+    v4u8 colour = v4u8_white;
+
+    if (state->pacman_count != 1 || state->ghost_count == 0) {
+        _snprintf_s(text, sizeof(text), _TRUNCATE, "Needs pacman and a ghost");
+        colour = v4u8_red;
+    }
+    else if (!validation->is_done) {
+        _snprintf_s(text, sizeof(text), _TRUNCATE, "Solving...");
+    }
+    else if (result->status == Solve_Status_Solved) {
+        // Branching is the moves a turn there were on average, lost the share of them that can't be won
+        f32 expanded = static_cast<f32>(result->nodes_expanded > 0 ? result->nodes_expanded : 1);
+        f32 generated = static_cast<f32>(result->states_generated + result->states_lost);
+        f32 lost = generated > 0.0f ? (100.0f * static_cast<f32>(result->states_lost)) / generated : 0.0f;
+        _snprintf_s(text, sizeof(text), _TRUNCATE, "Solvable in %u%s, branching %.1f, %.0f%% lost", result->input_count,
+                    result->input_count <= 1 ? " (trivial)" : "", generated / expanded, lost);
+        colour = result->input_count <= 1 ? v4u8_yellow : v4u8_green;
+    }
+    else if (result->status == Solve_Status_Unsolvable) {
+        _snprintf_s(text, sizeof(text), _TRUNCATE, "Unsolvable");
+        colour = v4u8_red;
+    }
+    else {
+        _snprintf_s(text, sizeof(text), _TRUNCATE, "Not solved, %s", get_solve_status_name(result->status));
+        colour = v4u8_yellow;
+    }
+
+    v2u text_dim = get_text_dim(font, text);
+    v2u Pt = V2u(8, 8);
+    renderer->draw_filled_rectangle(Pt - V2u(4, 4), text_dim.x + 8, text_dim.y + 8, v4u8_black);
+    renderer->print(font, Pt, text, colour);
 }
 
 
@@ -453,7 +617,7 @@ static void edit_level(Level_Editor *editor, Renderer *renderer, Input input, u3
         //
         // Render tiles and map
         draw_level(renderer, level, editor->render_mode, microseconds_since_start);
-        draw_maps(renderer, level, level->maps, level->current_map_index);
+        draw_maps(renderer, level, level->current_map_index);
 
         b32 changed_in_this_frame = false;
         editor->hot_tile = nullptr;
@@ -566,6 +730,12 @@ static void edit_level(Level_Editor *editor, Renderer *renderer, Input input, u3
             adjust_walls_in_level(level, current_state);
             create_maps_off_level(&editor->level);
         }  
+
+
+        //
+        // Whether the level can be won, and in how many turns
+        validate_level(editor, level);
+        draw_level_validation(renderer, font, level, &editor->validation);
     }
 
 
@@ -27,6 +27,7 @@ struct Font {
     u32 bitmap_width = 0;
     u32 bitmap_height = 0;
     u32 base = 0;
+    b32 is_mapped = false; // char_data points into a memory-mapped file (see pak.cpp)
 };
 
 void free_font(Font *font) {
@@ -37,9 +38,10 @@ void free_font(Font *font) {
         font->bitmap_height = 0;
         
         if (font->char_data) {
-            free(font->char_data);
+            if (!font->is_mapped)  free(font->char_data);
             font->char_data = nullptr;
         }
+        font->is_mapped = false;
         font->char_count = 0;
         
         font->line_height = 0;
@@ -0,0 +1,620 @@
+//
+// fuzz_main.cpp
+//
+// Fuzz targets for the level loader and the move resolver, built on Linux with build_linux.sh. There is one
+// LLVMFuzzerTestOneInput() per binary, so the same file is built twice:
+//     fuzz_levels (-DFUZZ_LEVELS) - parse_level() on mutated .level_txt files, and a few turns of the levels
+//                                    that load
+//     fuzz_moves                   - a level made out of the first bytes of the input, played with the rest
+//
+// After every turn, undo, redo and reset the level state has to hold up to find_broken_level_invariant(),
+// and simulate_turn() has to end up where play_turn() did. Anything else aborts, which is a crash to the
+// fuzzer, same as the asserts and what the sanitizers find.
+//
+// With clang (and -DFUZZ_LIBFUZZER) libFuzzer drives them, coverage guided, and minimizes what crashes:
+//     cd ../run_tree && ../build/fuzz_levels -max_len=4096 -timeout=5 fuzz/levels data/levels
+//     cd ../run_tree && ../build/fuzz_moves -max_len=1024 -timeout=5 fuzz/moves
+//     cd ../run_tree && ../build/fuzz_moves -minimize_crash=1 -runs=100000 crash-<hash>
+//
+// Without it (g++) main() below is a small stand-in, random inputs rather than coverage guided, that saves
+// what crashes to crash-<target>-<run> and can minimize it:
+//     fuzz_moves [-runs <n>] [-seed <n>] [-max_len <n>]
+//     fuzz_moves <file> ...                  runs the files, e.g. to reproduce a crash
+//     fuzz_moves -minimize <file>            writes <file>.minimized, the smallest input that still crashes
+//
+
+#include "common.h"
+#include "posix_win32_compat.h"
+
+#define kFuzz_Max_Turns      512  // Per input, fuzz_moves
+#define kFuzz_Level_Turns    32   // Per level that loads, fuzz_levels
+#define kFuzz_Max_Level_Size 12   // Width and height of the levels of fuzz_moves
+#define kFuzz_Default_Runs   100000
+#define kFuzz_Default_Length 1024
+
+
+
+
+//
+// Includes
+//
+
+#include "log.h"
+#include "profiler.h"
+#include "wav.cpp"
+#include "mixer.cpp"
+#include "audio_frontend.h"
+#include "headless_audio.cpp"
+
+#include "tokenizer.cpp"
+#include "mathematics.cpp"
+#include "bitmap.cpp"
+#include "font.cpp"
+#include "software_renderer.cpp"
+#include "scaler.cpp"
+#include "render_thread.cpp"
+#include "atlas.cpp"
+#include "wav_convert.cpp"
+#include "pak.cpp"
+#include "resources.cpp"
+#include "actor.cpp"
+#include "tile_and_item.cpp"
+#include "distance_oracle.cpp"
+#include "level.cpp"
+#include "movement.cpp"
+
+#include <signal.h>
+#include <sys/wait.h>
+
+
+
+
+//
+// #_Checks
+//
+
+// The level and a copy of it that is only ever changed with simulate_turn(), as the solver does. Pacman's
+// moves on the copy are worked out before the turn as well, with get_all_pacman_moves().
+struct Fuzz_Game {
+    Level level;
+    Level shadow;
+    Array_Of_Moves moves;
+    v2s *pacman_moves = nullptr;
+    u32 pacman_move_capacity = 0;
+    Wavs wavs; // Never played, there is no audio
+};
+
+
+static void fuzz_fail(char const *what, u32 step, Level *level = nullptr) {
+    fprintf(stderr, "Fuzz check failed at step %u, %s\n", step, what);
+
+    if (level && level->current_state) {
+        Level_State *state = level->current_state;
+        fprintf(stderr, "    mode duration %u, %u ghosts, %u pacman, %u small and %u large dots\n",
+                state->mode_duration, state->ghost_count, state->pacman_count, state->small_dot_count, state->large_dot_count);
+        for (u32 index = 0; index < state->actors.count; ++index) {
+            Actor *actor = &state->actors.data[index];
+            fprintf(stderr, "    actor %u, type %u at %u,%u going to %u,%u, state %u, pending state %u, mode %u\n",
+                    index, actor->type, actor->position.x, actor->position.y, actor->next_position.x, actor->next_position.y,
+                    actor->state, actor->pending_state, actor->mode);
+        }
+    }
+
+    abort();
+}
+
+
+static void check_fuzz_game(Fuzz_Game *game, u32 step) {
+    char const *broken = find_broken_level_invariant(&game->level);
+    if (broken)  fuzz_fail(broken, step, &game->level);
+
+    broken = find_broken_level_invariant(&game->shadow);
+    if (broken)  fuzz_fail(broken, step, &game->shadow);
+
+    Level_State *state = game->level.current_state;
+    Level_State *shadow_state = game->shadow.current_state;
+    if (hash_level_content(&game->level, state) != hash_level_content(&game->shadow, shadow_state) ||
+        state->score != shadow_state->score ||
+        state->ghost_count != shadow_state->ghost_count ||
+        state->pacman_count != shadow_state->pacman_count) {
+        fuzz_fail("simulate_turn() and play_turn() went different ways", step, &game->level);
+    }
+}
+
+
+// The shadow starts over from where the level is, after the level went somewhere simulate_turn() doesn't.
+// Only the state is copied, the walls are the same and so is the distance oracle.
+static void sync_fuzz_shadow(Fuzz_Game *game) {
+    copy_level_state(game->shadow.current_state, game->level.current_state);
+    create_maps_off_level(&game->shadow);
+}
+
+
+static void begin_fuzz_game(Fuzz_Game *game) {
+    create_maps_off_level(&game->level);
+    init_level_as_copy_of_level(&game->shadow, &game->level, game->level.current_state);
+    create_maps_off_level(&game->shadow);
+    init_array_of_moves(&game->moves);
+    check_fuzz_game(game, 0);
+}
+
+
+static void end_fuzz_game(Fuzz_Game *game) {
+    if (game->pacman_moves)  free(game->pacman_moves);
+    game->pacman_moves = nullptr;
+    game->pacman_move_capacity = 0;
+    free_array_of_moves(&game->moves);
+    fini_level(&game->shadow);
+    fini_level(&game->level);
+}
+
+
+// 0-3 are the directions, then no input, undo, redo and reset
+static void play_fuzz_step(Fuzz_Game *game, u8 command, u32 step) {
+    command = command % 8;
+
+    if (command <= 4) {
+        Input input = command < 4 ? static_cast<Input>(command) : Input_None;
+        u32 actor_count = game->shadow.current_state->actors.count;
+        if (game->pacman_move_capacity < actor_count + 1) {
+            if (game->pacman_moves)  free(game->pacman_moves);
+            game->pacman_move_capacity = actor_count + 1;
+            game->pacman_moves = static_cast<v2s *>(malloc(game->pacman_move_capacity * sizeof(v2s)));
+            if (!game->pacman_moves)  fuzz_fail("failed to allocate memory", step);
+        }
+        get_all_pacman_moves(&game->shadow, game->pacman_moves);
+
+        Turn_Result result = play_turn(&game->level, &game->moves, input, nullptr, &game->wavs);
+        Turn_Result shadow_result = simulate_turn(&game->shadow, &game->moves, input, game->pacman_moves);
+        if (result != shadow_result)  fuzz_fail("simulate_turn() and play_turn() returned different results", step);
+    }
+    else {
+        if (command == 5)  undo_one_level_state(&game->level);
+        if (command == 6)  redo_one_level_state(&game->level);
+        if (command == 7)  reset_level(&game->level);
+        create_maps_off_level(&game->level);
+        sync_fuzz_shadow(game);
+    }
+
+    check_fuzz_game(game, step);
+}
+
+
+
+
+//
+// #_Targets
+//
+
+#ifdef FUZZ_LEVELS
+static char const *kFuzz_Target_Name = "levels";
+
+// The input is a .level_txt file. The ones that load are played for a few turns, with inputs taken from the
+// file, so that whatever the loader lets through also goes through the move resolver.
+static void run_fuzz_target(u8 const *data, u32 size) {
+    Tokenizer tokenizer;
+    if (!init_tokenizer_from_memory(&tokenizer, "fuzz", reinterpret_cast<char const *>(data), size))  return;
+
+    Fuzz_Game game;
+    parse_level(&game.level, nullptr, &tokenizer);
+    b32 loaded = !tokenizer.error;
+    fini_tokenizer(&tokenizer);
+
+    if (loaded) {
+        begin_fuzz_game(&game);
+        for (u32 step = 1; step <= kFuzz_Level_Turns; ++step) {
+            play_fuzz_step(&game, data[(step * 31) % size] & 3, step);
+        }
+    }
+
+    end_fuzz_game(&game);
+}
+
+#else
+static char const *kFuzz_Target_Name = "moves";
+
+// The first two bytes are the width and the height, then one byte per tile; the tile type in the low bits,
+// then the item and the actor, on any tile since the editor allows that too. The level is written out as a
+// .level_txt and loaded the way the game does it. The rest of the bytes are the steps, see play_fuzz_step().
+static void run_fuzz_target(u8 const *data, u32 size) {
+    if (size < 2)  return;
+
+    u32 width  = 1 + (data[0] % kFuzz_Max_Level_Size);
+    u32 height = 1 + (data[1] % kFuzz_Max_Level_Size);
+    u32 tile_count = width * height;
+    if (size < 2 + tile_count)  return;
+
+    u8 const *tiles = data + 2;
+    u8 const *steps = tiles + tile_count;
+    u32 step_count = min(size - 2 - tile_count, static_cast<u32>(kFuzz_Max_Turns));
+
+    char layers[3][kFuzz_Max_Level_Size * kFuzz_Max_Level_Size];
+    b32 has_pacman = false;
+    for (u32 index = 0; index < tile_count; ++index) {
+        u8 tile = tiles[index];
+        u8 item = (tile >> 2) & 3;
+        u8 actor = tile >> 4;
+
+        layers[0][index] = ".--W"[tile & 3];
+        layers[1][index] = "..+X"[item];
+        layers[2][index] = '.';
+
+        if (actor == 10 && !has_pacman) {
+            layers[2][index] = 'P';
+            has_pacman = true;
+        }
+        else if (actor >= 11 && actor <= 14) {
+            layers[2][index] = static_cast<char>('1' + (actor - 11));
+        }
+    }
+
+    char text[4096];
+    char const *layer_names[3] = {"Layer_tiles", "Layer_items", "Layer_actors"};
+    s32 length = _snprintf_s(text, sizeof(text), _TRUNCATE, "Name:\"fuzz\"\nID:1\nWidth:%u\nHeight:%u\n", width, height);
+    for (u32 layer = 0; layer < 3; ++layer) {
+        length += _snprintf_s(text + length, sizeof(text) - length, _TRUNCATE, "%s:\n", layer_names[layer]);
+        for (u32 y = 0; y < height; ++y) {
+            length += _snprintf_s(text + length, sizeof(text) - length, _TRUNCATE, "%.*s\n", width, &layers[layer][y * width]);
+        }
+    }
+
+    Tokenizer tokenizer;
+    if (!init_tokenizer_from_memory(&tokenizer, "fuzz", text, static_cast<u32>(length)))  return;
+
+    Fuzz_Game game;
+    parse_level(&game.level, nullptr, &tokenizer);
+    if (tokenizer.error)  fuzz_fail(tokenizer.error_string, 0); // The text is made to load
+    fini_tokenizer(&tokenizer);
+
+    begin_fuzz_game(&game);
+    for (u32 step = 0; step < step_count; ++step) {
+        play_fuzz_step(&game, steps[step], step + 1);
+    }
+
+    end_fuzz_game(&game);
+}
+#endif
+
+
+extern "C" int LLVMFuzzerTestOneInput(u8 const *data, size_t size) {
+    if (size <= 0xFFFF)  run_fuzz_target(data, static_cast<u32>(size));
+    return 0;
+}
+
+
+
+
+//
+// #_Stand-in
+// For when there is no libFuzzer, see the top of the file
+//
+
+#ifndef FUZZ_LIBFUZZER
+
+extern "C" char const *__asan_default_options() {
+    return "abort_on_error=1"; // So that the crash handler below saves the input
+}
+
+
+struct Fuzz_Random {
+    u64 state;
+};
+
+
+static u32 get_fuzz_random(Fuzz_Random *random) {
+    // splitmix64
+    u64 z = (random->state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return static_cast<u32>((z ^ (z >> 31)) >> 32);
+}
+
+
+static u8 const *g_fuzz_input = nullptr;
+static u32 g_fuzz_input_size = 0;
+static char g_fuzz_crash_name[64];
+
+
+static void handle_fuzz_crash(int signal_number) {
+    // Only what is safe in a signal handler
+    int file = open(g_fuzz_crash_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (file >= 0) {
+        ssize_t written = write(file, g_fuzz_input, g_fuzz_input_size);
+        (void)written;
+        close(file);
+    }
+    signal(signal_number, SIG_DFL);
+    raise(signal_number);
+}
+
+
+static b32 write_fuzz_input(char const *path_and_name, u8 const *data, u32 size) {
+    b32 result = false;
+
+    FILE *file = fopen(path_and_name, "wb");
+    if (file) {
+        result = fwrite(data, 1, size, file) == size;
+        fclose(file);
+    }
+
+    return result;
+}
+
+
+// Runs the input in a child process, so that a crash can be told apart from the end of the run
+static b32 fuzz_input_crashes(u8 const *data, u32 size) {
+    b32 result = false;
+
+    fflush(stdout);
+    fflush(stderr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        int null_file = open("/dev/null", O_WRONLY);
+        if (null_file >= 0)  dup2(null_file, 2);
+        run_fuzz_target(data, size);
+        _exit(0);
+    }
+    else if (pid > 0) {
+        int status = 0;
+        waitpid(pid, &status, 0);
+        result = !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+
+    return result;
+}
+
+
+// Takes out ever smaller pieces of the input as long as it still crashes
+static u32 minimize_fuzz_input(char const *path_and_name) {
+    u32 error_code = 0;
+
+    u8 *data = nullptr;
+    u32 size = 0;
+    HANDLE mapping = nullptr;
+    u8 *input = nullptr;
+
+    if (!win32_map_file(path_and_name, &data, &size, &mapping)) {
+        fprintf(stderr, "Failed to read %s\n", path_and_name);
+        error_code = 2;
+    }
+    else if ((input = static_cast<u8 *>(malloc(size))) == nullptr) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        error_code = 3;
+    }
+    else {
+        memcpy(input, data, size);
+
+        if (!fuzz_input_crashes(input, size)) {
+            fprintf(stderr, "%s doesn't crash, there is nothing to minimize\n", path_and_name);
+            error_code = 4;
+        }
+        else {
+            u32 original_size = size;
+            for (u32 chunk = size / 2; chunk > 0; chunk /= 2) {
+                for (u32 offset = 0; offset + chunk <= size;) {
+                    // Try without [offset, offset + chunk)
+                    u8 *without = static_cast<u8 *>(malloc(size - chunk + 1));
+                    memcpy(without, input, offset);
+                    memcpy(without + offset, input + offset + chunk, size - offset - chunk);
+
+                    if (fuzz_input_crashes(without, size - chunk)) {
+                        free(input);
+                        input = without;
+                        size -= chunk;
+                    }
+                    else {
+                        free(without);
+                        offset += chunk;
+                    }
+                }
+            }
+
+            char minimized_name[MAX_PATH];
+            _snprintf_s(minimized_name, MAX_PATH, _TRUNCATE, "%s.minimized", path_and_name);
+            if (write_fuzz_input(minimized_name, input, size)) {
+                fprintf(stderr, "Minimized %s from %u to %u bytes, %s\n", path_and_name, original_size, size, minimized_name);
+            }
+            else {
+                fprintf(stderr, "Failed to write %s\n", minimized_name);
+                error_code = 5;
+            }
+        }
+    }
+
+    if (input)  free(input);
+    win32_unmap_file(data, size, mapping);
+
+    return error_code;
+}
+
+
+// The levels on disc are where fuzz_levels starts from, fuzz_moves starts from nothing
+struct Fuzz_Seeds {
+    u8 *data[64];
+    u32 size[64];
+    HANDLE mapping[64];
+    u32 count = 0;
+};
+
+
+static void load_fuzz_seeds(Fuzz_Seeds *seeds) {
+    #ifdef FUZZ_LEVELS
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA("data\\levels\\*.level_txt", &find_data);
+    b32 find_result = find_handle != INVALID_HANDLE_VALUE;
+
+    while (find_result && seeds->count < Array_Count(seeds->data)) {
+        char path_and_name[MAX_PATH];
+        _snprintf_s(path_and_name, MAX_PATH, _TRUNCATE, "data\\levels\\%s", find_data.cFileName);
+        u32 index = seeds->count;
+        if (win32_map_file(path_and_name, &seeds->data[index], &seeds->size[index], &seeds->mapping[index])) {
+            ++seeds->count;
+        }
+        find_result = FindNextFileA(find_handle, &find_data);
+    }
+
+    if (find_handle != INVALID_HANDLE_VALUE)  FindClose(find_handle);
+    #endif
+}
+
+
+static void free_fuzz_seeds(Fuzz_Seeds *seeds) {
+    for (u32 index = 0; index < seeds->count; ++index) {
+        win32_unmap_file(seeds->data[index], seeds->size[index], seeds->mapping[index]);
+    }
+    seeds->count = 0;
+}
+
+
+// A seed with a few bytes changed, taken out or put in, or random bytes if there are no seeds
+static u32 make_fuzz_input(u8 *input, u32 max_length, Fuzz_Seeds *seeds, Fuzz_Random *random) {
+    u32 size = 0;
+
+    if (seeds->count == 0) {
+        size = get_fuzz_random(random) % (max_length + 1);
+        for (u32 index = 0; index < size; ++index)  input[index] = static_cast<u8>(get_fuzz_random(random));
+        return size;
+    }
+
+    u32 seed_index = get_fuzz_random(random) % seeds->count;
+    size = min(seeds->size[seed_index], max_length);
+    memcpy(input, seeds->data[seed_index], size);
+
+    char const interesting[] = ".-WPX+1234\n: 0123456789/\"";
+    u32 mutation_count = 1 + (get_fuzz_random(random) % 8);
+    for (u32 mutation = 0; mutation < mutation_count && size > 0; ++mutation) {
+        u32 at = get_fuzz_random(random) % size;
+        u32 kind = get_fuzz_random(random) % 4;
+
+        if (kind == 0) {
+            input[at] = static_cast<u8>(get_fuzz_random(random));
+        }
+        else if (kind == 1) {
+            input[at] = interesting[get_fuzz_random(random) % (sizeof(interesting) - 1)];
+        }
+        else if (kind == 2) {
+            u32 count = min(1 + (get_fuzz_random(random) % 16), size - at);
+            memmove(input + at, input + at + count, size - at - count);
+            size -= count;
+        }
+        else if (size < max_length) {
+            memmove(input + at + 1, input + at, size - at);
+            input[at] = interesting[get_fuzz_random(random) % (sizeof(interesting) - 1)];
+            ++size;
+        }
+    }
+
+    return size;
+}
+
+
+static void print_usage(char const *program_name) {
+    fprintf(stderr, "Usage:\n");
+    fprintf(stderr, "    %s [-runs <n>] [-seed <n>] [-max_len <n>]\n", program_name);
+    fprintf(stderr, "    %s <file> ...\n", program_name);
+    fprintf(stderr, "    %s -minimize <file>\n", program_name);
+}
+
+
+int main(int argc, char **argv) {
+    u32 error_code = 0;
+
+    u32 runs = kFuzz_Default_Runs;
+    u32 max_length = kFuzz_Default_Length;
+    u64 seed = static_cast<u64>(time(nullptr));
+    b32 has_options = false;
+    b32 arguments_ok = true;
+
+    for (s32 index = 1; index < argc && arguments_ok; ++index) {
+        if (strcmp(argv[index], "-minimize") == 0 && argc == 3) {
+            return static_cast<int>(minimize_fuzz_input(argv[2]));
+        }
+        else if (strcmp(argv[index], "-runs") == 0 && index + 1 < argc) {
+            runs = static_cast<u32>(strtoul(argv[++index], nullptr, 10));
+            has_options = true;
+        }
+        else if (strcmp(argv[index], "-seed") == 0 && index + 1 < argc) {
+            seed = strtoull(argv[++index], nullptr, 10);
+            has_options = true;
+        }
+        else if (strcmp(argv[index], "-max_len") == 0 && index + 1 < argc) {
+            max_length = max(1u, static_cast<u32>(strtoul(argv[++index], nullptr, 10)));
+            has_options = true;
+        }
+        else if (argv[index][0] == '-') {
+            arguments_ok = false;
+        }
+    }
+
+    if (!arguments_ok) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    signal(SIGABRT, handle_fuzz_crash);
+    signal(SIGSEGV, handle_fuzz_crash);
+    signal(SIGFPE, handle_fuzz_crash);
+
+
+    //
+    // Run the files
+    if (!has_options && argc > 1) {
+        for (s32 index = 1; index < argc; ++index) {
+            u8 *data = nullptr;
+            u32 size = 0;
+            HANDLE mapping = nullptr;
+            if (win32_map_file(argv[index], &data, &size, &mapping) || access(argv[index], R_OK) == 0) { // Empty files aren't mapped
+                _snprintf_s(g_fuzz_crash_name, sizeof(g_fuzz_crash_name), _TRUNCATE, "crash-%s-file-%d", kFuzz_Target_Name, index);
+                g_fuzz_input = data;
+                g_fuzz_input_size = size;
+                run_fuzz_target(data, size);
+                win32_unmap_file(data, size, mapping);
+                fprintf(stderr, "Ran %s\n", argv[index]);
+            }
+            else {
+                fprintf(stderr, "Failed to read %s\n", argv[index]);
+                error_code = 2;
+            }
+        }
+        return static_cast<int>(error_code);
+    }
+
+
+    //
+    // Random runs
+    Fuzz_Seeds seeds;
+    load_fuzz_seeds(&seeds);
+
+    u8 *input = static_cast<u8 *>(malloc(max_length + 1));
+    if (!input) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        return 3;
+    }
+
+    fprintf(stderr, "Fuzzing %s, %u runs, seed %llu, %u seed inputs\n", kFuzz_Target_Name, runs, static_cast<unsigned long long>(seed), seeds.count);
+    Fuzz_Random random = {seed};
+    LARGE_INTEGER frequency, start, end;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+
+    for (u32 run = 0; run < runs; ++run) {
+        u32 size = make_fuzz_input(input, max_length, &seeds, &random);
+
+        _snprintf_s(g_fuzz_crash_name, sizeof(g_fuzz_crash_name), _TRUNCATE, "crash-%s-%u", kFuzz_Target_Name, run);
+        g_fuzz_input = input;
+        g_fuzz_input_size = size;
+        run_fuzz_target(input, size);
+    }
+
+    QueryPerformanceCounter(&end);
+    f64 seconds = static_cast<f64>(end.QuadPart - start.QuadPart) / static_cast<f64>(frequency.QuadPart);
+    fprintf(stderr, "Done, %u runs in %.1f s, %.0f runs per second\n", runs, seconds, seconds > 0.0 ? runs / seconds : 0.0);
+
+    free(input);
+    free_fuzz_seeds(&seeds);
+
+    return static_cast<int>(error_code);
+}
+
+#endif
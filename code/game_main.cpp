@@ -17,8 +17,10 @@ enum Game_State {
 
 struct Game {
     // Systems
-    Renderer *renderer = nullptr;
-    Audio audio;
+    Renderer *renderer = nullptr; // Records the frame for the render thread, when there is one
+    Render_Thread *render_thread = nullptr;
+    Hint_Engine *hint_engine = nullptr; // nullptr if there are no hints
+    Audio *audio = nullptr;
     Resources resources;
     Log log;
 
@@ -30,6 +32,10 @@ struct Game {
     Array_Of_Moves  all_the_moves;
     Array_Of_Levels all_the_levels;
 
+    Replay_Recorder replay_recorder;
+    Solution_Db solution_db;  // Mapped, with nothing in it if there is no file
+    Solution solution;        // For the current level, loaded when it starts
+
     u32_darray level_set;
     u32 current_level_index = 0;
 
@@ -38,6 +44,9 @@ struct Game {
     u32 window_width  = 0;
     u32 window_height = 0;
     Input input = Input_None;
+    b32 show_hint = false;
+    b32 show_solution = false;
+    b32 save_replays = false; // Of every win and loss, F8 saves the current attempt either way
 };
 
 
@@ -57,11 +66,16 @@ b32 init_game(Game *game) {
         }
 
 
-        // NOTE: Create a voice using a (somewhat) random wav file. If playing a wav with a different
-        //       format (different bit rate, etc...) the voice will be destroyed and re-created.
-        //       So this will not create any requirements of the wav formats.
-        result = init_voices(&game->audio, &game->resources.wavs.eat_small_dot);
-        if (!result)  LOG_ERROR(&game->log, "failed to init voices", 0);
+        // Decode the wavs for the mixer now rather than on the first time they are played
+        if (result && game->audio && game->audio->is_playing) {
+            Wavs *wavs = &game->resources.wavs;
+            Wav *all_the_wavs[] = {&wavs->eat_large_dot, &wavs->eat_small_dot, &wavs->ghost_dies, &wavs->won, &wavs->lost, &wavs->nope};
+            for (u32 index = 0; index < Array_Count(all_the_wavs); ++index) {
+                if (!prepare_wav(game->audio, all_the_wavs[index])) {
+                    LOG_ERROR(&game->log, "failed to prepare a wav for the mixer", index);
+                }
+            }
+        }
 
         game->microseconds_since_start = 0;
     }
@@ -89,6 +103,7 @@ b32 init_game(Game *game) {
         result = load_level(&game->current_level, &game->resources, "1.level_txt");
         if (result) {
             create_maps_off_level(&game->current_level);
+            begin_replay_recording(&game->replay_recorder, &game->current_level);
             game->state = Game_State_Playing;
         }
         else {
@@ -104,6 +119,16 @@ b32 init_game(Game *game) {
         LOG_ERROR_STR(&game->log, "failed to load the levels", 0);
     }
 
+    //
+    // Solutions, the game does without them (see solutions.cpp)
+    if (open_solution_db(&game->solution_db, kSolution_Path_And_Name)) {
+        log_u32(&game->log, "Solutions", game->solution_db.entry_count);
+        log_u32(&game->log, "Solutions for the levels as they are", count_current_solutions(&game->solution_db, &game->all_the_levels));
+    }
+    if (result) {
+        load_level_solution(&game->solution_db, &game->current_level, &game->solution);
+    }
+
     //
     // Load default level set
     {
@@ -118,6 +143,8 @@ b32 init_game(Game *game) {
 
 
 void fini_game(Game *game) {
+    end_replay_recording(&game->replay_recorder);
+    close_solution_db(&game->solution_db);
     free_darray(&game->level_set);
     fini_editor(&game->editor);
     free_array_of_levels(&game->all_the_levels);
@@ -141,6 +168,8 @@ void change_to_next_level(Game *game) {
         init_level_as_copy_of_level(&game->current_level, next_level, &next_level->original_state);
         reset_level(&game->current_level);
         create_maps_off_level(&game->current_level);
+        begin_replay_recording(&game->replay_recorder, &game->current_level);
+        load_level_solution(&game->solution_db, &game->current_level, &game->solution);
     }
 }
 
@@ -153,6 +182,8 @@ void change_to_prev_level(Game *game) {
         init_level_as_copy_of_level(&game->current_level, prev_level, &prev_level->original_state);
         reset_level(&game->current_level);
         create_maps_off_level(&game->current_level);
+        begin_replay_recording(&game->replay_recorder, &game->current_level);
+        load_level_solution(&game->solution_db, &game->current_level, &game->solution);
     }
 }
 
@@ -160,12 +191,14 @@ void change_to_prev_level(Game *game) {
 void victory(Game *game) {
     game->state = Game_State_Won;
     game->input = Input_None;
+    if (game->save_replays)  save_replay_recording(&game->replay_recorder, &game->current_level, Replay_Outcome_Won);
 }
 
 
 void defeat(Game *game) {
     game->state = Game_State_Lost;
     game->input = Input_None;
+    if (game->save_replays)  save_replay_recording(&game->replay_recorder, &game->current_level, Replay_Outcome_Lost);
 }
 
 
@@ -173,6 +206,7 @@ void reset(Game *game) {
     game->state = Game_State_Playing;
     reset_level(&game->current_level);
     create_maps_off_level(&game->current_level);
+    begin_replay_recording(&game->replay_recorder, &game->current_level);
 }
 
 
@@ -180,6 +214,7 @@ void undo(Game *game) {
     game->state = Game_State_Playing;
     undo_one_level_state(&game->current_level);
     create_maps_off_level(&game->current_level);
+    record_replay_event(&game->replay_recorder, Replay_Event_Undo);
 }
 
 
@@ -187,6 +222,7 @@ void redo(Game *game) {
     game->state = Game_State_Playing;
     redo_one_level_state(&game->current_level);
     create_maps_off_level(&game->current_level);
+    record_replay_event(&game->replay_recorder, Replay_Event_Redo);
 }
 
 
@@ -208,7 +244,20 @@ void draw_level(Game *game) {
 
     //
     // Draw maps
-    draw_maps(renderer, level, level->maps, level->current_map_index);
+    draw_maps(renderer, level, level->current_map_index);
+
+
+    //
+    // Draw the hint, from the solution if the player is on its way, otherwise it is searched for in the
+    // background and shows up when it's there
+    if (game->state == Game_State_Playing && game->show_hint) {
+        Hint hint = get_solution_hint(&game->solution, level);
+        if (hint.status == Hint_Status_None && game->hint_engine)  hint = get_hint(game->hint_engine, level);
+        draw_hint(renderer, font, &hint);
+    }
+    if (game->state == Game_State_Playing && game->show_solution) {
+        draw_solution(renderer, font, &game->solution, level);
+    }
 
 
     //
@@ -229,6 +278,7 @@ void draw_level(Game *game) {
 //
 
 void update_and_render(Game *game, f32 dt, b32 *should_quit) {
+    PROFILE_FUNCTION();
     Level *level = &game->current_level;
     game->renderer->clear(v4u8_black);
 
@@ -247,57 +297,21 @@ void update_and_render(Game *game, f32 dt, b32 *should_quit) {
         }
     }
     else if (game->state == Game_State_Playing) {
-        Level_State *level_state = level->current_state;
+        if (game->input < Input_Select) {
+            record_replay_input(&game->replay_recorder, game->input);
+        }
 
-        //
-        // Check for win-/loose-conditions
-        if (level_state->pacman_count == 0) {
+        Turn_Result turn_result = play_turn(level, &game->all_the_moves, game->input, game->audio, &game->resources.wavs);
+        if (turn_result == Turn_Result_Won) {
             victory(game);
-            play_wav(&game->audio, &game->resources.wavs.won);
+            play_wav(game->audio, &game->resources.wavs.won);
         }
-        else if (level_state->ghost_count == 0) {
+        else if (turn_result == Turn_Result_Lost) {
             defeat(game);
-            play_wav(&game->audio, &game->resources.wavs.lost);
+            play_wav(game->audio, &game->resources.wavs.lost);
         }
-        else if (game->input < Input_Select) {
-            #ifdef DEBUG
-            debug_check_all_actors(level);
-            #endif
-
-            collect_all_moves(level->maps, &game->all_the_moves, &game->input, level);
-            u32 valid_moves = resolve_all_moves(&game->all_the_moves, level);
-
-            #ifdef DEBUG
-            debug_check_all_move_sets(&game->all_the_moves);
-            debug_check_all_actors(level);
-            #endif
-
-            if (valid_moves == 0) {
-                cancel_moves(&game->all_the_moves, level);
-                play_wav(&game->audio, &game->resources.wavs.nope); // No valid moves at all, we won't move until we have at least one valid!
-            }
-            else {
-                // We're moving and thus we need to save the state and recalulate the "dijkstra maps".
-                save_current_level_state(level);
-                level_state = level->current_state;
-
-                debug_check_all_actors(level);
-                accept_moves(&game->all_the_moves, &game->audio, &game->resources.wavs, level);
-                debug_check_all_actors(level);
-
-                // Update mode counter
-                if (level_state->mode_duration > 0) {
-                    --level_state->mode_duration;
-                    if (level_state->mode_duration == 0) {
-                        change_pacman_mode(level, Actor_Mode_Prey);
-                    }
-                }
-
-                // Update "dijkstra-maps"
-                create_maps_off_level(level);
-            }
-
-            clear_array_of_moves(&game->all_the_moves);
+        else if (turn_result == Turn_Result_No_Valid_Moves) {
+            play_wav(game->audio, &game->resources.wavs.nope); // No valid moves at all, we won't move until we have at least one valid!
         }
     }
 
@@ -308,6 +322,8 @@ void update_and_render(Game *game, f32 dt, b32 *should_quit) {
     }
     else if (game->state == Game_State_End_Editing) {
         end_editing(&game->editor, &game->current_level);
+        begin_replay_recording(&game->replay_recorder, &game->current_level); // The level might have changed
+        load_level_solution(&game->solution_db, &game->current_level, &game->solution);
         game->state = Game_State_Playing;
     }
     else if (game->state == Game_State_Editing) {
@@ -328,5 +344,8 @@ void update_and_render(Game *game, f32 dt, b32 *should_quit) {
         game->microseconds_since_start = 0;
     }
 
+    if (game->audio)  game->audio->update(kFrame_Time);
+
+    advance_replay_recording(&game->replay_recorder);
     game->input = Input_None;
 }
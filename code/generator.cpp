@@ -0,0 +1,522 @@
+//
+// Level generator
+//
+// Makes levels at random and keeps the ones worth playing, for filling level sets without drawing every
+// level in the editor. A candidate is a connected floor dug out of the walls, dots on some of it, pacman and
+// a few ghosts. It is kept if the solver (see solver.cpp) wins it in no fewer than min_turns, and there is
+// enough to choose between on the way there (the branching, see get_solution_branching()).
+//
+// Solving is what takes the time, so the candidates are tried a batch at a time on as many threads as there
+// are cores, each with a solver of its own. A candidate is made from the seed and its number alone and the
+// batch is gone through in order, so the same options give the same levels whatever the thread count (as
+// long as no search runs out of time). The levels are saved after the ones that are already on disc and
+// added to a level set, the same as if they had been made in the editor.
+//
+
+#define kGenerator_Default_Size      11
+#define kGenerator_Default_Ghosts    3
+#define kGenerator_Default_Min_Turns 8
+#define kGenerator_Default_Max_Ms    2000 // Per candidate
+#define kGenerator_Batch_Per_Thread  8
+
+
+struct Generator_Options {
+    u32 level_count      = 1;
+    u64 seed             = 1;
+    u32 thread_count     = 0;    // 0 for one per core
+    u32 width            = kGenerator_Default_Size;
+    u32 height           = kGenerator_Default_Size;
+    u32 max_ghosts       = kGenerator_Default_Ghosts;
+    u32 min_turns        = kGenerator_Default_Min_Turns;
+    u32 max_turns        = 60;
+    f32 min_branching    = 2.0f;
+    u32 max_milliseconds = kGenerator_Default_Max_Ms;
+    u32 max_candidates   = 100000; // Tried before giving up, 0 for no limit
+    char const *level_set_name = "generated.level_set";
+};
+
+
+struct Generator_Candidate {
+    Level level;
+    u64 layout_hash = 0;   // hash_level_layout_canonical()
+    b32 is_good = false;   // Passed everything but the check for duplicates
+    u32 turns = 0;
+    f32 branching = 0.0f;
+    f32 lost = 0.0f;       // Share of the states that can't be won
+};
+
+
+// xorshift64*, one per candidate
+struct Generator_Random {
+    u64 state;
+};
+
+
+
+
+//
+// #_Random
+//
+
+static void init_generator_random(Generator_Random *random, u64 seed, u64 candidate_index) {
+    u64 hash = fnv1a_64(kFNV_Offset_Basis, &seed, sizeof(seed));
+    hash = fnv1a_64(hash, &candidate_index, sizeof(candidate_index));
+    random->state = hash != 0 ? hash : 1;
+}
+
+
+static u32 get_random_u32(Generator_Random *random) {
+    random->state ^= random->state >> 12;
+    random->state ^= random->state << 25;
+    random->state ^= random->state >> 27;
+    u32 result = static_cast<u32>((random->state * 0x2545F4914F6CDD1DULL) >> 32);
+    return result;
+}
+
+
+// In [min, max]
+static u32 get_random_in_range(Generator_Random *random, u32 min_value, u32 max_value) {
+    u32 result = min_value + (get_random_u32(random) % (max_value - min_value + 1));
+    return result;
+}
+
+
+
+
+//
+// #_Candidates
+//
+
+// A random floor tile without an actor on it, as a tile index
+static u32 get_random_free_floor(Level_State *state, u32 const *floor_tiles, u32 floor_count, Generator_Random *random) {
+    u32 result = floor_tiles[get_random_u32(random) % floor_count];
+    while (state->tiles[result].actor_id.index != 0xFFFF) {
+        result = floor_tiles[get_random_u32(random) % floor_count];
+    }
+    return result;
+}
+
+
+// Digs a floor out from the middle with a random walk, mirrored half the time, walls around it and nothing
+// outside of those. Then the dots and the actors, in the same way parse_level() would have put them there.
+static b32 make_level_candidate(Level *level, Generator_Options const *options, u64 candidate_index) {
+    b32 result = false;
+
+    Generator_Random random;
+    init_generator_random(&random, options->seed, candidate_index);
+
+    init_level(level, nullptr);
+    level->width  = options->width;
+    level->height = options->height;
+    _snprintf_s(level->name, kLevel_Name_Max_Length, _TRUNCATE, "Generated %llu-%llu",
+                static_cast<unsigned long long>(options->seed), static_cast<unsigned long long>(candidate_index));
+
+    Level_State *state = &level->original_state;
+    state->tile_count = level->width * level->height;
+    state->tiles = static_cast<Tile *>(calloc(state->tile_count, sizeof(Tile)));
+    u8 *is_floor = static_cast<u8 *>(calloc(state->tile_count, sizeof(u8)));
+    u32 *floor_tiles = static_cast<u32 *>(malloc(state->tile_count * sizeof(u32)));
+    if (!state->tiles || !is_floor || !floor_tiles) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        if (is_floor)     free(is_floor);
+        if (floor_tiles)  free(floor_tiles);
+        return result;
+    }
+
+
+    //
+    // Floor
+    u32 const width = level->width;
+    u32 const height = level->height;
+    u32 const inner_count = (width - 2) * (height - 2);
+    u32 const floor_target = (inner_count * get_random_in_range(&random, 30, 55)) / 100;
+    b32 const is_mirrored = (get_random_u32(&random) & 1) != 0;
+    v2s const steps[4] = {v2s(1, 0), v2s(0, 1), v2s(-1, 0), v2s(0, -1)};
+
+    u32 floor_count = 0;
+    s32 x = static_cast<s32>(width / 2);
+    s32 y = static_cast<s32>(height / 2);
+    for (u32 step = 0; floor_count < floor_target && step < 64 * inner_count; ++step) {
+        u32 indices[2] = {(y * width) + x, (y * width) + (width - 1 - x)};
+        for (u32 index = 0; index < (is_mirrored ? 2u : 1u); ++index) {
+            if (!is_floor[indices[index]]) {
+                is_floor[indices[index]] = 1;
+                floor_tiles[floor_count++] = indices[index];
+            }
+        }
+
+        v2s dP = steps[get_random_u32(&random) & 3];
+        if (x + dP.x >= 1 && x + dP.x <= static_cast<s32>(width) - 2)   x += dP.x;
+        if (y + dP.y >= 1 && y + dP.y <= static_cast<s32>(height) - 2)  y += dP.y;
+    }
+
+    for (u32 tile_y = 0; tile_y < height; ++tile_y) {
+        for (u32 tile_x = 0; tile_x < width; ++tile_x) {
+            Tile *tile = &state->tiles[(tile_y * width) + tile_x];
+            tile->actor_id = kActor_ID_Null;
+            tile->item.type = Item_Type_None;
+            tile->item.value = 0;
+            tile->type = Tile_Type_None;
+
+            if (is_floor[(tile_y * width) + tile_x]) {
+                tile->type = Tile_Type_Floor;
+                continue;
+            }
+            for (s32 dy = -1; dy <= 1; ++dy) {
+                for (s32 dx = -1; dx <= 1; ++dx) {
+                    s32 nx = static_cast<s32>(tile_x) + dx;
+                    s32 ny = static_cast<s32>(tile_y) + dy;
+                    if (nx >= 0 && ny >= 0 && nx < static_cast<s32>(width) && ny < static_cast<s32>(height) && is_floor[(ny * width) + nx]) {
+                        tile->type = Tile_Type_Wall_0;
+                    }
+                }
+            }
+        }
+    }
+
+
+    //
+    // Actors
+    u32 const ghost_count = get_random_in_range(&random, 1, max(1u, min(options->max_ghosts, 4u)));
+    if (floor_count > ghost_count + 2) {
+        u32 tile_index = get_random_free_floor(state, floor_tiles, floor_count, &random);
+        result = add_actor(nullptr, level, state, tile_index % width, tile_index / width, Actor_Type_Pacman);
+
+        for (u32 index = 0; index < ghost_count && result; ++index) {
+            tile_index = get_random_free_floor(state, floor_tiles, floor_count, &random);
+            Actor_Type type = static_cast<Actor_Type>(get_random_u32(&random) % Actor_Type_Pacman);
+            result = add_actor(nullptr, level, state, tile_index % width, tile_index / width, type);
+        }
+    }
+
+
+    //
+    // Dots, pacman goes for them so they are what makes him move
+    if (result) {
+        u32 const small_dot_chance = get_random_in_range(&random, 20, 70);
+        for (u32 index = 0; index < floor_count; ++index) {
+            Tile *tile = &state->tiles[floor_tiles[index]];
+            if (tile->actor_id.index == 0xFFFF && get_random_in_range(&random, 1, 100) <= small_dot_chance) {
+                tile->item.type = Item_Type_Dot_Small;
+                tile->item.value = kDot_Small_Value;
+                state->score += tile->item.value;
+                ++state->small_dot_count;
+            }
+        }
+
+        u32 const large_dot_count = get_random_in_range(&random, 0, 2);
+        for (u32 index = 0; index < large_dot_count; ++index) {
+            Tile *tile = &state->tiles[get_random_free_floor(state, floor_tiles, floor_count, &random)];
+            if (tile->item.type == Item_Type_Dot_Small) {
+                state->score -= tile->item.value;
+                --state->small_dot_count;
+            }
+            if (tile->item.type != Item_Type_Dot_Large) {
+                tile->item.type = Item_Type_Dot_Large;
+                tile->item.value = kDot_Large_Value;
+                state->score += tile->item.value;
+                ++state->large_dot_count;
+            }
+        }
+    }
+
+    free(is_floor);
+    free(floor_tiles);
+
+
+    //
+    // Done, see parse_level()
+    adjust_walls_in_level(level, &level->original_state);
+    copy_level_state(&level->states[0], &level->original_state);
+    level->first_valid_state_index = 0;
+    level->last_valid_state_index = 0;
+    level->current_state_index = 0;
+    level->current_state = &level->states[0];
+
+    return result;
+}
+
+
+// The moves there are on the way to winning, on average; the inputs that lead to states that are different
+// from each other and can still be won, counted from every state on the solution. Most inputs move something,
+// so counting the ones that do would say nearly four for every level.
+static f32 get_solution_branching(Solver *solver, Solve_Result *solve_result) {
+    f32 result = 0.0f;
+    if (solve_result->input_count == 0)  return result;
+
+    u32 const state_size = solver->state_size;
+    u8 *packed = solver->path_states;                     // Scratch, nothing is being searched
+    u8 *next = solver->path_states + state_size;          // Up to one for each input, then one for the next state
+    memcpy(packed, solver->root, state_size);
+
+    u32 move_count = 0;
+    for (u32 index = 0; index < solve_result->input_count; ++index) {
+        u32 next_count = 0;
+        for (u32 input = Input_Right; input <= static_cast<u32>(Input_Down); ++input) {
+            u8 *candidate = next + (next_count * state_size);
+            Turn_Result turn_result = play_solver_turn(solver, packed, static_cast<Input>(input), candidate);
+            if (turn_result != Turn_Result_Moved && turn_result != Turn_Result_Won)  continue;
+
+            b32 is_new = true;
+            for (u32 next_index = 0; next_index < next_count && is_new; ++next_index) {
+                is_new = memcmp(next + (next_index * state_size), candidate, state_size) != 0;
+            }
+            if (is_new)  ++next_count;
+        }
+        move_count += next_count;
+
+        play_solver_turn(solver, packed, solve_result->inputs[index], next + (4 * state_size));
+        memcpy(packed, next + (4 * state_size), state_size);
+    }
+    result = static_cast<f32>(move_count) / static_cast<f32>(solve_result->input_count);
+
+    return result;
+}
+
+
+static void evaluate_level_candidate(Solver *solver, Generator_Options const *options, Generator_Candidate *candidate) {
+    Level *level = &candidate->level;
+    candidate->is_good = false;
+
+    if (!init_solver(solver, level, &level->original_state))  return;
+
+    Solver_Options solver_options;
+    solver_options.max_turns = options->max_turns;
+    solver_options.max_milliseconds = options->max_milliseconds;
+
+    Solve_Result solve_result;
+    solve_level(solver, &solver_options, &solve_result);
+    if (solve_result.status != Solve_Status_Solved || solve_result.nodes_expanded == 0)  return;
+
+    f32 generated = static_cast<f32>(solve_result.states_generated + solve_result.states_lost);
+    candidate->turns = solve_result.input_count;
+    candidate->branching = get_solution_branching(solver, &solve_result);
+    candidate->lost = generated > 0.0f ? static_cast<f32>(solve_result.states_lost) / generated : 0.0f;
+    candidate->is_good = candidate->turns >= options->min_turns && candidate->branching >= options->min_branching;
+
+    if (candidate->is_good) {
+        candidate->layout_hash = hash_level_layout_canonical(level, &level->original_state);
+    }
+}
+
+
+// Worker thread, takes the next candidate of the batch until there are none left
+static void run_generator_thread(Generator_Options const *options, Generator_Candidate *candidates, u32 candidate_count,
+                                 u64 first_candidate_index, std::atomic<u32> *next_candidate) {
+    Solver solver;
+
+    for (u32 index = next_candidate->fetch_add(1); index < candidate_count; index = next_candidate->fetch_add(1)) {
+        Generator_Candidate *candidate = &candidates[index];
+        candidate->is_good = false;
+        if (make_level_candidate(&candidate->level, options, first_candidate_index + index)) {
+            evaluate_level_candidate(&solver, options, candidate);
+        }
+    }
+
+    free_solver(&solver);
+}
+
+
+
+
+//
+// #_Saving
+//
+
+static b32 write_level_set_to_disc(u32_darray *level_set, char const *level_set_name) {
+    b32 result = false;
+
+    char path_and_name[MAX_PATH];
+    _snprintf_s(path_and_name, MAX_PATH, _TRUNCATE, "data\\levels\\%s", level_set_name);
+
+    HANDLE file_handle;
+    result = win32_open_file_for_writing(path_and_name, &file_handle);
+    if (result) {
+        char buffer[16];
+        DWORD bytes_written;
+        for (u32 index = 0; index < level_set->count && result; ++index) {
+            DWORD bytes_to_write = _snprintf_s(buffer, sizeof(buffer), _TRUNCATE, index > 0 ? ",%u" : "%u", level_set->data[index]);
+            result = WriteFile(file_handle, buffer, bytes_to_write, &bytes_written, nullptr);
+        }
+        CloseHandle(file_handle);
+    }
+
+    return result;
+}
+
+
+// The editor numbers its levels from Current_level_count, it has to count the generated ones too
+static b32 write_editor_level_count_to_disc(u32 level_count) {
+    HANDLE file_handle;
+    b32 result = win32_open_file_for_writing("data\\levels\\editor_data.txt", &file_handle);
+    if (result) {
+        char buffer[64];
+        DWORD bytes_written;
+        DWORD bytes_to_write = _snprintf_s(buffer, sizeof(buffer), _TRUNCATE, "Current_level_count:%u", level_count);
+        result = WriteFile(file_handle, buffer, bytes_to_write, &bytes_written, nullptr);
+        CloseHandle(file_handle);
+    }
+
+    return result;
+}
+
+
+static u32 read_editor_level_count_from_disc() {
+    u32 result = 0;
+
+    Tokenizer tokenizer;
+    if (init_tokenizer(&tokenizer, "data\\levels\\", "editor_data.txt")) {
+        Token token;
+        b32 is_valid = true;
+        require_identifier_with_exact_name(&tokenizer, &token, "Current_level_count");
+        require_token(&tokenizer, &token, Token_colon);
+        require_token(&tokenizer, &token, Token_number);
+        u32 level_count = get_u32_from_token(&token, &is_valid);
+        if (is_valid && !tokenizer.error)  result = level_count;
+        fini_tokenizer(&tokenizer);
+    }
+
+    return result;
+}
+
+
+
+
+//
+// #_Generate
+//
+
+// Returns the number of levels that were saved
+static u32 generate_levels(Log *log, Generator_Options const *options) {
+    u32 result = 0;
+
+    if (options->width < 5 || options->height < 5 || options->width * options->height >= kSolver_Actor_Dead) {
+        LOG_ERROR(log, "the generated levels can't be that size", options->width);
+        return result;
+    }
+
+
+    //
+    // What is there already, the new levels go after it and mustn't be the same as any of it
+    Array_Of_Levels levels;
+    load_levels_from_disc(&levels, nullptr);
+    u32 next_level_id = read_editor_level_count_from_disc();
+    for (u32 index = 0; index < levels.count; ++index) {
+        next_level_id = max(next_level_id, levels.data[index].id);
+    }
+    ++next_level_id;
+
+    u32 layout_hash_count = 0;
+    u64 *layout_hashes = static_cast<u64 *>(malloc((levels.count + options->level_count) * sizeof(u64)));
+    if (!layout_hashes) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        free_array_of_levels(&levels);
+        return result;
+    }
+    for (u32 index = 0; index < levels.count; ++index) {
+        Level *level = &levels.data[index];
+        layout_hashes[layout_hash_count++] = hash_level_layout_canonical(level, &level->original_state);
+    }
+    free_array_of_levels(&levels);
+
+    u32_darray level_set;
+    WIN32_FIND_DATAA find_data;
+    char pattern[MAX_PATH];
+    _snprintf_s(pattern, MAX_PATH, _TRUNCATE, "data\\levels\\%s", options->level_set_name);
+    HANDLE find_handle = FindFirstFileA(pattern, &find_data);
+    if (find_handle != INVALID_HANDLE_VALUE) {
+        FindClose(find_handle);
+        if (!read_level_set_from_disc(&level_set, options->level_set_name)) {
+            LOG_ERROR_STR(log, "failed to read the level set", options->level_set_name);
+            free(layout_hashes);
+            free_darray(&level_set);
+            return result;
+        }
+    }
+
+
+    //
+    // A batch at a time
+    u32 thread_count = options->thread_count > 0 ? options->thread_count : max(1u, std::thread::hardware_concurrency());
+    u32 batch_size = thread_count * kGenerator_Batch_Per_Thread;
+    // The levels are set up by make_level_candidate(), and the threads are only there while they run
+    Generator_Candidate *candidates = static_cast<Generator_Candidate *>(calloc(batch_size, sizeof(Generator_Candidate)));
+    std::thread *threads = static_cast<std::thread *>(malloc(thread_count * sizeof(std::thread)));
+    if (!candidates || !threads) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        if (candidates)  free(candidates);
+        if (threads)     free(threads);
+        free_darray(&level_set);
+        free(layout_hashes);
+        return result;
+    }
+
+    u64 candidate_index = 0;
+    u32 duplicate_count = 0;
+    while (result < options->level_count && (options->max_candidates == 0 || candidate_index < options->max_candidates)) {
+        u32 candidate_count = batch_size;
+        if (options->max_candidates > 0)  candidate_count = static_cast<u32>(min(static_cast<u64>(batch_size), options->max_candidates - candidate_index));
+
+        std::atomic<u32> next_candidate{0};
+        for (u32 index = 0; index < thread_count; ++index) {
+            new (&threads[index]) std::thread(run_generator_thread, options, candidates, candidate_count, candidate_index, &next_candidate);
+        }
+        for (u32 index = 0; index < thread_count; ++index) {
+            threads[index].join();
+            threads[index].~thread();
+        }
+
+        for (u32 index = 0; index < candidate_count && result < options->level_count; ++index) {
+            Generator_Candidate *candidate = &candidates[index];
+            if (!candidate->is_good)  continue;
+
+            b32 is_duplicate = false;
+            for (u32 hash_index = 0; hash_index < layout_hash_count && !is_duplicate; ++hash_index) {
+                is_duplicate = layout_hashes[hash_index] == candidate->layout_hash;
+            }
+            if (is_duplicate) {
+                ++duplicate_count;
+                continue;
+            }
+
+            Level *level = &candidate->level;
+            level->id = next_level_id;
+            if (!save_level(level)) {
+                LOG_ERROR(log, "failed to save the level", level->id);
+                break;
+            }
+            layout_hashes[layout_hash_count++] = candidate->layout_hash;
+            push_u32(&level_set, level->id);
+            ++next_level_id;
+            ++result;
+
+            char line[128];
+            _snprintf_s(line, sizeof(line), _TRUNCATE, "Generate, level %u from candidate %llu, %u turns, branching %.2f, %.0f%% lost",
+                        level->id, static_cast<unsigned long long>(candidate_index + index), candidate->turns, candidate->branching, 100.0f * candidate->lost);
+            log_str(log, line);
+        }
+        candidate_index += candidate_count;
+    }
+
+    if (result > 0) {
+        if (!write_level_set_to_disc(&level_set, options->level_set_name)) {
+            LOG_ERROR_STR(log, "failed to write the level set", options->level_set_name);
+        }
+        if (!write_editor_level_count_to_disc(next_level_id - 1)) {
+            LOG_ERROR_STR(log, "failed to write the editor's level count", "editor_data.txt");
+        }
+    }
+    log_u32(log, "Generate, candidates tried", static_cast<u32>(candidate_index));
+    log_u32(log, "Generate, duplicates", duplicate_count);
+    log_u32(log, "Generate, levels saved", result);
+
+    for (u32 index = 0; index < batch_size; ++index) {
+        fini_level(&candidates[index].level);
+    }
+    free(candidates);
+    free(threads);
+    free_darray(&level_set);
+    free(layout_hashes);
+
+    return result;
+}
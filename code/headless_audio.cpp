@@ -0,0 +1,124 @@
+//
+// Audio back-ends without a sound device
+//
+// Audio_Null plays nothing at all, it is what the benchmarks and the headless tools use, and what the game
+// falls back to when there is no sound device.
+// Audio_Wav_File mixes in step with the game frames (see Audio::update()) and writes the result to a
+// 16-bit stereo wav file, so the same replay always gives the same file. That is what the audio
+// regression tests compare.
+//
+
+#define kAudio_Wav_File_Chunk_Frames 512 // Must be even
+
+
+struct Audio_Null : public Audio {
+    b32 init(Log *_log) final override {log = _log; return true;};
+    void update(u32 microseconds) final override {};
+};
+
+
+struct Audio_Wav_File : public Audio {
+    //
+    // Methods
+    Audio_Wav_File() {};
+    ~Audio_Wav_File();
+    b32 init(Log *log) final override;
+    b32 init_file(Log *log, char const *path_and_name);
+
+    void update(u32 microseconds) final override;
+
+    //
+    // Members
+    FILE *file = nullptr;
+    u64 elapsed_microseconds = 0;
+    u64 frames_written = 0;
+};
+
+
+
+
+//
+// #_Initialization and destructor
+//
+
+static void write_wav_file_header(FILE *file, u32 sample_rate, u64 frame_count) {
+    Wav_File_Header header;
+    fill_wav_file_header(&header, kMixer_Channel_Count, sample_rate, 16, static_cast<u32>(frame_count), 0);
+
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    fseek(file, 0, SEEK_END);
+}
+
+
+b32 Audio_Wav_File::init(Log *_log) {
+    b32 result = this->init_file(_log, "audio.wav");
+    return result;
+}
+
+
+b32 Audio_Wav_File::init_file(Log *_log, char const *path_and_name) {
+    b32 result = false;
+
+    this->log = _log;
+    init_mixer(&this->mixer, kMixer_Sample_Rate);
+
+    errno_t error = fopen_s(&this->file, path_and_name, "wb");
+    if (error != 0 || !this->file) {
+        LOG_ERROR_STR(this->log, "failed to open the audio file for writing", path_and_name);
+        this->file = nullptr;
+    }
+    else {
+        write_wav_file_header(this->file, this->mixer.sample_rate, 0); // The sizes are filled in when closing
+        this->elapsed_microseconds = 0;
+        this->frames_written = 0;
+        this->is_playing = true;
+        result = true;
+    }
+
+    return result;
+}
+
+
+Audio_Wav_File::~Audio_Wav_File() {
+    if (this->file) {
+        write_wav_file_header(this->file, this->mixer.sample_rate, this->frames_written);
+        fclose(this->file);
+        this->file = nullptr;
+    }
+
+    this->is_playing = false;
+    fini_mixer(&this->mixer);
+}
+
+
+
+
+//
+// #_Mixing
+//
+
+// Mixes and writes the frames up to the (rounded down, even) frame that corresponds to the elapsed time
+void Audio_Wav_File::update(u32 microseconds) {
+    if (!this->file)  return;
+
+    this->elapsed_microseconds += microseconds;
+    u64 frame_target = (this->elapsed_microseconds * this->mixer.sample_rate) / 1000000;
+    frame_target &= ~1ull;
+
+    f32 mixed[kAudio_Wav_File_Chunk_Frames * kMixer_Channel_Count];
+    s16 samples[kAudio_Wav_File_Chunk_Frames * kMixer_Channel_Count];
+
+    while (this->frames_written < frame_target) {
+        u32 frame_count = static_cast<u32>(min(frame_target - this->frames_written, static_cast<u64>(kAudio_Wav_File_Chunk_Frames)));
+        mix_audio(&this->mixer, mixed, frame_count);
+
+        u32 sample_count = frame_count * kMixer_Channel_Count;
+        for (u32 index = 0; index < sample_count; ++index) {
+            samples[index] = static_cast<s16>(mixed[index] * 32767.0f); // mix_audio() has clipped to [-1, 1]
+        }
+
+        fwrite(samples, sizeof(s16), sample_count, this->file);
+        this->frames_written += frame_count;
+    }
+}
@@ -0,0 +1,505 @@
+//
+// headless_main.cpp
+//
+// The game without a window or a sound device, for the things we want to run from scripts. Built on Linux
+// with build_linux.sh and run from the run_tree, where the data directory is.
+//
+// Usage:
+//     headless -replay <path> [-audio_out <path.wav>]
+//         Re-simulates a replay (see replay.cpp). The exit code is 0 if it ended with the same score and
+//         outcome as when it was recorded. With -audio_out the sounds of the replay are mixed into a wav
+//         file, frame by frame, so the same replay always gives the same file.
+//
+//     headless -convert_audio
+//         Converts the wavs in data\audio to the mixer's format and caches them in data\audio\cache (see
+//         wav_convert.cpp). The game does the same on load, this is for doing it as part of the build.
+//         The exit code is the number of wavs that failed.
+//
+//     headless -pack_resources
+//         Packs the resources into data\resources.pak (see pak.cpp), which the game loads instead of the
+//         loose files when it is there. Run it again after changing anything in data.
+//
+//     headless -solve <level id> [-ida] [-max_turns <n>] [-max_nodes <n>] [-max_ms <n>]
+//         Searches for the fewest inputs that win the level (see solver.cpp), with A* or IDA*, and prints them
+//         as R, U, L and D. The solution is played back with play_turn() to check it. The exit code is 0 if
+//         the level was solved.
+//
+//     headless -play_hints <level id> [-hint_ms <n>]
+//         Plays the level by following the hints (see hint.cpp), asking for one every frame like the game
+//         does and waiting a frame at a time while it is searched for. The exit code is 0 if it was won.
+//
+//     headless -build_solutions
+//         Solves every level in data\levels and writes the solutions to data\levels\solutions.db (see
+//         solutions.cpp), for the hints and for showing the solution in the game. The exit code is 0 if every
+//         level was solved.
+//
+//     headless -verify_solutions
+//         Plays every solution in data\levels\solutions.db on its level. The exit code is 0 if every level
+//         has a solution and it wins the level.
+//
+//     headless -generate <count> [-seed <n>] [-threads <n>] [-size <width> <height>] [-ghosts <n>] [-min_turns <n>]
+//                        [-max_turns <n>] [-min_branching <f>] [-max_ms <n>] [-max_candidates <n>] [-level_set <name>]
+//         Makes levels at random (see generator.cpp) until count of them are worth keeping, saves them after the
+//         levels in data\levels and adds them to the level set, generated.level_set if there is no other. The
+//         exit code is 0 if all of them were made.
+//
+//     headless -analyze <name.level_set> <path.csv> [-threads <n>] [-max_turns <n>] [-max_nodes <n>] [-max_ms <n>]
+//         Visits every state of every level in the level set (see analysis.cpp) and writes a row per level; the
+//         states there are, the fewest turns to win, the ways to win in that many, the share of dead ends
+//         and the branching. The exit code is 0 if every level was visited to the end.
+//
+//     headless -render_level <level id> <path.bmp> [-scale <n>] [-bilinear]
+//         Draws the start of a level and writes it as a bitmap, scaled n times (see scaler.cpp) for when the
+//         backbuffer's size isn't enough to see what is going on.
+//
+
+#include "common.h"
+#include "posix_win32_compat.h"
+
+
+
+
+//
+// Includes
+//
+
+#include "log.h"
+#include "profiler.h"
+#include "wav.cpp"
+#include "mixer.cpp"
+#include "audio_frontend.h"
+#include "headless_audio.cpp"
+#include "tokenizer.cpp"
+#include "mathematics.cpp"
+#include "bitmap.cpp"
+#include "font.cpp"
+#include "software_renderer.cpp"
+#include "scaler.cpp"
+#include "render_thread.cpp"
+#include "atlas.cpp"
+#include "wav_convert.cpp"
+#include "pak.cpp"
+#include "resources.cpp"
+#include "actor.cpp"
+#include "tile_and_item.cpp"
+#include "distance_oracle.cpp"
+#include "level.cpp"
+#include "movement.cpp"
+#include "solver.cpp"
+#include "hint.cpp"
+#include "solutions.cpp"
+#include "generator.cpp"
+#include "analysis.cpp"
+#include "replay.cpp"
+
+
+
+
+//
+// Frame dumps
+//
+
+static u32 render_level_to_bitmap(Log *log, u32 level_id, char const *path_and_name, u32 scale, Scale_Filter filter) {
+    u32 error_code = 0;
+
+    Resources resources;
+    Array_Of_Levels levels;
+    Renderer_Software_Headless renderer;
+    Scaler scaler;
+    u32 *frame = nullptr;
+
+    u32 size = kLevel_Size * kCell_Size;
+    u32 frame_size = scale * size;
+    Level *level = nullptr;
+
+    if (!init_resources(&resources)) {
+        LOG_ERROR_STR(log, "failed to load the resources", 0);
+        error_code = 1;
+    }
+    else if (load_levels_from_disc(&levels, &resources) == 0 || (level = get_level_with_id(&levels, level_id)) == nullptr) {
+        LOG_ERROR(log, "failed to load the level", level_id);
+        error_code = 2;
+    }
+    else if (!renderer.init(log, size, size)) {
+        LOG_ERROR_STR(log, "failed to initialize the renderer", 0);
+        error_code = 3;
+    }
+    else if ((frame = static_cast<u32 *>(malloc(static_cast<size_t>(frame_size) * frame_size * sizeof(u32)))) == nullptr) {
+        LOG_ERROR(log, "failed to allocate the frame, pixels", frame_size);
+        error_code = 3;
+    }
+    else {
+        create_maps_off_level(level);
+        renderer.clear(v4u8_black);
+        draw_level(&renderer, level, Level_Render_Mode_All, 0);
+
+        Scale_Rect rect = {0, 0, frame_size, frame_size};
+        if (!scale_frame(&scaler, filter, reinterpret_cast<u32 *>(renderer.backbuffer_memory), size, size, frame, frame_size, rect) ||
+            !write_bitmap_to_disc(path_and_name, frame, frame_size, frame_size)) {
+            LOG_ERROR_STR(log, "failed to write the frame", path_and_name);
+            error_code = 4;
+        }
+        else {
+            log_u32(log, "Frame written, width and height", frame_size);
+        }
+    }
+
+    if (frame)  free(frame);
+    free_scaler(&scaler);
+    free_array_of_levels(&levels);
+    free_resources(&resources);
+
+    return error_code;
+}
+
+
+
+
+//
+// Solving
+//
+
+static u32 solve_level_headless(Log *log, u32 level_id, Solver_Options const *options) {
+    u32 error_code = 0;
+
+    Array_Of_Levels levels;
+    Solver solver;
+    Solve_Result result;
+    Level *level = nullptr;
+
+    if (load_levels_from_disc(&levels, nullptr) == 0 || (level = get_level_with_id(&levels, level_id)) == nullptr) {
+        LOG_ERROR(log, "failed to load the level", level_id);
+        error_code = 2;
+    }
+    else if (!init_solver(&solver, level, &level->original_state)) {
+        LOG_ERROR(log, "failed to set up the solver for the level", level_id);
+        error_code = 3;
+    }
+    else {
+        solve_level(&solver, options, &result);
+
+        char solution[kSolver_Max_Turns + 1];
+        for (u32 index = 0; index < result.input_count; ++index) {
+            solution[index] = get_input_char(result.inputs[index]);
+        }
+        solution[result.input_count] = '\0';
+
+        char line[128];
+        _snprintf_s(line, sizeof(line), _TRUNCATE, "Solve, %s with %s", get_solve_status_name(result.status),
+                    result.method == Solver_Method_A_Star ? "A*" : "IDA*");
+        log_str(log, line);
+        log_u32(log, "Solve, turns", result.input_count);
+        log_u32(log, "Solve, nodes expanded", static_cast<u32>(result.nodes_expanded));
+        log_u32(log, "Solve, states generated", static_cast<u32>(result.states_generated));
+        log_u32(log, "Solve, states lost", static_cast<u32>(result.states_lost));
+        log_u32(log, "Solve, nodes stored", result.nodes_stored);
+        log_u32(log, "Solve, milliseconds", static_cast<u32>(result.milliseconds));
+        log_u32(log, "Solve, level symmetries", get_level_symmetries(level, &level->original_state));
+
+        if (result.status != Solve_Status_Solved) {
+            error_code = 4;
+        }
+        else {
+            // Straight to stdout, the log truncates its messages and this is meant to be copied. The log is
+            // never opened here (see main()), so it is written in order with the rest.
+            printf("Solve, solution %s\n", solution);
+
+            // Play it the way the game would, it has to end with pacman caught
+            Level copy;
+            Array_Of_Moves moves;
+            Wavs no_wavs; // Never played
+            init_level_as_copy_of_level(&copy, level, &level->original_state);
+            reset_level(&copy);
+            create_maps_off_level(&copy);
+            init_array_of_moves(&moves);
+
+            for (u32 index = 0; index < result.input_count; ++index) {
+                play_turn(&copy, &moves, result.inputs[index], nullptr, &no_wavs);
+            }
+            if (play_turn(&copy, &moves, Input_None, nullptr, &no_wavs) != Turn_Result_Won) {
+                LOG_ERROR(log, "the solution doesn't win the level", level_id);
+                error_code = 5;
+            }
+
+            free_array_of_moves(&moves);
+            fini_level(&copy);
+        }
+    }
+
+    free_solver(&solver);
+    free_array_of_levels(&levels);
+
+    return error_code;
+}
+
+
+
+
+//
+// Hints
+//
+
+static u32 play_level_with_hints(Log *log, u32 level_id, u32 hint_milliseconds) {
+    u32 error_code = 0;
+
+    Array_Of_Levels levels;
+    Hint_Engine engine;
+    Level *original = nullptr;
+
+    if (load_levels_from_disc(&levels, nullptr) == 0 || (original = get_level_with_id(&levels, level_id)) == nullptr) {
+        LOG_ERROR(log, "failed to load the level", level_id);
+        error_code = 2;
+    }
+    else if (!start_hint_engine(&engine, hint_milliseconds)) {
+        LOG_ERROR_STR(log, "failed to start the hint engine", 0);
+        error_code = 3;
+    }
+    else {
+        Level level;
+        Array_Of_Moves moves;
+        Wavs no_wavs; // Never played
+        init_level_as_copy_of_level(&level, original, &original->original_state);
+        reset_level(&level);
+        create_maps_off_level(&level);
+        init_array_of_moves(&moves);
+
+        char inputs[kSolver_Max_Turns + 1];
+        u32 input_count = 0;
+        u32 frame_count = 0;
+        u32 frames_waited = 0;  // For hints that weren't there on the first frame they were asked for
+        error_code = 4;
+        while (input_count < kSolver_Max_Turns && frame_count < 60 * 60 * 10) {
+            ++frame_count;
+            Hint hint = get_hint(&engine, &level);
+            if (hint.status == Hint_Status_Searching) {
+                ++frames_waited;
+                std::this_thread::sleep_for(std::chrono::microseconds(kFrame_Time));
+                continue;
+            }
+            if (hint.status != Hint_Status_Solved && hint.status != Hint_Status_Estimated) {
+                LOG_ERROR(log, "there is no hint for the level", level_id);
+                break;
+            }
+
+            inputs[input_count++] = get_input_char(hint.input);
+            play_turn(&level, &moves, hint.input, nullptr, &no_wavs);
+
+            // The level is over when the next turn is played
+            Level_State *state = level.current_state;
+            if (state->pacman_count == 0 || state->ghost_count == 0) {
+                if (play_turn(&level, &moves, Input_None, nullptr, &no_wavs) == Turn_Result_Won)  error_code = 0;
+                break;
+            }
+        }
+        inputs[input_count] = '\0';
+
+        printf("Hints, %s with %s\n", error_code == 0 ? "won" : "not won", inputs); // Not truncated, like the solution of -solve
+        log_u32(log, "Hints, turns", input_count);
+        log_u32(log, "Hints, frames waited", frames_waited);
+
+        free_array_of_moves(&moves);
+        fini_level(&level);
+    }
+
+    stop_hint_engine(&engine);
+    free_array_of_levels(&levels);
+
+    return error_code;
+}
+
+
+
+
+//
+// Main
+//
+
+static void print_usage(char const *program_name) {
+    fprintf(stderr, "Usage:\n");
+    fprintf(stderr, "    %s -replay <path> [-audio_out <path.wav>]\n", program_name);
+    fprintf(stderr, "    %s -convert_audio\n", program_name);
+    fprintf(stderr, "    %s -pack_resources\n", program_name);
+    fprintf(stderr, "    %s -solve <level id> [-ida] [-max_turns <n>] [-max_nodes <n>] [-max_ms <n>]\n", program_name);
+    fprintf(stderr, "    %s -play_hints <level id> [-hint_ms <n>]\n", program_name);
+    fprintf(stderr, "    %s -build_solutions\n", program_name);
+    fprintf(stderr, "    %s -verify_solutions\n", program_name);
+    fprintf(stderr, "    %s -generate <count> [-seed <n>] [-threads <n>] [-size <width> <height>] [-ghosts <n>] [-min_turns <n>]\n", program_name);
+    fprintf(stderr, "        [-max_turns <n>] [-min_branching <f>] [-max_ms <n>] [-max_candidates <n>] [-level_set <name>]\n");
+    fprintf(stderr, "    %s -analyze <name.level_set> <path.csv> [-threads <n>] [-max_turns <n>] [-max_nodes <n>] [-max_ms <n>]\n", program_name);
+    fprintf(stderr, "    %s -render_level <level id> <path.bmp> [-scale <n>] [-bilinear]\n", program_name);
+}
+
+
+int main(int argc, char **argv) {
+    u32 error_code = 0;
+
+    Log log; // Never opened, everything goes to stdout
+    log.print_log = true;
+
+    if (argc >= 3 && strcmp(argv[1], "-replay") == 0) {
+        char const *replay_path = argv[2];
+        char const *audio_path = nullptr;
+
+        for (int index = 3; index < argc; ++index) {
+            if (strcmp(argv[index], "-audio_out") == 0 && (index + 1) < argc) {
+                audio_path = argv[++index];
+            }
+            else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+
+        error_code = run_replay_headless(&log, replay_path, audio_path);
+    }
+    else if (argc == 2 && strcmp(argv[1], "-convert_audio") == 0) {
+        error_code = convert_all_wavs(&log);
+    }
+    else if (argc == 2 && strcmp(argv[1], "-pack_resources") == 0) {
+        error_code = pack_resources(&log) ? 0 : 1;
+    }
+    else if (argc >= 4 && strcmp(argv[1], "-render_level") == 0) {
+        u32 level_id = static_cast<u32>(atoi(argv[2]));
+        char const *frame_path = argv[3];
+        u32 scale = 1;
+        Scale_Filter filter = Scale_Filter_Nearest;
+
+        for (int index = 4; index < argc; ++index) {
+            if (strcmp(argv[index], "-scale") == 0 && (index + 1) < argc && atoi(argv[index + 1]) >= 1 && atoi(argv[index + 1]) <= 16) {
+                scale = static_cast<u32>(atoi(argv[++index]));
+            }
+            else if (strcmp(argv[index], "-bilinear") == 0) {
+                filter = Scale_Filter_Bilinear;
+            }
+            else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+
+        error_code = render_level_to_bitmap(&log, level_id, frame_path, scale, filter);
+    }
+    else if (argc >= 3 && strcmp(argv[1], "-play_hints") == 0) {
+        u32 level_id = static_cast<u32>(atoi(argv[2]));
+        u32 hint_milliseconds = kHint_Default_Milliseconds;
+
+        for (int index = 3; index < argc; ++index) {
+            if (strcmp(argv[index], "-hint_ms") == 0 && (index + 1) < argc) {
+                hint_milliseconds = static_cast<u32>(atoi(argv[++index]));
+            }
+            else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+
+        error_code = play_level_with_hints(&log, level_id, hint_milliseconds);
+    }
+    else if (argc >= 3 && strcmp(argv[1], "-solve") == 0) {
+        u32 level_id = static_cast<u32>(atoi(argv[2]));
+        Solver_Options options;
+
+        for (int index = 3; index < argc; ++index) {
+            if (strcmp(argv[index], "-ida") == 0) {
+                options.method = Solver_Method_IDA_Star;
+            }
+            else if (strcmp(argv[index], "-max_turns") == 0 && (index + 1) < argc) {
+                options.max_turns = static_cast<u32>(atoi(argv[++index]));
+            }
+            else if (strcmp(argv[index], "-max_nodes") == 0 && (index + 1) < argc) {
+                options.max_nodes = static_cast<u32>(atoi(argv[++index]));
+            }
+            else if (strcmp(argv[index], "-max_ms") == 0 && (index + 1) < argc) {
+                options.max_milliseconds = static_cast<u32>(atoi(argv[++index]));
+            }
+            else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+
+        error_code = solve_level_headless(&log, level_id, &options);
+    }
+    else if (argc == 2 && strcmp(argv[1], "-build_solutions") == 0) {
+        error_code = build_solutions_headless(&log);
+    }
+    else if (argc == 2 && strcmp(argv[1], "-verify_solutions") == 0) {
+        error_code = verify_solutions_headless(&log);
+    }
+    else if (argc >= 3 && strcmp(argv[1], "-generate") == 0) {
+        Generator_Options options;
+        options.level_count = static_cast<u32>(atoi(argv[2]));
+
+        for (int index = 3; index < argc; ++index) {
+            if (strcmp(argv[index], "-seed") == 0 && (index + 1) < argc) {
+                options.seed = static_cast<u64>(strtoull(argv[++index], nullptr, 10));
+            }
+            else if (strcmp(argv[index], "-threads") == 0 && (index + 1) < argc) {
+                options.thread_count = static_cast<u32>(atoi(argv[++index]));
+            }
+            else if (strcmp(argv[index], "-size") == 0 && (index + 2) < argc) {
+                options.width = static_cast<u32>(atoi(argv[++index]));
+                options.height = static_cast<u32>(atoi(argv[++index]));
+            }
+            else if (strcmp(argv[index], "-ghosts") == 0 && (index + 1) < argc) {
+                options.max_ghosts = static_cast<u32>(atoi(argv[++index]));
+            }
+            else if (strcmp(argv[index], "-min_turns") == 0 && (index + 1) < argc) {
+                options.min_turns = static_cast<u32>(atoi(argv[++index]));
+            }
+            else if (strcmp(argv[index], "-max_turns") == 0 && (index + 1) < argc) {
+                options.max_turns = static_cast<u32>(atoi(argv[++index]));
+            }
+            else if (strcmp(argv[index], "-min_branching") == 0 && (index + 1) < argc) {
+                options.min_branching = static_cast<f32>(atof(argv[++index]));
+            }
+            else if (strcmp(argv[index], "-max_ms") == 0 && (index + 1) < argc) {
+                options.max_milliseconds = static_cast<u32>(atoi(argv[++index]));
+            }
+            else if (strcmp(argv[index], "-max_candidates") == 0 && (index + 1) < argc) {
+                options.max_candidates = static_cast<u32>(atoi(argv[++index]));
+            }
+            else if (strcmp(argv[index], "-level_set") == 0 && (index + 1) < argc) {
+                options.level_set_name = argv[++index];
+            }
+            else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+
+        error_code = generate_levels(&log, &options) == options.level_count ? 0 : 2;
+    }
+    else if (argc >= 4 && strcmp(argv[1], "-analyze") == 0) {
+        char const *level_set_name = argv[2];
+        char const *csv_path = argv[3];
+        Analysis_Options options;
+
+        for (int index = 4; index < argc; ++index) {
+            if (strcmp(argv[index], "-threads") == 0 && (index + 1) < argc) {
+                options.thread_count = static_cast<u32>(atoi(argv[++index]));
+            }
+            else if (strcmp(argv[index], "-max_turns") == 0 && (index + 1) < argc) {
+                options.max_turns = static_cast<u32>(atoi(argv[++index]));
+            }
+            else if (strcmp(argv[index], "-max_nodes") == 0 && (index + 1) < argc) {
+                options.max_nodes = static_cast<u32>(atoi(argv[++index]));
+            }
+            else if (strcmp(argv[index], "-max_ms") == 0 && (index + 1) < argc) {
+                options.max_milliseconds = static_cast<u32>(atoi(argv[++index]));
+            }
+            else {
+                print_usage(argv[0]);
+                return 1;
+            }
+        }
+
+        error_code = analyze_level_set(&log, level_set_name, csv_path, &options);
+    }
+    else {
+        print_usage(argv[0]);
+        error_code = 1;
+    }
+
+    return static_cast<int>(error_code);
+}
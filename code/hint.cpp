@@ -0,0 +1,295 @@
+//
+// Hints
+//
+// The best next input from where the player is, searched for (see solver.cpp) on a thread of its own so
+// that the game never waits on it. The game calls get_hint() every frame it wants to show one. That only
+// ever tries the lock; it asks for a search when the state is new to it, and says the hint is on its way
+// until the search is done or whenever the hint thread happens to hold the lock.
+//
+// Solving a state solves every state on the way to winning as well, so they all go in the cache. As long
+// as the player follows the hints the next one is already there, and undoing back to a state that was
+// hinted before is too. A search for a state the player has already left is cancelled.
+//
+
+#define kHint_Cache_Size           4096 // Entries, a power of two
+#define kHint_Default_Milliseconds 500  // For a search, after that the hint is only an estimate
+
+
+enum Hint_Status {
+    Hint_Status_None = 0,
+    Hint_Status_Searching,
+    Hint_Status_Solved,     // input wins in distance turns, and no input does in fewer
+    Hint_Status_Estimated,  // Out of time, input leads to the state with the lowest bound on the turns left
+    Hint_Status_Lost,       // Nothing wins from here, see level_state_is_lost()
+
+    Hint_Status_Count,
+};
+
+
+struct Hint {
+    Hint_Status status = Hint_Status_None;
+    Input input = Input_None;
+    u32 distance = 0; // Turns to win, this one included
+};
+
+
+struct Hint_Cache_Entry {
+    u64 hash;  // hash_hint_state(), 0 for unused
+    Hint hint;
+};
+
+
+struct Hint_Engine {
+    Solver solver;                 // Only used by the hint thread
+    u32 max_milliseconds = kHint_Default_Milliseconds;
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    Level request;                 // The state to search from, a copy the game doesn't touch
+    u64 request_hash = 0;
+    b32 request_pending = false;
+    u64 searching_hash = 0;        // The state the hint thread is searching from, 0 when idle
+    Hint_Cache_Entry *cache = nullptr;
+    b32 is_running = false;        // Like everything above it, guarded by mutex
+
+    std::atomic<b32> cancel{false};
+    std::thread thread;
+};
+
+
+
+
+//
+// #_Cache
+//
+
+// Like hash_level_content(), but the actors are told apart by where they are in the level's list of them.
+// Two ghosts of a type that have swapped places don't play out the same (see pack_solver_state()).
+static u64 hash_hint_state(Level *level, Level_State *state) {
+    u64 result = hash_level_content(level, state);
+
+    for (u32 index = 0; index < state->actors.count; ++index) {
+        Actor *actor = &state->actors.data[index];
+        u32 tile_index = 0xFFFFFFFF;
+        if (actor_is_alive(actor)) {
+            tile_index = (actor->position.y * level->width) + actor->position.x;
+        }
+        result = fnv1a_64(result, &tile_index, sizeof(tile_index));
+    }
+    if (result == 0)  result = 1;
+
+    return result;
+}
+
+
+// Returns the entry for hash, or where it would go. Newer hints take the place of older ones.
+static Hint_Cache_Entry *get_hint_cache_entry(Hint_Engine *engine, u64 hash) {
+    Hint_Cache_Entry *result = &engine->cache[hash & (kHint_Cache_Size - 1)];
+    return result;
+}
+
+
+
+
+//
+// #_Thread
+//
+
+// Searches from the solver's root and returns the hints it found, for the root first
+static u32 search_for_hints(Hint_Engine *engine, Hint_Cache_Entry *entries) {
+    u32 result = 0;
+    Solver *solver = &engine->solver;
+
+    Solver_Options options;
+    options.max_milliseconds = engine->max_milliseconds;
+    options.cancel = &engine->cancel;
+
+    Solve_Result solve_result;
+    solve_level(solver, &options, &solve_result);
+
+    u8 *packed = solver->path_states;
+    u8 *next = solver->path_states + solver->state_size;
+    memcpy(packed, solver->root, solver->state_size);
+
+    if (solve_result.status == Solve_Status_Solved) {
+        //
+        // Every state on the way, hashed the same way as the game will
+        for (u32 index = 0; index < solve_result.input_count; ++index) {
+            unpack_solver_state(solver, packed);
+
+            Hint_Cache_Entry *entry = &entries[result++];
+            entry->hash = hash_hint_state(&solver->level, solver->level.current_state);
+            entry->hint.status = Hint_Status_Solved;
+            entry->hint.input = solve_result.inputs[index];
+            entry->hint.distance = solve_result.input_count - index;
+
+            play_solver_turn(solver, packed, solve_result.inputs[index], next);
+            u8 *temp = packed;
+            packed = next;
+            next = temp;
+        }
+    }
+    else if (solve_result.status != Solve_Status_Cancelled) {
+        //
+        // The input that looks the closest to winning, one turn ahead
+        Hint hint;
+        hint.status = Hint_Status_Lost;
+
+        if (solve_result.status != Solve_Status_Unsolvable) {
+            for (u32 input = Input_Right; input <= static_cast<u32>(Input_Down); ++input) {
+                Turn_Result turn_result = play_solver_turn(solver, packed, static_cast<Input>(input), next);
+                if (turn_result != Turn_Result_Moved && turn_result != Turn_Result_Won)  continue;
+
+                u32 distance = turn_result == Turn_Result_Won ? 1 : 1 + get_solver_lower_bound(solver);
+                if (hint.status == Hint_Status_Lost || distance < hint.distance) {
+                    hint.status = Hint_Status_Estimated;
+                    hint.input = static_cast<Input>(input);
+                    hint.distance = distance;
+                }
+            }
+        }
+
+        unpack_solver_state(solver, packed);
+        entries[0].hash = hash_hint_state(&solver->level, solver->level.current_state);
+        entries[0].hint = hint;
+        result = 1;
+    }
+
+    return result;
+}
+
+
+static void run_hint_thread(Hint_Engine *engine) {
+    Hint_Cache_Entry entries[kSolver_Max_Turns];
+    std::unique_lock<std::mutex> lock(engine->mutex);
+
+    for (;;) {
+        while (!engine->request_pending && engine->is_running) {
+            engine->condition.wait(lock);
+        }
+        if (!engine->is_running)  break;
+
+        engine->request_pending = false;
+        engine->searching_hash = engine->request_hash;
+        engine->cancel.store(false, std::memory_order_relaxed);
+        b32 can_search = init_solver(&engine->solver, &engine->request, engine->request.current_state);
+        lock.unlock();
+
+        u32 entry_count = 0;
+        if (can_search) {
+            PROFILE_SCOPE("Hint search");
+            entry_count = search_for_hints(engine, entries);
+        }
+
+        lock.lock();
+        if (!engine->cancel.load(std::memory_order_relaxed)) {
+            for (u32 index = 0; index < entry_count; ++index) {
+                *get_hint_cache_entry(engine, entries[index].hash) = entries[index];
+            }
+        }
+        engine->searching_hash = 0;
+    }
+}
+
+
+static b32 start_hint_engine(Hint_Engine *engine, u32 max_milliseconds) {
+    b32 result = false;
+
+    engine->cache = static_cast<Hint_Cache_Entry *>(calloc(kHint_Cache_Size, sizeof(Hint_Cache_Entry)));
+    if (!engine->cache) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        return result;
+    }
+
+    engine->max_milliseconds = max_milliseconds;
+    engine->request_pending = false;
+    engine->searching_hash = 0;
+    engine->is_running = true;
+    engine->thread = std::thread(run_hint_thread, engine);
+    result = true;
+
+    return result;
+}
+
+
+// Cancels the search there is, if any, and waits for the hint thread to be done with it
+static void stop_hint_engine(Hint_Engine *engine) {
+    if (engine->thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(engine->mutex);
+            engine->is_running = false;
+            engine->cancel.store(true, std::memory_order_relaxed);
+        }
+        engine->condition.notify_all();
+        engine->thread.join();
+    }
+
+    free_solver(&engine->solver);
+    fini_level(&engine->request);
+    if (engine->cache)  free(engine->cache);
+    engine->cache = nullptr;
+}
+
+
+
+
+//
+// #_Game
+//
+
+// The hint for the level's current state. Never waits for the hint thread; if the hint isn't known yet it
+// is searched for, and Hint_Status_Searching is returned until it is.
+static Hint get_hint(Hint_Engine *engine, Level *level) {
+    Hint result;
+    Level_State *state = level->current_state;
+    if (!engine->cache || !state || state->pacman_count == 0)  return result;
+
+    if (level_state_is_lost(level, state)) {
+        result.status = Hint_Status_Lost;
+        return result;
+    }
+
+    result.status = Hint_Status_Searching;
+    u64 hash = hash_hint_state(level, state);
+
+    std::unique_lock<std::mutex> lock(engine->mutex, std::try_to_lock);
+    if (!lock.owns_lock())  return result;
+
+    Hint_Cache_Entry *entry = get_hint_cache_entry(engine, hash);
+    if (entry->hash == hash) {
+        result = entry->hint;
+    }
+    else if (engine->searching_hash != hash && !(engine->request_pending && engine->request_hash == hash)) {
+        //
+        // New to us, anything we were searching for is of no use anymore
+        init_level_as_copy_of_level(&engine->request, level, state);
+        engine->request_hash = hash;
+        engine->request_pending = true;
+        if (engine->searching_hash != 0)  engine->cancel.store(true, std::memory_order_relaxed);
+
+        lock.unlock();
+        engine->condition.notify_all();
+    }
+
+    return result;
+}
+
+
+static void draw_hint(Renderer *renderer, Font *font, Hint *hint) {
+    char const *input_names[] = {"right", "up", "left", "down"};
+    char const *input_name = hint->input <= Input_Down ? input_names[hint->input] : "?";
+
+    char text[64];
+    switch (hint->status) {
+        case Hint_Status_Searching: _snprintf_s(text, sizeof(text), _TRUNCATE, "Hint: thinking..."); break;
+        case Hint_Status_Solved:    _snprintf_s(text, sizeof(text), _TRUNCATE, "Hint: %s, %u to go", input_name, hint->distance); break;
+        case Hint_Status_Estimated: _snprintf_s(text, sizeof(text), _TRUNCATE, "Hint: %s, %u or more to go", input_name, hint->distance); break;
+        case Hint_Status_Lost:      _snprintf_s(text, sizeof(text), _TRUNCATE, "Hint: can't be won, undo"); break;
+        default: return;
+    }
+
+    v2u text_dim = get_text_dim(font, text);
+    v2u Pt = V2u(8, 8);
+    renderer->draw_filled_rectangle(Pt - V2u(4, 4), text_dim.x + 8, text_dim.y + 8, v4u8_black);
+    renderer->print(font, Pt, text, v4u8_white);
+}
@@ -15,6 +15,9 @@ enum Map_Type {
 };
 
 
+#define kMap_Max_Value 300 // Of the tiles that can't be reached, and the walls
+
+
 struct Map_Direction {
     Direction direction = Direction_Unknown;
     s32 distance = 0;
@@ -46,6 +49,20 @@ enum Level_Render_Mode {
 };
 
 
+// The ways a level can be turned over onto itself, the ones with a transpose only for square levels
+enum Level_Symmetry {
+    Level_Symmetry_Mirror_X       = 1 << 0, // Left to right
+    Level_Symmetry_Mirror_Y       = 1 << 1, // Top to bottom
+    Level_Symmetry_Rotate_180     = 1 << 2,
+    Level_Symmetry_Transpose      = 1 << 3, // Across the diagonal from the top left
+    Level_Symmetry_Anti_Transpose = 1 << 4, // Across the other one
+    Level_Symmetry_Rotate_90      = 1 << 5,
+    Level_Symmetry_Rotate_270     = 1 << 6,
+
+    Level_Symmetry_Count = 7,
+};
+
+
 struct Level_State {
     Array_Of_Actors actors;
     Tile *tiles = nullptr;
@@ -66,7 +83,9 @@ struct Level {
     Level_State states[kLevel_States_Count];
     Level_State original_state;
 
-    s32 *maps[Map_Count] = {};
+    s32 *maps[Map_Count] = {};                // Built when asked for, see get_map()
+    b32 map_is_current[Map_Count] = {};
+    Distance_Oracle distance_oracle;
     u32 current_map_index = Map_Count; // DEBUG
 
     Level_State *current_state  = nullptr;
@@ -305,7 +324,9 @@ void fini_level(Level *level) {
                 free(level->maps[map_index]);
                 level->maps[map_index] = nullptr;
             }
+            level->map_is_current[map_index] = false;
         }
+        free_distance_oracle(&level->distance_oracle);
     }
 };
 
@@ -430,6 +451,163 @@ inline Actor *get_actor_at(Level *level, u32 x, u32 y) {
 }
 
 
+// Returns true if state can't be won from whatever the inputs are; all the ghosts are dead, or none of them
+// is in the same area of the level as pacman. Nothing leaves its area, and pacman is only caught by a ghost
+// moving onto his tile or the tile he is moving to. There are no parity rules to add to that, any actor can
+// stand still for a turn by walking into a wall or another actor.
+//
+// Takes the areas from the distance oracle, so it only looks at the actors and works for any state of the
+// level (the walls are the same in all of them). Returns false if the oracle is for other walls.
+static b32 level_state_is_lost(Level *level, Level_State *state) {
+    b32 result = false;
+    if (!state || state->pacman_count == 0)  return result;
+    if (state->ghost_count == 0)  return true;
+
+    Distance_Oracle *oracle = &level->distance_oracle;
+    if (!oracle->area_of_cell || oracle->width != level->width || oracle->height != level->height)  return result;
+
+    Actor *pacman = get_actor(&state->actors, level->pacman_id);
+    if (!pacman || !actor_is_alive(pacman))  return result;
+    u32 pacman_tile = (pacman->position.y * level->width) + pacman->position.x;
+
+    result = true;
+    for (u32 index = 0; index < state->actors.count && result; ++index) {
+        Actor *actor = &state->actors.data[index];
+        if (actor_is_ghost(actor) && actor_is_alive(actor)) {
+            u32 tile = (actor->position.y * level->width) + actor->position.x;
+            result = !tiles_are_connected(oracle, tile, pacman_tile);
+        }
+    }
+
+    return result;
+}
+
+
+
+
+//
+// #_Hashing
+//
+
+// Hashes what is visible in the level; the tiles, the items and the actors standing on them, but not the
+// actor ids or the undo history. Two levels with the same content hash will play out the same way.
+u64 hash_level_content(Level *level, Level_State *state) {
+    u64 result = kFNV_Offset_Basis;
+
+    if (level && state && state->tiles) {
+        result = fnv1a_64(result, &level->width, sizeof(level->width));
+        result = fnv1a_64(result, &level->height, sizeof(level->height));
+        result = fnv1a_64(result, &state->mode_duration, sizeof(state->mode_duration));
+
+        for (u32 index = 0; index < state->tile_count; ++index) {
+            Tile *tile = &state->tiles[index];
+            Actor *actor = get_actor(&state->actors, tile->actor_id);
+
+            u8 bytes[4];
+            bytes[0] = static_cast<u8>(tile->type);
+            bytes[1] = static_cast<u8>(tile->item.type);
+            bytes[2] = actor ? static_cast<u8>(actor->type) : 0xFF;
+            bytes[3] = actor ? static_cast<u8>(actor->mode) : 0xFF;
+            result = fnv1a_64(result, bytes, sizeof(bytes));
+        }
+    }
+
+    return result;
+}
+
+
+// Where the tile at x, y ends up when the level is turned over with symmetry, one of Level_Symmetry (or 0
+// for where it is)
+static u32 get_symmetric_tile_index(Level *level, u32 symmetry, u32 x, u32 y) {
+    u32 w = level->width - 1;
+    u32 h = level->height - 1;
+    u32 sx = x;
+    u32 sy = y;
+
+    switch (symmetry) {
+        case Level_Symmetry_Mirror_X:       sx = w - x; sy = y;     break;
+        case Level_Symmetry_Mirror_Y:       sx = x;     sy = h - y; break;
+        case Level_Symmetry_Rotate_180:     sx = w - x; sy = h - y; break;
+        case Level_Symmetry_Transpose:      sx = y;     sy = x;     break;
+        case Level_Symmetry_Anti_Transpose: sx = h - y; sy = w - x; break;
+        case Level_Symmetry_Rotate_90:      sx = h - y; sy = x;     break;
+        case Level_Symmetry_Rotate_270:     sx = y;     sy = w - x; break;
+    }
+
+    u32 result = (sy * level->width) + sx;
+    return result;
+}
+
+
+// What a tile looks like when it comes to playing the level; a wall, floor or nothing, the item and the actor
+// on it. The wall types are left out, they only say how a wall is drawn and that changes when it's turned.
+static u32 get_tile_layout(Level_State *state, Tile *tile) {
+    Actor *actor = get_actor(&state->actors, tile->actor_id);
+
+    u32 tile_class = tile_has_wall(tile) ? 0 : (tile->type == Tile_Type_Floor ? 1 : 2);
+    u32 actor_bits = actor ? ((static_cast<u32>(actor->type) << 1) | static_cast<u32>(actor->mode)) : 0xFF;
+
+    u32 result = tile_class | (static_cast<u32>(tile->item.type) << 8) | (actor_bits << 16);
+    return result;
+}
+
+
+// The Level_Symmetry flags the state is the same under, the tiles, items and actors all land on their like
+static u32 get_level_symmetries(Level *level, Level_State *state) {
+    u32 result = 0;
+    if (!level || !state || !state->tiles)  return result;
+
+    u32 symmetry_count = level->width == level->height ? Level_Symmetry_Count : 3;
+    for (u32 index = 0; index < symmetry_count; ++index) {
+        u32 symmetry = 1 << index;
+        b32 same = true;
+
+        for (u32 y = 0; y < level->height && same; ++y) {
+            for (u32 x = 0; x < level->width && same; ++x) {
+                Tile *tile = &state->tiles[(y * level->width) + x];
+                Tile *other = &state->tiles[get_symmetric_tile_index(level, symmetry, x, y)];
+                same = get_tile_layout(state, tile) == get_tile_layout(state, other);
+            }
+        }
+
+        if (same)  result |= symmetry;
+    }
+
+    return result;
+}
+
+
+// The same for a level and all its mirrored and rotated copies, for telling whether a level is one that
+// we already have turned over. Unlike hash_level_content() this doesn't mean they play out the same way,
+// pacman breaks ties between directions in a fixed order.
+static u64 hash_level_layout_canonical(Level *level, Level_State *state) {
+    u64 result = 0;
+    if (!level || !state || !state->tiles)  return result;
+
+    // Reading the level through every symmetry reads every turned over copy of it, as they are a group
+    u32 symmetry_count = level->width == level->height ? Level_Symmetry_Count : 3;
+    for (u32 index = 0; index <= symmetry_count; ++index) {
+        u32 symmetry = index == 0 ? 0 : 1 << (index - 1);
+
+        u64 hash = kFNV_Offset_Basis;
+        hash = fnv1a_64(hash, &level->width, sizeof(level->width));
+        hash = fnv1a_64(hash, &level->height, sizeof(level->height));
+        hash = fnv1a_64(hash, &state->mode_duration, sizeof(state->mode_duration));
+
+        for (u32 y = 0; y < level->height; ++y) {
+            for (u32 x = 0; x < level->width; ++x) {
+                u32 layout = get_tile_layout(state, &state->tiles[get_symmetric_tile_index(level, symmetry, x, y)]);
+                hash = fnv1a_64(hash, &layout, sizeof(layout));
+            }
+        }
+
+        if (index == 0 || hash < result)  result = hash;
+    }
+
+    return result;
+}
+
+
 
 
 //
@@ -480,6 +658,7 @@ void kill_actor(Level *level, Actor *actor) {
 //
 
 void draw_level(Renderer *renderer, Level *level, u32 render_mode, u32 microseconds_since_start) {
+    PROFILE_FUNCTION();
     Level_State *state = level->current_state;
     Font *font = &level->resources->font;
     Resources *resources = level->resources;
@@ -785,7 +964,7 @@ static b32 save_level(Level *level) {
         result = WriteFile(file_handle, buffer, bytes_to_write, &bytes_written, nullptr);
         assert(bytes_to_write == bytes_written);
 
-        bytes_to_write = _snprintf_s(buffer, buffer_size, _TRUNCATE, "Height:%u\n", level->width);
+        bytes_to_write = _snprintf_s(buffer, buffer_size, _TRUNCATE, "Height:%u\n", level->height);
         result = WriteFile(file_handle, buffer, bytes_to_write, &bytes_written, nullptr);
         assert(bytes_to_write == bytes_written);
 
@@ -897,234 +1076,294 @@ static b32 add_actor(Tokenizer *tokenizer, Level *level, Level_State *state, u32
 }
 
 
+static void parse_level(Level *level, Resources *resources, Tokenizer *tokenizer);
+
+
 static b32 load_level(Level *level, Resources *resources, char const *name) {
     b32 result = false;
 
     Tokenizer tokenizer;
     result = init_tokenizer(&tokenizer, "data\\levels\\", name);
     if (result) {
-        fini_level(level);
-        init_level(level, resources);
+        parse_level(level, resources, &tokenizer);
+        if (tokenizer.error) {
+            printf("%s(): invalid level, %s\n", __FUNCTION__, tokenizer.error_string);
+            result = false;
+        }
+        fini_tokenizer(&tokenizer);
+    }
 
-        eat_spaces_and_newline(&tokenizer);
-        Token token;
+    return result;
+}
 
-        // Name of level
-        require_identifier_with_exact_name(&tokenizer, &token, "Name");
-        require_token(&tokenizer, &token, Token_colon);
-        require_token(&tokenizer, &token, Token_string);
-        _snprintf_s(level->name, kLevel_Name_Max_Length, _TRUNCATE, "%s", token.data);
 
-        // Level id
-        require_identifier_with_exact_name(&tokenizer, &token, "ID");
-        require_token(&tokenizer, &token, Token_colon);
-        require_token(&tokenizer, &token, Token_number);
-        level->id = get_u32_from_token(&token);
+// The number in "Name:<number>" in the header of a level
+static u32 require_level_header_u32(Tokenizer *tokenizer, char const *name) {
+    u32 result = 0;
+    Token token;
 
-        //
-        // Width
-        require_identifier_with_exact_name(&tokenizer, &token, "Width");
-        require_token(&tokenizer, &token, Token_colon);
-        require_token(&tokenizer, &token, Token_number);
-        level->width = get_u32_from_token(&token);
+    require_identifier_with_exact_name(tokenizer, &token, name);
+    require_token(tokenizer, &token, Token_colon);
+    require_token(tokenizer, &token, Token_number);
 
-        //
-        // Height
-        require_identifier_with_exact_name(&tokenizer, &token, "Height");
-        require_token(&tokenizer, &token, Token_colon);
-        require_token(&tokenizer, &token, Token_number);
-        level->height = get_u32_from_token(&token);
+    if (!tokenizer->error) {
+        b32 is_valid = false;
+        result = get_u32_from_token(&token, &is_valid);
+        if (!is_valid) {
+            tokenizer->error = true;
+            _snprintf_s(tokenizer->error_string, kTokenizer_Error_String_Max_Length, _TRUNCATE, "In %s at %u:%u, %s is not a number",
+                        tokenizer->path_and_name, token.line_number, token.line_position, name);
+        }
+    }
 
+    return result;
+}
 
-        //
-        // Tiles
-        require_identifier_with_exact_name(&tokenizer, &token, "Layer_tiles");
-        require_token(&tokenizer, &token, Token_colon);
-        eat_spaces_and_newline(&tokenizer);
-        reload(&tokenizer);
-
-        Level_State *state = &level->original_state;
-        state->tile_count = level->width * level->height;
-        state->tiles = static_cast<Tile *>(calloc(state->tile_count, sizeof(Tile)));
-        assert(state->tiles);
-
-        b32 should_loop = !tokenizer.error;
-        b32 should_advance = true;
-
-        //for (s32 y = level->height - 1; (y >= 0) && should_loop; --y) {
-        for (u32 y = 0; (y < level->height) && should_loop; ++y) {
-            for (u32 x = 0; (x < level->width) && should_loop; ++x) {
-                Tile *tile = &state->tiles[(y * level->width) + x];
 
-                switch (tokenizer.curr_char) {
-                    case '.': {
-                        tile->type = Tile_Type_None;
-                    } break;
-
-                    case '-': {
-                        tile->type = Tile_Type_Floor;
-                    } break;
-
-                    case 'W': {
-                        tile->type = Tile_Type_Wall_0;
-                    } break;
-
-                    default: {
-                        token = get_token(&tokenizer);
-                        if (token.type == Token_comment) {
-                            skip_to_next_line(&tokenizer);
-                            should_advance = false;
-                        }
-                        else {
-                            tokenizer.error = true;
-                            _snprintf_s(tokenizer.error_string, kTokenizer_Error_String_Max_Length, _TRUNCATE, "In %s at %u:%u, found invalid token in the tile layer",
-                                        tokenizer.path_and_name, token.line_number, token.line_position);
-                            should_loop = false;
-                        }
-                    } break;
-                }
+// Sets the error of the tokenizer if a layer ends before the level does
+static b32 level_layer_has_ended(Tokenizer *tokenizer, char const *layer_name) {
+    b32 result = is_eof(tokenizer);
 
-                if (should_advance) {
-                    advance(&tokenizer);
-                }
-                should_advance = true;
+    if (result && !tokenizer->error) {
+        tokenizer->error = true;
+        _snprintf_s(tokenizer->error_string, kTokenizer_Error_String_Max_Length, _TRUNCATE, "In %s, the file ended in the %s layer",
+                    tokenizer->path_and_name, layer_name);
+    }
 
-                eat_spaces_and_newline(&tokenizer);
-                reload(&tokenizer);
-            }
-        }
+    return result;
+}
 
 
-        //
-        // Items
-        require_identifier_with_exact_name(&tokenizer, &token, "Layer_items");
-        require_token(&tokenizer, &token, Token_colon);
-        eat_spaces_and_newline(&tokenizer);
-        reload(&tokenizer);
+// Parses a level in the .level_txt format, also used on levels that are not on disc (see bench_main.cpp)
+static void parse_level(Level *level, Resources *resources, Tokenizer *tokenizer) {
+    fini_level(level);
+    init_level(level, resources);
 
-        should_loop = !tokenizer.error;
-        should_advance = true;
+    eat_spaces_and_newline(tokenizer);
+    Token token;
 
-        //for (s32 y = level->height - 1; (y >= 0) && should_loop; --y) {
-        for (u32 y = 0; (y < level->height) && should_loop; ++y) {
-            for (u32 x = 0; (x < level->width) && should_loop; ++x) {
-                Tile *tile = &state->tiles[(y * level->width) + x];
+    // Name of level
+    require_identifier_with_exact_name(tokenizer, &token, "Name");
+    require_token(tokenizer, &token, Token_colon);
+    require_token(tokenizer, &token, Token_string);
+    _snprintf_s(level->name, kLevel_Name_Max_Length, _TRUNCATE, "%s", token.data);
 
-                switch (tokenizer.curr_char) {
-                    case '.': {
-                        tile->item.type = Item_Type_None;
-                        tile->item.value = 0;
-                    } break;
-
-                    case '+': {
-                        tile->item.type = Item_Type_Dot_Small;
-                        tile->item.value = kDot_Small_Value;
-                        state->score += tile->item.value;
-                        ++state->small_dot_count;
-                    } break;
-
-                    case 'X': {
-                        tile->item.type = Item_Type_Dot_Large;
-                        tile->item.value = kDot_Large_Value;
-                        state->score += tile->item.value;
-                        ++state->large_dot_count;
-                    } break;
-
-                    default: {
-                        token = get_token(&tokenizer);
-                        if (token.type == Token_comment) {
-                            skip_to_next_line(&tokenizer);
-                            should_advance = false;
-                        }
-                        else {
-                            tokenizer.error = true;
-                            _snprintf_s(tokenizer.error_string, kTokenizer_Error_String_Max_Length, _TRUNCATE, "In %s at %u:%u, found invalid token in the items layer",
-                                        tokenizer.path_and_name, token.line_number, token.line_position);
-                            should_loop = false;
-                        }
-                    } break;
-                }
+    // Level id
+    level->id = require_level_header_u32(tokenizer, "ID");
 
-                if (should_advance) {
-                    advance(&tokenizer);
-                }
-                should_advance = true;
-
-                eat_spaces_and_newline(&tokenizer);
-                reload(&tokenizer);
-            }
-        }
+    //
+    // Width and height, nothing is read unless they are there and within bounds
+    level->width = require_level_header_u32(tokenizer, "Width");
+    level->height = require_level_header_u32(tokenizer, "Height");
+
+    if (!tokenizer->error && (level->width == 0 || level->height == 0 || level->width > kLevel_Max_Size || level->height > kLevel_Max_Size)) {
+        tokenizer->error = true;
+        _snprintf_s(tokenizer->error_string, kTokenizer_Error_String_Max_Length, _TRUNCATE, "In %s, the level is %ux%u, it has to be from 1x1 to %ux%u",
+                    tokenizer->path_and_name, level->width, level->height, static_cast<u32>(kLevel_Max_Size), static_cast<u32>(kLevel_Max_Size));
+    }
+    if (tokenizer->error) {
+        level->width = 0;
+        level->height = 0;
+        return;
+    }
 
 
-        //
-        // Actors
-        require_identifier_with_exact_name(&tokenizer, &token, "Layer_actors");
-        require_token(&tokenizer, &token, Token_colon);
-        eat_spaces_and_newline(&tokenizer);
-        reload(&tokenizer);
+    //
+    // Tiles
+    require_identifier_with_exact_name(tokenizer, &token, "Layer_tiles");
+    require_token(tokenizer, &token, Token_colon);
+    eat_spaces_and_newline(tokenizer);
+    reload(tokenizer);
+
+    Level_State *state = &level->original_state;
+    state->tile_count = level->width * level->height;
+    state->tiles = static_cast<Tile *>(calloc(state->tile_count, sizeof(Tile)));
+    assert(state->tiles);
+
+    b32 should_loop = !tokenizer->error;
+    b32 should_advance = true;
+
+    //for (s32 y = level->height - 1; (y >= 0) && should_loop; --y) {
+    for (u32 y = 0; (y < level->height) && should_loop; ++y) {
+        for (u32 x = 0; (x < level->width) && should_loop; ++x) {
+            if (level_layer_has_ended(tokenizer, "tile")) {
+                should_loop = false;
+                break;
+            }
+            Tile *tile = &state->tiles[(y * level->width) + x];
+
+            switch (tokenizer->curr_char) {
+                case '.': {
+                    tile->type = Tile_Type_None;
+                } break;
+
+                case '-': {
+                    tile->type = Tile_Type_Floor;
+                } break;
+
+                case 'W': {
+                    tile->type = Tile_Type_Wall_0;
+                } break;
+
+                default: {
+                    token = get_token(tokenizer);
+                    if (token.type == Token_comment) {
+                        skip_to_next_line(tokenizer);
+                        should_advance = false;
+                    }
+                    else {
+                        tokenizer->error = true;
+                        _snprintf_s(tokenizer->error_string, kTokenizer_Error_String_Max_Length, _TRUNCATE, "In %s at %u:%u, found invalid token in the tile layer",
+                                    tokenizer->path_and_name, token.line_number, token.line_position);
+                        should_loop = false;
+                    }
+                } break;
+            }
 
-        should_loop = !tokenizer.error;
-        should_advance = true;
+            if (should_advance) {
+                advance(tokenizer);
+            }
+            should_advance = true;
 
-        //for (s32 y = level->height - 1; (y >= 0) && should_loop; --y) {
-        for (u32 y = 0; (y < level->height) && should_loop; ++y) {
-            for (u32 x = 0; (x < level->width) && should_loop; ++x) {
-                Tile *tile = &state->tiles[(y * level->width) + x];
+            eat_spaces_and_newline(tokenizer);
+            reload(tokenizer);
+        }
+    }
 
-                switch (tokenizer.curr_char) {
-                    case '.': {
-                        tile->actor_id = kActor_ID_Null;
-                    } break;
-
-                    case 'P':
-                    case '1':
-                    case '2':
-                    case '3':
-                    case '4': {
-                        Actor_Type type = get_actor_type_from_char(tokenizer.curr_char);
-                        should_loop = add_actor(&tokenizer, level, state, x, y, type);
-                    } break;
-
-                    default: {
-                        token = get_token(&tokenizer);
-                        if (token.type == Token_comment) {
-                            skip_to_next_line(&tokenizer);
-                            should_advance = false;
-                        }
-                        else {
-                            tokenizer.error = true;
-                            _snprintf_s(tokenizer.error_string, kTokenizer_Error_String_Max_Length, _TRUNCATE, "In %s at %u:%u, found invalid token in the actor layer",
-                                        tokenizer.path_and_name, token.line_number, token.line_position);
-                            should_loop = false;
-                        }
-                    } break;
-                }
 
-                if (should_advance) {
-                    advance(&tokenizer);
-                }
-                should_advance = true;
+    //
+    // Items
+    require_identifier_with_exact_name(tokenizer, &token, "Layer_items");
+    require_token(tokenizer, &token, Token_colon);
+    eat_spaces_and_newline(tokenizer);
+    reload(tokenizer);
+
+    should_loop = !tokenizer->error;
+    should_advance = true;
+
+    //for (s32 y = level->height - 1; (y >= 0) && should_loop; --y) {
+    for (u32 y = 0; (y < level->height) && should_loop; ++y) {
+        for (u32 x = 0; (x < level->width) && should_loop; ++x) {
+            if (level_layer_has_ended(tokenizer, "items")) {
+                should_loop = false;
+                break;
+            }
+            Tile *tile = &state->tiles[(y * level->width) + x];
+
+            switch (tokenizer->curr_char) {
+                case '.': {
+                    tile->item.type = Item_Type_None;
+                    tile->item.value = 0;
+                } break;
+
+                case '+': {
+                    tile->item.type = Item_Type_Dot_Small;
+                    tile->item.value = kDot_Small_Value;
+                    state->score += tile->item.value;
+                    ++state->small_dot_count;
+                } break;
+
+                case 'X': {
+                    tile->item.type = Item_Type_Dot_Large;
+                    tile->item.value = kDot_Large_Value;
+                    state->score += tile->item.value;
+                    ++state->large_dot_count;
+                } break;
+
+                default: {
+                    token = get_token(tokenizer);
+                    if (token.type == Token_comment) {
+                        skip_to_next_line(tokenizer);
+                        should_advance = false;
+                    }
+                    else {
+                        tokenizer->error = true;
+                        _snprintf_s(tokenizer->error_string, kTokenizer_Error_String_Max_Length, _TRUNCATE, "In %s at %u:%u, found invalid token in the items layer",
+                                    tokenizer->path_and_name, token.line_number, token.line_position);
+                        should_loop = false;
+                    }
+                } break;
+            }
 
-                eat_spaces_and_newline(&tokenizer);
-                reload(&tokenizer);
+            if (should_advance) {
+                advance(tokenizer);
             }
+            should_advance = true;
+
+            eat_spaces_and_newline(tokenizer);
+            reload(tokenizer);
         }
+    }
 
 
+    //
+    // Actors
+    require_identifier_with_exact_name(tokenizer, &token, "Layer_actors");
+    require_token(tokenizer, &token, Token_colon);
+    eat_spaces_and_newline(tokenizer);
+    reload(tokenizer);
+
+    should_loop = !tokenizer->error;
+    should_advance = true;
+
+    //for (s32 y = level->height - 1; (y >= 0) && should_loop; --y) {
+    for (u32 y = 0; (y < level->height) && should_loop; ++y) {
+        for (u32 x = 0; (x < level->width) && should_loop; ++x) {
+            if (level_layer_has_ended(tokenizer, "actor")) {
+                should_loop = false;
+                break;
+            }
+            Tile *tile = &state->tiles[(y * level->width) + x];
+
+            switch (tokenizer->curr_char) {
+                case '.': {
+                    tile->actor_id = kActor_ID_Null;
+                } break;
+
+                case 'P':
+                case '1':
+                case '2':
+                case '3':
+                case '4': {
+                    Actor_Type type = get_actor_type_from_char(tokenizer->curr_char);
+                    should_loop = add_actor(tokenizer, level, state, x, y, type);
+                } break;
+
+                default: {
+                    token = get_token(tokenizer);
+                    if (token.type == Token_comment) {
+                        skip_to_next_line(tokenizer);
+                        should_advance = false;
+                    }
+                    else {
+                        tokenizer->error = true;
+                        _snprintf_s(tokenizer->error_string, kTokenizer_Error_String_Max_Length, _TRUNCATE, "In %s at %u:%u, found invalid token in the actor layer",
+                                    tokenizer->path_and_name, token.line_number, token.line_position);
+                        should_loop = false;
+                    }
+                } break;
+            }
 
-        //
-        // Done
-        adjust_walls_in_level(level, &level->original_state);
-        copy_level_state(&level->states[0], &level->original_state);
-        level->first_valid_state_index = 0;
-        level->last_valid_state_index = 0;
-        level->current_state_index = 0;
-        level->current_state = &level->states[0];
+            if (should_advance) {
+                advance(tokenizer);
+            }
+            should_advance = true;
 
-        fini_tokenizer(&tokenizer);
+            eat_spaces_and_newline(tokenizer);
+            reload(tokenizer);
+        }
     }
 
-    return result;
+
+
+    //
+    // Done
+    adjust_walls_in_level(level, &level->original_state);
+    copy_level_state(&level->states[0], &level->original_state);
+    level->first_valid_state_index = 0;
+    level->last_valid_state_index = 0;
+    level->current_state_index = 0;
+    level->current_state = &level->states[0];
 }
 
 
@@ -1136,136 +1375,242 @@ static b32 load_level(Level *level, Resources *resources, char const *name) {
 // - http://www.roguebasin.com/index.php?title=The_Incredible_Power_of_Dijkstra_Maps
 //
 
+// Lowers every floor tile to one more than its lowest floor neighbour, until nothing changes. Only floor
+// tiles are read, the others are expected to be at max_value. The floor tiles below max_value are the
+// seeds, they're taken in order of value and merged with a queue of the tiles they lowered. Both are then
+// in order, so every tile is only lowered once.
 void process_map(s32 *map, Tile *tiles, u32 width, u32 height, u32 max_value = 999) {
-    u32 change_count = 1;
-    while (change_count > 0) {
-        change_count = 0;
-        for (u32 y = 0; y < height; ++y) {
-            for (u32 x = 0; x < width; ++x) {
-                u32 curr_index = (width * y) + x;
-
-                Tile *tile = &tiles[curr_index];
-                if (!tile_is_traversable(tile))  continue;
+    s32 constexpr X[] = {1, 0, -1, 0};
+    s32 constexpr Y[] = {0, 1, 0, -1};
 
-                s32 min_value = max_value;
+    u32 tile_count = width * height;
+    s32 max = static_cast<s32>(max_value);
 
-                if (x < (width - 1)) {
-                    u32 next_index = (width * y) + x + 1;
-                    s32 *next_value = &map[next_index];
-                    min_value = min_value > *next_value ? *next_value : min_value;
-                }
+    s32 smallest = max;
+    for (u32 index = 0; index < tile_count; ++index) {
+        if (tile_is_traversable(&tiles[index]) && map[index] < smallest)  smallest = map[index];
+    }
+    if (smallest >= max)  return;
 
-                if (y < (height - 1)) {
-                    u32 next_index = (width * (y + 1)) + x;
-                    s32 *next_value = &map[next_index];
-                    min_value = min_value > *next_value ? *next_value : min_value;
-                }
+    u32 value_count = static_cast<u32>(max - smallest);
+    u32 *memory = static_cast<u32 *>(malloc((3 * tile_count + value_count + 1) * sizeof(u32)));
+    if (!memory) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        return;
+    }
+    u32 *seeds  = memory;
+    u32 *queue  = seeds + tile_count;
+    u32 *starts = queue + tile_count;     // Per value, where its seeds start
+    s32 *seed_values = reinterpret_cast<s32 *>(starts + value_count + 1);
 
-                if (x > 0) {
-                    u32 next_index = (width * y) + x - 1;
-                    s32 *next_value = &map[next_index];
-                    min_value = min_value > *next_value ? *next_value : min_value;
-                }
+    //
+    // Sort the seeds by value
+    memset(starts, 0, (value_count + 1) * sizeof(u32));
+    for (u32 index = 0; index < tile_count; ++index) {
+        if (tile_is_traversable(&tiles[index]) && map[index] < max)  ++starts[map[index] - smallest + 1];
+    }
+    for (u32 index = 1; index <= value_count; ++index) {
+        starts[index] += starts[index - 1];
+    }
+    u32 seed_count = 0;
+    for (u32 index = 0; index < tile_count; ++index) {
+        if (tile_is_traversable(&tiles[index]) && map[index] < max) {
+            u32 position = starts[map[index] - smallest]++;
+            seeds[position] = index;
+            seed_values[position] = map[index];
+            ++seed_count;
+        }
+    }
 
-                if (y > 0) {
-                    u32 next_index = (width * (y - 1)) + x;
-                    s32 *next_value = &map[next_index];
-                    min_value = min_value > *next_value ? *next_value : min_value;
-                }
+    //
+    // Take the lowest of the next seed and the next lowered tile
+    u32 seed_head  = 0;
+    u32 queue_head = 0;
+    u32 queue_tail = 0;
+    while (seed_head < seed_count || queue_head < queue_tail) {
+        u32 curr_index;
+        if (queue_head < queue_tail && (seed_head == seed_count || map[queue[queue_head]] <= seed_values[seed_head])) {
+            curr_index = queue[queue_head++];
+        }
+        else {
+            curr_index = seeds[seed_head];
+            b32 was_lowered = map[curr_index] != seed_values[seed_head++];
+            if (was_lowered)  continue; // It is in the queue
+        }
 
-                s32 *curr_value = &map[curr_index];
-                if (*curr_value > (min_value + 1)) {
-                    *curr_value = min_value + 1;
-                    ++change_count;
-                }
+        s32 next_value = map[curr_index] + 1;
+        s32 x = static_cast<s32>(curr_index % width);
+        s32 y = static_cast<s32>(curr_index / width);
+        for (u32 direction = 0; direction < 4; ++direction) {
+            s32 next_x = x + X[direction];
+            s32 next_y = y + Y[direction];
+            if (next_x < 0 || next_y < 0 || next_x >= static_cast<s32>(width) || next_y >= static_cast<s32>(height))  continue;
+
+            u32 next_index = (width * next_y) + next_x;
+            if (tile_is_traversable(&tiles[next_index]) && map[next_index] > next_value) {
+                map[next_index] = next_value;
+                queue[queue_tail++] = next_index;
             }
         }
     }
+
+    free(memory);
 }
 
 
-void create_maps_off_level(Level *level) {
-    size_t map_size_in_bytes = level->width * level->height * sizeof(s32);
-    for (u32 map_index = 0; map_index < Map_Count; ++map_index) {
-        s32 **map = &level->maps[map_index];
-        if (*map) {
-            free(*map);
-            *map = nullptr;
-        }
+// The tiles a map starts out at 0 on, tile is traversable
+static b32 is_map_source(Level *level, Map_Type map_type, Tile *tile, u32 x, u32 y) {
+    b32 result = false;
 
-        *map = static_cast<s32 *>(malloc(map_size_in_bytes));
-        assert(*map);
+    if (map_type == Map_Ghosts || map_type == Map_Flee_Ghosts) {
+        Actor *actor = get_actor_at(level, x, y);
+        result = actor && actor_is_ghost(actor);
+    }
+    else if (map_type == Map_Dot_Small) {
+        result = tile->item.type == Item_Type_Dot_Small;
+    }
+    else if (map_type == Map_Dot_Large) {
+        result = tile->item.type == Item_Type_Dot_Large;
     }
 
+    return result;
+}
+
+
+static s32 *get_map(Level *level, Map_Type map_type);
+
+static void build_map(Level *level, Map_Type map_type, s32 *map) {
+    PROFILE_FUNCTION();
     u32 width = level->width;
     u32 height = level->height;
     Tile *tiles = level->current_state->tiles;
-    u32 constexpr max_value = 300;
-
 
     //
-    // Process the maps
-    for (u32 map_index = 0; map_index < Map_Count; ++map_index) {
-        s32 *map = level->maps[map_index];
-
-        //
-        // Set initial values
+    // For the flee map, we want to "invert" the values so that when "rolling down" it, we will
+    // move away from the ghosts but moving away in a manner that doesn't always lead to the corners.
+    if (map_type == Map_Flee_Ghosts) {
+        memcpy(map, get_map(level, Map_Ghosts), width * height * sizeof(s32));
+        for (u32 index = 0; index < width * height; ++index) {
+            if (tile_is_traversable(&tiles[index]))  map[index] = -1 * map[index];
+        }
+    }
+    else {
         for (u32 y = 0; y < height; ++y) {
             for (u32 x = 0; x < width; ++x) {
                 u32 index = (width * y) + x;
-                s32 *value = &map[index];
                 Tile *tile = &tiles[index];
-                *value = max_value;
-
-                if (tile_is_traversable(tile)) {
-                    if (map_index == Map_Ghosts || map_index == Map_Flee_Ghosts) {
-                        Actor *actor = get_actor_at(level, x, y);
-                        if (actor && actor_is_ghost(actor)) {
-                            *value = 0;
-                        }
-                    }
-                    else if (map_index == Map_Dot_Small) {
-                        if (tile->item.type == Item_Type_Dot_Small) {
-                            *value = 0;
-                        }
-                    }
-                    else if (map_index == Map_Dot_Large) {
-                        if (tile->item.type == Item_Type_Dot_Large) {
-                            *value = 0;
-                        }
-                    }
-                }
+                map[index] = tile_is_traversable(tile) && is_map_source(level, map_type, tile, x, y) ? 0 : kMap_Max_Value;
             }
         }
+    }
+
+    process_map(map, tiles, width, height, kMap_Max_Value);
+}
 
-        process_map(map, tiles, width, height, max_value);
+
+// Called whenever the level state changes. The maps are only built again when asked for, and the distance
+// oracle only when the walls have changed.
+void create_maps_off_level(Level *level) {
+    PROFILE_FUNCTION();
+    for (u32 map_index = 0; map_index < Map_Count; ++map_index) {
+        level->map_is_current[map_index] = false;
     }
 
+    update_distance_oracle(&level->distance_oracle, level->current_state->tiles, level->width, level->height);
+}
+
+
+// The whole map, e.g. for drawing it
+static s32 *get_map(Level *level, Map_Type map_type) {
+    s32 **map = &level->maps[map_type];
+
+    if (!level->map_is_current[map_type]) {
+        if (*map)  free(*map);
+        *map = static_cast<s32 *>(malloc(level->width * level->height * sizeof(s32)));
+        assert(*map);
+
+        build_map(level, map_type, *map);
+        level->map_is_current[map_type] = true;
+    }
+
+    return *map;
+}
+
+
+// The values the map has at the given tiles. With a distance table that is the distance to the nearest
+// source, or for the flee map the lowest "distance to here minus the distance to the nearest ghost" of
+// all the tiles that can be reached, without building the map.
+static void get_map_values(Level *level, Map_Type map_type, u32 const *tile_indices, u32 count, s32 *values) {
+    Distance_Oracle *oracle = &level->distance_oracle;
+
+    if (!oracle->table || level->map_is_current[map_type]) {
+        s32 *map = get_map(level, map_type);
+        for (u32 index = 0; index < count; ++index) {
+            values[index] = map[tile_indices[index]];
+        }
+        return;
+    }
 
     //
-    // For the flee map, we want to "invert" the values so that when "rolling down" it, we will
-    // move away from the ghosts but moving away in a manner that doesn't always lead to the corners.
-    {
-        s32 *map = level->maps[Map_Flee_Ghosts];
-        for (u32 y = 0; y < height; ++y) {
-            for (u32 x = 0; x < width; ++x) {
-                u32 curr_index = (width * y) + x;
+    // The sources, as cells of the oracle. The ghosts are found from the actors, there are fewer of them.
+    Level_State *state = level->current_state;
+    u32 *sources = oracle->queue;
+    u32 source_count = 0;
+    if (map_type == Map_Ghosts || map_type == Map_Flee_Ghosts) {
+        for (u32 index = 0; index < state->actors.count; ++index) {
+            Actor *actor = &state->actors.data[index];
+            if (actor_is_alive(actor) && actor_is_ghost(actor)) {
+                s32 cell = oracle->cell_of_tile[(level->width * actor->position.y) + actor->position.x];
+                if (cell >= 0)  sources[source_count++] = static_cast<u32>(cell);
+            }
+        }
+    }
+    else {
+        for (u32 cell = 0; cell < oracle->cell_count; ++cell) {
+            u32 tile_index = oracle->tile_of_cell[cell];
+            if (is_map_source(level, map_type, &state->tiles[tile_index], tile_index % level->width, tile_index / level->width)) {
+                sources[source_count++] = cell;
+            }
+        }
+    }
 
-                Tile *tile = &tiles[curr_index];
-                if (!tile_is_traversable(tile))  continue;
+    //
+    // For the flee map, minus the distance to the nearest ghost of every cell first
+    if (map_type == Map_Flee_Ghosts) {
+        for (u32 cell = 0; cell < oracle->cell_count; ++cell) {
+            s32 value = kMap_Max_Value;
+            for (u32 source = 0; source < source_count; ++source) {
+                value = min(value, static_cast<s32>(get_distance(oracle, cell, sources[source])));
+            }
+            oracle->values[cell] = -1 * value;
+        }
+    }
 
-                map[curr_index] = -1 * map[curr_index];
+    for (u32 index = 0; index < count; ++index) {
+        s32 cell = oracle->cell_of_tile[tile_indices[index]];
+        s32 value = kMap_Max_Value; // What the walls are on every map
+
+        if (cell >= 0 && map_type == Map_Flee_Ghosts) {
+            for (u32 other_cell = 0; other_cell < oracle->cell_count; ++other_cell) {
+                u32 distance = get_distance(oracle, cell, other_cell);
+                if (distance != kDistance_Unreachable) {
+                    value = min(value, oracle->values[other_cell] + static_cast<s32>(distance));
+                }
+            }
+        }
+        else if (cell >= 0) {
+            for (u32 source = 0; source < source_count; ++source) {
+                value = min(value, static_cast<s32>(get_distance(oracle, cell, sources[source])));
             }
         }
 
-        process_map(map, tiles, width, height, max_value);
+        values[index] = value;
     }
 }
 
 
-Map_Direction get_shortest_direction_on_map(Level *level, s32 *map, Actor *actor) {
+Map_Direction get_shortest_direction_on_map(Level *level, Map_Type map_type, Actor *actor) {
     Map_Direction result = {Direction_Unknown, 0x7FFFFFFF};
-    //Level *level = get_current_level_state(world);
 
     s32 constexpr X[] = {1, 0, -1, 0};
     s32 constexpr Y[] = {0, 1, 0, -1};
@@ -1273,15 +1618,27 @@ Map_Direction get_shortest_direction_on_map(Level *level, s32 *map, Actor *actor
     v2u P = actor->position;
 
     if (P.x < level->width && P.y < level->height) {
+        u32 directions[4];
+        u32 tile_indices[4];
+        s32 values[4];
+        u32 count = 0;
+
         for (u32 index = 0; index < 4; ++index) {
             v2s dP = v2s(X[index], Y[index]);
             if (move_is_possible(level, actor, dP)) {
                 v2s new_P = P + dP;
-                s32 value = map[(level->width * new_P.y) + new_P.x];
-                if (value < result.distance) {
-                    result.distance = value;
-                    result.direction = static_cast<Direction>(index);
-                }
+                directions[count] = index;
+                tile_indices[count] = (level->width * new_P.y) + new_P.x;
+                ++count;
+            }
+        }
+
+        get_map_values(level, map_type, tile_indices, count, values);
+
+        for (u32 index = 0; index < count; ++index) {
+            if (values[index] < result.distance) {
+                result.distance = values[index];
+                result.direction = static_cast<Direction>(directions[index]);
             }
         }
     }
@@ -1290,14 +1647,16 @@ Map_Direction get_shortest_direction_on_map(Level *level, s32 *map, Actor *actor
 };
 
 
-static void draw_maps(Renderer *renderer, Level *level, s32 **maps, u32 map_index) {
+static void draw_maps(Renderer *renderer, Level *level, u32 map_index) {
+    PROFILE_FUNCTION();
     //
     // Draw maps, DEBUG
     u32 level_width  = level->width;
     u32 level_height = level->height;
     Font *font = &level->resources->font;
 
-    if (map_index < Map_Count && maps[map_index]) {
+    if (map_index < Map_Count && level->current_state) {
+        s32 *map = get_map(level, static_cast<Map_Type>(map_index));
         char text[10];
 
         u32 constexpr kOffset_x = kCell_Size / 2;
@@ -1306,7 +1665,7 @@ static void draw_maps(Renderer *renderer, Level *level, s32 **maps, u32 map_inde
         for (u32 y = 0; y < level_height; ++y) {
             for (u32 x = 0; x < level_width; ++x) {
                 u32 index = (level_width * y) + x;
-                s32 value = maps[map_index][index];
+                s32 value = map[index];
                 u32 error = _snprintf_s(text, 10, _TRUNCATE, "%d", value);
                 assert(error > 0);
 
@@ -1370,6 +1729,10 @@ static void free_array_of_levels(Array_Of_Levels *levels) {
             Level *level = &levels->data[index];
             fini_level(level);
         }
+        if (levels->data)  free(levels->data);
+        levels->data = nullptr;
+        levels->capacity = 0;
+        levels->count = 0;
     }
 }
 
@@ -1392,9 +1755,15 @@ b32 grow_array_of_levels(Array_Of_Levels *array) {
         size_t new_size = sizeof(Level) * new_capacity;
         void *new_ptr = realloc(array->data, new_size);
         if (new_ptr) {
-            array->capacity = new_capacity;
             array->data = static_cast<Level *>(new_ptr);
-            memset(array->data, 0, array->capacity * sizeof(Level));
+            memset(array->data + array->capacity, 0, (new_capacity - array->capacity) * sizeof(Level));
+            array->capacity = new_capacity;
+
+            // The levels have moved, and their current state with them
+            for (u32 index = 0; index < array->count; ++index) {
+                Level *level = &array->data[index];
+                if (level->current_state)  level->current_state = &level->states[level->current_state_index];
+            }
             result = true;
         }
         else {
@@ -1428,7 +1797,7 @@ static Level *get_level_with_id(Array_Of_Levels *levels, u32 level_id) {
     Level *result = nullptr;
 
     if (levels) {
-        for (u32 index = 0; index < levels->capacity; ++index) {
+        for (u32 index = 0; index < levels->count; ++index) {
             Level *level = &levels->data[index];
             if (level->id == level_id) {
                 result = level;
@@ -1445,7 +1814,7 @@ static Level *get_level_with_exact_name(Array_Of_Levels *levels, char const *nam
     Level *result = nullptr;
 
     if (levels) {
-        for (u32 index = 0; index < levels->capacity; ++index) {
+        for (u32 index = 0; index < levels->count; ++index) {
             Level *level = &levels->data[index];
             if (strcmp(level->name, name) == 0) {
                 result = level;
@@ -1466,14 +1835,19 @@ static u32 load_levels_from_disc(Array_Of_Levels *levels, Resources *resources)
 
         WIN32_FIND_DATAA find_data;
         HANDLE find_handle = FindFirstFileA("data\\levels\\*.level_txt", &find_data);
-        b32 load_result = true;
         b32 find_result = true;
 
-        while ((load_result) && (find_result) && (find_handle != INVALID_HANDLE_VALUE)) {
+        while ((find_result) && (find_handle != INVALID_HANDLE_VALUE)) {
             Level *level = get_next_empty_level(levels);
             if (level) {
-                load_result = load_level(level, resources, find_data.cFileName);
-                if (load_result)  ++loaded_levels;
+                if (load_level(level, resources, find_data.cFileName)) {
+                    ++loaded_levels;
+                }
+                else {
+                    // Left out, load_level() has said why, the other levels are still loaded
+                    fini_level(level);
+                    --levels->count;
+                }
             }
             find_result = FindNextFileA(find_handle, &find_data);
         }
@@ -1566,6 +1940,7 @@ static b32 read_level_set_from_disc(u32_darray *u32_array, char const *level_set
                 }
             }
 
+            eat_spaces_and_newline(&tokenizer);
             if (!is_eof(&tokenizer)) {
                 result = require_token(&tokenizer, &token, Token_comma);
             }
@@ -2,6 +2,24 @@
 // Logging utility
 // (c) Marcus Larsson
 //
+// Logging never touches the file on the calling thread. A call copies the message into a fixed-size record in
+// a lock-free ring buffer (many producers, one consumer) and returns. The writer thread, started by open_log(),
+// wakes up every few milliseconds, formats and timestamps everything in the ring and flushes it as one batch.
+// If the ring is full the message is dropped and counted instead of blocking the caller, the writer reports
+// the number of dropped messages with the next batch.
+//
+// Before open_log() and after close_log() (or if the writer failed to start) the messages are written
+// directly, on the calling thread, just like before.
+//
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#define kLog_Ring_Size          1024 // Must be a power of two
+#define kLog_Message_Length     128  // Longer messages are truncated
+#define kLog_Error_String_Length 64
+#define kLog_Writer_Sleep_Ms    4
 
 
 
@@ -10,10 +28,45 @@
 // Declarations
 //
 
+enum Log_Record_Type {
+    Log_Record_Str = 0,
+    Log_Record_U32,
+    Log_Record_Error,
+    Log_Record_Error_Str,
+};
+
+
+struct Log_Record {
+    time_t time;
+    char const *file;     // Always string literals (__FILENAME__ and __FUNCTION__), so the pointers are enough
+    char const *function;
+    u32 line;
+    u32 value;
+    u8  type;             // Log_Record_Type
+    u8  has_error_string;
+    char message[kLog_Message_Length];
+    char error_string[kLog_Error_String_Length];
+};
+
+
+// One slot of the ring, see http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+struct Log_Cell {
+    std::atomic<u32> sequence;
+    Log_Record record;
+};
+
+
 struct Log {
     FILE *file = nullptr;
     b32 print_log = false;
-    b32 flush_immediately = true;
+    b32 flush_immediately = true; // The writer flushes after every batch, otherwise only when the log is closed
+
+    Log_Cell *ring = nullptr;
+    alignas(64) std::atomic<u32> write_position{0};
+    alignas(64) u32 read_position = 0;  // Only touched by the writer thread
+    std::atomic<u32> dropped_count{0};
+    std::atomic<b32> is_running{false};
+    std::thread writer;
 };
 
 static b32 open_log(Log *log);
@@ -22,8 +75,6 @@ static void log_error(Log *log, char const *string, u32 value, char const *file
 static void log_error_str(Log *log, char const *string, char const *error_string, char const *file = nullptr, char const *function = nullptr, u32 line = 0);
 static void log_str(Log *log, char const *string);
 static void log_u32(Log *log, char const *string, u32 value);
-static void log_current_time(Log *log);
-static void close_log(Log *log);
 
 #define LOG_ERROR(log, string, error_value)   log_error(log, string, error_value, __FILENAME__, __FUNCTION__, __LINE__)
 #define LOG_ERROR_STR(log, string, error_str) log_error_str(log, string, error_str, __FILENAME__, __FUNCTION__, __LINE__)
@@ -35,13 +86,203 @@ static void close_log(Log *log);
 // Implementation
 //
 
+
+//
+// Formatting, only done by the writer thread (or by the caller when there is no writer)
+
+static void write_time(FILE *file, time_t timer) {
+    tm local_time;
+    u32 time_result = localtime_s(&local_time, &timer);
+    if (time_result == 0) {
+        fprintf(file, "(%02d:%02d:%02d) ",
+                local_time.tm_hour, local_time.tm_min, local_time.tm_sec);
+    }
+    else {
+        fprintf(file, "!_ERROR: failed to get the current date and time, error: %d\n", time_result);
+    }
+}
+
+
+static void write_log_record(Log *log, Log_Record *record) {
+    char const *error_string = record->has_error_string ? record->error_string : nullptr;
+
+    if (log->file) {
+        switch (record->type) {
+            case Log_Record_Str: {
+                write_time(log->file, record->time);
+                fprintf(log->file, "%s\n", record->message);
+            } break;
+
+            case Log_Record_U32: {
+                write_time(log->file, record->time);
+                fprintf(log->file, "%s: %u\n", record->message, record->value);
+            } break;
+
+            case Log_Record_Error: {
+                fprintf(log->file, "!_");
+                write_time(log->file, record->time);
+                if (record->file && record->function && record->line) {
+                    fprintf(log->file, "Error in %s in %s at line %u, %s (%u)\n", record->file, record->function, record->line, record->message, record->value);
+                }
+                else {
+                    fprintf(log->file, "Error, %s (%u)\n", record->message, record->value);
+                }
+            } break;
+
+            case Log_Record_Error_Str: {
+                fprintf(log->file, "!_");
+                write_time(log->file, record->time);
+                if (record->file && record->function && record->line) {
+                    if (error_string) {
+                        fprintf(log->file, "Error in %s in %s at line %u, %s (%s)\n", record->file, record->function, record->line, record->message, error_string);
+                    }
+                    else {
+                        fprintf(log->file, "Error in %s in %s at line %u, %s\n", record->file, record->function, record->line, record->message);
+                    }
+                }
+                else {
+                    fprintf(log->file, "Error, %s (%s)\n", record->message, error_string);
+                }
+            } break;
+        }
+    }
+
+    if (log->print_log || !log->file) {
+        switch (record->type) {
+            case Log_Record_Str: {
+                printf("%s\n", record->message);
+            } break;
+
+            case Log_Record_U32: {
+                printf("%s: %u\n", record->message, record->value);
+            } break;
+
+            case Log_Record_Error: {
+                printf("Error in %s in %s at line %u, %s (%u)\n", record->file, record->function, record->line, record->message, record->value);
+            } break;
+
+            case Log_Record_Error_Str: {
+                printf("Error in %s in %s at line %u, %s (%s)\n", record->file, record->function, record->line, record->message, error_string);
+            } break;
+        }
+    }
+}
+
+
+//
+// The ring buffer
+
+// Returns false if the ring is full, the caller never waits for the writer.
+static b32 push_log_record(Log *log, Log_Record *record) {
+    b32 result = false;
+
+    u32 position = log->write_position.load(std::memory_order_relaxed);
+    for (;;) {
+        Log_Cell *cell = &log->ring[position & (kLog_Ring_Size - 1)];
+        u32 sequence = cell->sequence.load(std::memory_order_acquire);
+        s32 difference = static_cast<s32>(sequence - position);
+
+        if (difference == 0) {
+            if (log->write_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                cell->record = *record;
+                cell->sequence.store(position + 1, std::memory_order_release);
+                result = true;
+                break;
+            }
+            // position was reloaded by the failed compare_exchange, try again
+        }
+        else if (difference < 0) {
+            break; // Full
+        }
+        else {
+            position = log->write_position.load(std::memory_order_relaxed);
+        }
+    }
+
+    return result;
+}
+
+
+// Writes everything that is in the ring right now, returns the number of records written. The records are
+// timestamped here, with the time of the batch, the callers don't spend the time(nullptr) on it.
+static u32 drain_log_ring(Log *log) {
+    u32 result = 0;
+    time_t batch_time = time(nullptr);
+
+    for (;;) {
+        Log_Cell *cell = &log->ring[log->read_position & (kLog_Ring_Size - 1)];
+        u32 sequence = cell->sequence.load(std::memory_order_acquire);
+        if (sequence != log->read_position + 1)  break; // Empty, or the producer hasn't finished copying yet
+
+        cell->record.time = batch_time;
+        write_log_record(log, &cell->record);
+        cell->sequence.store(log->read_position + kLog_Ring_Size, std::memory_order_release);
+        ++log->read_position;
+        ++result;
+    }
+
+    u32 dropped_count = log->dropped_count.exchange(0, std::memory_order_relaxed);
+    if (dropped_count > 0) {
+        Log_Record record = {};
+        record.time  = batch_time;
+        record.type  = Log_Record_U32;
+        record.value = dropped_count;
+        _snprintf_s(record.message, kLog_Message_Length, _TRUNCATE, "Log ring buffer full, messages dropped");
+        write_log_record(log, &record);
+        ++result;
+    }
+
+    if (result > 0 && log->flush_immediately && log->file) {
+        fflush(log->file);
+    }
+
+    return result;
+}
+
+
+static void run_log_writer(Log *log) {
+    while (log->is_running.load(std::memory_order_acquire)) {
+        if (drain_log_ring(log) == 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(kLog_Writer_Sleep_Ms));
+        }
+    }
+
+    // Whatever was logged before close_log() stopped us
+    drain_log_ring(log);
+}
+
+
+static void submit_log_record(Log *log, Log_Record *record) {
+    if (log->is_running.load(std::memory_order_acquire)) {
+        if (!push_log_record(log, record)) {
+            log->dropped_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    else {
+        record->time = time(nullptr);
+        write_log_record(log, record);
+        if (log->flush_immediately && log->file) {
+            fflush(log->file);
+        }
+    }
+}
+
+
+static void copy_log_string(char *dst, u32 dst_size, char const *src) {
+    _snprintf_s(dst, dst_size, _TRUNCATE, "%s", src ? src : "");
+}
+
+
+//
+// API
+
 static b32 open_log(Log *log) {
     b32 result = false;
 
     if (log) {
         errno_t error = fopen_s(&log->file, "log.txt", "wb");
         if (error != 0) {
-            
+            log->file = nullptr;
         }
         else {
             result = true;
@@ -55,9 +296,9 @@ static b32 open_log(Log *log) {
             fprintf(log->file, "\n\n");
             fprintf(log->file, "     A puzzle-homage to Pac-man\n");
             fprintf(log->file, "     Created by Marcus Larsson 2020\n\n");
-            
+
             time_t timer;
-            time(&timer);            
+            time(&timer);
             tm local_time;
             u32 time_result = localtime_s(&local_time, &timer);
             if (time_result == 0) {
@@ -67,11 +308,22 @@ static b32 open_log(Log *log) {
             }
             else {
                 fprintf(log->file, "!ERROR: failed to get the current date and time, error: %d\n", time_result);
-            }            
-        }
+            }
 
-        if (log->flush_immediately) {
             fflush(log->file);
+
+            //
+            // Start the writer
+            log->ring = static_cast<Log_Cell *>(calloc(kLog_Ring_Size, sizeof(Log_Cell)));
+            if (log->ring) {
+                for (u32 index = 0; index < kLog_Ring_Size; ++index) {
+                    log->ring[index].sequence.store(index, std::memory_order_relaxed);
+                }
+                log->write_position.store(0, std::memory_order_relaxed);
+                log->read_position = 0;
+                log->is_running.store(true, std::memory_order_release);
+                log->writer = std::thread(run_log_writer, log);
+            }
         }
     }
 
@@ -79,73 +331,45 @@ static b32 open_log(Log *log) {
 }
 
 
-static void log_current_time(Log *log) {
-    if (log) {
-        time_t timer;
-        time(&timer);            
-        tm local_time;
-        u32 time_result = localtime_s(&local_time, &timer);
-        if (time_result == 0) {
-            fprintf(log->file, "(%02d:%02d:%02d) ",
-                    local_time.tm_hour, local_time.tm_min, local_time.tm_sec);
-        }
-        else {
-            fprintf(log->file, "!_ERROR: failed to get the current date and time, error: %d\n", time_result);
-        }
-    }
-}
-
-
 static void log_str(Log *log, char const *string) {
     if (log && string) {
-        log_current_time(log);
-        fprintf(log->file, "%s\n", string);
+        Log_Record record = {};
+        record.type = Log_Record_Str;
+        copy_log_string(record.message, kLog_Message_Length, string);
+        submit_log_record(log, &record);
     }
-
-    if (log->print_log || !log) {
+    else if (string) {
         printf("%s\n", string);
     }
-
-    if (log->flush_immediately) {
-        fflush(log->file);
-    }
 }
 
 
 static void log_u32(Log *log, char const *string, u32 value) {
     if (log && string) {
-        log_current_time(log);
-        fprintf(log->file, "%s: %u\n", string, value);
-    }
-
-    if (log->print_log || !log) {
-        printf("%s\n", string);
+        Log_Record record = {};
+        record.type  = Log_Record_U32;
+        record.value = value;
+        copy_log_string(record.message, kLog_Message_Length, string);
+        submit_log_record(log, &record);
     }
-
-    if (log->flush_immediately) {
-        fflush(log->file);
+    else if (string) {
+        printf("%s: %u\n", string, value);
     }
 }
 
 
 static void log_error(Log *log, char const *string, u32 error_value, char const *file, char const *function, u32 line) {
     if (log) {
-        fprintf(log->file, "!_");
-        log_current_time(log);
-
-        if (file && function && line) {
-            fprintf(log->file, "Error in %s in %s at line %u, %s (%u)\n", file, function, line, string, error_value);
-        }
-        else {
-            fprintf(log->file, "Error, %s (%u)\n", string, error_value);
-        }
-
-        if (log->flush_immediately) {
-            fflush(log->file);
-        }
+        Log_Record record = {};
+        record.type     = Log_Record_Error;
+        record.value    = error_value;
+        record.file     = file;
+        record.function = function;
+        record.line     = line;
+        copy_log_string(record.message, kLog_Message_Length, string);
+        submit_log_record(log, &record);
     }
-
-    if (log->print_log || !log) {
+    else {
         printf("Error in %s in %s at line %u, %s (%u)\n", file, function, line, string, error_value);
     }
 }
@@ -153,34 +377,39 @@ static void log_error(Log *log, char const *string, u32 error_value, char const
 
 static void log_error_str(Log *log, char const *string, char const *error_string, char const *file, char const *function, u32 line) {
     if (log) {
-        fprintf(log->file, "!_");
-        log_current_time(log);
-
-        if (file && function && line) {
-            if (error_string) {
-                fprintf(log->file, "Error in %s in %s at line %u, %s (%s)\n", file, function, line, string, error_string);
-            }
-            else {
-                fprintf(log->file, "Error in %s in %s at line %u, %s\n", file, function, line, string);
-            }
-        }
-        else {
-            fprintf(log->file, "Error, %s (%s)\n", string, error_string);
-        }
-
-        if (log->flush_immediately) {
-            fflush(log->file);
+        Log_Record record = {};
+        record.type     = Log_Record_Error_Str;
+        record.file     = file;
+        record.function = function;
+        record.line     = line;
+        copy_log_string(record.message, kLog_Message_Length, string);
+        if (error_string) {
+            record.has_error_string = true;
+            copy_log_string(record.error_string, kLog_Error_String_Length, error_string);
         }
+        submit_log_record(log, &record);
     }
-
-    if (log->print_log || !log) {
+    else {
         printf("Error in %s in %s at line %u, %s (%s)\n", file, function, line, string, error_string);
     }
 }
 
 
+// Stops the writer after it has written everything that was logged before this call.
 static void close_log(Log *log) {
-    if (log && log->file) {
-        fclose(log->file);
+    if (log) {
+        if (log->is_running.exchange(false, std::memory_order_acq_rel)) {
+            log->writer.join();
+        }
+
+        if (log->ring) {
+            free(log->ring);
+            log->ring = nullptr;
+        }
+
+        if (log->file) {
+            fclose(log->file);
+            log->file = nullptr;
+        }
     }
 }
@@ -417,3 +417,22 @@ u32 fp_lerp_premul(u32 dst, u32 src) {
     u32 result = (a << 24) | (r << 16) | (g << 8) | b;    
     return result;
 }
+
+
+
+
+//
+// Hashing
+//
+
+u64 constexpr kFNV_Offset_Basis = 0xcbf29ce484222325;
+u64 constexpr kFNV_Prime        = 0x100000001b3;
+
+u64 fnv1a_64(u64 hash, void const *data, size_t size) {
+    u8 const *bytes = static_cast<u8 const *>(data);
+    for (size_t index = 0; index < size; ++index) {
+        hash ^= bytes[index];
+        hash *= kFNV_Prime;
+    }
+    return hash;
+}
@@ -0,0 +1,378 @@
+//
+// Software audio mixer
+//
+// All sounds are mixed into a single stereo stream of 32-bit floats, which is all the audio back-end sees (see
+// win32_audio.cpp). The game thread posts commands (play this sound) through a lock-free single producer,
+// single consumer queue. The mixing thread (the back-end's buffer callback) picks them up at the start of
+// every buffer, so posting never waits for the mixer and the mixer never waits for the game.
+//
+// Wavs are decoded once, on the game thread, into Mixer_Sounds in the mixer's format; stereo floats at the
+// mixer's sample rate. After that a playing sound is just a read position into its samples, and mixing is
+// a SIMD multiply-add per voice.
+//
+
+#include <atomic>
+#include <xmmintrin.h>
+
+#define kMixer_Channel_Count 2
+#define kMixer_Sample_Rate   48000 // The wavs are converted to this offline, see wav_convert.cpp
+#define kMixer_Max_Sounds    64   // Distinct wavs
+#define kMixer_Max_Voices    256  // Sounds playing at the same time, the oldest is replaced when all are busy
+#define kMixer_Command_Count 256  // Must be a power of two
+
+
+
+
+//
+// Declarations
+//
+
+struct Mixer_Sound {
+    Wav const *wav = nullptr;
+    f32 *samples = nullptr;   // Interleaved stereo, padded with silence to a multiple of 4 floats
+    u32 frame_count = 0;
+};
+
+
+struct Mixer_Voice {
+    Mixer_Sound *sound = nullptr;
+    u32 position = 0;         // In frames
+    f32 volume = 1.0f;
+};
+
+
+enum Mixer_Command_Type {
+    Mixer_Command_Play = 0,
+    Mixer_Command_Stop_All,
+};
+
+
+struct Mixer_Command {
+    Mixer_Command_Type type = Mixer_Command_Play;
+    Mixer_Sound *sound = nullptr;
+    f32 volume = 1.0f;
+};
+
+
+struct Mixer {
+    // Game thread
+    Mixer_Sound sounds[kMixer_Max_Sounds];
+    u32 sound_count = 0;
+    u32 sample_rate = kMixer_Sample_Rate;
+
+    // The command queue
+    Mixer_Command commands[kMixer_Command_Count];
+    alignas(64) std::atomic<u32> command_write{0};
+    alignas(64) std::atomic<u32> command_read{0};
+    std::atomic<u32> dropped_command_count{0};
+
+    // Mixing thread
+    alignas(64) Mixer_Voice voices[kMixer_Max_Voices];
+    u32 voice_count = 0;
+    f32 master_volume = 1.0f;
+};
+
+
+
+
+//
+// Init and fini
+//
+
+static void init_mixer(Mixer *mixer, u32 sample_rate) {
+    mixer->sound_count = 0;
+    mixer->sample_rate = sample_rate;
+    mixer->command_write.store(0, std::memory_order_relaxed);
+    mixer->command_read.store(0, std::memory_order_relaxed);
+    mixer->dropped_command_count.store(0, std::memory_order_relaxed);
+    mixer->voice_count = 0;
+}
+
+
+// The mixing thread must be stopped before this is called
+static void fini_mixer(Mixer *mixer) {
+    for (u32 index = 0; index < mixer->sound_count; ++index) {
+        if (mixer->sounds[index].samples) {
+            free(mixer->sounds[index].samples);
+        }
+        mixer->sounds[index] = {};
+    }
+    mixer->sound_count = 0;
+    mixer->voice_count = 0;
+}
+
+
+
+
+//
+// Decoding
+//
+
+// Returns a sample in [-1, 1[, bytes points at a sample of bits_per_sample bits (little endian)
+static f32 decode_pcm_sample(u8 const *bytes, u16 bits_per_sample, u16 audio_format) {
+    f32 result = 0.0f;
+
+    if (audio_format == Wav_Audio_Format_IEE_FLOAT && bits_per_sample == 32) {
+        memcpy(&result, bytes, sizeof(f32));
+    }
+    else if (bits_per_sample == 8) { // 8-bit PCM is unsigned
+        result = (static_cast<s32>(bytes[0]) - 128) * (1.0f / 128.0f);
+    }
+    else if (bits_per_sample == 16) {
+        s16 value = static_cast<s16>(bytes[0] | (bytes[1] << 8));
+        result = value * (1.0f / 32768.0f);
+    }
+    else if (bits_per_sample == 24) {
+        s32 value = static_cast<s32>((bytes[0] << 8) | (bytes[1] << 16) | (static_cast<u32>(bytes[2]) << 24)) >> 8;
+        result = value * (1.0f / 8388608.0f);
+    }
+    else if (bits_per_sample == 32) {
+        s32 value = static_cast<s32>(bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<u32>(bytes[3]) << 24));
+        result = value * (1.0f / 2147483648.0f);
+    }
+
+    return result;
+}
+
+
+// Converts the wav to stereo floats at the mixer's sample rate. The wavs in the game's data have already been
+// converted to 16-bit stereo at that rate (see wav_convert.cpp), which is a straight copy. Anything else is
+// handled too: mono is played on both channels, channels after the first two are dropped and other sample
+// rates are converted with linear interpolation.
+static b32 decode_wav(Mixer *mixer, Wav const *wav, Mixer_Sound *output) {
+    b32 result = false;
+
+    Wav_Format const *format = &wav->format;
+    u32 bytes_per_sample = format->bits_per_sample / 8;
+    b32 is_supported = wav->data && format->number_of_channels > 0 && format->sample_rate > 0 &&
+                       bytes_per_sample >= 1 && bytes_per_sample <= 4 &&
+                       format->block_align >= format->number_of_channels * bytes_per_sample;
+    if (!is_supported) {
+        printf("%s() unsupported wav format (%u channels, %u bits, %u Hz)\n", __FUNCTION__,
+               format->number_of_channels, format->bits_per_sample, format->sample_rate);
+        return result;
+    }
+
+    u16 audio_format = format->audio_format;
+    if (audio_format == Wav_Audio_Format_Extensible) {
+        audio_format = static_cast<u16>(format->subformat[0] & 0xFFFF); // The GUID starts with the format tag
+    }
+
+    u32 source_frame_count = static_cast<u32>(wav->data_size / format->block_align);
+    u32 frame_count = static_cast<u32>((static_cast<u64>(source_frame_count) * mixer->sample_rate) / format->sample_rate);
+
+    u32 sample_count = frame_count * kMixer_Channel_Count;
+    u32 padded_sample_count = (sample_count + 3) & ~3u;
+    f32 *samples = static_cast<f32 *>(calloc(padded_sample_count > 0 ? padded_sample_count : 4, sizeof(f32)));
+    if (!samples) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        return result;
+    }
+
+    b32 is_canonical = audio_format == Wav_Audio_Format_PCM && format->bits_per_sample == 16 &&
+                       format->number_of_channels == kMixer_Channel_Count && format->sample_rate == mixer->sample_rate &&
+                       format->block_align == kMixer_Channel_Count * sizeof(s16);
+    if (is_canonical) {
+        s16 const *source = reinterpret_cast<s16 const *>(wav->data);
+        for (u32 index = 0; index < sample_count; ++index) {
+            samples[index] = source[index] * (1.0f / 32768.0f);
+        }
+
+        output->wav = wav;
+        output->samples = samples;
+        output->frame_count = frame_count;
+        result = true;
+
+        return result;
+    }
+
+    u32 right_channel_offset = format->number_of_channels > 1 ? bytes_per_sample : 0;
+    f64 step = static_cast<f64>(format->sample_rate) / static_cast<f64>(mixer->sample_rate);
+
+    for (u32 frame = 0; frame < frame_count; ++frame) {
+        f64 source_position = frame * step;
+        u32 frame0 = static_cast<u32>(source_position);
+        u32 frame1 = min(frame0 + 1, source_frame_count - 1);
+        f32 t = static_cast<f32>(source_position - frame0);
+
+        u8 const *bytes0 = wav->data + (static_cast<size_t>(frame0) * format->block_align);
+        u8 const *bytes1 = wav->data + (static_cast<size_t>(frame1) * format->block_align);
+
+        f32 left0  = decode_pcm_sample(bytes0, format->bits_per_sample, audio_format);
+        f32 left1  = decode_pcm_sample(bytes1, format->bits_per_sample, audio_format);
+        f32 right0 = decode_pcm_sample(bytes0 + right_channel_offset, format->bits_per_sample, audio_format);
+        f32 right1 = decode_pcm_sample(bytes1 + right_channel_offset, format->bits_per_sample, audio_format);
+
+        samples[2*frame + 0] = left0  + t * (left1  - left0);
+        samples[2*frame + 1] = right0 + t * (right1 - right0);
+    }
+
+    output->wav = wav;
+    output->samples = samples;
+    output->frame_count = frame_count;
+    result = true;
+
+    return result;
+}
+
+
+// Game thread. Decodes the wav the first time it is seen, call this at load time to avoid doing that on the
+// first play.
+static Mixer_Sound *get_mixer_sound(Mixer *mixer, Wav const *wav) {
+    Mixer_Sound *result = nullptr;
+
+    for (u32 index = 0; index < mixer->sound_count; ++index) {
+        if (mixer->sounds[index].wav == wav) {
+            result = &mixer->sounds[index];
+            break;
+        }
+    }
+
+    if (!result && mixer->sound_count < kMixer_Max_Sounds) {
+        Mixer_Sound *sound = &mixer->sounds[mixer->sound_count];
+        if (decode_wav(mixer, wav, sound)) {
+            ++mixer->sound_count;
+            result = sound;
+        }
+    }
+
+    return result;
+}
+
+
+
+
+//
+// Commands, posted by the game thread
+//
+
+static b32 post_mixer_command(Mixer *mixer, Mixer_Command command) {
+    b32 result = false;
+
+    u32 write = mixer->command_write.load(std::memory_order_relaxed);
+    u32 read  = mixer->command_read.load(std::memory_order_acquire);
+    if ((write - read) < kMixer_Command_Count) {
+        mixer->commands[write & (kMixer_Command_Count - 1)] = command;
+        mixer->command_write.store(write + 1, std::memory_order_release);
+        result = true;
+    }
+    else {
+        mixer->dropped_command_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    return result;
+}
+
+
+static b32 mixer_play(Mixer *mixer, Wav const *wav, f32 volume = 1.0f) {
+    b32 result = false;
+
+    Mixer_Sound *sound = get_mixer_sound(mixer, wav);
+    if (sound) {
+        Mixer_Command command;
+        command.type   = Mixer_Command_Play;
+        command.sound  = sound;
+        command.volume = volume;
+        result = post_mixer_command(mixer, command);
+    }
+
+    return result;
+}
+
+
+static b32 mixer_stop_all(Mixer *mixer) {
+    Mixer_Command command;
+    command.type = Mixer_Command_Stop_All;
+    b32 result = post_mixer_command(mixer, command);
+    return result;
+}
+
+
+
+
+//
+// Mixing, only called from the mixing thread
+//
+
+static void process_mixer_commands(Mixer *mixer) {
+    u32 read  = mixer->command_read.load(std::memory_order_relaxed);
+    u32 write = mixer->command_write.load(std::memory_order_acquire);
+
+    for (; read != write; ++read) {
+        Mixer_Command *command = &mixer->commands[read & (kMixer_Command_Count - 1)];
+
+        if (command->type == Mixer_Command_Play) {
+            Mixer_Voice *voice = nullptr;
+            if (mixer->voice_count < kMixer_Max_Voices) {
+                voice = &mixer->voices[mixer->voice_count++];
+            }
+            else {
+                // Replace the voice that has played the longest
+                voice = &mixer->voices[0];
+                for (u32 index = 1; index < mixer->voice_count; ++index) {
+                    if (mixer->voices[index].position > voice->position)  voice = &mixer->voices[index];
+                }
+            }
+
+            voice->sound    = command->sound;
+            voice->position = 0;
+            voice->volume   = command->volume;
+        }
+        else if (command->type == Mixer_Command_Stop_All) {
+            mixer->voice_count = 0;
+        }
+    }
+
+    mixer->command_read.store(read, std::memory_order_release);
+}
+
+
+// Fills output with frame_count frames of interleaved stereo, frame_count must be even. Finished voices are
+// removed.
+static void mix_audio(Mixer *mixer, f32 *output, u32 frame_count) {
+    PROFILE_FUNCTION();
+    assert((frame_count & 1) == 0);
+
+    process_mixer_commands(mixer);
+
+    u32 sample_count = frame_count * kMixer_Channel_Count;
+    __m128 const zero = _mm_setzero_ps();
+    for (u32 index = 0; index < sample_count; index += 4) {
+        _mm_storeu_ps(output + index, zero);
+    }
+
+    for (u32 voice_index = 0; voice_index < mixer->voice_count;) {
+        Mixer_Voice *voice = &mixer->voices[voice_index];
+        Mixer_Sound *sound = voice->sound;
+
+        u32 frames_left = sound->frame_count - voice->position;
+        u32 frames_to_mix = min(frames_left, frame_count);
+
+        // Two frames at a time, the samples are padded so reading past the end of an odd sound is fine
+        f32 const *src = sound->samples + (voice->position * kMixer_Channel_Count);
+        __m128 volume = _mm_set1_ps(voice->volume);
+        u32 samples_to_mix = ((frames_to_mix + 1) & ~1u) * kMixer_Channel_Count;
+        for (u32 index = 0; index < samples_to_mix; index += 4) {
+            __m128 sum = _mm_loadu_ps(output + index);
+            __m128 value = _mm_loadu_ps(src + index);
+            _mm_storeu_ps(output + index, _mm_add_ps(sum, _mm_mul_ps(value, volume)));
+        }
+
+        voice->position += frames_to_mix;
+        if (voice->position >= sound->frame_count) {
+            *voice = mixer->voices[--mixer->voice_count]; // The voice we moved here is mixed next
+        }
+        else {
+            ++voice_index;
+        }
+    }
+
+    // Master volume, and clip instead of wrapping around in the back-end
+    __m128 master_volume = _mm_set1_ps(mixer->master_volume);
+    __m128 const lower = _mm_set1_ps(-1.0f);
+    __m128 const upper = _mm_set1_ps( 1.0f);
+    for (u32 index = 0; index < sample_count; index += 4) {
+        __m128 value = _mm_mul_ps(_mm_loadu_ps(output + index), master_volume);
+        _mm_storeu_ps(output + index, _mm_min_ps(_mm_max_ps(value, lower), upper));
+    }
+}
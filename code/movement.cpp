@@ -154,6 +154,79 @@ static void debug_check_all_actors(Level *level) {
 }
 
 
+// What debug_check_all_actors() looks for, and what has to hold between the turns: every actor is settled,
+// the living ones stand on tiles of their own that know about them, and the counters in the level
+// state agree with the tiles and the actors. Returns what is broken, or nullptr. Slow, for fuzz_main.cpp.
+static char const *find_broken_level_invariant(Level *level) {
+    Level_State *state = level->current_state;
+    Array_Of_Actors *array = &state->actors;
+
+    u32 alive_count = 0;
+    u32 ghost_count = 0;
+    u32 pacman_count = 0;
+    Actor *pacman = nullptr;
+
+    for (u32 outer_index = 0; outer_index < array->count; ++outer_index) {
+        Actor *outer_actor = &array->data[outer_index];
+
+        if (outer_actor->state != Actor_State_Idle && outer_actor->state != Actor_State_Dead)  return "an actor is neither idle nor dead";
+        if (outer_actor->pending_state != outer_actor->state)                                   return "an actor has a pending state left";
+        if (!actor_is_alive(outer_actor))  continue;
+
+        Tile *tile = get_tile_at(level, outer_actor->position);
+        if (!tile)                                 return "an actor is outside of the level";
+        if (!(tile->actor_id == outer_actor->id))  return "an actor's tile doesn't know about it";
+
+        for (u32 inner_index = outer_index + 1; inner_index < array->count; ++inner_index) {
+            Actor *inner_actor = &array->data[inner_index];
+            if (actor_is_alive(inner_actor) && inner_actor->position == outer_actor->position)  return "two living actors share a tile";
+        }
+
+        ++alive_count;
+        if (actor_is_ghost(outer_actor)) {
+            ++ghost_count;
+        }
+        else if (outer_actor->type == Actor_Type_Pacman) {
+            ++pacman_count;
+            pacman = outer_actor;
+        }
+    }
+
+    if (alive_count != array->active)          return "the active count of the actors is off";
+    if (ghost_count != state->ghost_count)     return "the ghost count is off";
+    if (pacman_count != state->pacman_count)   return "the pacman count is off";
+
+    if (pacman) {
+        Actor_Mode pacman_mode = state->mode_duration > 0 ? Actor_Mode_Predator : Actor_Mode_Prey;
+        if (pacman->mode != pacman_mode)  return "pacman's mode doesn't follow the mode duration";
+
+        for (u32 index = 0; index < array->count; ++index) {
+            Actor *actor = &array->data[index];
+            if (actor_is_alive(actor) && actor_is_ghost(actor) && actor->mode == pacman_mode)  return "a ghost has the same mode as pacman";
+        }
+    }
+
+    u32 small_dot_count = 0;
+    u32 large_dot_count = 0;
+    for (u32 index = 0; index < state->tile_count; ++index) {
+        Tile *tile = &state->tiles[index];
+        if (tile->item.type == Item_Type_Dot_Small)  ++small_dot_count;
+        if (tile->item.type == Item_Type_Dot_Large)  ++large_dot_count;
+
+        if (tile->actor_id.index != 0xFFFF) {
+            Actor *actor = get_actor(array, tile->actor_id);
+            if (!actor_is_alive(actor))  return "a tile refers to an actor that isn't alive";
+            if ((actor->position.y * level->width) + actor->position.x != index)  return "a tile refers to an actor that isn't on it";
+        }
+    }
+
+    if (small_dot_count != state->small_dot_count)  return "the small dot count is off";
+    if (large_dot_count != state->large_dot_count)  return "the large dot count is off";
+
+    return nullptr;
+}
+
+
 //
 // NOTE: Slow, but we will not have that many moves per turn (famous last words), so we'll should be ok.
 Move_Set *get_move_set(Array_Of_Moves *array, v2u dst) {
@@ -237,7 +310,7 @@ v2s get_movement_vector(Actor *actor, Input input) {
 
 
 void collect_move(Array_Of_Moves *all_the_moves, Level *level, Actor *actor, v2s dP) {
-    if (move_is_possible(level, actor, dP)) {
+    if ((dP.x != 0 || dP.y != 0) && move_is_possible(level, actor, dP)) {
         v2u dst = V2u(static_cast<u32>(static_cast<s32>(actor->position.x) + dP.x),
                       static_cast<u32>(static_cast<s32>(actor->position.y) + dP.y));
         add_move(all_the_moves, actor, dst, level);
@@ -252,12 +325,13 @@ void collect_move(Array_Of_Moves *all_the_moves, Level *level, Actor *actor, v2s
 }
 
 
-v2s get_pacman_move(s32 **maps, Level *level, Actor *pacman) {
+// Where pacman goes, or nowhere (0, 0) when there is no floor next to him
+v2s get_pacman_move(Level *level, Actor *pacman) {
     Direction next_direction = Direction_Right;
     v2u Po = pacman->position;
 
-    Map_Direction closest_ghost = get_shortest_direction_on_map(level, maps[Map_Ghosts], pacman);
-    assert(closest_ghost.direction < Direction_Count);
+    Map_Direction closest_ghost = get_shortest_direction_on_map(level, Map_Ghosts, pacman);
+    if (closest_ghost.direction == Direction_Unknown)  return v2s(0, 0); // Walled in
     assert(closest_ghost.distance >= 0);
 
     Level_State *state = level->current_state;
@@ -267,11 +341,11 @@ v2s get_pacman_move(s32 **maps, Level *level, Actor *pacman) {
     }
     else {
         if (state->large_dot_count > 0) {
-            Map_Direction closest_large_dot = get_shortest_direction_on_map(level, maps[Map_Dot_Large], pacman);
+            Map_Direction closest_large_dot = get_shortest_direction_on_map(level, Map_Dot_Large, pacman);
             assert(closest_large_dot.direction < Direction_Count);
 
             if ((closest_ghost.distance - 1) <= closest_large_dot.distance) {
-                Map_Direction flee = get_shortest_direction_on_map(level, maps[Map_Flee_Ghosts], pacman);
+                Map_Direction flee = get_shortest_direction_on_map(level, Map_Flee_Ghosts, pacman);
                 next_direction = flee.direction;
             }
             else {
@@ -279,12 +353,12 @@ v2s get_pacman_move(s32 **maps, Level *level, Actor *pacman) {
             }
         }
         else if (state->small_dot_count > 0) {
-            Map_Direction closest_small_dot = get_shortest_direction_on_map(level, maps[Map_Dot_Small], pacman);
+            Map_Direction closest_small_dot = get_shortest_direction_on_map(level, Map_Dot_Small, pacman);
             assert(closest_small_dot.direction < Direction_Count);
             next_direction = closest_small_dot.direction;
         }
         else {
-            Map_Direction flee = get_shortest_direction_on_map(level, maps[Map_Flee_Ghosts], pacman);
+            Map_Direction flee = get_shortest_direction_on_map(level, Map_Flee_Ghosts, pacman);
             next_direction = flee.direction;
         }
     }
@@ -294,14 +368,31 @@ v2s get_pacman_move(s32 **maps, Level *level, Actor *pacman) {
 }
 
 
-void collect_all_moves(s32 **maps, Array_Of_Moves *all_the_moves, Input *input, Level *level) {
+// Pacman's moves from the current state, one per actor slot and (0, 0) for the others. He decides from the
+// state alone, the moves are all collected before any of them is made, so these are his moves whatever the
+// input is and a search can work them out once for the four inputs it tries from a state (see solver.cpp).
+void get_all_pacman_moves(Level *level, v2s *pacman_moves) {
+    Level_State *state = level->current_state;
+    for (u32 index = 0; index < state->actors.count; ++index) {
+        Actor *actor = &state->actors.data[index];
+        pacman_moves[index] = v2s(0, 0);
+        if (actor->state != Actor_State_Dead && actor->type == Actor_Type_Pacman) {
+            pacman_moves[index] = get_pacman_move(level, actor);
+        }
+    }
+}
+
+
+// pacman_moves, if there are any, are from get_all_pacman_moves() on the current state
+void collect_all_moves(Array_Of_Moves *all_the_moves, Input *input, Level *level, v2s const *pacman_moves = nullptr) {
+    PROFILE_FUNCTION();
     Level_State *state = level->current_state;
     for (u32 index = 0; index < state->actors.count; ++index) {
         Actor *actor = &state->actors.data[index];
         if (actor->state != Actor_State_Dead) {
             v2s dP;
             if (actor->type == Actor_Type_Pacman) {
-                dP = get_pacman_move(maps, level, actor);
+                dP = pacman_moves ? pacman_moves[index] : get_pacman_move(level, actor);
             }
             else {
                 dP = get_movement_vector(actor, *input);
@@ -312,6 +403,17 @@ void collect_all_moves(s32 **maps, Array_Of_Moves *all_the_moves, Input *input,
 }
 
 
+// Takes back everything that is pending; the moves, and the deaths they would have led to. Also for the
+// state that is kept for undo, which is saved in the middle of the turn.
+static void settle_actors(Level_State *state) {
+    for (u32 index = 0; index < state->actors.count; ++index) {
+        Actor *actor = &state->actors.data[index];
+        actor->pending_state = actor->state;
+        actor->next_position = actor->position;
+    }
+}
+
+
 void cancel_move_set(Level *level, Move_Set *set) {
     for (u32 move_index = 0; move_index < set->move_count; ++move_index) {
         Move *move = &set->moves[move_index];
@@ -327,10 +429,12 @@ void cancel_moves(Array_Of_Moves *all_the_moves, Level *level) {
         Move_Set *set = &all_the_moves->data[move_set_index];
         cancel_move_set(level, set);
     }
+    settle_actors(level->current_state); // An actor that stands still might have been about to be eaten
 };
 
 
 u32 resolve_all_moves(Array_Of_Moves *all_the_moves, Level *level) {
+    PROFILE_FUNCTION();
     u32 valid_moves = 0;
 
     //
@@ -351,7 +455,6 @@ u32 resolve_all_moves(Array_Of_Moves *all_the_moves, Level *level) {
             if ((set->predator_count == 0 || set->predator_count > 1) && set->move_count > 1) {
                 cancel_move_set(level, set);
                 ++resolved_collisions;
-                printf("cancelled move set!\n");
             }
             else {
                 for (u32 move_index = 0; move_index < set->move_count; ++move_index) {
@@ -429,8 +532,8 @@ u32 resolve_all_moves(Array_Of_Moves *all_the_moves, Level *level) {
             else if (set->predator_count == 1 && set->move_count > 1) {
                 if (src_actor->mode == Actor_Mode_Prey) {
                     src_actor->pending_state = Actor_State_At_Deaths_Door;
-                    ++valid_moves;
                 }
+                ++valid_moves; // The predator too, even if it is the only one moving
             }
             else {
                 ++valid_moves;
@@ -469,6 +572,7 @@ Direction get_direction_from_move(v2u from, v2u to) {
 
 
 void accept_moves(Array_Of_Moves *all_the_moves, Audio *audio, Wavs *wavs, Level *level) {
+    PROFILE_FUNCTION();
     Level_State *state = level->current_state;
 
     for (u32 move_set_index = 0; move_set_index < all_the_moves->count; ++move_set_index) {
@@ -534,3 +638,119 @@ void accept_moves(Array_Of_Moves *all_the_moves, Audio *audio, Wavs *wavs, Level
         }
     }
 }
+
+
+
+
+//
+// #_Turn
+//
+
+enum Turn_Result {
+    Turn_Result_None,           // Nothing happened, no input or the input wasn't a direction
+    Turn_Result_Moved,
+    Turn_Result_No_Valid_Moves,
+    Turn_Result_Won,
+    Turn_Result_Lost,
+};
+
+
+// The rest of a turn, once the moves are resolved and at least one of them is valid
+static void finish_turn(Level *level, Array_Of_Moves *all_the_moves, Audio *audio, Wavs *wavs) {
+    Level_State *level_state = level->current_state;
+
+    debug_check_all_actors(level);
+    accept_moves(all_the_moves, audio, wavs, level);
+    debug_check_all_actors(level);
+
+    // Update mode counter
+    if (level_state->mode_duration > 0) {
+        --level_state->mode_duration;
+        if (level_state->mode_duration == 0) {
+            change_pacman_mode(level, Actor_Mode_Prey);
+        }
+    }
+
+    // Update "dijkstra-maps"
+    create_maps_off_level(level);
+}
+
+
+// Checks the win-/loose-conditions and, if the level is still in play and the input is a direction, moves
+// all the actors one step. It does not draw anything, so it is used both by update_and_render() and when
+// re-simulating a level without a window (see replay.cpp). audio may be nullptr.
+Turn_Result play_turn(Level *level, Array_Of_Moves *all_the_moves, Input input, Audio *audio, Wavs *wavs) {
+    Turn_Result result = Turn_Result_None;
+    Level_State *level_state = level->current_state;
+
+    if (level_state->pacman_count == 0) {
+        result = Turn_Result_Won;
+    }
+    else if (level_state->ghost_count == 0) {
+        result = Turn_Result_Lost;
+    }
+    else if (input < Input_Select) {
+        #ifdef DEBUG
+        debug_check_all_actors(level);
+        #endif
+
+        collect_all_moves(all_the_moves, &input, level);
+        u32 valid_moves = resolve_all_moves(all_the_moves, level);
+
+        #ifdef DEBUG
+        debug_check_all_move_sets(all_the_moves);
+        debug_check_all_actors(level);
+        #endif
+
+        if (valid_moves == 0) {
+            cancel_moves(all_the_moves, level);
+            result = Turn_Result_No_Valid_Moves;
+        }
+        else {
+            // We're moving and thus we need to save the state and recalulate the "dijkstra maps".
+            Level_State *prev_state = level->current_state;
+            save_current_level_state(level);
+            settle_actors(prev_state);
+            finish_turn(level, all_the_moves, audio, wavs);
+            result = Turn_Result_Moved;
+        }
+
+        clear_array_of_moves(all_the_moves);
+    }
+
+    return result;
+}
+
+
+// Like play_turn(), but the current level state is changed in place instead of saved for undo, and nothing
+// is played. For searching through the states of a level (see solver.cpp), which keeps them itself.
+// pacman_moves are as for collect_all_moves().
+Turn_Result simulate_turn(Level *level, Array_Of_Moves *all_the_moves, Input input, v2s const *pacman_moves = nullptr) {
+    Turn_Result result = Turn_Result_None;
+    Level_State *level_state = level->current_state;
+
+    if (level_state->pacman_count == 0) {
+        result = Turn_Result_Won;
+    }
+    else if (level_state->ghost_count == 0) {
+        result = Turn_Result_Lost;
+    }
+    else if (input < Input_Select) {
+        collect_all_moves(all_the_moves, &input, level, pacman_moves);
+        u32 valid_moves = resolve_all_moves(all_the_moves, level);
+
+        if (valid_moves == 0) {
+            cancel_moves(all_the_moves, level);
+            result = Turn_Result_No_Valid_Moves;
+        }
+        else {
+            static Wavs no_wavs; // Never played, there is no audio
+            finish_turn(level, all_the_moves, nullptr, &no_wavs);
+            result = Turn_Result_Moved;
+        }
+
+        clear_array_of_moves(all_the_moves);
+    }
+
+    return result;
+}
@@ -0,0 +1,376 @@
+//
+// Resource archive
+//
+// All the resources packed into one file, data\resources.pak, so that loading them is one open and one
+// mapping instead of a read, a malloc and a copy per file. The data of every entry is already in the
+// layout the game uses (the pixels of a Bmp, the samples of a canonical Wav, the Char_Data of a Font), and
+// aligned to kPak_Alignment bytes, so the resources just point into the mapping.
+//
+// Layout:
+//     Pak_Header
+//     data, kPak_Alignment aligned per entry
+//     Pak_Entry * entry_count, at toc_offset
+//
+// The atlas is stored as it is built at load time (see atlas.cpp), with its table of Sprites.
+//
+// The archive is written by `headless -pack_resources` (see pack_resources() in resources.cpp) from the
+// loose files in data, which is also what the game loads when there is no archive. Every entry has the hash
+// and size of the loose files it was made from, and when those are there and have changed since, the game
+// loads them instead of the archive.
+//
+
+#define kPak_Version          3
+#define kPak_Alignment        64
+#define kPak_Max_Entries      64
+#define kPak_Name_Max_Length  48
+
+u32 constexpr kPak_FourCC = 'KAPP'; // "PPAK"
+
+
+enum Pak_Entry_Type : u32 {
+    Pak_Entry_Type_Bitmap = 0,
+    Pak_Entry_Type_Wav,
+    Pak_Entry_Type_Font,    // The data is the Char_Data, the font's bitmap is its own entry
+    Pak_Entry_Type_Sprites, // The data is the Sprites of an atlas (see atlas.cpp), the atlas is its own entry
+
+    Pak_Entry_Type_Count,
+};
+
+
+#pragma pack(push, 1)
+struct Pak_Header {
+    u32 fourcc;
+    u32 version;
+    u32 entry_count;
+    u32 toc_offset;
+};
+
+
+struct Pak_Entry {
+    char name[kPak_Name_Max_Length];
+    u32 type;
+    u32 offset; // From the start of the file
+    u32 size;
+    u64 source_hash; // Of the loose files the entry was made from, see hash_resource_files() in resources.cpp
+    u32 source_size;
+
+    // Bitmaps
+    Bitmap_info_header bitmap_header;
+    u32 row_size;
+
+    // Wavs
+    u16 audio_format;
+    u16 number_of_channels;
+    u32 sample_rate;
+    u32 average_bytes_per_second;
+    u16 block_align;
+    u16 bits_per_sample;
+
+    // Fonts
+    u32 char_count;
+    u32 line_height;
+    u32 spacing_x;
+    u32 spacing_y;
+    u32 base;
+};
+#pragma pack(pop)
+
+
+struct Pak {
+    u8 *data = nullptr;
+    u32 size = 0;
+    HANDLE mapping = nullptr;
+    Pak_Entry const *entries = nullptr;
+    u32 entry_count = 0;
+};
+
+
+struct Pak_Writer {
+    Pak_Entry entries[kPak_Max_Entries];
+    void const *data[kPak_Max_Entries];
+    u32 entry_count = 0;
+    u32 size = sizeof(Pak_Header); // Where the next entry's data goes
+    u64 source_hash = 0;           // Given to the entries that are added, see set_pak_sources()
+    u32 source_size = 0;
+    b32 error = false;
+};
+
+
+
+
+//
+// Reading
+//
+
+static void close_pak(Pak *pak) {
+    win32_unmap_file(pak->data, pak->size, pak->mapping);
+    *pak = {};
+}
+
+
+// Returns false, without printing anything, if there is no archive at path_and_name
+static b32 open_pak(Pak *pak, char const *path_and_name) {
+    b32 result = false;
+
+    *pak = {};
+    if (!win32_map_file(path_and_name, &pak->data, &pak->size, &pak->mapping)) {
+        return result;
+    }
+
+    Pak_Header const *header = reinterpret_cast<Pak_Header const *>(pak->data);
+    b32 is_valid = pak->size >= sizeof(Pak_Header) && header->fourcc == kPak_FourCC && header->version == kPak_Version &&
+                   header->entry_count <= kPak_Max_Entries && (header->toc_offset % kPak_Alignment) == 0 &&
+                   header->toc_offset <= pak->size &&
+                   (pak->size - header->toc_offset) >= header->entry_count * sizeof(Pak_Entry);
+
+    if (is_valid) {
+        pak->entries = reinterpret_cast<Pak_Entry const *>(pak->data + header->toc_offset);
+        pak->entry_count = header->entry_count;
+
+        for (u32 index = 0; index < pak->entry_count && is_valid; ++index) {
+            Pak_Entry const *entry = &pak->entries[index];
+            is_valid = entry->type < Pak_Entry_Type_Count && (entry->offset % kPak_Alignment) == 0 &&
+                       entry->offset <= pak->size && entry->size <= (pak->size - entry->offset) &&
+                       entry->name[kPak_Name_Max_Length - 1] == '\0';
+        }
+    }
+
+    if (is_valid) {
+        result = true;
+    }
+    else {
+        printf("%s() %s is not a valid archive, or from another version\n", __FUNCTION__, path_and_name);
+        close_pak(pak);
+    }
+
+    return result;
+}
+
+
+static Pak_Entry const *find_pak_entry(Pak *pak, char const *name, Pak_Entry_Type type) {
+    Pak_Entry const *result = nullptr;
+
+    for (u32 index = 0; index < pak->entry_count; ++index) {
+        Pak_Entry const *entry = &pak->entries[index];
+        if (entry->type == type && strcmp(entry->name, name) == 0) {
+            result = entry;
+            break;
+        }
+    }
+
+    if (!result) {
+        printf("%s() there is no %s in the archive\n", __FUNCTION__, name);
+    }
+
+    return result;
+}
+
+
+static b32 load_bitmap_from_pak(Pak *pak, char const *name, Bmp *output) {
+    b32 result = false;
+
+    Pak_Entry const *entry = find_pak_entry(pak, name, Pak_Entry_Type_Bitmap);
+    if (entry && entry->size == entry->row_size * static_cast<u32>(entry->bitmap_header.height)) {
+        free_bitmap(output);
+        output->header    = entry->bitmap_header;
+        output->row_size  = entry->row_size;
+        output->data_size = entry->size;
+        output->data      = pak->data + entry->offset;
+        output->is_mapped = true;
+        result = true;
+    }
+
+    return result;
+}
+
+
+static b32 load_wav_from_pak(Pak *pak, char const *name, Wav *output) {
+    b32 result = false;
+
+    Pak_Entry const *entry = find_pak_entry(pak, name, Pak_Entry_Type_Wav);
+    if (entry && entry->block_align > 0) {
+        free_wav(output);
+        output->type = Wav_Type_Wave;
+        output->format.audio_format             = entry->audio_format;
+        output->format.number_of_channels       = entry->number_of_channels;
+        output->format.sample_rate              = entry->sample_rate;
+        output->format.average_bytes_per_second = entry->average_bytes_per_second;
+        output->format.block_align              = entry->block_align;
+        output->format.bits_per_sample          = entry->bits_per_sample;
+        output->data      = pak->data + entry->offset;
+        output->data_size = entry->size;
+        output->is_mapped = true;
+        result = true;
+    }
+
+    return result;
+}
+
+
+static b32 load_font_from_pak(Pak *pak, char const *name, Font *output) {
+    b32 result = false;
+
+    char bitmap_name[kPak_Name_Max_Length];
+    _snprintf_s(bitmap_name, sizeof(bitmap_name), _TRUNCATE, "%s.bitmap", name);
+
+    Pak_Entry const *entry = find_pak_entry(pak, name, Pak_Entry_Type_Font);
+    if (entry && entry->char_count > 0 && entry->size == entry->char_count * sizeof(Char_Data)) {
+        free_font(output);
+        if (load_bitmap_from_pak(pak, bitmap_name, &output->bitmap)) {
+            output->char_data     = reinterpret_cast<Char_Data *>(pak->data + entry->offset);
+            output->char_count    = entry->char_count;
+            output->line_height   = entry->line_height;
+            output->spacing_x     = entry->spacing_x;
+            output->spacing_y     = entry->spacing_y;
+            output->base          = entry->base;
+            output->bitmap_width  = output->bitmap.header.width;
+            output->bitmap_height = output->bitmap.header.height;
+            output->is_mapped = true;
+            result = true;
+        }
+    }
+
+    return result;
+}
+
+
+// sprites gets sprite_count Sprites, copied since they are tiny
+static b32 load_sprites_from_pak(Pak *pak, char const *name, Sprite *sprites, u32 sprite_count) {
+    b32 result = false;
+
+    Pak_Entry const *entry = find_pak_entry(pak, name, Pak_Entry_Type_Sprites);
+    if (entry && entry->size == sprite_count * sizeof(Sprite)) {
+        memcpy(sprites, pak->data + entry->offset, entry->size);
+        result = true;
+    }
+
+    return result;
+}
+
+
+
+//
+// Writing
+//
+
+static Pak_Entry *add_pak_entry(Pak_Writer *writer, char const *name, Pak_Entry_Type type, void const *data, u32 size) {
+    Pak_Entry *result = nullptr;
+
+    if (writer->entry_count >= kPak_Max_Entries || strlen(name) >= kPak_Name_Max_Length) {
+        printf("%s() can't add %s, too many entries or too long a name\n", __FUNCTION__, name);
+        writer->error = true;
+        return result;
+    }
+
+    writer->size = (writer->size + kPak_Alignment - 1) & ~(kPak_Alignment - 1);
+
+    result = &writer->entries[writer->entry_count];
+    memset(result, 0, sizeof(Pak_Entry));
+    _snprintf_s(result->name, sizeof(result->name), _TRUNCATE, "%s", name);
+    result->type   = type;
+    result->offset = writer->size;
+    result->size   = size;
+    result->source_hash = writer->source_hash;
+    result->source_size = writer->source_size;
+
+    writer->data[writer->entry_count++] = data;
+    writer->size += size;
+
+    return result;
+}
+
+
+// The loose files the entries that are added after this are made from
+static void set_pak_sources(Pak_Writer *writer, u64 source_hash, u32 source_size) {
+    writer->source_hash = source_hash;
+    writer->source_size = source_size;
+}
+
+
+static void add_bitmap_to_pak(Pak_Writer *writer, char const *name, Bmp const *bitmap) {
+    Pak_Entry *entry = add_pak_entry(writer, name, Pak_Entry_Type_Bitmap, bitmap->data, static_cast<u32>(bitmap->data_size));
+    if (entry) {
+        entry->bitmap_header = bitmap->header;
+        entry->row_size = static_cast<u32>(bitmap->row_size);
+    }
+}
+
+
+static void add_wav_to_pak(Pak_Writer *writer, char const *name, Wav const *wav) {
+    Pak_Entry *entry = add_pak_entry(writer, name, Pak_Entry_Type_Wav, wav->data, static_cast<u32>(wav->data_size));
+    if (entry) {
+        entry->audio_format             = wav->format.audio_format;
+        entry->number_of_channels       = wav->format.number_of_channels;
+        entry->sample_rate              = wav->format.sample_rate;
+        entry->average_bytes_per_second = wav->format.average_bytes_per_second;
+        entry->block_align              = wav->format.block_align;
+        entry->bits_per_sample          = wav->format.bits_per_sample;
+    }
+}
+
+
+static void add_font_to_pak(Pak_Writer *writer, char const *name, Font const *font) {
+    char bitmap_name[kPak_Name_Max_Length];
+    _snprintf_s(bitmap_name, sizeof(bitmap_name), _TRUNCATE, "%s.bitmap", name);
+    add_bitmap_to_pak(writer, bitmap_name, &font->bitmap);
+
+    Pak_Entry *entry = add_pak_entry(writer, name, Pak_Entry_Type_Font, font->char_data, font->char_count * sizeof(Char_Data));
+    if (entry) {
+        entry->char_count  = font->char_count;
+        entry->line_height = font->line_height;
+        entry->spacing_x   = font->spacing_x;
+        entry->spacing_y   = font->spacing_y;
+        entry->base        = font->base;
+    }
+}
+
+
+static void add_sprites_to_pak(Pak_Writer *writer, char const *name, Sprite const *sprites, u32 sprite_count) {
+    add_pak_entry(writer, name, Pak_Entry_Type_Sprites, sprites, sprite_count * sizeof(Sprite));
+}
+
+
+// Writes the archive. The data that was added must still be around.
+static b32 write_pak(Pak_Writer *writer, char const *path_and_name) {
+    b32 result = false;
+    if (writer->error)  return result;
+
+    Pak_Header header;
+    header.fourcc      = kPak_FourCC;
+    header.version     = kPak_Version;
+    header.entry_count = writer->entry_count;
+    header.toc_offset  = (writer->size + kPak_Alignment - 1) & ~(kPak_Alignment - 1);
+
+    HANDLE file_handle;
+    if (win32_open_file_for_writing(path_and_name, &file_handle)) {
+        u8 padding[kPak_Alignment] = {};
+        u32 position = 0;
+        DWORD bytes_written = 0;
+
+        result = WriteFile(file_handle, &header, sizeof(header), &bytes_written, nullptr) && bytes_written == sizeof(header);
+        position += sizeof(header);
+
+        for (u32 index = 0; index < writer->entry_count && result; ++index) {
+            Pak_Entry const *entry = &writer->entries[index];
+            u32 padding_size = entry->offset - position;
+            result = WriteFile(file_handle, padding, padding_size, &bytes_written, nullptr) && bytes_written == padding_size;
+            result = result && WriteFile(file_handle, writer->data[index], entry->size, &bytes_written, nullptr) && bytes_written == entry->size;
+            position = entry->offset + entry->size;
+        }
+
+        if (result) {
+            u32 padding_size = header.toc_offset - position;
+            u32 toc_size = writer->entry_count * sizeof(Pak_Entry);
+            result = WriteFile(file_handle, padding, padding_size, &bytes_written, nullptr) && bytes_written == padding_size;
+            result = result && WriteFile(file_handle, writer->entries, toc_size, &bytes_written, nullptr) && bytes_written == toc_size;
+        }
+
+        if (!result) {
+            printf("%s() failed to write %s\n", __FUNCTION__, path_and_name);
+        }
+
+        CloseHandle(file_handle);
+    }
+
+    return result;
+}
@@ -0,0 +1,396 @@
+//
+// POSIX stand-ins for the parts of win32 and the MSVC CRT that the game code uses
+//
+// Only included by the entry points that are built on Linux (bench_main.cpp and friends), the game itself is
+// still built with build.bat. Include common.h before this file. Paths are written the windows way in the
+// game code ("data\\levels\\1.level_txt"), so every function here that takes a path converts it first.
+//
+
+#include <stdarg.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/syscall.h>
+#include <type_traits>
+
+#define __FILENAME__ (strrchr(__FILE__, '/') ? strrchr(__FILE__, '/') + 1 : __FILE__)
+
+#define MAX_PATH 260
+#define _TRUNCATE (static_cast<size_t>(-1))
+
+typedef int      errno_t;
+typedef int      BOOL;
+typedef u32      DWORD;
+typedef s32      LONG;
+typedef void    *HANDLE;
+
+#define INVALID_HANDLE_VALUE (reinterpret_cast<HANDLE>(static_cast<intptr_t>(-1)))
+
+union LARGE_INTEGER {
+    s64 QuadPart;
+};
+
+
+// windows.h defines these as macros, templates won't break the standard headers
+template <typename A, typename B>
+inline typename std::common_type<A, B>::type min(A a, B b) { return a < b ? a : b; }
+
+template <typename A, typename B>
+inline typename std::common_type<A, B>::type max(A a, B b) { return a > b ? a : b; }
+
+
+
+
+//
+// Paths
+//
+
+// Converts the path separators to '/'
+static void posix_path(char const *path, char *output, size_t output_size) {
+    size_t index = 0;
+    for (; path[index] && index < (output_size - 1); ++index) {
+        output[index] = path[index] == '\\' ? '/' : path[index];
+    }
+    output[index] = '\0';
+}
+
+
+
+
+//
+// MSVC CRT
+//
+
+static int _vsnprintf_s(char *buffer, size_t buffer_size, size_t count, char const *format, va_list args) {
+    size_t size = count < buffer_size ? count + 1 : buffer_size;
+    int result = vsnprintf(buffer, size, format, args);
+
+    // Like MSVC: -1 if the output was truncated
+    if (result < 0 || static_cast<size_t>(result) >= size) {
+        result = -1;
+    }
+
+    return result;
+}
+
+
+static int _snprintf_s(char *buffer, size_t buffer_size, size_t count, char const *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = _vsnprintf_s(buffer, buffer_size, count, format, args);
+    va_end(args);
+    return result;
+}
+
+
+template <size_t Size>
+static int _snprintf_s(char (&buffer)[Size], size_t count, char const *format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = _vsnprintf_s(buffer, Size, count, format, args);
+    va_end(args);
+    return result;
+}
+
+
+#define sscanf_s sscanf
+
+
+static errno_t fopen_s(FILE **file, char const *path_and_name, char const *mode) {
+    char path[MAX_PATH];
+    posix_path(path_and_name, path, MAX_PATH);
+
+    *file = fopen(path, mode);
+    errno_t result = *file ? 0 : errno;
+    return result;
+}
+
+
+static size_t fread_s(void *buffer, size_t buffer_size, size_t element_size, size_t count, FILE *file) {
+    size_t result = 0;
+
+    if (element_size > 0 && (element_size * count) <= buffer_size) {
+        result = fread(buffer, element_size, count, file);
+    }
+
+    return result;
+}
+
+
+static errno_t memcpy_s(void *dst, size_t dst_size, void const *src, size_t count) {
+    errno_t result = 0;
+
+    if (count > dst_size || (count > 0 && (!dst || !src))) {
+        if (dst && dst_size > 0)  memset(dst, 0, dst_size);
+        result = EINVAL;
+    }
+    else if (count > 0) {
+        memcpy(dst, src, count);
+    }
+
+    return result;
+}
+
+
+static errno_t localtime_s(tm *result, time_t const *timer) {
+    errno_t error = localtime_r(timer, result) ? 0 : errno;
+    return error;
+}
+
+
+#define ZeroMemory(ptr, size) memset((ptr), 0, (size))
+
+
+
+
+//
+// win32
+//
+
+static DWORD GetLastError() {
+    return static_cast<DWORD>(errno);
+}
+
+
+static DWORD GetCurrentThreadId() {
+    return static_cast<DWORD>(syscall(SYS_gettid));
+}
+
+
+static LONG InterlockedIncrement(LONG volatile *value) {
+    return __atomic_add_fetch(value, 1, __ATOMIC_SEQ_CST);
+}
+
+
+static LONG InterlockedDecrement(LONG volatile *value) {
+    return __atomic_sub_fetch(value, 1, __ATOMIC_SEQ_CST);
+}
+
+
+static BOOL QueryPerformanceFrequency(LARGE_INTEGER *frequency) {
+    frequency->QuadPart = 1000000000;
+    return true;
+}
+
+
+static BOOL QueryPerformanceCounter(LARGE_INTEGER *counter) {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    counter->QuadPart = static_cast<s64>(now.tv_sec) * 1000000000 + now.tv_nsec;
+    return true;
+}
+
+
+// HANDLEs to files are FILE *
+static BOOL WriteFile(HANDLE file, void const *buffer, DWORD bytes_to_write, DWORD *bytes_written, void *overlapped) {
+    size_t written = fwrite(buffer, 1, bytes_to_write, static_cast<FILE *>(file));
+    if (bytes_written)  *bytes_written = static_cast<DWORD>(written);
+    return written == bytes_to_write;
+}
+
+
+static BOOL CloseHandle(HANDLE file) {
+    BOOL result = false;
+
+    if (file && file != INVALID_HANDLE_VALUE) {
+        result = fclose(static_cast<FILE *>(file)) == 0;
+    }
+
+    return result;
+}
+
+
+static BOOL CreateDirectoryA(char const *path_and_name, void *security_attributes) {
+    char path[MAX_PATH];
+    posix_path(path_and_name, path, MAX_PATH);
+    return mkdir(path, 0755) == 0;
+}
+
+
+//
+// Finding files, only the file name of WIN32_FIND_DATAA is filled in
+struct WIN32_FIND_DATAA {
+    char cFileName[MAX_PATH];
+};
+
+
+struct Posix_Find {
+    DIR *directory;
+    char pattern[MAX_PATH];
+};
+
+
+static BOOL FindNextFileA(HANDLE find_handle, WIN32_FIND_DATAA *find_data) {
+    BOOL result = false;
+
+    if (find_handle && find_handle != INVALID_HANDLE_VALUE) {
+        Posix_Find *find = static_cast<Posix_Find *>(find_handle);
+        for (dirent *entry = readdir(find->directory); entry; entry = readdir(find->directory)) {
+            if (fnmatch(find->pattern, entry->d_name, 0) == 0) {
+                _snprintf_s(find_data->cFileName, MAX_PATH, _TRUNCATE, "%s", entry->d_name);
+                result = true;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+
+static BOOL FindClose(HANDLE find_handle) {
+    BOOL result = false;
+
+    if (find_handle && find_handle != INVALID_HANDLE_VALUE) {
+        Posix_Find *find = static_cast<Posix_Find *>(find_handle);
+        closedir(find->directory);
+        free(find);
+        result = true;
+    }
+
+    return result;
+}
+
+
+static HANDLE FindFirstFileA(char const *path_and_pattern, WIN32_FIND_DATAA *find_data) {
+    HANDLE result = INVALID_HANDLE_VALUE;
+
+    char path[MAX_PATH];
+    posix_path(path_and_pattern, path, MAX_PATH);
+
+    char *separator = strrchr(path, '/');
+    char const *directory_name = ".";
+    char const *pattern = path;
+    if (separator) {
+        *separator = '\0';
+        directory_name = path;
+        pattern = separator + 1;
+    }
+
+    DIR *directory = opendir(directory_name);
+    if (directory) {
+        Posix_Find *find = static_cast<Posix_Find *>(calloc(1, sizeof(Posix_Find)));
+        find->directory = directory;
+        _snprintf_s(find->pattern, MAX_PATH, _TRUNCATE, "%s", pattern);
+
+        if (FindNextFileA(find, find_data)) {
+            result = find;
+        }
+        else {
+            FindClose(find);
+        }
+    }
+
+    return result;
+}
+
+
+
+
+//
+// Utilities, the win32_* functions from win32_main.cpp
+//
+
+b32 win32_read_entire_file(char const *path_and_name, u8 **data, u32 *size) {
+    b32 result = false;
+
+    FILE *file = nullptr;
+    errno_t error = fopen_s(&file, path_and_name, "rb");
+    if (error != 0) {
+        printf("%s() failed to open file %s, error = %d\n", __FUNCTION__, path_and_name, error);
+    }
+    else {
+        fseek(file, 0, SEEK_END);
+        *size = static_cast<u32>(ftell(file));
+        fseek(file, 0, SEEK_SET);
+
+        *data = static_cast<u8 *>(malloc(*size));
+        size_t bytes_read = fread(*data, 1, *size, file);
+        result = bytes_read == *size;
+        if (!result) {
+            printf("%s() failed to read %u bytes from file %s, error = %d\n", __FUNCTION__, *size, path_and_name, errno);
+        }
+
+        fclose(file);
+    }
+
+    return result;
+}
+
+
+b32 win32_open_file_for_writing(char const *path_and_name, HANDLE *handle) {
+    b32 result = true;
+
+    FILE *file = nullptr;
+    errno_t error = fopen_s(&file, path_and_name, "wb");
+    if (error != 0) {
+        printf("%s() failed to create file %s, error = %d\n", __FUNCTION__, path_and_name, error);
+        result = false;
+        *handle = nullptr;
+    }
+    else {
+        *handle = file;
+    }
+
+    return result;
+}
+
+
+HANDLE win32_open_file_for_reading(char const *path_and_name) {
+    HANDLE result = INVALID_HANDLE_VALUE;
+
+    FILE *file = nullptr;
+    errno_t error = fopen_s(&file, path_and_name, "rb");
+    if (error != 0) {
+        printf("%s() failed to open file %s, error = %d\n", __FUNCTION__, path_and_name, error);
+    }
+    else {
+        result = file;
+    }
+
+    return result;
+}
+
+
+// mmap has no mapping handle, mapping is always nullptr
+b32 win32_map_file(char const *path_and_name, u8 **data, u32 *size, HANDLE *mapping) {
+    b32 result = false;
+    *data = nullptr;
+    *size = 0;
+    *mapping = nullptr;
+
+    char path[MAX_PATH];
+    posix_path(path_and_name, path, MAX_PATH);
+
+    int file = open(path, O_RDONLY);
+    if (file < 0) {
+        return result; // Not an error, the caller decides what a missing file means
+    }
+
+    struct stat file_stat;
+    if (fstat(file, &file_stat) == 0 && file_stat.st_size > 0 && file_stat.st_size <= 0xFFFFFFFF) {
+        void *view = mmap(nullptr, static_cast<size_t>(file_stat.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (view != MAP_FAILED) {
+            *data = static_cast<u8 *>(view);
+            *size = static_cast<u32>(file_stat.st_size);
+            result = true;
+        }
+        else {
+            printf("%s() failed to map file %s, error = %d\n", __FUNCTION__, path_and_name, errno);
+        }
+    }
+
+    close(file);
+
+    return result;
+}
+
+
+void win32_unmap_file(u8 *data, u32 size, HANDLE mapping) {
+    if (data)  munmap(data, size);
+}
@@ -0,0 +1,222 @@
+//
+// CPU profiler
+//
+// Scoped timing markers that record into a per-thread ring buffer and can be dumped as a Chrome trace
+// (open chrome://tracing, or https://ui.perfetto.dev, and load the file).
+//
+// Usage:
+//     PROFILE_FUNCTION();          // Times the rest of the enclosing function
+//     PROFILE_SCOPE("Message pump"); // Times the rest of the enclosing scope, the name must be a string literal
+//
+// Compiled away entirely unless kProfiler is defined. When compiled in, nothing is recorded until
+// recording is turned on (F9) and the only cost of a marker is a check of a global flag.
+// F10 writes everything currently in the ring buffers to profile_<date>_<time>.json.
+//
+
+#define kProfiler_Events_Per_Thread (1 << 16) // Must be a power of two
+#define kProfiler_Max_Thread_Count  16
+
+
+
+
+//
+// Declarations
+//
+
+struct Profiler_Event {
+    char const *name = nullptr;
+    s64 begin = 0; // Performance counter ticks
+    s64 end   = 0;
+};
+
+
+struct Profiler_Thread_Buffer {
+    Profiler_Event events[kProfiler_Events_Per_Thread];
+    u64 write_count = 0; // Total number of events written, the ring buffer index is write_count & (size - 1)
+    u32 thread_id   = 0;
+};
+
+
+struct Profiler {
+    Profiler_Thread_Buffer *thread_buffers[kProfiler_Max_Thread_Count] = {};
+    volatile LONG thread_count = 0;
+    volatile b32 is_recording  = false;
+    s64 ticks_per_second = 1;
+    s64 start_ticks      = 0;
+};
+
+
+#ifdef kProfiler
+
+static Profiler g_profiler;
+static thread_local Profiler_Thread_Buffer *t_profiler_buffer = nullptr;
+
+static void init_profiler();
+static void fini_profiler();
+static void toggle_profiler_recording(Log *log);
+static b32  write_profile_to_disc(Log *log);
+
+
+struct Profiler_Scope {
+    char const *name;
+    s64 begin;
+
+    Profiler_Scope(char const *scope_name);
+    ~Profiler_Scope();
+};
+
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b)  PROFILER_CONCAT_(a, b)
+#define PROFILE_SCOPE(name)    Profiler_Scope PROFILER_CONCAT(profiler_scope_, __LINE__)(name)
+#define PROFILE_FUNCTION()     PROFILE_SCOPE(__FUNCTION__)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+
+#endif
+
+
+
+
+//
+// Implementation
+//
+
+#ifdef kProfiler
+
+static inline s64 profiler_ticks() {
+    LARGE_INTEGER ticks;
+    QueryPerformanceCounter(&ticks);
+    return ticks.QuadPart;
+}
+
+
+static void init_profiler() {
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    g_profiler.ticks_per_second = frequency.QuadPart;
+    g_profiler.start_ticks = profiler_ticks();
+}
+
+
+static void fini_profiler() {
+    g_profiler.is_recording = false;
+
+    for (u32 index = 0; index < kProfiler_Max_Thread_Count; ++index) {
+        if (g_profiler.thread_buffers[index]) {
+            free(g_profiler.thread_buffers[index]);
+            g_profiler.thread_buffers[index] = nullptr;
+        }
+    }
+    g_profiler.thread_count = 0;
+}
+
+
+// The first time a thread records an event it gets a buffer of its own, so recording never has to lock.
+// Buffers are never handed back until fini_profiler().
+static Profiler_Thread_Buffer *get_profiler_thread_buffer() {
+    if (!t_profiler_buffer) {
+        LONG slot = InterlockedIncrement(&g_profiler.thread_count) - 1;
+        if (slot < kProfiler_Max_Thread_Count) {
+            Profiler_Thread_Buffer *buffer = static_cast<Profiler_Thread_Buffer *>(calloc(1, sizeof(Profiler_Thread_Buffer)));
+            if (buffer) {
+                buffer->thread_id = GetCurrentThreadId();
+                g_profiler.thread_buffers[slot] = buffer;
+                t_profiler_buffer = buffer;
+            }
+        }
+        else {
+            InterlockedDecrement(&g_profiler.thread_count);
+        }
+    }
+
+    return t_profiler_buffer;
+}
+
+
+Profiler_Scope::Profiler_Scope(char const *scope_name) {
+    name  = scope_name;
+    begin = g_profiler.is_recording ? profiler_ticks() : 0;
+}
+
+
+Profiler_Scope::~Profiler_Scope() {
+    if (begin && g_profiler.is_recording) {
+        Profiler_Thread_Buffer *buffer = get_profiler_thread_buffer();
+        if (buffer) {
+            Profiler_Event *event = &buffer->events[buffer->write_count & (kProfiler_Events_Per_Thread - 1)];
+            event->name  = name;
+            event->begin = begin;
+            event->end   = profiler_ticks();
+            ++buffer->write_count;
+        }
+    }
+}
+
+
+static void toggle_profiler_recording(Log *log) {
+    g_profiler.is_recording = !g_profiler.is_recording;
+    log_str(log, g_profiler.is_recording ? "Profiler recording started" : "Profiler recording stopped");
+}
+
+
+// NOTE: Should be called between frames from the main thread. Events recorded by other threads while
+//       this runs might be torn, which is fine for a trace.
+static b32 write_profile_to_disc(Log *log) {
+    b32 result = false;
+
+    time_t timer;
+    time(&timer);
+    tm local_time = {};
+    localtime_s(&local_time, &timer);
+
+    u32 constexpr buffer_size = 256;
+    char path_and_name[buffer_size];
+    _snprintf_s(path_and_name, buffer_size, _TRUNCATE, "profile_%04d%02d%02d_%02d%02d%02d.json",
+                1900 + local_time.tm_year, 1 + local_time.tm_mon, local_time.tm_mday,
+                local_time.tm_hour, local_time.tm_min, local_time.tm_sec);
+
+    FILE *file = nullptr;
+    errno_t error = fopen_s(&file, path_and_name, "wb");
+    if (error != 0 || !file) {
+        LOG_ERROR_STR(log, "failed to open the profile for writing", path_and_name);
+        return result;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+    b32 is_first = true;
+    double const microseconds_per_tick = 1000000.0 / static_cast<double>(g_profiler.ticks_per_second);
+    u32 thread_count = min(static_cast<u32>(g_profiler.thread_count), kProfiler_Max_Thread_Count);
+
+    for (u32 thread_index = 0; thread_index < thread_count; ++thread_index) {
+        Profiler_Thread_Buffer *buffer = g_profiler.thread_buffers[thread_index];
+        if (!buffer)  continue;
+
+        u64 write_count = buffer->write_count;
+        u64 first = write_count > kProfiler_Events_Per_Thread ? write_count - kProfiler_Events_Per_Thread : 0;
+
+        for (u64 index = first; index < write_count; ++index) {
+            Profiler_Event *event = &buffer->events[index & (kProfiler_Events_Per_Thread - 1)];
+            if (!event->name)  continue;
+
+            double ts  = static_cast<double>(event->begin - g_profiler.start_ticks) * microseconds_per_tick;
+            double dur = static_cast<double>(event->end - event->begin) * microseconds_per_tick;
+            fprintf(file, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    is_first ? "" : ",\n", event->name, buffer->thread_id, ts, dur);
+            is_first = false;
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    log_str(log, "Profile written");
+    result = true;
+
+    return result;
+}
+
+#endif
@@ -0,0 +1,408 @@
+//
+// Render thread
+//
+// Simulating and drawing overlap instead of adding up. The game draws into a Renderer_Recorder, which only
+// writes the calls into a Render_Frame: a flat list of commands, with the text copied into the frame so
+// nothing in it points at state the game goes on to change. Bitmaps, spans and fonts are resources and
+// don't change once loaded, so the frame keeps pointers to those.
+//
+// There are two frames. While the game records into one, the render thread replays the other on the real
+// renderer and presents it. end_render_frame() only waits if the render thread is still busy with the
+// previous frame, so what is on screen is at most one frame behind the simulation.
+//
+
+#include <mutex>
+#include <condition_variable>
+
+#define kRender_Frame_Initial_Command_Capacity 1024
+#define kRender_Frame_Initial_Text_Capacity    4096
+
+
+enum Render_Command_Type : u32 {
+    Render_Command_Clear = 0,
+    Render_Command_Filled_Rectangle,
+    Render_Command_Rectangle_Outline,
+    Render_Command_Bitmap,
+    Render_Command_Bitmap_Sub_Rect,
+    Render_Command_Coloured_Bitmap,
+    Render_Command_Bitmap_Spans,
+    Render_Command_Print,
+};
+
+
+struct Render_Command {
+    Render_Command_Type type;
+    v2u P;
+    u32 x0, y0, x1, y1;         // The sub-rectangle, or the width and height in x1 and y1 for rectangles
+    v4u8 colour;
+    Bmp *bitmap;
+    Bitmap_Spans const *spans;
+    Font *font;
+    u32 text_offset;            // Print, into the frame's text
+};
+
+
+struct Render_Frame {
+    Render_Command *commands = nullptr;
+    u32 command_count = 0;
+    u32 command_capacity = 0;
+
+    char *text = nullptr;       // Every printed string, zero terminated, one after the other
+    u32 text_size = 0;
+    u32 text_capacity = 0;
+};
+
+
+struct Renderer_Recorder : public Renderer {
+    //
+    // Methods
+    b32 init(Log *log, u32 width, u32 height) final override;
+
+    void clear(v4u8 clear_colour) final override;
+
+    void draw_filled_rectangle(v2u P, u32 w, u32 h, v4u8 colour) final override;
+    void draw_rectangle_outline(v2u P, u32 w, u32 h, v4u8 colour) final override;
+
+    void draw_bitmap(v2u P, Bmp *bitmap) final override;
+    void draw_bitmap(v2u P, Bmp *bitmap, u32 x0, u32 y0, u32 x1, u32 y1) final override;
+    void draw_coloured_bitmap(v2u P, Bmp *bitmap, u32 x0, u32 y0, u32 x1, u32 y1, v4u8 colour) final override;
+    void draw_bitmap_spans(v2u P, Bmp *bitmap, Bitmap_Spans const *spans, u32 x0, u32 y0, u32 x1, u32 y1) final override;
+
+    v2u print(Font *font, v2u Po, char const *text, v4u8 colour_v4u8 = v4u8_white) final override;
+
+    void draw_to_screen() final override {}; // The render thread presents, see end_render_frame()
+
+    u32 get_backbuffer_width()  final override {return width;}
+    u32 get_backbuffer_height() final override {return height;}
+
+    //
+    // Members
+    Render_Frame *frame = nullptr;
+    u32 width  = 0;
+    u32 height = 0;
+    Log *log = nullptr;
+};
+
+
+struct Render_Thread {
+    Renderer *renderer = nullptr;  // The real one, only used by the render thread while it is running
+    Renderer_Recorder recorder;
+    Render_Frame frames[2];
+    u32 recording_index = 0;       // Only touched by the game thread
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    s32 submitted_index = -1;      // The frame the render thread has until it is presented, -1 when idle
+    b32 is_running = false;        // Guarded by mutex, like submitted_index
+    std::thread thread;
+};
+
+
+
+
+//
+// #_Frames
+//
+
+static void free_render_frame(Render_Frame *frame) {
+    if (frame->commands)  free(frame->commands);
+    if (frame->text)      free(frame->text);
+    *frame = {};
+}
+
+
+static Render_Command *push_render_command(Render_Frame *frame, Render_Command_Type type) {
+    Render_Command *result = nullptr;
+
+    if (frame->command_count == frame->command_capacity) {
+        u32 new_capacity = frame->command_capacity == 0 ? kRender_Frame_Initial_Command_Capacity : 2 * frame->command_capacity;
+        Render_Command *new_commands = static_cast<Render_Command *>(realloc(frame->commands, new_capacity * sizeof(Render_Command)));
+        if (!new_commands) {
+            printf("%s in %s failed to reallocate memory!\n", __FUNCTION__, __FILE__);
+            return result;
+        }
+        frame->commands = new_commands;
+        frame->command_capacity = new_capacity;
+    }
+
+    result = &frame->commands[frame->command_count++];
+    memset(result, 0, sizeof(Render_Command));
+    result->type = type;
+
+    return result;
+}
+
+
+// Returns the offset of the copy, or 0xFFFFFFFF if we're out of memory
+static u32 push_render_text(Render_Frame *frame, char const *text) {
+    u32 result = 0xFFFFFFFF;
+
+    u32 size = static_cast<u32>(strlen(text)) + 1;
+    if (frame->text_size + size > frame->text_capacity) {
+        u32 new_capacity = frame->text_capacity == 0 ? kRender_Frame_Initial_Text_Capacity : frame->text_capacity;
+        while (frame->text_size + size > new_capacity)  new_capacity *= 2;
+
+        char *new_text = static_cast<char *>(realloc(frame->text, new_capacity));
+        if (!new_text) {
+            printf("%s in %s failed to reallocate memory!\n", __FUNCTION__, __FILE__);
+            return result;
+        }
+        frame->text = new_text;
+        frame->text_capacity = new_capacity;
+    }
+
+    result = frame->text_size;
+    memcpy(frame->text + frame->text_size, text, size);
+    frame->text_size += size;
+
+    return result;
+}
+
+
+// Draws the frame on renderer, in the order it was recorded
+static void replay_render_frame(Render_Frame const *frame, Renderer *renderer) {
+    PROFILE_FUNCTION();
+
+    for (u32 index = 0; index < frame->command_count; ++index) {
+        Render_Command const *command = &frame->commands[index];
+        switch (command->type) {
+            case Render_Command_Clear: {
+                renderer->clear(command->colour);
+            } break;
+
+            case Render_Command_Filled_Rectangle: {
+                renderer->draw_filled_rectangle(command->P, command->x1, command->y1, command->colour);
+            } break;
+
+            case Render_Command_Rectangle_Outline: {
+                renderer->draw_rectangle_outline(command->P, command->x1, command->y1, command->colour);
+            } break;
+
+            case Render_Command_Bitmap: {
+                renderer->draw_bitmap(command->P, command->bitmap);
+            } break;
+
+            case Render_Command_Bitmap_Sub_Rect: {
+                renderer->draw_bitmap(command->P, command->bitmap, command->x0, command->y0, command->x1, command->y1);
+            } break;
+
+            case Render_Command_Coloured_Bitmap: {
+                renderer->draw_coloured_bitmap(command->P, command->bitmap, command->x0, command->y0, command->x1, command->y1, command->colour);
+            } break;
+
+            case Render_Command_Bitmap_Spans: {
+                renderer->draw_bitmap_spans(command->P, command->bitmap, command->spans, command->x0, command->y0, command->x1, command->y1);
+            } break;
+
+            case Render_Command_Print: {
+                renderer->print(command->font, command->P, frame->text + command->text_offset, command->colour);
+            } break;
+
+            default: {
+                assert(false);
+            } break;
+        }
+    }
+}
+
+
+
+
+//
+// #_Recording
+//
+
+b32 Renderer_Recorder::init(Log *_log, u32 _width, u32 _height) {
+    this->log = _log;
+    this->width = _width;
+    this->height = _height;
+    return true;
+}
+
+
+void Renderer_Recorder::clear(v4u8 clear_colour) {
+    Render_Command *command = push_render_command(this->frame, Render_Command_Clear);
+    if (command) {
+        command->colour = clear_colour;
+    }
+}
+
+
+void Renderer_Recorder::draw_filled_rectangle(v2u P, u32 w, u32 h, v4u8 colour) {
+    Render_Command *command = push_render_command(this->frame, Render_Command_Filled_Rectangle);
+    if (command) {
+        command->P = P;
+        command->x1 = w;
+        command->y1 = h;
+        command->colour = colour;
+    }
+}
+
+
+void Renderer_Recorder::draw_rectangle_outline(v2u P, u32 w, u32 h, v4u8 colour) {
+    Render_Command *command = push_render_command(this->frame, Render_Command_Rectangle_Outline);
+    if (command) {
+        command->P = P;
+        command->x1 = w;
+        command->y1 = h;
+        command->colour = colour;
+    }
+}
+
+
+void Renderer_Recorder::draw_bitmap(v2u P, Bmp *bitmap) {
+    Render_Command *command = push_render_command(this->frame, Render_Command_Bitmap);
+    if (command) {
+        command->P = P;
+        command->bitmap = bitmap;
+    }
+}
+
+
+void Renderer_Recorder::draw_bitmap(v2u P, Bmp *bitmap, u32 x0, u32 y0, u32 x1, u32 y1) {
+    Render_Command *command = push_render_command(this->frame, Render_Command_Bitmap_Sub_Rect);
+    if (command) {
+        command->P = P;
+        command->bitmap = bitmap;
+        command->x0 = x0;
+        command->y0 = y0;
+        command->x1 = x1;
+        command->y1 = y1;
+    }
+}
+
+
+void Renderer_Recorder::draw_coloured_bitmap(v2u P, Bmp *bitmap, u32 x0, u32 y0, u32 x1, u32 y1, v4u8 colour) {
+    Render_Command *command = push_render_command(this->frame, Render_Command_Coloured_Bitmap);
+    if (command) {
+        command->P = P;
+        command->bitmap = bitmap;
+        command->x0 = x0;
+        command->y0 = y0;
+        command->x1 = x1;
+        command->y1 = y1;
+        command->colour = colour;
+    }
+}
+
+
+void Renderer_Recorder::draw_bitmap_spans(v2u P, Bmp *bitmap, Bitmap_Spans const *spans, u32 x0, u32 y0, u32 x1, u32 y1) {
+    Render_Command *command = push_render_command(this->frame, Render_Command_Bitmap_Spans);
+    if (command) {
+        command->P = P;
+        command->bitmap = bitmap;
+        command->spans = spans;
+        command->x0 = x0;
+        command->y0 = y0;
+        command->x1 = x1;
+        command->y1 = y1;
+    }
+}
+
+
+// Returns the same as Renderer_Software::print(), without drawing anything
+v2u Renderer_Recorder::print(Font *font, v2u Po, char const *text, v4u8 colour_v4u8) {
+    v2u result = Po;
+    result.x += get_text_dim(font, text).x;
+
+    u32 text_offset = push_render_text(this->frame, text);
+    if (text_offset != 0xFFFFFFFF) {
+        Render_Command *command = push_render_command(this->frame, Render_Command_Print);
+        if (command) {
+            command->P = Po;
+            command->font = font;
+            command->colour = colour_v4u8;
+            command->text_offset = text_offset;
+        }
+    }
+
+    return result;
+}
+
+
+
+
+//
+// #_Thread
+//
+
+static void run_render_thread(Render_Thread *render_thread) {
+    std::unique_lock<std::mutex> lock(render_thread->mutex);
+
+    for (;;) {
+        while (render_thread->submitted_index < 0 && render_thread->is_running) {
+            render_thread->condition.wait(lock);
+        }
+        if (render_thread->submitted_index < 0)  break; // Stopped, and every submitted frame is presented
+
+        //
+        // The game doesn't touch the submitted frame until we say we're done with it
+        Render_Frame *frame = &render_thread->frames[render_thread->submitted_index];
+        lock.unlock();
+        {
+            PROFILE_SCOPE("Render frame");
+            replay_render_frame(frame, render_thread->renderer);
+            render_thread->renderer->draw_to_screen();
+        }
+        lock.lock();
+
+        render_thread->submitted_index = -1;
+        render_thread->condition.notify_all();
+    }
+}
+
+
+// From now on the game draws through begin_render_frame() and renderer is only used by the render thread
+static void start_render_thread(Render_Thread *render_thread, Renderer *renderer, Log *log) {
+    render_thread->renderer = renderer;
+    render_thread->recording_index = 0;
+    render_thread->submitted_index = -1;
+    render_thread->recorder.init(log, renderer->get_backbuffer_width(), renderer->get_backbuffer_height());
+
+    render_thread->is_running = true;
+    render_thread->thread = std::thread(run_render_thread, render_thread);
+}
+
+
+// Presents the frame that is already submitted, if any, before stopping
+static void stop_render_thread(Render_Thread *render_thread) {
+    if (render_thread->thread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(render_thread->mutex);
+            render_thread->is_running = false;
+        }
+        render_thread->condition.notify_all();
+        render_thread->thread.join();
+    }
+
+    free_render_frame(&render_thread->frames[0]);
+    free_render_frame(&render_thread->frames[1]);
+}
+
+
+// The renderer to draw this frame with, it records into the frame the render thread isn't using
+static Renderer *begin_render_frame(Render_Thread *render_thread) {
+    Render_Frame *frame = &render_thread->frames[render_thread->recording_index];
+    frame->command_count = 0;
+    frame->text_size = 0;
+    render_thread->recorder.frame = frame;
+
+    return &render_thread->recorder;
+}
+
+
+// Hands the recorded frame to the render thread, once it is done with the previous one
+static void end_render_frame(Render_Thread *render_thread) {
+    PROFILE_FUNCTION();
+
+    {
+        std::unique_lock<std::mutex> lock(render_thread->mutex);
+        while (render_thread->submitted_index >= 0) {
+            render_thread->condition.wait(lock);
+        }
+        render_thread->submitted_index = static_cast<s32>(render_thread->recording_index);
+    }
+    render_thread->condition.notify_all();
+
+    render_thread->recording_index ^= 1;
+}
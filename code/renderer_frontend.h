@@ -4,6 +4,8 @@
 
 
 struct Renderer {
+    virtual ~Renderer() {};
+
     virtual b32 init(Log *log, u32 width, u32 height) = 0;
 
     virtual void clear(v4u8 clear_colour) = 0;
@@ -14,6 +16,7 @@ struct Renderer {
     virtual void draw_bitmap(v2u P, Bmp *bitmap) = 0;
     virtual void draw_bitmap(v2u P, Bmp *bitmap, u32 x0, u32 y0, u32 x1, u32 y1) = 0;
     virtual void draw_coloured_bitmap(v2u P, Bmp *bitmap, u32 x0, u32 y0, u32 x1, u32 y1, v4u8 colour) = 0;
+    virtual void draw_bitmap_spans(v2u P, Bmp *bitmap, Bitmap_Spans const *spans, u32 x0, u32 y0, u32 x1, u32 y1) = 0;
 
     virtual v2u print(Font *font, v2u Po, char const *text, v4u8 colour_v4u8 = v4u8_white) = 0;
 
@@ -0,0 +1,414 @@
+//
+// Replays
+//
+// A replay is a recording of one attempt at a level: the id and the content hash of the level followed by
+// every input (and undo/redo) together with the frame it happened on. play_turn() is deterministic, so a
+// replay can be re-simulated without a window, at maximum speed, and the final score and outcome compared to
+// the recorded ones. This is how we turn bug reports into cases that can be reproduced.
+//
+
+#define kReplay_Magic   0x594C5052 // "RPLY"
+#define kReplay_Version 1
+
+#define kReplay_Audio_Tail_Frames 180 // Three seconds
+
+
+enum Replay_Event_Type {
+    Replay_Event_Input = 0,
+    Replay_Event_Undo,
+    Replay_Event_Redo,
+
+    Replay_Event_Count,
+};
+
+
+enum Replay_Outcome {
+    Replay_Outcome_None = 0, // The replay was saved before the level was won or lost
+    Replay_Outcome_Won,
+    Replay_Outcome_Lost,
+
+    Replay_Outcome_Count,
+};
+
+
+#pragma pack(push, 1)
+struct Replay_Header {
+    u32 magic;
+    u16 version;
+    u16 header_size;
+    u32 level_id;
+    u64 content_hash;  // hash_level_content() of the level's original state
+    u32 event_count;
+    u32 frame_count;   // Number of frames from the start of the recording until it was saved
+    u16 final_score;
+    u8  outcome;       // Replay_Outcome
+    u8  padding;
+};
+#pragma pack(pop)
+
+
+#pragma pack(push, 1)
+struct Replay_Event {
+    u32 frame;  // Frames since the start of the recording
+    u8  type;   // Replay_Event_Type
+    u8  input;  // Input, only used by Replay_Event_Input
+};
+#pragma pack(pop)
+
+
+struct Replay {
+    Replay_Header header = {};
+    Replay_Event *events = nullptr;
+    u32 capacity = 0;
+};
+
+
+struct Replay_Recorder {
+    Replay replay;
+    u32 frame = 0;
+    b32 is_recording = false;
+};
+
+
+struct Replay_Result {
+    b32 level_found     = false;
+    b32 hash_matches    = false;
+    b32 matches         = false; // Score and outcome are the same as when the replay was recorded
+    u32 turns_played    = 0;
+    u16 final_score     = 0;
+    Replay_Outcome outcome = Replay_Outcome_None;
+};
+
+
+
+
+//
+// Storage
+//
+
+static void free_replay(Replay *replay) {
+    if (replay) {
+        if (replay->events) {
+            free(replay->events);
+            replay->events = nullptr;
+        }
+        replay->capacity = 0;
+        replay->header = {};
+    }
+}
+
+
+static b32 push_replay_event(Replay *replay, Replay_Event event) {
+    b32 result = false;
+
+    if (replay) {
+        if (replay->header.event_count == replay->capacity) {
+            u32 new_capacity = replay->capacity == 0 ? 256 : 2 * replay->capacity;
+            void *new_ptr = realloc(replay->events, new_capacity * sizeof(Replay_Event));
+            if (new_ptr) {
+                replay->events = static_cast<Replay_Event *>(new_ptr);
+                replay->capacity = new_capacity;
+            }
+            else {
+                printf("%s in %s failed to reallocate memory!\n", __FUNCTION__, __FILE__);
+            }
+        }
+
+        if (replay->header.event_count < replay->capacity) {
+            replay->events[replay->header.event_count++] = event;
+            result = true;
+        }
+    }
+
+    return result;
+}
+
+
+static b32 write_replay_to_disc(Replay *replay, char const *path_and_name) {
+    b32 result = false;
+
+    HANDLE file_handle;
+    result = win32_open_file_for_writing(path_and_name, &file_handle);
+    if (result) {
+        DWORD bytes_written;
+        DWORD bytes_to_write = sizeof(Replay_Header);
+        result = WriteFile(file_handle, &replay->header, bytes_to_write, &bytes_written, nullptr);
+        result = result && (bytes_written == bytes_to_write);
+
+        bytes_to_write = replay->header.event_count * sizeof(Replay_Event);
+        if (result && bytes_to_write > 0) {
+            result = WriteFile(file_handle, replay->events, bytes_to_write, &bytes_written, nullptr);
+            result = result && (bytes_written == bytes_to_write);
+        }
+
+        if (!result) {
+            printf("%s() failed to write the replay to %s\n", __FUNCTION__, path_and_name);
+        }
+
+        CloseHandle(file_handle);
+    }
+
+    return result;
+}
+
+
+static b32 read_replay_from_disc(Replay *replay, char const *path_and_name) {
+    b32 result = false;
+    free_replay(replay);
+
+    u8 *data = nullptr;
+    u32 size = 0;
+    if (win32_read_entire_file(path_and_name, &data, &size)) {
+        Replay_Header *header = reinterpret_cast<Replay_Header *>(data);
+
+        if (size < sizeof(Replay_Header) || header->magic != kReplay_Magic) {
+            printf("%s(): %s is not a replay\n", __FUNCTION__, path_and_name);
+        }
+        else if (header->version != kReplay_Version || header->header_size != sizeof(Replay_Header)) {
+            printf("%s(): %s has an unsupported version (%u)\n", __FUNCTION__, path_and_name, header->version);
+        }
+        else if ((size - sizeof(Replay_Header)) / sizeof(Replay_Event) < header->event_count) {
+            printf("%s(): %s is truncated\n", __FUNCTION__, path_and_name);
+        }
+        else {
+            replay->header = *header;
+            replay->capacity = header->event_count;
+
+            if (replay->capacity > 0) {
+                size_t events_size = replay->capacity * sizeof(Replay_Event);
+                replay->events = static_cast<Replay_Event *>(malloc(events_size));
+                assert(replay->events);
+                memcpy(replay->events, data + sizeof(Replay_Header), events_size);
+            }
+
+            result = true;
+        }
+    }
+
+    if (data) {
+        free(data);
+    }
+
+    return result;
+}
+
+
+
+
+//
+// Recording
+//
+
+static void begin_replay_recording(Replay_Recorder *recorder, Level *level) {
+    free_replay(&recorder->replay);
+
+    Replay_Header *header = &recorder->replay.header;
+    header->magic        = kReplay_Magic;
+    header->version      = kReplay_Version;
+    header->header_size  = sizeof(Replay_Header);
+    header->level_id     = level->id;
+    header->content_hash = hash_level_content(level, &level->original_state);
+
+    recorder->frame = 0;
+    recorder->is_recording = true;
+}
+
+
+static void end_replay_recording(Replay_Recorder *recorder) {
+    free_replay(&recorder->replay);
+    recorder->frame = 0;
+    recorder->is_recording = false;
+}
+
+
+static void record_replay_event(Replay_Recorder *recorder, Replay_Event_Type type, Input input = Input_None) {
+    if (recorder->is_recording) {
+        Replay_Event event;
+        event.frame = recorder->frame;
+        event.type  = static_cast<u8>(type);
+        event.input = static_cast<u8>(input);
+        push_replay_event(&recorder->replay, event);
+    }
+}
+
+
+static void record_replay_input(Replay_Recorder *recorder, Input input) {
+    record_replay_event(recorder, Replay_Event_Input, input);
+}
+
+
+// Should be called once per frame
+static void advance_replay_recording(Replay_Recorder *recorder) {
+    if (recorder->is_recording) {
+        ++recorder->frame;
+    }
+}
+
+
+// Writes what has been recorded so far to data\replays\, the recording continues after this.
+static b32 save_replay_recording(Replay_Recorder *recorder, Level *level, Replay_Outcome outcome) {
+    b32 result = false;
+
+    if (recorder->is_recording) {
+        Replay_Header *header = &recorder->replay.header;
+        header->frame_count = recorder->frame;
+        header->final_score = level->current_state->score;
+        header->outcome     = static_cast<u8>(outcome);
+
+        CreateDirectoryA("data\\replays", nullptr); // Fails if it already exists, which is fine
+
+        time_t timer;
+        time(&timer);
+        tm local_time = {};
+        localtime_s(&local_time, &timer);
+
+        u32 constexpr buffer_size = 512;
+        char path_and_name[buffer_size];
+        _snprintf_s(path_and_name, buffer_size, _TRUNCATE, "data\\replays\\level_%u_%04d%02d%02d_%02d%02d%02d_%u.replay",
+                    header->level_id, 1900 + local_time.tm_year, 1 + local_time.tm_mon, local_time.tm_mday,
+                    local_time.tm_hour, local_time.tm_min, local_time.tm_sec, recorder->frame);
+
+        result = write_replay_to_disc(&recorder->replay, path_and_name);
+    }
+
+    return result;
+}
+
+
+
+
+//
+// Playback
+//
+
+// Re-simulates the replay on a copy of the level, without rendering and as fast as possible. If audio is
+// given, the sounds are played into it in step with the recorded frames, the same replay then always
+// produces the same audio (see Audio_Wav_File).
+static b32 play_replay(Replay *replay, Array_Of_Levels *levels, Replay_Result *result, Audio *audio = nullptr, Wavs *wavs = nullptr) {
+    *result = {};
+
+    Level *original_level = get_level_with_id(levels, replay->header.level_id);
+    if (!original_level) {
+        printf("%s(): found no level with id %u\n", __FUNCTION__, replay->header.level_id);
+        return false;
+    }
+    result->level_found = true;
+
+    u64 content_hash = hash_level_content(original_level, &original_level->original_state);
+    if (content_hash != replay->header.content_hash) {
+        printf("%s(): level %u has changed since the replay was recorded\n", __FUNCTION__, replay->header.level_id);
+        return false;
+    }
+    result->hash_matches = true;
+
+    Level level;
+    init_level_as_copy_of_level(&level, original_level, &original_level->original_state);
+    reset_level(&level);
+    create_maps_off_level(&level);
+
+    Array_Of_Moves moves;
+    init_array_of_moves(&moves);
+
+    Wavs no_wavs; // Never played, without audio there is nothing to play them on
+    if (!audio || !wavs)  wavs = &no_wavs;
+
+    u32 frame = 0;
+    for (u32 index = 0; index < replay->header.event_count; ++index) {
+        Replay_Event *event = &replay->events[index];
+
+        if (audio && event->frame > frame) {
+            audio->update((event->frame - frame) * kFrame_Time);
+            frame = event->frame;
+        }
+
+        if (event->type == Replay_Event_Input) {
+            Turn_Result turn_result = play_turn(&level, &moves, static_cast<Input>(event->input), audio, wavs);
+            if (turn_result == Turn_Result_Moved)  ++result->turns_played;
+            if (turn_result == Turn_Result_No_Valid_Moves)  play_wav(audio, &wavs->nope);
+        }
+        else if (event->type == Replay_Event_Undo) {
+            undo_one_level_state(&level);
+            create_maps_off_level(&level);
+        }
+        else if (event->type == Replay_Event_Redo) {
+            redo_one_level_state(&level);
+            create_maps_off_level(&level);
+        }
+    }
+
+    // The win-/loose-conditions are checked at the start of a turn, so we'll need one more to get the outcome.
+    Turn_Result turn_result = play_turn(&level, &moves, Input_None, audio, wavs);
+    result->outcome = turn_result == Turn_Result_Won  ? Replay_Outcome_Won :
+                      turn_result == Turn_Result_Lost ? Replay_Outcome_Lost : Replay_Outcome_None;
+    result->final_score = level.current_state->score;
+    result->matches = (result->outcome == replay->header.outcome) && (result->final_score == replay->header.final_score);
+
+    if (audio) {
+        if (result->outcome == Replay_Outcome_Won)   play_wav(audio, &wavs->won);
+        if (result->outcome == Replay_Outcome_Lost)  play_wav(audio, &wavs->lost);
+
+        // Until the end of the recording, and then long enough for the last sound to finish
+        u32 frames_left = replay->header.frame_count > frame ? replay->header.frame_count - frame : 0;
+        audio->update((frames_left + kReplay_Audio_Tail_Frames) * kFrame_Time);
+    }
+
+    free_array_of_moves(&moves);
+    fini_level(&level);
+
+    return true;
+}
+
+
+// Loads all the levels and plays the replay. Returns 0 if the replay ended with the same score and outcome
+// as when it was recorded. If audio_path_and_name is given the sounds of the replay are written to that
+// wav file.
+static u32 run_replay_headless(Log *log, char const *path_and_name, char const *audio_path_and_name = nullptr) {
+    u32 error_code = 0;
+
+    Replay replay;
+    Array_Of_Levels levels;
+    Resources resources;
+    Audio_Wav_File audio;
+    b32 with_audio = audio_path_and_name != nullptr;
+
+    if (!read_replay_from_disc(&replay, path_and_name)) {
+        LOG_ERROR_STR(log, "failed to read the replay", path_and_name);
+        error_code = 1;
+    }
+    else if (load_levels_from_disc(&levels, nullptr) == 0) { // No resources needed since we don't draw anything
+        LOG_ERROR_STR(log, "failed to load the levels", 0);
+        error_code = 2;
+    }
+    else if (with_audio && (!init_resources(&resources) || !audio.init_file(log, audio_path_and_name))) {
+        LOG_ERROR_STR(log, "failed to set up the audio output", audio_path_and_name);
+        error_code = 5;
+    }
+    else {
+        Replay_Result result;
+        if (!play_replay(&replay, &levels, &result, with_audio ? &audio : nullptr, with_audio ? &resources.wavs : nullptr)) {
+            LOG_ERROR_STR(log, "failed to play the replay", path_and_name);
+            error_code = 3;
+        }
+        else {
+            log_u32(log, "Replay, turns played", result.turns_played);
+            log_u32(log, "Replay, final score", result.final_score);
+            log_u32(log, "Replay, expected score", replay.header.final_score);
+            log_u32(log, "Replay, outcome", result.outcome);
+            log_u32(log, "Replay, expected outcome", replay.header.outcome);
+
+            if (result.matches) {
+                log_str(log, "Replay matches the recording");
+            }
+            else {
+                LOG_ERROR_STR(log, "replay does not match the recording", path_and_name);
+                error_code = 4;
+            }
+        }
+    }
+
+    free_resources(&resources);
+    free_array_of_levels(&levels);
+    free_replay(&replay);
+
+    return error_code;
+}
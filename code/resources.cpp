@@ -3,19 +3,29 @@
 // (c) Marcus Larsson
 //
 
-struct Bitmaps {
-    Bmp ghost_red;
-    Bmp ghost_pink;
-    Bmp ghost_cyan;
-    Bmp ghost_orange;
-    Bmp ghost_as_prey;
-    Bmp ghost_eye;
-    Bmp ghost_pupil;
-    Bmp dot_large;
-    Bmp dot_small;
-    Bmp background;
-    Bmp pacman_atlas;
-    Bmp wall_atlas;
+enum Sprite_Id {
+    Sprite_Ghost_Red = 0,
+    Sprite_Ghost_Pink,
+    Sprite_Ghost_Cyan,
+    Sprite_Ghost_Orange,
+    Sprite_Ghost_As_Prey,
+    Sprite_Ghost_Eye,
+    Sprite_Ghost_Pupil,
+    Sprite_Dot_Large,
+    Sprite_Dot_Small,
+    Sprite_Background,
+    Sprite_Pacman_Atlas, // 4x4 cells, one column per direction and one row per frame
+    Sprite_Wall_Atlas,   // 4x4 cells, one per wall type
+
+    Sprite_Count,
+};
+
+
+// All the game's bitmaps, packed into one atlas (see atlas.cpp)
+struct Sprites {
+    Bmp atlas;
+    Sprite sprites[Sprite_Count];
+    Bitmap_Spans spans[Sprite_Count]; // Built at load time from the atlas
 };
 
 
@@ -30,68 +40,282 @@ struct Wavs {
 
 
 struct Resources {
-    Bitmaps bitmaps;
+    Sprites sprites;
     Wavs wavs;
     Font font;
+    Pak pak; // Everything above points into this when it was loaded from the archive
 };
 
 
-static b32 init_resources(Resources *resources) {
+#define kResources_Pak_Path_And_Name "data\\resources.pak"
+#define kResources_Font_Name         "fonts\\font"
+#define kResources_Atlas_Name        "atlas"
+
+
+// Paths are relative to the data directory, every sprite has one bitmap
+struct Resource_Bitmap {
+    char const *name;
+    Sprite_Id sprite;
+};
+
+static Resource_Bitmap const kResource_Bitmaps[] = {
+    {"bitmaps\\ghost_red.bmp"    , Sprite_Ghost_Red},
+    {"bitmaps\\ghost_pink.bmp"   , Sprite_Ghost_Pink},
+    {"bitmaps\\ghost_cyan.bmp"   , Sprite_Ghost_Cyan},
+    {"bitmaps\\ghost_orange.bmp" , Sprite_Ghost_Orange},
+    {"bitmaps\\ghost_as_prey.bmp", Sprite_Ghost_As_Prey},
+    {"bitmaps\\ghost_eyes.bmp"   , Sprite_Ghost_Eye},
+    {"bitmaps\\ghost_pupils.bmp" , Sprite_Ghost_Pupil},
+    {"bitmaps\\dot_large.bmp"    , Sprite_Dot_Large},
+    {"bitmaps\\dot_small.bmp"    , Sprite_Dot_Small},
+    {"bitmaps\\background.bmp"   , Sprite_Background},
+    {"bitmaps\\pacman_atlas.bmp" , Sprite_Pacman_Atlas},
+    {"bitmaps\\wall_atlas.bmp"   , Sprite_Wall_Atlas},
+};
+
+
+// Paths are relative to the data directory, they're also the names in the archive
+struct Resource_Wav {
+    char const *name;
+    Wav Wavs::*wav;
+};
+
+static Resource_Wav const kResource_Wavs[] = {
+    {"audio\\eat_large_dot.wav", &Wavs::eat_large_dot},
+    {"audio\\eat_small_dot.wav", &Wavs::eat_small_dot},
+    {"audio\\ghost_dies.wav"   , &Wavs::ghost_dies},
+    {"audio\\won.wav"          , &Wavs::won},
+    {"audio\\lost.wav"         , &Wavs::lost},
+    {"audio\\nope.wav"         , &Wavs::nope},
+};
+
+
+// The files load_font() reads, relative to the data directory
+static char const *const kResource_Font_Files[] = {"fonts\\font.fnt", "fonts\\font.bmp"};
+
+
+static void free_resources(Resources *resources) {
+    for (u32 index = 0; index < Sprite_Count; ++index) {
+        free_bitmap_spans(&resources->sprites.spans[index]);
+    }
+    free_bitmap(&resources->sprites.atlas);
+
+    free_font(&resources->font);
+
+    for (u32 index = 0; index < Array_Count(kResource_Wavs); ++index) {
+        free_wav(&(resources->wavs.*kResource_Wavs[index].wav));
+    }
+
+    close_pak(&resources->pak);
+}
+
+
+// From the loose files in data, the wavs are converted to the mixer's format (see wav_convert.cpp)
+static b32 init_resources_from_files(Resources *resources) {
     b32 result = true;
+    char path_and_name[MAX_PATH];
+
+    // bitmaps, packed into the atlas
+    {
+        Bmp bitmaps[Sprite_Count];
+        Bmp const *bitmaps_by_sprite[Sprite_Count] = {};
+        for (u32 index = 0; result && index < Array_Count(kResource_Bitmaps); ++index) {
+            Resource_Bitmap const *resource = &kResource_Bitmaps[index];
+            _snprintf_s(path_and_name, MAX_PATH, _TRUNCATE, "data\\%s", resource->name);
+            result = load_bitmap(path_and_name, &bitmaps[resource->sprite]);
+            bitmaps_by_sprite[resource->sprite] = &bitmaps[resource->sprite];
+        }
+
+        if (result)  result = build_atlas(bitmaps_by_sprite, Sprite_Count, &resources->sprites.atlas, resources->sprites.sprites);
+
+        for (u32 index = 0; index < Sprite_Count; ++index) {
+            free_bitmap(&bitmaps[index]);
+        }
+    }
 
-    // bitmaps
-    if (result)  result = load_bitmap("data\\bitmaps\\ghost_red.bmp"    , &resources->bitmaps.ghost_red);
-    if (result)  result = load_bitmap("data\\bitmaps\\ghost_pink.bmp"   , &resources->bitmaps.ghost_pink);
-    if (result)  result = load_bitmap("data\\bitmaps\\ghost_cyan.bmp"   , &resources->bitmaps.ghost_cyan);
-    if (result)  result = load_bitmap("data\\bitmaps\\ghost_orange.bmp" , &resources->bitmaps.ghost_orange);
-    if (result)  result = load_bitmap("data\\bitmaps\\ghost_as_prey.bmp", &resources->bitmaps.ghost_as_prey);
-    if (result)  result = load_bitmap("data\\bitmaps\\ghost_eyes.bmp"   , &resources->bitmaps.ghost_eye);
-    if (result)  result = load_bitmap("data\\bitmaps\\ghost_pupils.bmp" , &resources->bitmaps.ghost_pupil);
-    if (result)  result = load_bitmap("data\\bitmaps\\dot_large.bmp"    , &resources->bitmaps.dot_large);
-    if (result)  result = load_bitmap("data\\bitmaps\\dot_small.bmp"    , &resources->bitmaps.dot_small);
-    if (result)  result = load_bitmap("data\\bitmaps\\background.bmp"   , &resources->bitmaps.background);
-    if (result)  result = load_bitmap("data\\bitmaps\\pacman_atlas.bmp" , &resources->bitmaps.pacman_atlas);
-    if (result)  result = load_bitmap("data\\bitmaps\\wall_atlas.bmp"   , &resources->bitmaps.wall_atlas);
-        
     // fonts
     if (result)  result = load_font("data\\fonts", "font", &resources->font);
-    
+
     // wavs
-    if (result)  result = load_wav("data\\audio\\eat_large_dot.wav", &resources->wavs.eat_large_dot);
-    if (result)  result = load_wav("data\\audio\\eat_small_dot.wav", &resources->wavs.eat_small_dot);
-    if (result)  result = load_wav("data\\audio\\ghost_dies.wav", &resources->wavs.ghost_dies);
-    if (result)  result = load_wav("data\\audio\\won.wav", &resources->wavs.won);
-    if (result)  result = load_wav("data\\audio\\lost.wav", &resources->wavs.lost);
-    if (result)  result = load_wav("data\\audio\\nope.wav", &resources->wavs.nope);
+    for (u32 index = 0; result && index < Array_Count(kResource_Wavs); ++index) {
+        _snprintf_s(path_and_name, MAX_PATH, _TRUNCATE, "data\\%s", kResource_Wavs[index].name);
+        result = load_canonical_wav(path_and_name, &(resources->wavs.*kResource_Wavs[index].wav));
+    }
 
     return result;
 }
 
 
-static void free_resources(Resources *resources) {
-    //
-    // bitmaps
-    free_bitmap(&resources->bitmaps.ghost_red);
-    free_bitmap(&resources->bitmaps.ghost_pink);
-    free_bitmap(&resources->bitmaps.ghost_cyan);
-    free_bitmap(&resources->bitmaps.ghost_orange);
-    free_bitmap(&resources->bitmaps.ghost_as_prey);
-    free_bitmap(&resources->bitmaps.ghost_eye);
-    free_bitmap(&resources->bitmaps.ghost_pupil);
-    free_bitmap(&resources->bitmaps.dot_large);
-    free_bitmap(&resources->bitmaps.dot_small);
-    free_bitmap(&resources->bitmaps.background);
-    free_bitmap(&resources->bitmaps.pacman_atlas);
-    free_bitmap(&resources->bitmaps.wall_atlas);
-
-    // font
-    free_font(&resources->font);
 
-    // wavs
-    free_wav(&resources->wavs.eat_large_dot);
-    free_wav(&resources->wavs.eat_small_dot);
-    free_wav(&resources->wavs.ghost_dies);
-    free_wav(&resources->wavs.won);
-    free_wav(&resources->wavs.lost);
-    free_wav(&resources->wavs.nope);
+
+//
+// Sources of the archive
+//
+// The loose files that go into each entry, for telling when the archive is out of date
+
+// The hash and total size of the files, names relative to the data directory. Returns false if one of them
+// can't be read, as when the game is shipped with only the archive.
+static b32 hash_resource_files(char const *const *names, u32 name_count, u64 *hash, u32 *size) {
+    b32 result = true;
+    char path_and_name[MAX_PATH];
+
+    *hash = kFNV_Offset_Basis;
+    *size = 0;
+    for (u32 index = 0; result && index < name_count; ++index) {
+        _snprintf_s(path_and_name, MAX_PATH, _TRUNCATE, "data\\%s", names[index]);
+
+        u8 *data = nullptr;
+        u32 data_size = 0;
+        HANDLE mapping = nullptr;
+        result = win32_map_file(path_and_name, &data, &data_size, &mapping);
+        if (result) {
+            *hash = fnv1a_64(*hash, &data_size, sizeof(data_size));
+            *hash = fnv1a_64(*hash, data, data_size);
+            *size += data_size;
+            win32_unmap_file(data, data_size, mapping);
+        }
+    }
+
+    return result;
+}
+
+
+static void get_resource_bitmap_names(char const **names) {
+    for (u32 index = 0; index < Array_Count(kResource_Bitmaps); ++index) {
+        names[index] = kResource_Bitmaps[index].name;
+    }
+}
+
+
+// False if the files are there and aren't the ones the entry was packed from
+static b32 pak_entry_is_current(Pak *pak, char const *name, Pak_Entry_Type type, char const *const *source_names, u32 source_count) {
+    b32 result = false;
+
+    Pak_Entry const *entry = find_pak_entry(pak, name, type);
+    if (entry) {
+        u64 hash;
+        u32 size;
+        result = !hash_resource_files(source_names, source_count, &hash, &size) || (hash == entry->source_hash && size == entry->source_size);
+        if (!result) {
+            printf("%s() the loose files of %s have changed since the archive was packed\n", __FUNCTION__, name);
+        }
+    }
+
+    return result;
+}
+
+
+// From the archive, nothing is copied. Reading the loose files to check that the archive is current costs
+// a little, but far less than decoding them, converting the wavs and building the atlas.
+static b32 init_resources_from_pak(Resources *resources) {
+    b32 result = true;
+    Pak *pak = &resources->pak;
+
+    char const *bitmap_names[Array_Count(kResource_Bitmaps)];
+    get_resource_bitmap_names(bitmap_names);
+    if (result)  result = pak_entry_is_current(pak, kResources_Atlas_Name, Pak_Entry_Type_Bitmap, bitmap_names, Array_Count(bitmap_names));
+    if (result)  result = load_bitmap_from_pak(pak, kResources_Atlas_Name, &resources->sprites.atlas);
+    if (result)  result = load_sprites_from_pak(pak, kResources_Atlas_Name, resources->sprites.sprites, Sprite_Count);
+
+    if (result)  result = pak_entry_is_current(pak, kResources_Font_Name, Pak_Entry_Type_Font, kResource_Font_Files, Array_Count(kResource_Font_Files));
+    if (result)  result = load_font_from_pak(pak, kResources_Font_Name, &resources->font);
+
+    for (u32 index = 0; result && index < Array_Count(kResource_Wavs); ++index) {
+        Wav *wav = &(resources->wavs.*kResource_Wavs[index].wav);
+        result = pak_entry_is_current(pak, kResource_Wavs[index].name, Pak_Entry_Type_Wav, &kResource_Wavs[index].name, 1) &&
+                 load_wav_from_pak(pak, kResource_Wavs[index].name, wav) && is_canonical_wav(wav);
+    }
+
+    return result;
+}
+
+
+// Loads from data\resources.pak if there is one and it is current, from the loose files otherwise
+static b32 init_resources(Resources *resources) {
+    b32 result = false;
+
+    if (open_pak(&resources->pak, kResources_Pak_Path_And_Name)) {
+        result = init_resources_from_pak(resources);
+        if (!result) {
+            printf("%s() %s is out of date, loading the loose files instead\n", __FUNCTION__, kResources_Pak_Path_And_Name);
+            free_resources(resources);
+        }
+    }
+
+    if (!result) {
+        result = init_resources_from_files(resources);
+    }
+
+    if (result) {
+        Sprites *sprites = &resources->sprites;
+        result = build_sprite_spans(&sprites->atlas, sprites->sprites, Sprite_Count, sprites->spans);
+    }
+
+    return result;
 }
+
+
+// The asset-build step, packs the loose files into data\resources.pak
+static b32 pack_resources(Log *log) {
+    b32 result = false;
+
+    Resources resources;
+    if (init_resources_from_files(&resources)) {
+        Pak_Writer *writer = new Pak_Writer;
+        u64 source_hash;
+        u32 source_size;
+
+        char const *bitmap_names[Array_Count(kResource_Bitmaps)];
+        get_resource_bitmap_names(bitmap_names);
+        if (!hash_resource_files(bitmap_names, Array_Count(bitmap_names), &source_hash, &source_size))  writer->error = true;
+        set_pak_sources(writer, source_hash, source_size);
+        add_bitmap_to_pak(writer, kResources_Atlas_Name, &resources.sprites.atlas);
+        add_sprites_to_pak(writer, kResources_Atlas_Name, resources.sprites.sprites, Sprite_Count);
+
+        if (!hash_resource_files(kResource_Font_Files, Array_Count(kResource_Font_Files), &source_hash, &source_size))  writer->error = true;
+        set_pak_sources(writer, source_hash, source_size);
+        add_font_to_pak(writer, kResources_Font_Name, &resources.font);
+
+        for (u32 index = 0; index < Array_Count(kResource_Wavs); ++index) {
+            if (!hash_resource_files(&kResource_Wavs[index].name, 1, &source_hash, &source_size))  writer->error = true;
+            set_pak_sources(writer, source_hash, source_size);
+            add_wav_to_pak(writer, kResource_Wavs[index].name, &(resources.wavs.*kResource_Wavs[index].wav));
+        }
+
+        result = write_pak(writer, kResources_Pak_Path_And_Name);
+        if (result) {
+            log_u32(log, "Packed resources, entries", writer->entry_count);
+            log_u32(log, "Packed resources, bytes", writer->size);
+        }
+        else {
+            LOG_ERROR_STR(log, "failed to write the archive", kResources_Pak_Path_And_Name);
+        }
+
+        delete writer;
+    }
+    else {
+        LOG_ERROR_STR(log, "failed to load the resources to pack, is the data directory present?", 0);
+    }
+
+    free_resources(&resources);
+
+    return result;
+}
+
+
+
+
+//
+// Drawing
+//
+
+static void draw_sprite(Renderer *renderer, Resources *resources, Sprite_Id sprite, v2u P) {
+    draw_sprite(renderer, P, &resources->sprites.atlas, &resources->sprites.spans[sprite]);
+}
+
+
+// [x0, x1[ and [y0, y1[ relative to the sprite
+static void draw_sprite(Renderer *renderer, Resources *resources, Sprite_Id sprite, v2u P, u32 x0, u32 y0, u32 x1, u32 y1) {
+    draw_sprite(renderer, P, &resources->sprites.atlas, &resources->sprites.spans[sprite], x0, y0, x1, y1);
+}
+
@@ -0,0 +1,386 @@
+//
+// Scaler
+//
+// Scales the backbuffer into a bigger (or smaller) buffer, so that presenting it is a plain 1:1 copy and
+// doesn't depend on how well the driver does StretchBlt. Also used by the headless build for frame dumps.
+//
+// Both buffers are 32 bits per pixel and bottom-up like the backbuffer. Nearest scaling copies a row once
+// and then replicates it for every output row that samples the same source row, and when the scale is a
+// whole number it replicates the pixels within the row with SSE2 as well. Bilinear scales every source row
+// horizontally once and blends two of those for each output row, with 8-bit weights.
+//
+
+enum Scale_Mode {
+    Scale_Mode_Fit_Nearest = 0, // As big as fits, keeping the aspect ratio
+    Scale_Mode_Fit_Bilinear,
+    Scale_Mode_Integer,         // The largest whole multiple that fits, every source pixel the same size
+
+    Scale_Mode_Count,
+};
+
+
+enum Scale_Filter {
+    Scale_Filter_Nearest = 0,
+    Scale_Filter_Bilinear,
+};
+
+
+// Where in the output buffer the scaled frame goes
+struct Scale_Rect {
+    u32 x = 0;
+    u32 y = 0;
+    u32 width = 0;
+    u32 height = 0;
+};
+
+
+struct Scaler {
+    Scale_Mode mode = Scale_Mode_Fit_Nearest;
+
+    u32 *columns = nullptr; // Per output column the source column, the left one of the two for bilinear
+    u32  column_capacity = 0;
+    u32 *row = nullptr;     // Bilinear, two source rows scaled to the output's width
+    u32  row_capacity = 0;
+    u16 *weights = nullptr; // Bilinear, per output column 4 x (256 - weight) and 4 x weight, ready for SSE2
+
+    // The borders are only cleared when the frame moves, or it goes to another buffer
+    Scale_Rect previous_rect;
+    u32 *previous_output = nullptr;
+};
+
+
+static void free_scaler(Scaler *scaler) {
+    if (scaler->columns)  free(scaler->columns);
+    if (scaler->row)      free(scaler->row);
+    if (scaler->weights)  free(scaler->weights);
+    *scaler = {};
+}
+
+
+
+
+//
+// Rectangles
+//
+
+// The letterboxed rectangle for the mode, centered in the output
+static Scale_Rect get_scale_rect(Scale_Mode mode, u32 src_w, u32 src_h, u32 dst_w, u32 dst_h) {
+    Scale_Rect result;
+
+    if (src_w == 0 || src_h == 0 || dst_w == 0 || dst_h == 0)  return result;
+
+    u32 factor = min(dst_w / src_w, dst_h / src_h);
+    if (mode == Scale_Mode_Integer && factor >= 1) {
+        result.width  = factor * src_w;
+        result.height = factor * src_h;
+    }
+    else {
+        //
+        // Same as we did for StretchBlt, as wide as the output unless that makes it too tall
+        f32 aspect_ratio = static_cast<f32>(src_w) / static_cast<f32>(src_h);
+        f32 w = static_cast<f32>(dst_w);
+        f32 h = w / aspect_ratio;
+        if (h > static_cast<f32>(dst_h)) {
+            h = static_cast<f32>(dst_h);
+            w = aspect_ratio * h;
+        }
+
+        result.width  = min(static_cast<u32>(w), dst_w);
+        result.height = min(static_cast<u32>(h), dst_h);
+    }
+
+    result.x = (dst_w - result.width)  / 2;
+    result.y = (dst_h - result.height) / 2;
+
+    return result;
+}
+
+
+
+
+//
+// Nearest
+//
+
+// Every pixel of src repeated factor times
+static void replicate_row(u32 *dst, u32 const *src, u32 src_w, u32 factor) {
+    if (factor == 1) {
+        memcpy(dst, src, src_w * sizeof(u32));
+    }
+    else if (factor == 2) {
+        u32 x = 0;
+        for (; x + 4 <= src_w; x += 4) {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + x));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2*x),     _mm_unpacklo_epi32(pixels, pixels));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + 2*x + 4), _mm_unpackhi_epi32(pixels, pixels));
+        }
+        for (; x < src_w; ++x) {
+            dst[2*x] = dst[2*x + 1] = src[x];
+        }
+    }
+    else if (factor >= 4) {
+        // Overlapping stores, the last one ends exactly at the end of the pixel's run
+        for (u32 x = 0; x < src_w; ++x) {
+            __m128i pixel = _mm_set1_epi32(static_cast<int>(src[x]));
+            u32 *run = dst + x*factor;
+            for (u32 offset = 0; offset + 4 < factor; offset += 4) {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(run + offset), pixel);
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(run + factor - 4), pixel);
+        }
+    }
+    else {
+        for (u32 x = 0; x < src_w; ++x) {
+            for (u32 offset = 0; offset < factor; ++offset) {
+                dst[x*factor + offset] = src[x];
+            }
+        }
+    }
+}
+
+
+static void scale_nearest(Scaler *scaler, u32 const *src, u32 src_w, u32 src_h, u32 *dst, u32 dst_pitch, Scale_Rect rect) {
+    u32 factor = rect.width / src_w;
+    b32 is_whole_multiple = factor >= 1 && factor * src_w == rect.width;
+
+    //
+    // Sample the middle of each output pixel
+    if (!is_whole_multiple) {
+        for (u32 x = 0; x < rect.width; ++x) {
+            scaler->columns[x] = static_cast<u32>(((2ull*x + 1) * src_w) / (2ull * rect.width));
+        }
+    }
+
+    u32 previous_src_y = src_h;
+    for (u32 y = 0; y < rect.height; ++y) {
+        u32 src_y = static_cast<u32>(((2ull*y + 1) * src_h) / (2ull * rect.height));
+        u32 *dst_row = dst + (rect.y + y)*dst_pitch + rect.x;
+
+        if (src_y == previous_src_y) {
+            memcpy(dst_row, dst_row - dst_pitch, rect.width * sizeof(u32));
+        }
+        else if (is_whole_multiple) {
+            replicate_row(dst_row, src + src_y*src_w, src_w, factor);
+        }
+        else {
+            u32 const *src_row = src + src_y*src_w;
+            for (u32 x = 0; x < rect.width; ++x) {
+                dst_row[x] = src_row[scaler->columns[x]];
+            }
+        }
+
+        previous_src_y = src_y;
+    }
+}
+
+
+
+
+//
+// Bilinear
+//
+
+// 16.16 position of the middle of output pixel index in the source, clamped to the first and last pixel
+static u32 get_bilinear_position(u32 index, u32 src_size, u32 dst_size) {
+    s64 position = ((2ll*index + 1) * src_size * 65536) / (2ll * dst_size) - 32768;
+    s64 last = static_cast<s64>(src_size - 1) << 16;
+    u32 result = static_cast<u32>(position < 0 ? 0 : position > last ? last : position);
+    return result;
+}
+
+
+// row = a + (b - a)*weight/256, per channel
+static void blend_rows(u32 *row, u32 const *a, u32 const *b, u32 count, u32 weight) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i weight_a = _mm_set1_epi16(static_cast<short>(256 - weight));
+    __m128i weight_b = _mm_set1_epi16(static_cast<short>(weight));
+
+    u32 x = 0;
+    for (; x + 4 <= count; x += 4) {
+        __m128i pa = _mm_loadu_si128(reinterpret_cast<__m128i const *>(a + x));
+        __m128i pb = _mm_loadu_si128(reinterpret_cast<__m128i const *>(b + x));
+        __m128i low  = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pa, zero), weight_a), _mm_mullo_epi16(_mm_unpacklo_epi8(pb, zero), weight_b));
+        __m128i high = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pa, zero), weight_a), _mm_mullo_epi16(_mm_unpackhi_epi8(pb, zero), weight_b));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(row + x), _mm_packus_epi16(_mm_srli_epi16(low, 8), _mm_srli_epi16(high, 8)));
+    }
+    for (; x < count; ++x) {
+        u32 result = 0;
+        for (u32 shift = 0; shift < 32; shift += 8) {
+            u32 channel = ((((a[x] >> shift) & 0xFF) * (256 - weight)) + (((b[x] >> shift) & 0xFF) * weight)) >> 8;
+            result |= channel << shift;
+        }
+        row[x] = result;
+    }
+}
+
+
+// One source row to count pixels, columns and weights as set up by scale_bilinear()
+static void scale_row_bilinear(u32 *dst, u32 const *src, u32 src_w, u32 const *columns, u16 const *weights, u32 count) {
+    __m128i zero = _mm_setzero_si128();
+
+    //
+    // Two output pixels at a time, each with its two neighbours as [left | right] in 16-bit lanes,
+    // weighted and then the halves added together
+    u32 x = 0;
+    for (; x + 2 <= count; x += 2) {
+        u32 a = columns[x];
+        u32 b = columns[x + 1];
+        __m128i pixels = _mm_set_epi32(static_cast<int>(src[min(b + 1, src_w - 1)]), static_cast<int>(src[b]),
+                                       static_cast<int>(src[min(a + 1, src_w - 1)]), static_cast<int>(src[a]));
+        __m128i a_sum = _mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), _mm_loadu_si128(reinterpret_cast<__m128i const *>(weights + 8*x)));
+        __m128i b_sum = _mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), _mm_loadu_si128(reinterpret_cast<__m128i const *>(weights + 8*x + 8)));
+        __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(a_sum, b_sum), _mm_unpackhi_epi64(a_sum, b_sum)), 8);
+        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(sum, zero));
+    }
+    for (; x < count; ++x) {
+        u32 x0 = columns[x];
+        u32 x1 = min(x0 + 1, src_w - 1);
+        u32 weight = weights[8*x + 4];
+        u32 result = 0;
+        for (u32 shift = 0; shift < 32; shift += 8) {
+            u32 channel = ((((src[x0] >> shift) & 0xFF) * (256 - weight)) + (((src[x1] >> shift) & 0xFF) * weight)) >> 8;
+            result |= channel << shift;
+        }
+        dst[x] = result;
+    }
+}
+
+
+// Each source row is scaled horizontally once, into one of two cached rows, and every output row blends
+// the two rows around it
+static void scale_bilinear(Scaler *scaler, u32 const *src, u32 src_w, u32 src_h, u32 *dst, u32 dst_pitch, Scale_Rect rect) {
+    for (u32 x = 0; x < rect.width; ++x) {
+        u32 position = get_bilinear_position(x, src_w, rect.width);
+        u16 weight = static_cast<u16>((position >> 8) & 0xFF);
+        scaler->columns[x] = position >> 16;
+        for (u32 lane = 0; lane < 4; ++lane) {
+            scaler->weights[8*x + lane]     = static_cast<u16>(256 - weight);
+            scaler->weights[8*x + 4 + lane] = weight;
+        }
+    }
+
+    u32 *rows[2] = {scaler->row, scaler->row + rect.width};
+    u32 row_sources[2] = {src_h, src_h}; // The source row in each cached row, none yet
+
+    u32 previous_position = 0xFFFFFFFF;
+    for (u32 y = 0; y < rect.height; ++y) {
+        u32 position = get_bilinear_position(y, src_h, rect.height);
+        u32 *dst_row = dst + (rect.y + y)*dst_pitch + rect.x;
+
+        if ((position >> 8) == (previous_position >> 8)) {
+            memcpy(dst_row, dst_row - dst_pitch, rect.width * sizeof(u32));
+            continue;
+        }
+        previous_position = position;
+
+        //
+        // Make sure the cached rows are src_y0 and src_y1, the step from one output row to the next is usually
+        // at most one source row, so the new top row is often the old bottom row
+        u32 src_y0 = position >> 16;
+        u32 src_y1 = min(src_y0 + 1, src_h - 1);
+        if (row_sources[0] != src_y0) {
+            if (row_sources[1] == src_y0) {
+                u32 *row = rows[0];
+                rows[0] = rows[1];
+                rows[1] = row;
+                row_sources[0] = row_sources[1];
+                row_sources[1] = src_h;
+            }
+            else {
+                scale_row_bilinear(rows[0], src + src_y0*src_w, src_w, scaler->columns, scaler->weights, rect.width);
+                row_sources[0] = src_y0;
+            }
+        }
+        if (row_sources[1] != src_y1) {
+            scale_row_bilinear(rows[1], src + src_y1*src_w, src_w, scaler->columns, scaler->weights, rect.width);
+            row_sources[1] = src_y1;
+        }
+
+        blend_rows(dst_row, rows[0], rows[1], rect.width, (position >> 8) & 0xFF);
+    }
+}
+
+
+
+//
+// Scaling
+//
+
+static b32 reserve_scaler(Scaler *scaler, u32 column_count, u32 row_count) {
+    b32 result = true;
+
+    if (column_count > scaler->column_capacity) {
+        u32 *columns = static_cast<u32 *>(realloc(scaler->columns, column_count * sizeof(u32)));
+        if (columns)  scaler->columns = columns;
+
+        u16 *weights = static_cast<u16 *>(realloc(scaler->weights, column_count * 8 * sizeof(u16)));
+        if (weights)  scaler->weights = weights;
+
+        if (columns && weights) {
+            scaler->column_capacity = column_count;
+        }
+        else {
+            result = false;
+        }
+    }
+
+    if (result && row_count > scaler->row_capacity) {
+        u32 *row = static_cast<u32 *>(realloc(scaler->row, row_count * sizeof(u32)));
+        if (row) {
+            scaler->row = row;
+            scaler->row_capacity = row_count;
+        }
+        else {
+            result = false;
+        }
+    }
+
+    if (!result) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+    }
+
+    return result;
+}
+
+
+// Scales src into rect of dst, dst_pitch is the width of dst in pixels. Leaves the rest of dst as it is.
+static b32 scale_frame(Scaler *scaler, Scale_Filter filter, u32 const *src, u32 src_w, u32 src_h, u32 *dst, u32 dst_pitch, Scale_Rect rect) {
+    b32 result = false;
+
+    if (src_w == 0 || src_h == 0 || rect.width == 0 || rect.height == 0)  return result;
+    if (!reserve_scaler(scaler, rect.width, 2 * rect.width))              return result;
+
+    if (filter == Scale_Filter_Bilinear) {
+        scale_bilinear(scaler, src, src_w, src_h, dst, dst_pitch, rect);
+    }
+    else {
+        scale_nearest(scaler, src, src_w, src_h, dst, dst_pitch, rect);
+    }
+
+    result = true;
+
+    return result;
+}
+
+
+// Scales src to fit dst according to the scaler's mode, with black borders
+static b32 scale_frame(Scaler *scaler, u32 const *src, u32 src_w, u32 src_h, u32 *dst, u32 dst_w, u32 dst_h) {
+    PROFILE_FUNCTION();
+    b32 result = false;
+
+    Scale_Rect rect = get_scale_rect(scaler->mode, src_w, src_h, dst_w, dst_h);
+
+    b32 has_moved = dst != scaler->previous_output ||
+                    rect.x != scaler->previous_rect.x || rect.y != scaler->previous_rect.y ||
+                    rect.width != scaler->previous_rect.width || rect.height != scaler->previous_rect.height;
+    if (has_moved) {
+        memset(dst, 0, static_cast<size_t>(dst_w) * dst_h * sizeof(u32));
+        scaler->previous_output = dst;
+        scaler->previous_rect = rect;
+    }
+
+    Scale_Filter filter = scaler->mode == Scale_Mode_Fit_Bilinear ? Scale_Filter_Bilinear : Scale_Filter_Nearest;
+    result = scale_frame(scaler, filter, src, src_w, src_h, dst, dst_w, rect);
+
+    return result;
+}
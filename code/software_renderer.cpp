@@ -0,0 +1,621 @@
+//
+// Renderer back-end, software
+//
+// Renderer_Software does all the rasterization into a 32-bit backbuffer in memory. The platform specific
+// back-ends (see win32_software_renderer.cpp) derive from it and only create the backbuffer and present it.
+// Renderer_Software_Headless never presents anything, it is used by the tools and benchmarks that run
+// without a window.
+//
+
+#include "renderer_frontend.h"
+
+#include <emmintrin.h>
+
+#define kText_Cache_Run_Count  32
+#define kText_Cache_Max_Length 128 // Longer strings are drawn glyph by glyph, without the cache
+
+
+//
+// A string laid out with a font and tinted with a colour, composited once into premultiplied pixels so that
+// drawing it again is a single blit. See #_Text cache.
+struct Text_Run {
+    Font *font = nullptr;
+    u8 *font_pixels = nullptr; // font->bitmap.data when the run was built, a reloaded font gets new runs
+    u32 colour = 0;
+    u64 hash = 0;
+    u32 length = 0;
+    char text[kText_Cache_Max_Length] = {};
+
+    u32 *pixels = nullptr;     // width * height, premultiplied
+    u32 pixel_capacity = 0;
+    u32 width  = 0;
+    u32 height = 0;
+    s32 offset_x = 0;          // From the pen position to the top left corner of pixels
+    s32 offset_y = 0;
+    u32 advance_x = 0;
+
+    u64 last_used = 0;         // For finding the least recently used run
+};
+
+
+struct Text_Cache {
+    Text_Run runs[kText_Cache_Run_Count];
+    u64 use_count = 0;
+};
+
+
+struct Renderer_Software : public Renderer {
+    //
+    // Methods
+    ~Renderer_Software();
+
+    void clear(v4u8 clear_colour) override;
+
+    void draw_filled_rectangle(v2u P, u32 w, u32 h, v4u8 colour) override;
+    void draw_rectangle_outline(v2u P, u32 w, u32 h, v4u8 colour) override;
+
+    void draw_bitmap(v2u P, Bmp *bitmap) override;
+    void draw_bitmap(v2u P, Bmp *bitmap, u32 x0, u32 y0, u32 x1, u32 y1) override;
+    void draw_coloured_bitmap(v2u P, Bmp *bitmap, u32 x0, u32 y0, u32 x1, u32 y1, v4u8 colour) override;
+    void draw_bitmap_spans(v2u P, Bmp *bitmap, Bitmap_Spans const *spans, u32 x0, u32 y0, u32 x1, u32 y1) override;
+
+    v2u print(Font *font, v2u Po, char const *text, v4u8 colour_v4u8 = v4u8_white) override;
+
+    u32 get_backbuffer_width()  final override {return backbuffer_width;}
+    u32 get_backbuffer_height() final override {return backbuffer_height;}
+
+    v2u print_glyphs(Font *font, v2u Po, char const *text, v4u8 colour_v4u8);
+    void draw_text_run(v2u Po, Text_Run *run);
+
+    //
+    // Members
+    v4u8 *backbuffer_memory = nullptr;
+    u32   backbuffer_width  = 0;
+    u32   backbuffer_height = 0;
+    Log *log = nullptr;
+    Text_Cache text_cache;
+};
+
+
+struct Renderer_Software_Headless : public Renderer_Software {
+    Renderer_Software_Headless() {};
+    ~Renderer_Software_Headless();
+    b32 init(Log *log, u32 width, u32 height) final override;
+
+    void draw_to_screen() final override {}; // Nothing to present, the frame stays in backbuffer_memory
+};
+
+
+
+
+//
+// #_Initialization and destructor
+static void fini_text_cache(Text_Cache *cache);
+static Text_Run *get_text_run(Text_Cache *cache, Font *font, char const *text, u32 length, u32 colour);
+
+Renderer_Software::~Renderer_Software() {
+    fini_text_cache(&this->text_cache);
+}
+
+
+b32 Renderer_Software_Headless::init(Log *_log, u32 width, u32 height) {
+    b32 result = false;
+
+    this->log = _log;
+    this->backbuffer_width = width;
+    this->backbuffer_height = height;
+    this->backbuffer_memory = static_cast<v4u8 *>(calloc(width * height, sizeof(v4u8)));
+    if (this->backbuffer_memory) {
+        result = true;
+    }
+    else {
+        LOG_ERROR(log, "failed to allocate the backbuffer", width * height);
+    }
+
+    return result;
+}
+
+
+Renderer_Software_Headless::~Renderer_Software_Headless() {
+    if (this->backbuffer_memory) {
+        free(this->backbuffer_memory);
+        this->backbuffer_memory = nullptr;
+    }
+}
+
+
+
+
+//
+// #_Rendering
+//
+// Every draw call clips its rectangle to the source and the backbuffer once, and then hands whole rows to a
+// kernel. The blit kernels are templates over the blend (Blend_Copy, Blend_Premul_Over, Blend_Tinted_Over),
+// so the choice of blend is made at compile time rather than per pixel. Fills and clears store 4 pixels at
+// a time.
+//
+
+struct Blit_Rect {
+    u32 src_x;
+    u32 src_y;
+    u32 dst_x;
+    u32 dst_y;
+    u32 width;
+    u32 height;
+};
+
+
+// [x0, x1[ and [y0, y1[ of a bitmap of bitmap_width * bitmap_height drawn at P, returns false if nothing is visible
+static b32 clip_blit(Blit_Rect *rect, v2u P, u32 x0, u32 y0, u32 x1, u32 y1, u32 bitmap_width, u32 bitmap_height, u32 backbuffer_width, u32 backbuffer_height) {
+    b32 result = false;
+
+    x1 = min(x1, bitmap_width);
+    y1 = min(y1, bitmap_height);
+    if (x0 < x1 && y0 < y1 && P.x < backbuffer_width && P.y < backbuffer_height) {
+        rect->src_x  = x0;
+        rect->src_y  = y0;
+        rect->dst_x  = P.x;
+        rect->dst_y  = P.y;
+        rect->width  = min(x1 - x0, backbuffer_width  - P.x);
+        rect->height = min(y1 - y0, backbuffer_height - P.y);
+        result = true;
+    }
+
+    return result;
+}
+
+
+//
+// Blends, dst is the backbuffer pixel and src the bitmap pixel
+struct Blend_Copy {
+    static u32 blend(u32 dst, u32 src, u32 colour) {return src;}
+};
+
+struct Blend_Premul_Over {
+    static u32 blend(u32 dst, u32 src, u32 colour) {return fp_lerp_premul(dst, src);}
+};
+
+struct Blend_Tinted_Over { // The bitmap multiplied by colour, then over the backbuffer
+    static u32 blend(u32 dst, u32 src, u32 colour) {return fp_lerp_premul(dst, fp_mul_non_premul_src(src, colour));}
+};
+
+
+template <typename Blend>
+static void blit_row(u32 *dst, u32 const *src, u32 count, u32 colour) {
+    for (u32 x = 0; x < count; ++x) {
+        dst[x] = Blend::blend(dst[x], src[x], colour);
+    }
+}
+
+template <>
+void blit_row<Blend_Copy>(u32 *dst, u32 const *src, u32 count, u32 colour) {
+    memcpy(dst, src, count * sizeof(u32));
+}
+
+// 4 pixels at a time, as long as they really are premultiplied (no channel above alpha). Then none of the
+// sums in fp_lerp_premul() go above 255 and 16-bit lanes give the same result. Other pixels take the scalar path.
+template <>
+void blit_row<Blend_Premul_Over>(u32 *dst, u32 const *src, u32 count, u32 colour) {
+    __m128i zero = _mm_setzero_si128();
+    __m128i one_plus_max_alpha = _mm_set1_epi32(256);
+
+    u32 x = 0;
+    for (; x + 4 <= count; x += 4) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<__m128i const *>(src + x));
+
+        __m128i alpha = _mm_srli_epi32(s, 24);
+        __m128i alpha_bytes = _mm_or_si128(alpha, _mm_slli_epi32(alpha, 8));
+        alpha_bytes = _mm_or_si128(alpha_bytes, _mm_slli_epi32(alpha_bytes, 16));
+        b32 is_premultiplied = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(s, alpha_bytes), alpha_bytes)) == 0xFFFF;
+
+        if (is_premultiplied) {
+            __m128i d = _mm_loadu_si128(reinterpret_cast<__m128i const *>(dst + x));
+            __m128i scale = _mm_sub_epi32(one_plus_max_alpha, alpha);       // 256 - alpha, per pixel
+            scale = _mm_or_si128(scale, _mm_slli_epi32(scale, 16));        // in both 16-bit halves
+            __m128i low  = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi32(scale, scale)), 8);
+            __m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi32(scale, scale)), 8);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_add_epi8(s, _mm_packus_epi16(low, high)));
+        }
+        else {
+            for (u32 index = x; index < x + 4; ++index) {
+                dst[index] = fp_lerp_premul(dst[index], src[index]);
+            }
+        }
+    }
+    for (; x < count; ++x) {
+        dst[x] = fp_lerp_premul(dst[x], src[x]);
+    }
+}
+
+
+template <typename Blend>
+static void blit(u32 *backbuffer, u32 backbuffer_width, Blit_Rect const *rect, Bmp const *bitmap, u32 colour) {
+    u32 const *src = reinterpret_cast<u32 const *>(bitmap->data) + (rect->src_y * bitmap->header.width) + rect->src_x;
+    u32 *dst = backbuffer + (rect->dst_y * backbuffer_width) + rect->dst_x;
+
+    for (u32 y = 0; y < rect->height; ++y) {
+        blit_row<Blend>(dst, src, rect->width, colour);
+        src += bitmap->header.width;
+        dst += backbuffer_width;
+    }
+}
+
+
+// dst[x] = value
+static void store_row(u32 *dst, u32 count, u32 value) {
+    __m128i values = _mm_set1_epi32(static_cast<int>(value));
+
+    u32 x = 0;
+    for (; x + 4 <= count; x += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), values);
+    }
+    for (; x < count; ++x) {
+        dst[x] = value;
+    }
+}
+
+
+// dst[x] = fp_lerp_non_premul_src(dst[x], colour), bit for bit. The colour's part of the sum is the same for
+// every pixel, and the backbuffer's part is every channel times (256 - alpha) >> 8, which fits 16-bit lanes.
+static void fill_row(u32 *dst, u32 count, u32 colour) {
+    u32 alpha = colour >> 24;
+    u32 src = fp_lerp_non_premul_src(0, colour);
+
+    if (alpha == 0xFF) { // Nothing of dst is left
+        store_row(dst, count, src);
+        return;
+    }
+
+    __m128i zero   = _mm_setzero_si128();
+    __m128i scale  = _mm_set1_epi16(static_cast<short>(256 - alpha));
+    __m128i colour_part = _mm_set1_epi32(static_cast<int>(src));
+
+    u32 x = 0;
+    for (; x + 4 <= count; x += 4) {
+        __m128i pixels = _mm_loadu_si128(reinterpret_cast<__m128i *>(dst + x));
+        __m128i low  = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(pixels, zero), scale), 8);
+        __m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(pixels, zero), scale), 8);
+        pixels = _mm_add_epi8(_mm_packus_epi16(low, high), colour_part); // The sums are at most 255
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), pixels);
+    }
+    for (; x < count; ++x) {
+        dst[x] = fp_lerp_non_premul_src(dst[x], colour);
+    }
+}
+
+
+void Renderer_Software::clear(v4u8 clear_colour) {
+    if (this->backbuffer_memory) {
+        store_row(reinterpret_cast<u32 *>(this->backbuffer_memory), this->backbuffer_width * this->backbuffer_height, clear_colour._u32);
+    }
+}
+
+
+void Renderer_Software::draw_filled_rectangle(v2u P, u32 w, u32 h, v4u8 colour) {
+    if ((colour._u32 >> 24) == 0)  return; // Blending nothing
+    if (P.x >= this->backbuffer_width || P.y >= this->backbuffer_height)  return;
+
+    w = min(w, this->backbuffer_width  - P.x);
+    h = min(h, this->backbuffer_height - P.y);
+
+    u32 *dst = reinterpret_cast<u32 *>(&this->backbuffer_memory[(P.y * this->backbuffer_width) + P.x]);
+    for (u32 y = 0; y < h; ++y) {
+        fill_row(dst, w, colour._u32);
+        dst += this->backbuffer_width;
+    }
+}
+
+
+// The corners are blended twice, once by a row and once by a column
+void Renderer_Software::draw_rectangle_outline(v2u P, u32 w, u32 h, v4u8 colour) {
+    if ((colour._u32 >> 24) == 0 || w == 0 || h == 0)  return;
+    if (P.x >= this->backbuffer_width || P.y >= this->backbuffer_height)  return;
+
+    u32 width = this->backbuffer_width;
+    u32 *pixels = reinterpret_cast<u32 *>(this->backbuffer_memory);
+    u32 right  = P.x + w - 1;
+    u32 bottom = P.y + h - 1;
+    u32 row_width = min(w, width - P.x);
+
+    fill_row(pixels + (P.y * width) + P.x, row_width, colour._u32);
+    if (bottom < this->backbuffer_height) {
+        fill_row(pixels + (bottom * width) + P.x, row_width, colour._u32);
+    }
+
+    u32 stop_y = min(bottom + 1, this->backbuffer_height);
+    for (u32 y = P.y; y < stop_y; ++y) {
+        u32 *dst = pixels + (y * width);
+        dst[P.x] = fp_lerp_non_premul_src(dst[P.x], colour._u32);
+        if (right < width) {
+            dst[right] = fp_lerp_non_premul_src(dst[right], colour._u32);
+        }
+    }
+}
+
+
+// we assume that bitmap is premultiplied with its alpha
+// P location to draw at
+// (x0, y0) starting point in source bitmap
+// (x1, y1) ending point in source bitmap
+//      [x0, ..., x1[  and [y0, ..., y1[  (that is, x1 and y1 is excluded from the range)
+void Renderer_Software::draw_bitmap(v2u P, Bmp *bitmap, u32 x0, u32 y0, u32 x1, u32 y1) {
+    Blit_Rect rect;
+    if (clip_blit(&rect, P, x0, y0, x1, y1, bitmap->header.width, bitmap->header.height, this->backbuffer_width, this->backbuffer_height)) {
+        blit<Blend_Premul_Over>(reinterpret_cast<u32 *>(this->backbuffer_memory), this->backbuffer_width, &rect, bitmap, 0);
+    }
+}
+
+
+// Same result as draw_bitmap() of the rectangle of spans, but only the pixels in spans are touched.
+// Opaque spans are copied, the others are blended.
+//      [x0, ..., x1[  and [y0, ..., y1[  relative to the rectangle of spans
+void Renderer_Software::draw_bitmap_spans(v2u P, Bmp *bitmap, Bitmap_Spans const *spans, u32 x0, u32 y0, u32 x1, u32 y1) {
+    Blit_Rect rect;
+    if (!clip_blit(&rect, P, x0, y0, x1, y1, spans->width, spans->height, this->backbuffer_width, this->backbuffer_height)) {
+        return;
+    }
+    x1 = x0 + rect.width;
+    y1 = y0 + rect.height;
+
+    u32 const *src_pixels = reinterpret_cast<u32 const *>(bitmap->data);
+    u32 *dst_pixels = reinterpret_cast<u32 *>(this->backbuffer_memory);
+
+    for (u32 y = y0; y < y1; ++y) {
+        u32 const *src = src_pixels + ((spans->y + y) * bitmap->header.width) + spans->x;
+        u32 *dst = dst_pixels + ((P.y + (y - y0)) * this->backbuffer_width) + P.x;   // dst[x - x0] is src[x]
+
+        Bitmap_Span const *span = spans->spans + spans->row_starts[y];
+        Bitmap_Span const *end  = spans->spans + spans->row_starts[y + 1];
+        for (; span < end && span->x < x1; ++span) {
+            u32 start = max(static_cast<u32>(span->x), x0);
+            u32 stop  = min(static_cast<u32>(span->x + span->length), x1);
+            if (start >= stop)  continue;
+
+            if (span->type == Bitmap_Span_Type_Opaque) {
+                blit_row<Blend_Copy>(dst + (start - x0), src + start, stop - start, 0);
+            }
+            else {
+                blit_row<Blend_Premul_Over>(dst + (start - x0), src + start, stop - start, 0);
+            }
+        }
+    }
+}
+
+
+// we assume that bitmap is premultiplied with its alpha
+// P location to draw at
+// (x0, y0) starting point in source bitmap
+// (x1, y1) ending point in source bitmap
+//      [x0, ..., x1[  and [y0, ..., y1[  (that is, x1 and y1 is excluded from the range)
+void Renderer_Software::draw_coloured_bitmap(v2u P, Bmp *bitmap, u32 x0, u32 y0, u32 x1, u32 y1, v4u8 colour) {
+    Blit_Rect rect;
+    if (clip_blit(&rect, P, x0, y0, x1, y1, bitmap->header.width, bitmap->header.height, this->backbuffer_width, this->backbuffer_height)) {
+        blit<Blend_Tinted_Over>(reinterpret_cast<u32 *>(this->backbuffer_memory), this->backbuffer_width, &rect, bitmap, colour._u32);
+    }
+}
+
+
+// we assume that bitmap is premultiplied with its alpha
+void Renderer_Software::draw_bitmap(v2u P, Bmp *bitmap) {
+    this->draw_bitmap(P, bitmap, 0, 0, bitmap->header.width, bitmap->header.height);
+}
+
+
+// Draws the glyphs one by one, tinting every pixel of every glyph
+v2u Renderer_Software::print_glyphs(Font *font, v2u Po, char const *text, v4u8 colour_v4u8) {
+    v2u P = Po;    
+    for (char const *ptr = text; *ptr; ++ptr) {        
+        u32 char_index = *ptr - 32;
+        if (char_index < font->char_count) {
+            Char_Data *c = &font->char_data[char_index];
+            u32 bx = c->x;
+            u32 by = font->bitmap.header.height - c->y - c->height;
+            u32 x = P.x + c->offset_x;
+            u32 y = P.y + (font->base - c->offset_y - c->height);
+            this->draw_coloured_bitmap(V2u(x, y), &font->bitmap, bx, by, bx + c->width, by + c->height, colour_v4u8);
+            P.x += c->advance_x;
+        }
+    }
+
+    return P;
+}
+
+
+v2u Renderer_Software::print(Font *font, v2u Po, char const *text, v4u8 colour_v4u8) {
+    PROFILE_FUNCTION();
+
+    v2u result = Po;
+
+    size_t length = strlen(text);
+    if (length >= kText_Cache_Max_Length) {
+        result = this->print_glyphs(font, Po, text, colour_v4u8);
+    }
+    else {
+        Text_Run *run = get_text_run(&this->text_cache, font, text, static_cast<u32>(length), colour_v4u8._u32);
+        if (run) {
+            this->draw_text_run(Po, run);
+            result.x += run->advance_x;
+        }
+        else {
+            result = this->print_glyphs(font, Po, text, colour_v4u8);
+        }
+    }
+
+    return result;
+}
+
+
+
+
+//
+// #_Text cache
+//
+// The score, the banners and the editor captions are the same from one frame to the next, so instead of
+// tinting every glyph pixel each frame print() composites the whole string once into a Text_Run and blits
+// that. Runs are looked up by (font, text, colour), the least recently used run is replaced when the cache
+// is full.
+//
+
+static void fini_text_cache(Text_Cache *cache) {
+    for (u32 index = 0; index < kText_Cache_Run_Count; ++index) {
+        Text_Run *run = &cache->runs[index];
+        if (run->pixels) {
+            free(run->pixels);
+        }
+        *run = {};
+    }
+    cache->use_count = 0;
+}
+
+
+// Lays out the text and composites the tinted glyphs into run->pixels, in the same order as print_glyphs()
+// would draw them.
+static b32 build_text_run(Text_Run *run, Font *font, char const *text, u32 length, u32 colour) {
+    b32 result = false;
+
+    //
+    // Bounds of the run, relative to the pen position
+    s32 min_x = INT32_MAX, min_y = INT32_MAX;
+    s32 max_x = INT32_MIN, max_y = INT32_MIN;
+    u32 pen_x = 0;
+    for (u32 index = 0; index < length; ++index) {
+        u32 char_index = text[index] - 32;
+        if (char_index < font->char_count) {
+            Char_Data *c = &font->char_data[char_index];
+            s32 x = static_cast<s32>(pen_x + c->offset_x);
+            s32 y = static_cast<s32>(font->base - c->offset_y - c->height);
+            min_x = min(min_x, x);
+            min_y = min(min_y, y);
+            max_x = max(max_x, x + static_cast<s32>(c->width));
+            max_y = max(max_y, y + static_cast<s32>(c->height));
+            pen_x += c->advance_x;
+        }
+    }
+
+    u32 width  = min_x < max_x ? static_cast<u32>(max_x - min_x) : 0;
+    u32 height = min_y < max_y ? static_cast<u32>(max_y - min_y) : 0;
+    u32 pixel_count = width * height;
+
+    if (pixel_count > run->pixel_capacity) {
+        void *new_ptr = realloc(run->pixels, pixel_count * sizeof(u32));
+        if (!new_ptr) {
+            printf("%s in %s failed to reallocate memory!\n", __FUNCTION__, __FILE__);
+            return result;
+        }
+        run->pixels = static_cast<u32 *>(new_ptr);
+        run->pixel_capacity = pixel_count;
+    }
+
+    run->font        = font;
+    run->font_pixels = font->bitmap.data;
+    run->colour      = colour;
+    run->length      = length;
+    memcpy(run->text, text, length);
+    run->text[length] = '\0';
+    run->width     = width;
+    run->height    = height;
+    run->offset_x  = width  ? min_x : 0;
+    run->offset_y  = height ? min_y : 0;
+    run->advance_x = pen_x;
+
+    if (pixel_count > 0) {
+        memset(run->pixels, 0, pixel_count * sizeof(u32));
+
+        Bmp *bitmap = &font->bitmap;
+        u32 *bitmap_pixels = reinterpret_cast<u32 *>(bitmap->data);
+
+        pen_x = 0;
+        for (u32 index = 0; index < length; ++index) {
+            u32 char_index = text[index] - 32;
+            if (char_index < font->char_count) {
+                Char_Data *c = &font->char_data[char_index];
+                u32 bx = c->x;
+                u32 by = bitmap->header.height - c->y - c->height;
+                u32 x0 = static_cast<u32>(static_cast<s32>(pen_x + c->offset_x) - run->offset_x);
+                u32 y0 = static_cast<u32>(static_cast<s32>(font->base - c->offset_y - c->height) - run->offset_y);
+
+                u32 stop_y = min(static_cast<u32>(bitmap->header.height), c->height);
+                u32 stop_x = min(static_cast<u32>(bitmap->header.width) , c->width);
+                for (u32 y = 0; y < stop_y; ++y) {
+                    u32 *src = bitmap_pixels + (bitmap->header.width * (by + y)) + bx;
+                    u32 *dst = run->pixels + (width * (y0 + y)) + x0;
+                    for (u32 x = 0; x < stop_x; ++x) {
+                        dst[x] = fp_lerp_premul(dst[x], fp_mul_non_premul_src(src[x], colour));
+                    }
+                }
+
+                pen_x += c->advance_x;
+            }
+        }
+    }
+
+    result = true;
+
+    return result;
+}
+
+
+static Text_Run *get_text_run(Text_Cache *cache, Font *font, char const *text, u32 length, u32 colour) {
+    Text_Run *result = nullptr;
+
+    u64 hash = fnv1a_64(kFNV_Offset_Basis, text, length);
+    Text_Run *least_recently_used = &cache->runs[0];
+
+    for (u32 index = 0; index < kText_Cache_Run_Count; ++index) {
+        Text_Run *run = &cache->runs[index];
+        if (run->hash == hash && run->font == font && run->colour == colour && run->length == length &&
+            run->font_pixels == font->bitmap.data && memcmp(run->text, text, length) == 0) {
+            result = run;
+            break;
+        }
+
+        if (run->last_used < least_recently_used->last_used) {
+            least_recently_used = run;
+        }
+    }
+
+    if (!result) {
+        if (build_text_run(least_recently_used, font, text, length, colour)) {
+            least_recently_used->hash = hash;
+            result = least_recently_used;
+        }
+        else {
+            least_recently_used->last_used = 0;
+            least_recently_used->font = nullptr; // Never matches until it is rebuilt
+        }
+    }
+
+    if (result) {
+        result->last_used = ++cache->use_count;
+    }
+
+    return result;
+}
+
+
+// A single blit of the composited run, clipped to the backbuffer
+void Renderer_Software::draw_text_run(v2u Po, Text_Run *run) {
+    // The positions wrap around like the u32 maths in print_glyphs()
+    s32 left = static_cast<s32>(Po.x) + run->offset_x;
+    s32 top  = static_cast<s32>(Po.y) + run->offset_y;
+
+    s32 start_x = max(0, -left);
+    s32 start_y = max(0, -top);
+    s32 stop_x  = min(static_cast<s32>(run->width),  static_cast<s32>(this->backbuffer_width)  - left);
+    s32 stop_y  = min(static_cast<s32>(run->height), static_cast<s32>(this->backbuffer_height) - top);
+
+    for (s32 y = start_y; y < stop_y; ++y) {
+        u32 *src = run->pixels + (run->width * y);
+        u32 *dst = reinterpret_cast<u32 *>(&this->backbuffer_memory[(this->backbuffer_width * (top + y)) + left]);
+        for (s32 x = start_x; x < stop_x; ++x) {
+            // Blending an empty or a fully covering pixel gives the same result as skipping or copying it
+            u32 alpha = src[x] >> 24;
+            if (alpha == 0xFF) {
+                dst[x] = src[x];
+            }
+            else if (src[x]) {
+                dst[x] = fp_lerp_premul(dst[x], src[x]);
+            }
+        }
+    }
+}
@@ -0,0 +1,461 @@
+//
+// Solutions
+//
+// The fewest inputs that win each level, searched for ahead of time (see solver.cpp) and kept in one file,
+// data\levels\solutions.db, so that the hints and showing the solution don't have to search at all. A
+// solution is for one level as it is; it is found by the level's id and the content hash of its start
+// (see hash_level_content()), a level that has been edited since has none.
+//
+// Along with the inputs is the hash of the state before each of them (the low half of hash_hint_state()),
+// which is how the game knows where on the way to winning the player is. A solution is played out with
+// play_turn() when it is loaded, the first time a level is started, and only used if it still gets to every
+// state it should and wins. The game maps the file when it starts and only checks that the solutions are for
+// the levels it has, it doesn't read one until it is needed.
+//
+// Layout:
+//     Solution_Header
+//     Solution_Entry * entry_count
+//     per entry, at its offset, the inputs (four to a byte, 2 bits each) and then a u32 hash per input, of
+//     the state the input is played from
+//
+// The file is written by `headless -build_solutions` and checked in along with the levels, so the game ships
+// with it. Run it again after changing a level, until then that level's hints are searched for in the
+// background. `headless -verify_solutions` plays every solution in it against the levels on disc.
+//
+
+#define kSolution_Version 1
+#define kSolution_Path_And_Name "data\\levels\\solutions.db"
+
+u32 constexpr kSolution_FourCC = 'NLOS'; // "SOLN"
+
+
+#pragma pack(push, 1)
+struct Solution_Header {
+    u32 fourcc;
+    u32 version;
+    u32 entry_count;
+    u32 header_size;
+};
+
+
+struct Solution_Entry {
+    u32 level_id;
+    u64 content_hash;  // hash_level_content() of the level's original state
+    u32 offset;        // From the start of the file
+    u16 input_count;
+    u16 padding;
+};
+#pragma pack(pop)
+
+
+struct Solution_Db {
+    u8 *data = nullptr;
+    u32 size = 0;
+    HANDLE mapping = nullptr;
+    Solution_Entry const *entries = nullptr;
+    u32 entry_count = 0;
+};
+
+
+// One level's solution, as it is used
+struct Solution {
+    u32 level_id = 0;
+    u64 content_hash = 0;
+    Input inputs[kSolver_Max_Turns];
+    u32 step_hashes[kSolver_Max_Turns]; // Of the state that inputs[n] is played from
+    u32 input_count = 0;
+    b32 is_valid = false;               // Played out and won
+};
+
+
+
+
+//
+// #_File
+//
+
+static u32 get_solution_data_size(u32 input_count) {
+    u32 result = ((input_count + 3) / 4) + (input_count * sizeof(u32));
+    return result;
+}
+
+
+static void close_solution_db(Solution_Db *db) {
+    win32_unmap_file(db->data, db->size, db->mapping);
+    *db = {};
+}
+
+
+// Returns false, without printing anything, if there is no file at path_and_name
+static b32 open_solution_db(Solution_Db *db, char const *path_and_name) {
+    b32 result = false;
+
+    *db = {};
+    if (!win32_map_file(path_and_name, &db->data, &db->size, &db->mapping)) {
+        return result;
+    }
+
+    Solution_Header const *header = reinterpret_cast<Solution_Header const *>(db->data);
+    b32 is_valid = db->size >= sizeof(Solution_Header) && header->fourcc == kSolution_FourCC && header->version == kSolution_Version &&
+                   header->header_size == sizeof(Solution_Header) &&
+                   (db->size - sizeof(Solution_Header)) / sizeof(Solution_Entry) >= header->entry_count;
+
+    if (is_valid) {
+        db->entries = reinterpret_cast<Solution_Entry const *>(db->data + sizeof(Solution_Header));
+        db->entry_count = header->entry_count;
+
+        for (u32 index = 0; index < db->entry_count && is_valid; ++index) {
+            Solution_Entry const *entry = &db->entries[index];
+            is_valid = entry->input_count <= kSolver_Max_Turns && entry->offset <= db->size &&
+                       get_solution_data_size(entry->input_count) <= (db->size - entry->offset);
+        }
+    }
+
+    if (is_valid) {
+        result = true;
+    }
+    else {
+        printf("%s() %s is not a valid solution file, or from another version\n", __FUNCTION__, path_and_name);
+        close_solution_db(db);
+    }
+
+    return result;
+}
+
+
+static Solution_Entry const *find_solution_entry(Solution_Db *db, u32 level_id, u64 content_hash) {
+    Solution_Entry const *result = nullptr;
+
+    for (u32 index = 0; index < db->entry_count; ++index) {
+        Solution_Entry const *entry = &db->entries[index];
+        if (entry->level_id == level_id && entry->content_hash == content_hash) {
+            result = entry;
+            break;
+        }
+    }
+
+    return result;
+}
+
+
+// The number of solutions that are for the levels as they are, the others are for levels that have changed
+static u32 count_current_solutions(Solution_Db *db, Array_Of_Levels *levels) {
+    u32 result = 0;
+
+    for (u32 index = 0; index < levels->count; ++index) {
+        Level *level = &levels->data[index];
+        if (find_solution_entry(db, level->id, hash_level_content(level, &level->original_state)))  ++result;
+    }
+
+    return result;
+}
+
+
+static b32 write_solutions_to_disc(Solution *solutions, u32 solution_count, char const *path_and_name) {
+    b32 result = false;
+
+    HANDLE file_handle;
+    result = win32_open_file_for_writing(path_and_name, &file_handle);
+    if (result) {
+        Solution_Header header = {};
+        header.fourcc      = kSolution_FourCC;
+        header.version     = kSolution_Version;
+        header.entry_count = solution_count;
+        header.header_size = sizeof(Solution_Header);
+
+        DWORD bytes_written;
+        result = WriteFile(file_handle, &header, sizeof(header), &bytes_written, nullptr);
+
+        u32 offset = sizeof(Solution_Header) + (solution_count * sizeof(Solution_Entry));
+        for (u32 index = 0; index < solution_count && result; ++index) {
+            Solution_Entry entry = {};
+            entry.level_id     = solutions[index].level_id;
+            entry.content_hash = solutions[index].content_hash;
+            entry.offset       = offset;
+            entry.input_count  = static_cast<u16>(solutions[index].input_count);
+            result = WriteFile(file_handle, &entry, sizeof(entry), &bytes_written, nullptr);
+            offset += get_solution_data_size(entry.input_count);
+        }
+
+        for (u32 index = 0; index < solution_count && result; ++index) {
+            Solution *solution = &solutions[index];
+            u8 packed_inputs[kSolver_Max_Turns / 4] = {};
+            for (u32 input_index = 0; input_index < solution->input_count; ++input_index) {
+                packed_inputs[input_index / 4] |= static_cast<u8>(solution->inputs[input_index] << (2 * (input_index % 4)));
+            }
+            result = WriteFile(file_handle, packed_inputs, (solution->input_count + 3) / 4, &bytes_written, nullptr);
+            result = result && WriteFile(file_handle, solution->step_hashes, solution->input_count * sizeof(u32), &bytes_written, nullptr);
+        }
+
+        if (!result) {
+            printf("%s() failed to write the solutions to %s\n", __FUNCTION__, path_and_name);
+        }
+
+        CloseHandle(file_handle);
+    }
+
+    return result;
+}
+
+
+
+
+//
+// #_Solutions
+//
+
+static u32 get_solution_step_hash(Level *level, Level_State *state) {
+    u32 result = static_cast<u32>(hash_hint_state(level, state));
+    return result;
+}
+
+
+// Plays the solution from the start of the level, it has to get to the states it says it does and win
+static b32 verify_solution(Level *original_level, Solution *solution) {
+    b32 result = false;
+
+    Level level;
+    Array_Of_Moves moves;
+    Wavs no_wavs; // Never played
+    init_level_as_copy_of_level(&level, original_level, &original_level->original_state);
+    reset_level(&level);
+    create_maps_off_level(&level);
+    init_array_of_moves(&moves);
+
+    result = solution->content_hash == hash_level_content(original_level, &original_level->original_state);
+    for (u32 index = 0; index < solution->input_count && result; ++index) {
+        result = get_solution_step_hash(&level, level.current_state) == solution->step_hashes[index] &&
+                 play_turn(&level, &moves, solution->inputs[index], nullptr, &no_wavs) == Turn_Result_Moved;
+    }
+
+    // The level is won at the start of the next turn
+    result = result && play_turn(&level, &moves, Input_None, nullptr, &no_wavs) == Turn_Result_Won;
+
+    free_array_of_moves(&moves);
+    fini_level(&level);
+
+    return result;
+}
+
+
+// The solution for the level as it starts, from the file. Returns false if there is none, or if it doesn't
+// win the level.
+static b32 load_level_solution(Solution_Db *db, Level *level, Solution *solution) {
+    b32 result = false;
+    solution->is_valid = false;
+    solution->input_count = 0;
+
+    u64 content_hash = hash_level_content(level, &level->original_state);
+    Solution_Entry const *entry = db->data ? find_solution_entry(db, level->id, content_hash) : nullptr;
+    if (entry) {
+        solution->level_id = entry->level_id;
+        solution->content_hash = entry->content_hash;
+        solution->input_count = entry->input_count;
+
+        u8 const *packed_inputs = db->data + entry->offset;
+        u8 const *step_hashes = packed_inputs + ((entry->input_count + 3) / 4);
+        for (u32 index = 0; index < entry->input_count; ++index) {
+            solution->inputs[index] = static_cast<Input>((packed_inputs[index / 4] >> (2 * (index % 4))) & 3);
+        }
+        memcpy(solution->step_hashes, step_hashes, entry->input_count * sizeof(u32));
+
+        solution->is_valid = verify_solution(level, solution);
+        result = solution->is_valid;
+    }
+
+    return result;
+}
+
+
+// Searches for the solution of the level, for writing to the file
+static b32 solve_level_for_solution(Solver *solver, Level *level, Solution *solution) {
+    b32 result = false;
+    solution->is_valid = false;
+    solution->input_count = 0;
+
+    if (!init_solver(solver, level, &level->original_state))  return result;
+
+    Solver_Options options;
+    options.max_turns = kSolver_Max_Turns;
+
+    Solve_Result solve_result;
+    if (solve_level(solver, &options, &solve_result) == Solve_Status_Solved && solve_result.input_count > 0) {
+        solution->level_id = level->id;
+        solution->content_hash = hash_level_content(level, &level->original_state);
+        solution->input_count = solve_result.input_count;
+
+        // The hashes are of the level the way the game has it, not the solver's scratch copy
+        Level copy;
+        Array_Of_Moves moves;
+        Wavs no_wavs; // Never played
+        init_level_as_copy_of_level(&copy, level, &level->original_state);
+        reset_level(&copy);
+        create_maps_off_level(&copy);
+        init_array_of_moves(&moves);
+
+        for (u32 index = 0; index < solve_result.input_count; ++index) {
+            solution->inputs[index] = solve_result.inputs[index];
+            solution->step_hashes[index] = get_solution_step_hash(&copy, copy.current_state);
+            play_turn(&copy, &moves, solve_result.inputs[index], nullptr, &no_wavs);
+        }
+
+        free_array_of_moves(&moves);
+        fini_level(&copy);
+
+        solution->is_valid = verify_solution(level, solution);
+        result = solution->is_valid;
+    }
+
+    return result;
+}
+
+
+// The step of the solution that the level's current state is, or input_count if it is none of them
+static u32 find_solution_step(Solution *solution, Level *level) {
+    u32 result = solution->input_count;
+
+    if (solution->is_valid && level->current_state && solution->level_id == level->id) {
+        u32 step_hash = get_solution_step_hash(level, level->current_state);
+        for (u32 index = 0; index < solution->input_count; ++index) {
+            if (solution->step_hashes[index] == step_hash) {
+                result = index;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+
+// A hint straight from the solution, if the player is on the way it takes. Hint_Status_None otherwise.
+static Hint get_solution_hint(Solution *solution, Level *level) {
+    Hint result;
+
+    u32 step = find_solution_step(solution, level);
+    if (step < solution->input_count) {
+        result.status = Hint_Status_Solved;
+        result.input = solution->inputs[step];
+        result.distance = solution->input_count - step;
+    }
+
+    return result;
+}
+
+
+// The inputs left to win from where the player is on the solution, next to where the hint goes
+static void draw_solution(Renderer *renderer, Font *font, Solution *solution, Level *level) {
+    char text[kSolver_Max_Turns + 16];
+    u32 step = find_solution_step(solution, level);
+
+    if (!solution->is_valid) {
+        _snprintf_s(text, sizeof(text), _TRUNCATE, "No solution");
+    }
+    else if (step >= solution->input_count) {
+        _snprintf_s(text, sizeof(text), _TRUNCATE, "Off the solution, reset");
+    }
+    else {
+        u32 length = static_cast<u32>(_snprintf_s(text, sizeof(text), _TRUNCATE, "Solution: "));
+        for (u32 index = step; index < solution->input_count && length < sizeof(text) - 1; ++index) {
+            text[length++] = get_input_char(solution->inputs[index]);
+        }
+        text[length] = '\0';
+    }
+
+    v2u text_dim = get_text_dim(font, text);
+    v2u Pt = V2u(8, 8 + text_dim.y + 12);
+    renderer->draw_filled_rectangle(Pt - V2u(4, 4), text_dim.x + 8, text_dim.y + 8, v4u8_black);
+    renderer->print(font, Pt, text, v4u8_white);
+}
+
+
+
+
+//
+// #_Headless
+//
+
+// Solves every level on disc and writes the solutions. Returns 0 if all of them were solved.
+static u32 build_solutions_headless(Log *log) {
+    u32 error_code = 0;
+
+    Array_Of_Levels levels;
+    Solver solver;
+    Solution *solutions = nullptr;
+
+    if (load_levels_from_disc(&levels, nullptr) == 0) {
+        LOG_ERROR_STR(log, "failed to load the levels", 0);
+        error_code = 2;
+    }
+    else if ((solutions = static_cast<Solution *>(calloc(levels.count, sizeof(Solution)))) == nullptr) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        error_code = 3;
+    }
+    else {
+        u32 solution_count = 0;
+        for (u32 index = 0; index < levels.count; ++index) {
+            Level *level = &levels.data[index];
+            if (solve_level_for_solution(&solver, level, &solutions[solution_count])) {
+                ++solution_count;
+            }
+            else {
+                LOG_ERROR(log, "found no solution for the level", level->id);
+                error_code = 4;
+            }
+        }
+
+        if (!write_solutions_to_disc(solutions, solution_count, kSolution_Path_And_Name)) {
+            LOG_ERROR_STR(log, "failed to write the solutions", kSolution_Path_And_Name);
+            error_code = 5;
+        }
+        log_u32(log, "Solutions, levels", levels.count);
+        log_u32(log, "Solutions, written", solution_count);
+    }
+
+    if (solutions)  free(solutions);
+    free_solver(&solver);
+    free_array_of_levels(&levels);
+
+    return error_code;
+}
+
+
+// Plays every solution in the file on its level. Returns 0 if every one of them wins its level, and every
+// level has one.
+static u32 verify_solutions_headless(Log *log) {
+    u32 error_code = 0;
+
+    Array_Of_Levels levels;
+    Solution_Db db;
+    Solution solution;
+
+    if (load_levels_from_disc(&levels, nullptr) == 0) {
+        LOG_ERROR_STR(log, "failed to load the levels", 0);
+        error_code = 2;
+    }
+    else if (!open_solution_db(&db, kSolution_Path_And_Name)) {
+        LOG_ERROR_STR(log, "failed to open the solutions", kSolution_Path_And_Name);
+        error_code = 3;
+    }
+    else {
+        u32 verified_count = 0;
+        for (u32 index = 0; index < levels.count; ++index) {
+            Level *level = &levels.data[index];
+            if (load_level_solution(&db, level, &solution)) {
+                ++verified_count;
+            }
+            else {
+                LOG_ERROR(log, "the level has no solution that wins it", level->id);
+                error_code = 4;
+            }
+        }
+        log_u32(log, "Solutions, levels", levels.count);
+        log_u32(log, "Solutions, in the file", db.entry_count);
+        log_u32(log, "Solutions, verified", verified_count);
+    }
+
+    close_solution_db(&db);
+    free_array_of_levels(&levels);
+
+    return error_code;
+}
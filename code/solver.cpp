@@ -0,0 +1,828 @@
+//
+// Solver
+//
+// Searches for the fewest inputs that win a level, i.e. get pacman caught. Every input moves all the ghosts
+// at once and pacman answers with get_pacman_move(), so there are at most four moves from every state and
+// nothing is random. The states are played out on a scratch copy of the level with simulate_turn() and kept
+// packed (see pack_solver_state()), a few bytes per actor and one bit per dot.
+//
+// Two searches, both guided by get_solver_lower_bound():
+// - A* keeps every state it has seen, up to max_nodes, and is the one to use when that fits.
+// - IDA* only keeps the current path (and a fixed size table of the states it has been to), for when it
+//   doesn't. It goes over the same states again for every new bound, so it is slower.
+//
+
+#include <atomic>
+
+#define kSolver_Max_Turns          256
+#define kSolver_Default_Max_Nodes  (1 << 20)
+#define kSolver_IDA_Table_Size     (1 << 16)  // Entries, a power of two
+#define kSolver_Found              0xFFFFFFFF // From ida_star_search(), a solution was found
+#define kSolver_Actor_Dead         0xFFFF     // Tile index of the actors that have died
+
+
+enum Solver_Method {
+    Solver_Method_A_Star = 0,
+    Solver_Method_IDA_Star,
+
+    Solver_Method_Count,
+};
+
+
+enum Solve_Status {
+    Solve_Status_Solved = 0,
+    Solve_Status_Unsolvable,  // Every state that can be reached has been tried
+    Solve_Status_Turn_Limit,  // There might be a solution, but not within max_turns
+    Solve_Status_Node_Limit,  // A* had to keep more than max_nodes states
+    Solve_Status_Time_Limit,
+    Solve_Status_Cancelled,   // From another thread, see Solver_Options::cancel
+
+    Solve_Status_Count,
+};
+
+
+struct Solver_Options {
+    Solver_Method method = Solver_Method_A_Star;
+    u32 max_turns        = 100;
+    u32 max_nodes        = kSolver_Default_Max_Nodes;
+    u32 max_milliseconds = 0;    // 0 for no limit
+    b32 fall_back_to_ida = true; // When A* runs out of nodes
+    std::atomic<b32> const *cancel = nullptr; // The search stops soon after this is set, if there is one
+};
+
+
+struct Solve_Result {
+    Solve_Status status  = Solve_Status_Unsolvable;
+    Solver_Method method = Solver_Method_A_Star; // The search that gave the result
+    Input inputs[kSolver_Max_Turns];
+    u32 input_count = 0;
+
+    u64 nodes_expanded   = 0;
+    u64 states_generated = 0;
+    u64 states_lost      = 0; // Not searched from, see level_state_is_lost()
+    u32 nodes_stored     = 0; // A*
+    u32 iterations       = 0; // IDA*, the number of bounds tried
+    f64 milliseconds     = 0.0;
+};
+
+
+struct Solver_Node {
+    u32 parent;
+    u16 g;        // Turns from the start
+    u8  input;    // That led here from parent
+    u8  flags;    // Solver_Node_Flags
+};
+
+enum Solver_Node_Flags {
+    Solver_Node_Expanded = 1 << 0,
+    Solver_Node_Won      = 1 << 1,
+    Solver_Node_Lost     = 1 << 2, // Only kept by explore_level(), the searches don't keep these
+};
+
+
+struct Solver_IDA_Entry {
+    u64 hash;
+    u16 g;
+    u16 iteration;
+};
+
+
+struct Solver {
+    Level level;            // Scratch, holds one state that simulate_turn() changes in place
+    Array_Of_Moves moves;
+
+    Actor_ID *actor_ids = nullptr; // The ids the actors have in the level, they don't change while searching
+    u32 actor_count = 0;
+    u32 *item_tiles = nullptr;     // The tiles with a dot at the start, the only ones that can have one
+    Item_Type *item_types = nullptr;
+    u32 item_count = 0;
+    u32 state_size = 0;            // Bytes per packed state
+    u8 *root = nullptr;
+
+    // Pacman's moves from the state the last turn was played from, see play_solver_turn()
+    v2s *pacman_moves = nullptr;   // actor_count of them
+    u8 *pacman_moves_state = nullptr;
+    b32 has_pacman_moves = false;
+
+    // A*
+    u8 *states = nullptr;          // node_capacity packed states
+    Solver_Node *nodes = nullptr;
+    u32 node_count = 0;
+    u32 node_capacity = 0;
+    u32 *slots = nullptr;          // Hash table of node index + 1, 0 is empty
+    u32 slot_mask = 0;
+    u64 *open = nullptr;           // Binary heap, see get_open_key()
+    u32 open_count = 0;
+    u32 open_capacity = 0;
+
+    // IDA*
+    u8 *path_states = nullptr;     // (kSolver_Max_Turns + 1) packed states
+    u64 path_hashes[kSolver_Max_Turns + 1];
+    Input path_inputs[kSolver_Max_Turns];
+    Solver_IDA_Entry *ida_table = nullptr;
+
+    s64 deadline = 0;              // In performance counter ticks, 0 for none
+    std::atomic<b32> const *cancel = nullptr;
+    b32 out_of_time = false;       // Or cancelled
+    b32 hit_turn_limit = false;
+};
+
+
+
+
+//
+// Setup
+//
+
+static void free_solver(Solver *solver) {
+    fini_level(&solver->level);
+    free_array_of_moves(&solver->moves);
+
+    if (solver->actor_ids)    free(solver->actor_ids);
+    if (solver->item_tiles)   free(solver->item_tiles);
+    if (solver->item_types)   free(solver->item_types);
+    if (solver->root)         free(solver->root);
+    if (solver->pacman_moves) free(solver->pacman_moves);
+    if (solver->pacman_moves_state)  free(solver->pacman_moves_state);
+    if (solver->states)       free(solver->states);
+    if (solver->nodes)        free(solver->nodes);
+    if (solver->slots)        free(solver->slots);
+    if (solver->open)         free(solver->open);
+    if (solver->path_states)  free(solver->path_states);
+    if (solver->ida_table)    free(solver->ida_table);
+
+    solver->actor_ids = nullptr;
+    solver->item_tiles = nullptr;
+    solver->item_types = nullptr;
+    solver->root = nullptr;
+    solver->pacman_moves = nullptr;
+    solver->pacman_moves_state = nullptr;
+    solver->has_pacman_moves = false;
+    solver->states = nullptr;
+    solver->nodes = nullptr;
+    solver->slots = nullptr;
+    solver->open = nullptr;
+    solver->path_states = nullptr;
+    solver->ida_table = nullptr;
+    solver->actor_count = 0;
+    solver->item_count = 0;
+    solver->state_size = 0;
+    solver->node_count = 0;
+    solver->node_capacity = 0;
+    solver->slot_mask = 0;
+    solver->open_count = 0;
+    solver->open_capacity = 0;
+}
+
+
+static void pack_solver_state(Solver *solver, u8 *packed);
+
+// Sets the solver up to search from state, one of level's states
+static b32 init_solver(Solver *solver, Level *level, Level_State *state) {
+    b32 result = false;
+    free_solver(solver);
+
+    init_level_as_copy_of_level(&solver->level, level, state);
+    reset_level(&solver->level);
+    create_maps_off_level(&solver->level);
+    init_array_of_moves(&solver->moves);
+
+    Level_State *scratch = solver->level.current_state;
+    if (!scratch || !scratch->tiles || solver->level.width * solver->level.height >= kSolver_Actor_Dead) {
+        printf("%s() the level can't be searched\n", __FUNCTION__);
+        return result;
+    }
+
+    solver->actor_count = scratch->actors.count;
+    for (u32 index = 0; index < scratch->tile_count; ++index) {
+        if (scratch->tiles[index].item.type != Item_Type_None)  ++solver->item_count;
+    }
+    solver->state_size = 3 + (2 * solver->actor_count) + ((solver->item_count + 7) / 8);
+
+    solver->actor_ids   = static_cast<Actor_ID *>(malloc((solver->actor_count + 1) * sizeof(Actor_ID)));
+    solver->item_tiles  = static_cast<u32 *>(malloc((solver->item_count + 1) * sizeof(u32)));
+    solver->item_types  = static_cast<Item_Type *>(malloc((solver->item_count + 1) * sizeof(Item_Type)));
+    solver->root        = static_cast<u8 *>(malloc(solver->state_size));
+    solver->path_states = static_cast<u8 *>(malloc((kSolver_Max_Turns + 1) * solver->state_size));
+    solver->pacman_moves       = static_cast<v2s *>(malloc((solver->actor_count + 1) * sizeof(v2s)));
+    solver->pacman_moves_state = static_cast<u8 *>(malloc(solver->state_size));
+    if (!solver->actor_ids || !solver->item_tiles || !solver->item_types || !solver->root || !solver->path_states ||
+        !solver->pacman_moves || !solver->pacman_moves_state) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        return result;
+    }
+
+    for (u32 index = 0; index < solver->actor_count; ++index) {
+        solver->actor_ids[index] = scratch->actors.data[index].id;
+    }
+
+    u32 item_index = 0;
+    for (u32 index = 0; index < scratch->tile_count; ++index) {
+        if (scratch->tiles[index].item.type != Item_Type_None) {
+            solver->item_tiles[item_index] = index;
+            solver->item_types[item_index] = scratch->tiles[index].item.type;
+            ++item_index;
+        }
+    }
+
+    pack_solver_state(solver, solver->root);
+    result = true;
+
+    return result;
+}
+
+
+
+
+//
+// States
+//
+
+// The scratch level's state, packed:
+//     u16 mode_duration
+//     u8  pacman's mode, the ghosts always have the other one (see change_pacman_mode())
+//     per actor, u16 tile index (kSolver_Actor_Dead when dead)
+//     one bit per item tile, set while it still has its dot
+// The score isn't part of it, it doesn't change how the level plays out, and neither are the ids or where
+// the dead actors died. So two states only pack differently if they can play out differently.
+//
+// NOTE: The live actors are packed in the order of their slots, not sorted. Swapping two ghosts of the same
+// type doesn't give the same state, resolve_all_moves() settles the collisions in slot order and a ghost
+// can be stopped by one of them and not the other. Mirrored states aren't the same either, pacman breaks
+// ties between directions in a fixed order (see get_pacman_move()).
+static void pack_solver_state(Solver *solver, u8 *packed) {
+    Level_State *state = solver->level.current_state;
+    memset(packed, 0, solver->state_size);
+
+    packed[0] = static_cast<u8>(state->mode_duration & 0xFF);
+    packed[1] = static_cast<u8>(state->mode_duration >> 8);
+
+    Actor *pacman = get_pacman(&solver->level);
+    packed[2] = static_cast<u8>(pacman ? pacman->mode : Actor_Mode_Prey);
+
+    u8 *at = packed + 3;
+    for (u32 index = 0; index < solver->actor_count; ++index) {
+        Actor *actor = &state->actors.data[index];
+        u32 tile_index = kSolver_Actor_Dead;
+        if (actor_is_alive(actor)) {
+            tile_index = (actor->position.y * solver->level.width) + actor->position.x;
+        }
+        at[0] = static_cast<u8>(tile_index & 0xFF);
+        at[1] = static_cast<u8>(tile_index >> 8);
+        at += 2;
+    }
+
+    for (u32 index = 0; index < solver->item_count; ++index) {
+        if (state->tiles[solver->item_tiles[index]].item.type != Item_Type_None) {
+            at[index / 8] |= static_cast<u8>(1 << (index % 8));
+        }
+    }
+}
+
+
+// Makes packed the scratch level's current state
+static void unpack_solver_state(Solver *solver, u8 const *packed) {
+    Level *level = &solver->level;
+    Level_State *state = level->current_state;
+    Array_Of_Actors *actors = &state->actors;
+
+    //
+    // Every tile that names an actor is where that actor is (or where it died)
+    for (u32 index = 0; index < actors->capacity; ++index) {
+        Actor *actor = &actors->data[index];
+        Tile *tile = get_tile_at(level, actor->position);
+        if (tile)  tile->actor_id = kActor_ID_Null;
+    }
+
+    state->mode_duration   = static_cast<u16>(packed[0] | (packed[1] << 8));
+    state->ghost_count     = 0;
+    state->pacman_count    = 0;
+    state->small_dot_count = 0;
+    state->large_dot_count = 0;
+
+    actors->count  = static_cast<u16>(solver->actor_count);
+    actors->active = 0;
+
+    Actor_Mode pacman_mode = static_cast<Actor_Mode>(packed[2]);
+    Actor_Mode ghost_mode = static_cast<Actor_Mode>(!static_cast<b32>(pacman_mode));
+
+    u8 const *at = packed + 3;
+    for (u32 index = 0; index < solver->actor_count; ++index) {
+        Actor *actor = &actors->data[index];
+        u32 tile_index = at[0] | (at[1] << 8);
+
+        actor->id   = solver->actor_ids[index];
+        actor->mode = actor->type == Actor_Type_Pacman ? pacman_mode : ghost_mode;
+
+        if (tile_index == kSolver_Actor_Dead) {
+            actor->state = Actor_State_Dead;
+        }
+        else {
+            actor->state = Actor_State_Idle;
+            actor->position = V2u(tile_index % level->width, tile_index / level->width);
+            state->tiles[tile_index].actor_id = actor->id;
+            ++actors->active;
+
+            if (actor_is_ghost(actor))  ++state->ghost_count;
+            else                        ++state->pacman_count;
+        }
+
+        actor->pending_state = actor->state;
+        actor->next_position = actor->position;
+        at += 2;
+    }
+
+    for (u32 index = 0; index < solver->item_count; ++index) {
+        Tile *tile = &state->tiles[solver->item_tiles[index]];
+        if (at[index / 8] & (1 << (index % 8))) {
+            tile->item.type = solver->item_types[index];
+            if (tile->item.type == Item_Type_Dot_Small)  ++state->small_dot_count;
+            else                                         ++state->large_dot_count;
+        }
+        else {
+            tile->item.type = Item_Type_None;
+        }
+    }
+
+    create_maps_off_level(level);
+}
+
+
+// Plays input from the packed state, which must still be in play. The scratch level and next are then the
+// state it leads to. Returns Turn_Result_Won if the turn ended the level, or _Lost if it did or if it can't
+// be won from there anymore, those aren't worth searching.
+//
+// The searches play all four inputs from a state one after the other, and pacman's moves are the same for
+// all of them (see get_all_pacman_moves()), so they are kept for the state and only worked out again when
+// the turn is played from another one. That is most of the map queries of a turn.
+static Turn_Result play_solver_turn(Solver *solver, u8 const *packed, Input input, u8 *next) {
+    unpack_solver_state(solver, packed);
+
+    if (!solver->has_pacman_moves || memcmp(solver->pacman_moves_state, packed, solver->state_size) != 0) {
+        get_all_pacman_moves(&solver->level, solver->pacman_moves);
+        memcpy(solver->pacman_moves_state, packed, solver->state_size);
+        solver->has_pacman_moves = true;
+    }
+
+    Turn_Result result = simulate_turn(&solver->level, &solver->moves, input, solver->pacman_moves);
+    if (result == Turn_Result_Moved) {
+        Level_State *state = solver->level.current_state;
+        if      (state->pacman_count == 0)                       result = Turn_Result_Won;
+        else if (level_state_is_lost(&solver->level, state))  result = Turn_Result_Lost;
+
+        pack_solver_state(solver, next);
+    }
+
+    return result;
+}
+
+
+// Never more than the number of turns it takes to win from the scratch level's state. Pacman is caught by
+// a ghost moving onto his tile, or both of them moving onto the same tile, so they must first be within two
+// tiles of each other; they close in by at most two a turn. And the ghosts can't catch him at all while
+// he is the predator.
+static u32 get_solver_lower_bound(Solver *solver) {
+    u32 result = 0;
+    Level *level = &solver->level;
+    Level_State *state = level->current_state;
+
+    Actor *pacman = get_pacman(level);
+    if (state->pacman_count > 0 && pacman) {
+        u32 tile_index = (pacman->position.y * level->width) + pacman->position.x;
+        s32 distance = 0;
+        get_map_values(level, Map_Ghosts, &tile_index, 1, &distance);
+
+        result = static_cast<u32>(max(1, (distance + 1) / 2));
+        if (pacman->mode == Actor_Mode_Predator) {
+            result = max(result, static_cast<u32>(state->mode_duration) + 1);
+        }
+    }
+
+    return result;
+}
+
+
+static u64 hash_solver_state(Solver *solver, u8 const *packed) {
+    u64 result = fnv1a_64(kFNV_Offset_Basis, packed, solver->state_size);
+    return result;
+}
+
+
+static b32 solver_is_out_of_time(Solver *solver) {
+    if (solver->deadline != 0 && !solver->out_of_time) {
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+        solver->out_of_time = now.QuadPart >= solver->deadline;
+    }
+    if (solver->cancel && !solver->out_of_time) {
+        solver->out_of_time = solver->cancel->load(std::memory_order_relaxed);
+    }
+
+    return solver->out_of_time;
+}
+
+
+
+
+//
+// A*
+//
+
+// Sorts the open list by f, then by the highest g (closest to a solution) and then by node index
+static u64 get_open_key(u32 f, u32 g, u32 node_index) {
+    u64 result = (static_cast<u64>(f) << 48) | (static_cast<u64>(0xFFFF - g) << 32) | node_index;
+    return result;
+}
+
+
+static b32 push_open(Solver *solver, u64 key) {
+    if (solver->open_count == solver->open_capacity) {
+        u32 new_capacity = solver->open_capacity == 0 ? 1024 : 2 * solver->open_capacity;
+        void *new_ptr = realloc(solver->open, new_capacity * sizeof(u64));
+        if (!new_ptr) {
+            printf("%s in %s failed to reallocate memory!\n", __FUNCTION__, __FILE__);
+            return false;
+        }
+        solver->open = static_cast<u64 *>(new_ptr);
+        solver->open_capacity = new_capacity;
+    }
+
+    u32 position = solver->open_count++;
+    while (position > 0) {
+        u32 parent = (position - 1) / 2;
+        if (solver->open[parent] <= key)  break;
+        solver->open[position] = solver->open[parent];
+        position = parent;
+    }
+    solver->open[position] = key;
+
+    return true;
+}
+
+
+static u64 pop_open(Solver *solver) {
+    u64 result = solver->open[0];
+    u64 last = solver->open[--solver->open_count];
+
+    u32 position = 0;
+    for (;;) {
+        u32 child = (2 * position) + 1;
+        if (child >= solver->open_count)  break;
+        if (child + 1 < solver->open_count && solver->open[child + 1] < solver->open[child])  ++child;
+        if (last <= solver->open[child])  break;
+        solver->open[position] = solver->open[child];
+        position = child;
+    }
+    if (solver->open_count > 0)  solver->open[position] = last;
+
+    return result;
+}
+
+
+// Returns the node with the packed state, or node_count if there is none. slot is where it is or would go.
+static u32 find_node(Solver *solver, u8 const *packed, u64 hash, u32 *slot) {
+    u32 result = solver->node_count;
+    u32 index = static_cast<u32>(hash) & solver->slot_mask;
+
+    while (solver->slots[index] != 0) {
+        u32 node_index = solver->slots[index] - 1;
+        if (memcmp(&solver->states[node_index * solver->state_size], packed, solver->state_size) == 0) {
+            result = node_index;
+            break;
+        }
+        index = (index + 1) & solver->slot_mask;
+    }
+    *slot = index;
+
+    return result;
+}
+
+
+// Room for twice as many nodes, up to max_nodes
+static b32 grow_nodes(Solver *solver, u32 max_nodes) {
+    b32 result = false;
+    if (solver->node_capacity >= max_nodes)  return result;
+
+    u32 new_capacity = solver->node_capacity == 0 ? 4096 : 2 * solver->node_capacity;
+    if (new_capacity > max_nodes)  new_capacity = max_nodes;
+
+    u32 slot_count = 1;
+    while (slot_count < 2 * new_capacity) {
+        slot_count *= 2;
+    }
+
+    void *new_states = realloc(solver->states, static_cast<size_t>(new_capacity) * solver->state_size);
+    if (new_states)  solver->states = static_cast<u8 *>(new_states);
+    void *new_nodes = realloc(solver->nodes, new_capacity * sizeof(Solver_Node));
+    if (new_nodes)  solver->nodes = static_cast<Solver_Node *>(new_nodes);
+    u32 *new_slots = static_cast<u32 *>(calloc(slot_count, sizeof(u32)));
+
+    if (!new_states || !new_nodes || !new_slots) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        if (new_slots)  free(new_slots);
+        return result;
+    }
+
+    if (solver->slots)  free(solver->slots);
+    solver->slots = new_slots;
+    solver->slot_mask = slot_count - 1;
+    solver->node_capacity = new_capacity;
+
+    for (u32 node_index = 0; node_index < solver->node_count; ++node_index) {
+        u8 const *packed = &solver->states[node_index * solver->state_size];
+        u32 slot;
+        find_node(solver, packed, hash_solver_state(solver, packed), &slot);
+        solver->slots[slot] = node_index + 1;
+    }
+    result = true;
+
+    return result;
+}
+
+
+// Adds the state in the scratch level, packed in packed, if it is new or now reached in fewer turns
+static b32 add_a_star_node(Solver *solver, Solver_Options const *options, u8 const *packed, u32 parent, u32 g, Input input, b32 won) {
+    if (!solver->slots && !grow_nodes(solver, options->max_nodes))  return false;
+
+    u64 hash = hash_solver_state(solver, packed);
+    u32 slot;
+    u32 node_index = find_node(solver, packed, hash, &slot);
+
+    if (node_index < solver->node_count) {
+        Solver_Node *node = &solver->nodes[node_index];
+        if ((node->flags & Solver_Node_Expanded) || node->g <= g)  return true;
+    }
+    else {
+        if (solver->node_count == solver->node_capacity) {
+            if (!grow_nodes(solver, options->max_nodes))  return false;
+            find_node(solver, packed, hash, &slot);
+        }
+
+        node_index = solver->node_count++;
+        memcpy(&solver->states[node_index * solver->state_size], packed, solver->state_size);
+        solver->slots[slot] = node_index + 1;
+        solver->nodes[node_index].flags = 0;
+    }
+
+    Solver_Node *node = &solver->nodes[node_index];
+    node->parent = parent;
+    node->g      = static_cast<u16>(g);
+    node->input  = static_cast<u8>(input);
+    if (won)  node->flags |= Solver_Node_Won;
+
+    u32 h = won ? 0 : get_solver_lower_bound(solver);
+    b32 result = push_open(solver, get_open_key(g + h, g, node_index));
+
+    return result;
+}
+
+
+static Solve_Status solve_a_star(Solver *solver, Solver_Options const *options, Solve_Result *result) {
+    Solve_Status status = Solve_Status_Unsolvable;
+
+    solver->node_count = 0;
+    solver->open_count = 0;
+    if (solver->slots)  memset(solver->slots, 0, (solver->slot_mask + 1) * sizeof(u32));
+
+    unpack_solver_state(solver, solver->root);
+    if (!add_a_star_node(solver, options, solver->root, 0, 0, Input_None, false)) {
+        return Solve_Status_Node_Limit;
+    }
+
+    u8 *next = solver->path_states; // Scratch, IDA* isn't running
+    while (solver->open_count > 0) {
+        u64 key = pop_open(solver);
+        u32 node_index = static_cast<u32>(key & 0xFFFFFFFF);
+        u32 g = 0xFFFF - static_cast<u32>((key >> 32) & 0xFFFF);
+        Solver_Node *node = &solver->nodes[node_index];
+        if ((node->flags & Solver_Node_Expanded) || node->g != g)  continue; // Reached in fewer turns since
+
+        if (node->flags & Solver_Node_Won) {
+            u32 count = node->g;
+            result->input_count = count;
+            for (u32 index = node_index; index != 0; index = solver->nodes[index].parent) {
+                result->inputs[--count] = static_cast<Input>(solver->nodes[index].input);
+            }
+            status = Solve_Status_Solved;
+            break;
+        }
+
+        node->flags |= Solver_Node_Expanded;
+        ++result->nodes_expanded;
+        if ((result->nodes_expanded & 0xFF) == 0 && solver_is_out_of_time(solver)) {
+            status = Solve_Status_Time_Limit;
+            break;
+        }
+
+        if (g + 1 > options->max_turns) {
+            solver->hit_turn_limit = true;
+            continue;
+        }
+
+        for (u32 input = Input_Right; input <= static_cast<u32>(Input_Down); ++input) {
+            u8 const *packed = &solver->states[node_index * solver->state_size];
+            Turn_Result turn_result = play_solver_turn(solver, packed, static_cast<Input>(input), next);
+            if (turn_result == Turn_Result_Lost)  ++result->states_lost;
+            if (turn_result != Turn_Result_Moved && turn_result != Turn_Result_Won)  continue;
+
+            ++result->states_generated;
+            if (!add_a_star_node(solver, options, next, node_index, g + 1, static_cast<Input>(input), turn_result == Turn_Result_Won)) {
+                status = Solve_Status_Node_Limit;
+                break;
+            }
+        }
+        if (status == Solve_Status_Node_Limit)  break;
+    }
+
+    if (status == Solve_Status_Unsolvable && solver->hit_turn_limit)  status = Solve_Status_Turn_Limit;
+    result->nodes_stored = solver->node_count;
+
+    return status;
+}
+
+
+
+
+//
+// IDA*
+//
+
+// Depth first from path_states[depth], with g = depth, cutting off where g + h goes above threshold. Returns
+// kSolver_Found, or the lowest g + h that was cut off (0xFFFF if there was none) so that the next
+// iteration knows where to start.
+static u32 ida_star_search(Solver *solver, Solver_Options const *options, Solve_Result *result, u32 depth, u32 threshold, u16 iteration) {
+    u32 next_threshold = 0xFFFF;
+
+    ++result->nodes_expanded;
+    if ((result->nodes_expanded & 0xFF) == 0 && solver_is_out_of_time(solver))  return next_threshold;
+
+    u8 const *packed = &solver->path_states[depth * solver->state_size];
+    u8 *next = &solver->path_states[(depth + 1) * solver->state_size];
+
+    for (u32 input = Input_Right; input <= static_cast<u32>(Input_Down) && !solver->out_of_time; ++input) {
+        Turn_Result turn_result = play_solver_turn(solver, packed, static_cast<Input>(input), next);
+        if (turn_result == Turn_Result_Lost)  ++result->states_lost;
+        if (turn_result != Turn_Result_Moved && turn_result != Turn_Result_Won)  continue;
+        ++result->states_generated;
+
+        solver->path_inputs[depth] = static_cast<Input>(input);
+        if (turn_result == Turn_Result_Won) {
+            result->input_count = depth + 1;
+            return kSolver_Found;
+        }
+
+        u32 g = depth + 1;
+        u32 f = g + get_solver_lower_bound(solver);
+        if (f > options->max_turns) {
+            solver->hit_turn_limit = true;
+            continue;
+        }
+        if (f > threshold) {
+            next_threshold = min(next_threshold, f);
+            continue;
+        }
+
+        //
+        // Not if it is already on the path, or was reached in as few turns earlier in this iteration
+        u64 hash = hash_solver_state(solver, next);
+        b32 is_on_path = false;
+        for (u32 index = 0; index <= depth && !is_on_path; ++index) {
+            is_on_path = solver->path_hashes[index] == hash &&
+                         memcmp(&solver->path_states[index * solver->state_size], next, solver->state_size) == 0;
+        }
+        if (is_on_path)  continue;
+
+        Solver_IDA_Entry *entry = &solver->ida_table[hash & (kSolver_IDA_Table_Size - 1)];
+        if (entry->iteration == iteration && entry->hash == hash && entry->g <= g)  continue;
+        entry->hash = hash;
+        entry->g = static_cast<u16>(g);
+        entry->iteration = iteration;
+
+        solver->path_hashes[g] = hash;
+        u32 search_result = ida_star_search(solver, options, result, g, threshold, iteration);
+        if (search_result == kSolver_Found)  return kSolver_Found;
+        next_threshold = min(next_threshold, search_result);
+    }
+
+    return next_threshold;
+}
+
+
+static Solve_Status solve_ida_star(Solver *solver, Solver_Options const *options, Solve_Result *result) {
+    Solve_Status status = Solve_Status_Unsolvable;
+
+    if (!solver->ida_table) {
+        solver->ida_table = static_cast<Solver_IDA_Entry *>(malloc(kSolver_IDA_Table_Size * sizeof(Solver_IDA_Entry)));
+        if (!solver->ida_table) {
+            printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+            return Solve_Status_Node_Limit;
+        }
+    }
+    memset(solver->ida_table, 0, kSolver_IDA_Table_Size * sizeof(Solver_IDA_Entry));
+
+    memcpy(solver->path_states, solver->root, solver->state_size);
+    solver->path_hashes[0] = hash_solver_state(solver, solver->root);
+    unpack_solver_state(solver, solver->root);
+    u32 threshold = get_solver_lower_bound(solver);
+
+    u16 iteration = 0;
+    while (threshold <= options->max_turns) {
+        ++iteration;
+        ++result->iterations;
+
+        u32 search_result = ida_star_search(solver, options, result, 0, threshold, iteration);
+        if (solver->out_of_time) {
+            status = Solve_Status_Time_Limit;
+            break;
+        }
+        if (search_result == kSolver_Found) {
+            for (u32 index = 0; index < result->input_count; ++index) {
+                result->inputs[index] = solver->path_inputs[index];
+            }
+            status = Solve_Status_Solved;
+            break;
+        }
+        if (search_result == 0xFFFF) {
+            status = solver->hit_turn_limit ? Solve_Status_Turn_Limit : Solve_Status_Unsolvable;
+            break;
+        }
+        threshold = search_result;
+    }
+
+    if (threshold > options->max_turns)  status = Solve_Status_Turn_Limit;
+
+    return status;
+}
+
+
+
+
+//
+// Solving
+//
+
+// Searches for the shortest win from the solver's state. The inputs of the solution are in result->inputs.
+static Solve_Status solve_level(Solver *solver, Solver_Options const *options, Solve_Result *result) {
+    PROFILE_FUNCTION();
+    *result = {};
+
+    Solver_Options clamped = *options;
+    clamped.max_turns = min(clamped.max_turns, static_cast<u32>(kSolver_Max_Turns));
+
+    LARGE_INTEGER frequency;
+    LARGE_INTEGER start;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&start);
+    solver->deadline = 0;
+    if (clamped.max_milliseconds > 0) {
+        solver->deadline = start.QuadPart + ((static_cast<s64>(clamped.max_milliseconds) * frequency.QuadPart) / 1000);
+    }
+    solver->cancel = clamped.cancel;
+    solver->out_of_time = false;
+    solver->hit_turn_limit = false;
+
+    result->method = clamped.method;
+    unpack_solver_state(solver, solver->root);
+    Level_State *state = solver->level.current_state;
+
+    if (state->pacman_count == 0) {
+        result->status = Solve_Status_Solved;
+    }
+    else if (level_state_is_lost(&solver->level, state)) {
+        result->status = Solve_Status_Unsolvable;
+    }
+    else if (clamped.method == Solver_Method_A_Star) {
+        result->status = solve_a_star(solver, &clamped, result);
+        if (result->status == Solve_Status_Node_Limit && clamped.fall_back_to_ida) {
+            result->method = Solver_Method_IDA_Star;
+            solver->hit_turn_limit = false;
+            result->status = solve_ida_star(solver, &clamped, result);
+        }
+    }
+    else {
+        result->status = solve_ida_star(solver, &clamped, result);
+    }
+    if (result->status == Solve_Status_Time_Limit && clamped.cancel && clamped.cancel->load(std::memory_order_relaxed)) {
+        result->status = Solve_Status_Cancelled;
+    }
+
+    LARGE_INTEGER end;
+    QueryPerformanceCounter(&end);
+    result->milliseconds = (1000.0 * static_cast<f64>(end.QuadPart - start.QuadPart)) / static_cast<f64>(frequency.QuadPart);
+
+    return result->status;
+}
+
+
+static char const *get_solve_status_name(Solve_Status status) {
+    char const *names[Solve_Status_Count] = {"solved", "unsolvable", "turn limit", "node limit", "time limit", "cancelled"};
+    char const *result = status < Solve_Status_Count ? names[status] : "unknown";
+    return result;
+}
+
+
+static char get_input_char(Input input) {
+    char const chars[] = {'R', 'U', 'L', 'D'};
+    char result = input <= Input_Down ? chars[input] : '?';
+    return result;
+}
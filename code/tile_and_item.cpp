@@ -104,10 +104,10 @@ void draw_tile(Renderer *renderer, Resources *resources, Tile *tile, v2u P) {
             u32 cell_size = 64; // TODO: handle different cell size
             u32 x = cell_size * (wall_id % 4);
             u32 y = cell_size * static_cast<u32>(floorf(static_cast<f32>(wall_id) / 4.0f));
-            renderer->draw_bitmap(P, &resources->bitmaps.wall_atlas, x, y, x + 64, y + 64);
+            draw_sprite(renderer, resources, Sprite_Wall_Atlas, P, x, y, x + 64, y + 64);
         }
         else if (tile->type == Tile_Type_None) {
-            renderer->draw_bitmap(P, &resources->bitmaps.background);
+            draw_sprite(renderer, resources, Sprite_Background, P);
         }
     }
 }
@@ -115,10 +115,10 @@ void draw_tile(Renderer *renderer, Resources *resources, Tile *tile, v2u P) {
 void draw_item(Renderer *renderer, Resources *resources, Tile *tile, v2u P) {
     if (tile) {
         if (tile->item.type == Item_Type_Dot_Small) {
-            renderer->draw_bitmap(P, &resources->bitmaps.dot_small);
+            draw_sprite(renderer, resources, Sprite_Dot_Small, P);
         }
         else if (tile->item.type == Item_Type_Dot_Large) {
-            renderer->draw_bitmap(P, &resources->bitmaps.dot_large);
+            draw_sprite(renderer, resources, Sprite_Dot_Large, P);
         }
     }
 }
@@ -108,7 +108,7 @@ b32 char_is_letter(char c) {
 
 
 b32 is_eof(Tokenizer *tokenizer) {
-    b32 result = tokenizer->current_position > (tokenizer->size - 1);
+    b32 result = tokenizer->current_position >= tokenizer->size;
     return result;
 }
 
@@ -138,9 +138,12 @@ void reload(Tokenizer *tokenizer) {
     if (!tokenizer->error && !is_eof(tokenizer)) {
         tokenizer->curr_char = tokenizer->data[tokenizer->current_position];
 
-        if (tokenizer->current_position < (tokenizer->size - 2)) {
+        if ((tokenizer->current_position + 1) < tokenizer->size) {
             tokenizer->next_char = tokenizer->data[tokenizer->current_position + 1];
         }
+        else {
+            tokenizer->next_char = '\0'; // Files that don't end with a newline would otherwise keep a stale next_char
+        }
     }
 }
 
@@ -256,7 +259,9 @@ Token get_token(Tokenizer *tokenizer) {
                             result.data[index++] = tokenizer->curr_char;
                         }
 
-                        if (!char_is_space_or_newline(tokenizer->next_char) && tokenizer->next_char != ',' && tokenizer->next_char != ':') {
+                        // A number can end the file, like the last id of a level set
+                        if (!char_is_space_or_newline(tokenizer->next_char) && tokenizer->next_char != ',' && tokenizer->next_char != ':' &&
+                            !at_last_position(tokenizer)) {
                             _snprintf_s(tokenizer->error_string, kTokenizer_Error_String_Max_Length, _TRUNCATE,
                                       "In %s at %u:%u, found an invalid char while tokenizing a number",
                                       tokenizer->path_and_name, tokenizer->line_number, tokenizer->line_position);
@@ -328,6 +333,12 @@ b32 require_token(Tokenizer *tokenizer, Token *token, Token_type token_type) {
             result = true;
         }
     }
+    else if (!tokenizer->error) {
+        _snprintf_s(tokenizer->error_string, kTokenizer_Error_String_Max_Length, _TRUNCATE,
+                  "In %s, expected '%s' but the file ended", tokenizer->path_and_name, Token_type_str[token_type]);
+        token->type = Token_error;
+        tokenizer->error = true;
+    }
 
     return result;
 }
@@ -365,6 +376,12 @@ b32 require_identifier_with_exact_name(Tokenizer *tokenizer, Token *token, char
             tokenizer->error = true;
         }
     }
+    else if (!tokenizer->error) {
+        _snprintf_s(tokenizer->error_string, kTokenizer_Error_String_Max_Length, _TRUNCATE,
+                  "In %s, expected an identifier named '%s' but the file ended", tokenizer->path_and_name, name);
+        token->type = Token_error;
+        tokenizer->error = true;
+    }
 
     return result;
 }
@@ -444,6 +461,26 @@ b32 init_tokenizer(Tokenizer *tokenizer, char const *path, char const *name) {
 }
 
 
+// Copies the data, name is only used in error messages
+b32 init_tokenizer_from_memory(Tokenizer *tokenizer, char const *name, char const *data, u32 size) {
+    b32 result = false;
+
+    _snprintf_s(tokenizer->path_and_name, kTokenizer_Path_And_Name_Max_Length, _TRUNCATE, "%s", name);
+
+    tokenizer->data = static_cast<char *>(malloc(max(size, 1u)));
+    if (tokenizer->data) {
+        if (size > 0)  memcpy(tokenizer->data, data, size);
+        tokenizer->size = size;
+        reload(tokenizer);
+        tokenizer->line_number = 1;
+        tokenizer->line_position = 1;
+        result = true;
+    }
+
+    return result;
+}
+
+
 void fini_tokenizer(Tokenizer *tokenizer) {
     if (tokenizer) {
         if (tokenizer->data) {
@@ -74,6 +74,7 @@ struct Wav {
     size_t data_size = 0;
     Wav_Type type = Wav_Type_Unknown;
     Wav_Format format;
+    b32 is_mapped = false; // data points into a memory-mapped file (see pak.cpp) and isn't ours to free
 };
 
 
@@ -331,10 +332,53 @@ b32 load_wav(char const *path_and_name, Wav *output) {
 }
 
 
+//
+// Writing, the header of a PCM wav file with only a fmt and a data chunk. extra_size is the size of any
+// chunks that are written after the data.
+//
+
+#pragma pack(push, 1)
+struct Wav_File_Header {
+    u32 riff_id;          // "RIFF"
+    u32 riff_size;        // File size - 8
+    u32 wave_id;          // "WAVE"
+    u32 fmt_id;           // "fmt "
+    u32 fmt_size;         // 16
+    u16 audio_format;     // 1, PCM
+    u16 number_of_channels;
+    u32 sample_rate;
+    u32 average_bytes_per_second;
+    u16 block_align;
+    u16 bits_per_sample;
+    u32 data_id;          // "data"
+    u32 data_size;
+};
+#pragma pack(pop)
+
+
+void fill_wav_file_header(Wav_File_Header *header, u16 number_of_channels, u32 sample_rate, u16 bits_per_sample, u32 frame_count, u32 extra_size) {
+    u16 block_align = number_of_channels * (bits_per_sample / 8);
+
+    header->riff_id   = kWav_FourCC_RIFF;
+    header->riff_size = static_cast<u32>(sizeof(Wav_File_Header) - 8 + (frame_count * block_align) + extra_size);
+    header->wave_id   = kWav_FourCC_WAVE;
+    header->fmt_id    = kWav_FourCC_FMT;
+    header->fmt_size  = 16;
+    header->audio_format             = Wav_Audio_Format_PCM;
+    header->number_of_channels       = number_of_channels;
+    header->sample_rate              = sample_rate;
+    header->average_bytes_per_second = sample_rate * block_align;
+    header->block_align              = block_align;
+    header->bits_per_sample          = bits_per_sample;
+    header->data_id   = kWav_FourCC_DATA;
+    header->data_size = frame_count * block_align;
+}
+
+
 void free_wav(Wav *data) {
     if (data) {
         if (data->data) {
-            free(data->data);
+            if (!data->is_mapped)  free(data->data);
             memset(data, 0, sizeof(Wav));
         }
     }
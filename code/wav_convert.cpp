@@ -0,0 +1,452 @@
+//
+// Wav conversion
+//
+// Every wav the game plays is converted to one canonical format, the mixer's (see mixer.cpp): 16-bit PCM,
+// stereo, kMixer_Sample_Rate. Converting means decoding to float, resampling with a windowed sinc filter
+// and quantizing back to 16 bits, which is far too slow to do every time the game starts, so the result is
+// cached on disc in data\audio\cache\ together with a hash of the source file. load_canonical_wav() only
+// converts when the cache is missing or stale, and `headless -convert_audio` does it for all the wavs as
+// an asset-build step.
+//
+
+#include <xmmintrin.h>
+
+#define kWav_Canonical_Channel_Count   kMixer_Channel_Count
+#define kWav_Canonical_Sample_Rate     kMixer_Sample_Rate
+#define kWav_Canonical_Bits_Per_Sample 16
+
+#define kWav_Convert_Version     1    // Bump when the conversion changes, it invalidates the cache
+#define kWav_Resampler_Taps      32   // Must be a multiple of 4
+#define kWav_Resampler_Max_Phases 1024
+
+#define kWav_Cache_Directory "data\\audio\\cache"
+
+u32 constexpr kWav_FourCC_HASH = 'hsah'; // Chunk at the end of the cached files with the hash of the source
+
+
+struct Wav_Resampler {
+    f32 *filters = nullptr;  // phase_count * kWav_Resampler_Taps
+    u32 phase_count = 0;
+    u32 input_rate  = 0;
+    u32 output_rate = 0;
+};
+
+
+
+
+//
+// Resampling
+//
+
+static u32 greatest_common_divisor(u32 a, u32 b) {
+    while (b != 0) {
+        u32 t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+
+static void fini_resampler(Wav_Resampler *resampler) {
+    if (resampler->filters) {
+        free(resampler->filters);
+    }
+    *resampler = {};
+}
+
+
+// Builds the polyphase filter bank. With rates that have a small enough ratio (44100 -> 48000 is 147/160)
+// every output sample has an exact phase, otherwise the phase is rounded to one of kWav_Resampler_Max_Phases.
+static b32 init_resampler(Wav_Resampler *resampler, u32 input_rate, u32 output_rate) {
+    b32 result = false;
+
+    u32 divisor = greatest_common_divisor(input_rate, output_rate);
+    resampler->input_rate  = input_rate;
+    resampler->output_rate = output_rate;
+    resampler->phase_count = min(output_rate / divisor, static_cast<u32>(kWav_Resampler_Max_Phases));
+    resampler->filters = static_cast<f32 *>(malloc(resampler->phase_count * kWav_Resampler_Taps * sizeof(f32)));
+    if (!resampler->filters) {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+        return result;
+    }
+
+    // Low-pass at a little below the lower of the two Nyquist frequencies, relative to the input rate
+    f64 constexpr pi = 3.14159265358979323846;
+    f64 cutoff = 0.475 * min(1.0, static_cast<f64>(output_rate) / static_cast<f64>(input_rate));
+    s32 constexpr half_taps = kWav_Resampler_Taps / 2;
+
+    for (u32 phase = 0; phase < resampler->phase_count; ++phase) {
+        f32 *filter = resampler->filters + (phase * kWav_Resampler_Taps);
+        f64 fraction = static_cast<f64>(phase) / static_cast<f64>(resampler->phase_count);
+        f64 sum = 0.0;
+
+        for (s32 tap = 0; tap < kWav_Resampler_Taps; ++tap) {
+            // Distance from the input sample under this tap to the output position
+            f64 x = static_cast<f64>(tap - half_taps + 1) - fraction;
+            f64 sinc = x == 0.0 ? 2.0 * cutoff : sin(2.0 * pi * cutoff * x) / (pi * x);
+
+            // Blackman window over [-half_taps, half_taps]
+            f64 w = (x + half_taps) / (2.0 * half_taps);
+            f64 window = 0.42 - 0.5 * cos(2.0 * pi * w) + 0.08 * cos(4.0 * pi * w);
+
+            f64 value = sinc * window;
+            filter[tap] = static_cast<f32>(value);
+            sum += value;
+        }
+
+        // Unity gain for every phase
+        for (u32 tap = 0; tap < kWav_Resampler_Taps; ++tap) {
+            filter[tap] = static_cast<f32>(filter[tap] / sum);
+        }
+    }
+
+    result = true;
+
+    return result;
+}
+
+
+static u32 get_resampled_frame_count(Wav_Resampler *resampler, u32 input_frame_count) {
+    u64 result = ((static_cast<u64>(input_frame_count) * resampler->output_rate) + resampler->input_rate - 1) / resampler->input_rate;
+    return static_cast<u32>(result);
+}
+
+
+// input must have kWav_Resampler_Taps frames of silence before and after the input_frame_count frames
+static void resample(Wav_Resampler *resampler, f32 const *input, u32 input_frame_count, f32 *output, u32 output_frame_count) {
+    PROFILE_FUNCTION();
+
+    u64 const input_rate  = resampler->input_rate;
+    u64 const output_rate = resampler->output_rate;
+
+    for (u32 frame = 0; frame < output_frame_count; ++frame) {
+        u64 position = static_cast<u64>(frame) * input_rate;
+        u64 index    = position / output_rate;
+        u64 phase    = ((position % output_rate) * resampler->phase_count) / output_rate;
+
+        f32 const *filter = resampler->filters + (phase * kWav_Resampler_Taps);
+        f32 const *x = input + index - (kWav_Resampler_Taps / 2 - 1);
+
+        __m128 sum = _mm_setzero_ps();
+        for (u32 tap = 0; tap < kWav_Resampler_Taps; tap += 4) {
+            sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(x + tap), _mm_loadu_ps(filter + tap)));
+        }
+
+        // Horizontal add
+        __m128 shuffled = _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(2, 3, 0, 1));
+        sum = _mm_add_ps(sum, shuffled);
+        shuffled = _mm_movehl_ps(shuffled, sum);
+        sum = _mm_add_ss(sum, shuffled);
+        output[frame] = _mm_cvtss_f32(sum);
+    }
+}
+
+
+
+
+//
+// Conversion
+//
+
+static s16 quantize_to_s16(f32 value) {
+    f32 scaled = value * 32767.0f;
+    scaled = scaled >  32767.0f ?  32767.0f : scaled;
+    scaled = scaled < -32768.0f ? -32768.0f : scaled;
+    s16 result = static_cast<s16>(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f);
+    return result;
+}
+
+
+static b32 is_canonical_wav(Wav const *wav) {
+    b32 result = wav->format.audio_format == Wav_Audio_Format_PCM &&
+                 wav->format.number_of_channels == kWav_Canonical_Channel_Count &&
+                 wav->format.sample_rate == kWav_Canonical_Sample_Rate &&
+                 wav->format.bits_per_sample == kWav_Canonical_Bits_Per_Sample;
+    return result;
+}
+
+
+// Converts input to the canonical format, output gets its own copy of the data
+static b32 convert_wav_to_canonical(Wav const *input, Wav *output) {
+    PROFILE_FUNCTION();
+    b32 result = false;
+
+    Wav_Format const *format = &input->format;
+    u32 bytes_per_sample = format->bits_per_sample / 8;
+    b32 is_supported = input->data && format->number_of_channels > 0 && format->sample_rate > 0 &&
+                       bytes_per_sample >= 1 && bytes_per_sample <= 4 &&
+                       format->block_align >= format->number_of_channels * bytes_per_sample;
+    if (!is_supported) {
+        printf("%s() unsupported wav format (%u channels, %u bits, %u Hz)\n", __FUNCTION__,
+               format->number_of_channels, format->bits_per_sample, format->sample_rate);
+        return result;
+    }
+
+    u16 audio_format = format->audio_format;
+    if (audio_format == Wav_Audio_Format_Extensible) {
+        audio_format = static_cast<u16>(format->subformat[0] & 0xFFFF); // The GUID starts with the format tag
+    }
+
+    Wav_Resampler resampler;
+    if (!init_resampler(&resampler, format->sample_rate, kWav_Canonical_Sample_Rate)) {
+        return result;
+    }
+
+    u32 input_frame_count  = static_cast<u32>(input->data_size / format->block_align);
+    u32 output_frame_count = get_resampled_frame_count(&resampler, input_frame_count);
+
+    //
+    // Decode one channel at a time into a padded float buffer and resample it
+    u32 padded_frame_count = input_frame_count + 2 * kWav_Resampler_Taps;
+    f32 *planar_input  = static_cast<f32 *>(calloc(padded_frame_count, sizeof(f32)));
+    f32 *planar_output = static_cast<f32 *>(malloc((output_frame_count + 1) * sizeof(f32)));
+    s16 *samples = static_cast<s16 *>(malloc((output_frame_count + 1) * kWav_Canonical_Channel_Count * sizeof(s16)));
+
+    if (planar_input && planar_output && samples) {
+        for (u32 channel = 0; channel < kWav_Canonical_Channel_Count; ++channel) {
+            // Mono is played on both channels, channels after the first two are dropped
+            u32 source_channel = min(channel, static_cast<u32>(format->number_of_channels - 1));
+            u8 const *bytes = input->data + (source_channel * bytes_per_sample);
+
+            f32 *x = planar_input + kWav_Resampler_Taps;
+            for (u32 frame = 0; frame < input_frame_count; ++frame) {
+                x[frame] = decode_pcm_sample(bytes + (static_cast<size_t>(frame) * format->block_align), format->bits_per_sample, audio_format);
+            }
+
+            resample(&resampler, x, input_frame_count, planar_output, output_frame_count);
+
+            for (u32 frame = 0; frame < output_frame_count; ++frame) {
+                samples[(frame * kWav_Canonical_Channel_Count) + channel] = quantize_to_s16(planar_output[frame]);
+            }
+        }
+
+        *output = {};
+        output->type = Wav_Type_Wave;
+        output->format.audio_format             = Wav_Audio_Format_PCM;
+        output->format.number_of_channels       = kWav_Canonical_Channel_Count;
+        output->format.sample_rate              = kWav_Canonical_Sample_Rate;
+        output->format.bits_per_sample          = kWav_Canonical_Bits_Per_Sample;
+        output->format.block_align              = kWav_Canonical_Channel_Count * sizeof(s16);
+        output->format.average_bytes_per_second = kWav_Canonical_Sample_Rate * output->format.block_align;
+        output->data = reinterpret_cast<u8 *>(samples);
+        output->data_size = output_frame_count * output->format.block_align;
+        samples = nullptr; // Owned by output
+        result = true;
+    }
+    else {
+        printf("%s in %s failed to allocate memory!\n", __FUNCTION__, __FILE__);
+    }
+
+    if (samples)        free(samples);
+    if (planar_output)  free(planar_output);
+    if (planar_input)   free(planar_input);
+    fini_resampler(&resampler);
+
+    return result;
+}
+
+
+
+
+//
+// The cache
+//
+
+static void get_wav_cache_path(char const *path_and_name, char *output, size_t output_size) {
+    char const *name = path_and_name;
+    for (char const *ptr = path_and_name; *ptr; ++ptr) {
+        if (*ptr == '\\' || *ptr == '/')  name = ptr + 1;
+    }
+    _snprintf_s(output, output_size, _TRUNCATE, "%s\\%s", kWav_Cache_Directory, name);
+}
+
+
+static u64 hash_wav_source(u8 const *data, u32 size) {
+    u32 version = kWav_Convert_Version;
+    u64 result = fnv1a_64(kFNV_Offset_Basis, &version, sizeof(version));
+    result = fnv1a_64(result, data, size);
+    return result;
+}
+
+
+// Returns true if the file is a canonical wav written by write_wav_cache() from a source with source_hash
+static b32 read_wav_cache(char const *path_and_name, u64 source_hash, Wav *output) {
+    b32 result = false;
+
+    u8 *data = nullptr;
+    u32 size = 0;
+    FILE *file = nullptr;
+    errno_t error = fopen_s(&file, path_and_name, "rb");
+    if (error == 0 && file) {
+        fclose(file);
+        if (!win32_read_entire_file(path_and_name, &data, &size)) {
+            data = nullptr;
+        }
+    }
+
+    if (data && size >= sizeof(Wav_File_Header)) {
+        Wav_File_Header *header = reinterpret_cast<Wav_File_Header *>(data);
+        u32 hash_chunk_offset = sizeof(Wav_File_Header) + header->data_size;
+
+        b32 is_valid = header->riff_id == kWav_FourCC_RIFF && header->wave_id == kWav_FourCC_WAVE &&
+                       header->fmt_id == kWav_FourCC_FMT && header->fmt_size == 16 && header->data_id == kWav_FourCC_DATA &&
+                       header->audio_format == Wav_Audio_Format_PCM &&
+                       header->number_of_channels == kWav_Canonical_Channel_Count &&
+                       header->sample_rate == kWav_Canonical_Sample_Rate &&
+                       header->bits_per_sample == kWav_Canonical_Bits_Per_Sample &&
+                       header->data_size <= size && (hash_chunk_offset + 16) <= size;
+
+        if (is_valid) {
+            u32 chunk_id, chunk_size;
+            u64 hash;
+            memcpy(&chunk_id,   data + hash_chunk_offset,     sizeof(u32));
+            memcpy(&chunk_size, data + hash_chunk_offset + 4, sizeof(u32));
+            memcpy(&hash,       data + hash_chunk_offset + 8, sizeof(u64));
+
+            if (chunk_id == kWav_FourCC_HASH && chunk_size == sizeof(u64) && hash == source_hash) {
+                *output = {};
+                output->type = Wav_Type_Wave;
+                output->format.audio_format             = header->audio_format;
+                output->format.number_of_channels       = header->number_of_channels;
+                output->format.sample_rate              = header->sample_rate;
+                output->format.bits_per_sample          = header->bits_per_sample;
+                output->format.block_align              = header->block_align;
+                output->format.average_bytes_per_second = header->average_bytes_per_second;
+                output->data_size = header->data_size;
+                output->data = static_cast<u8 *>(malloc(header->data_size > 0 ? header->data_size : 1));
+                assert(output->data);
+                memcpy(output->data, data + sizeof(Wav_File_Header), header->data_size);
+                result = true;
+            }
+        }
+    }
+
+    if (data) {
+        free(data);
+    }
+
+    return result;
+}
+
+
+static b32 write_wav_cache(char const *path_and_name, u64 source_hash, Wav const *wav) {
+    b32 result = false;
+
+    CreateDirectoryA(kWav_Cache_Directory, nullptr); // Fails if it already exists, which is fine
+
+    HANDLE file_handle;
+    if (win32_open_file_for_writing(path_and_name, &file_handle)) {
+        u32 frame_count = static_cast<u32>(wav->data_size / wav->format.block_align);
+        Wav_File_Header header;
+        fill_wav_file_header(&header, wav->format.number_of_channels, wav->format.sample_rate, wav->format.bits_per_sample, frame_count, 16);
+
+        u32 hash_chunk[4];
+        hash_chunk[0] = kWav_FourCC_HASH;
+        hash_chunk[1] = sizeof(u64);
+        memcpy(&hash_chunk[2], &source_hash, sizeof(u64));
+
+        DWORD bytes_written = 0;
+        result = WriteFile(file_handle, &header, sizeof(header), &bytes_written, nullptr) && bytes_written == sizeof(header);
+        result = result && WriteFile(file_handle, wav->data, header.data_size, &bytes_written, nullptr) && bytes_written == header.data_size;
+        result = result && WriteFile(file_handle, hash_chunk, sizeof(hash_chunk), &bytes_written, nullptr) && bytes_written == sizeof(hash_chunk);
+
+        if (!result) {
+            printf("%s() failed to write the converted wav to %s\n", __FUNCTION__, path_and_name);
+        }
+
+        CloseHandle(file_handle);
+    }
+
+    return result;
+}
+
+
+// Loads the wav in the canonical format, from the cache if it is up to date and by converting (and
+// caching) it otherwise. converted is set to true if the wav had to be converted.
+static b32 load_canonical_wav(char const *path_and_name, Wav *output, b32 *converted = nullptr) {
+    b32 result = false;
+    if (converted)  *converted = false;
+
+    u8 *data = nullptr;
+    u32 size = 0;
+    if (!win32_read_entire_file(path_and_name, &data, &size)) {
+        if (data)  free(data);
+        return result;
+    }
+
+    u64 source_hash = hash_wav_source(data, size);
+
+    char cache_path[MAX_PATH];
+    get_wav_cache_path(path_and_name, cache_path, MAX_PATH);
+
+    free_wav(output);
+    result = read_wav_cache(cache_path, source_hash, output);
+    if (!result) {
+        Wav source;
+        if (parse_WAV(data, size, &source)) {
+            if (is_canonical_wav(&source)) {
+                *output = source;
+                source = {};
+                result = true;
+            }
+            else {
+                result = convert_wav_to_canonical(&source, output);
+            }
+
+            if (result) {
+                write_wav_cache(cache_path, source_hash, output); // The game works without the cache, just slower to start
+                if (converted)  *converted = true;
+            }
+        }
+        free_wav(&source);
+    }
+
+    free(data);
+
+    return result;
+}
+
+
+// The asset-build step, converts every wav in data\audio that isn't cached yet. Returns the number of
+// wavs that failed.
+static u32 convert_all_wavs(Log *log) {
+    u32 failed_count = 0;
+    u32 converted_count = 0;
+    u32 cached_count = 0;
+
+    WIN32_FIND_DATAA find_data;
+    HANDLE find_handle = FindFirstFileA("data\\audio\\*.wav", &find_data);
+    b32 find_result = find_handle != INVALID_HANDLE_VALUE;
+
+    while (find_result) {
+        char path_and_name[MAX_PATH];
+        _snprintf_s(path_and_name, MAX_PATH, _TRUNCATE, "data\\audio\\%s", find_data.cFileName);
+
+        Wav wav;
+        b32 converted = false;
+        if (load_canonical_wav(path_and_name, &wav, &converted)) {
+            char message[MAX_PATH + 32];
+            _snprintf_s(message, sizeof(message), _TRUNCATE, "%s %s", path_and_name, converted ? "converted" : "is up to date");
+            log_str(log, message);
+            if (converted)  ++converted_count;
+            else            ++cached_count;
+        }
+        else {
+            LOG_ERROR_STR(log, "failed to convert", path_and_name);
+            ++failed_count;
+        }
+        free_wav(&wav);
+
+        find_result = FindNextFileA(find_handle, &find_data);
+    }
+
+    if (find_handle != INVALID_HANDLE_VALUE) {
+        FindClose(find_handle);
+    }
+
+    log_u32(log, "Wavs converted", converted_count);
+    log_u32(log, "Wavs up to date", cached_count);
+
+    return failed_count;
+}
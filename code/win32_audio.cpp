@@ -1,247 +1,172 @@
 #include "XAUDIO2REDIST.H"
 
 //
-// Structs
+// Audio back-end, XAudio2
+//
+// One streaming source voice plays the output of the mixer (see mixer.cpp). kAudio_Buffer_Count buffers are
+// queued on the voice, and every time XAudio2 is done with one the callback mixes the next kAudio_Buffer_Frames
+// frames into it and queues it again. The game thread never touches the voice after init, play_wav() only
+// posts a command to the mixer.
 //
 
-#define kAudio_Total_Voice_Count 3
+#define kAudio_Buffer_Count  3
+#define kAudio_Buffer_Frames 512 // About 11 ms at 48 kHz, must be even
 
-struct Audio_Source {
-    XAUDIO2_BUFFER buffer;
-    WAVEFORMATEX format;
-    IXAudio2SourceVoice *voice = nullptr;
-    //b32 is_playing = false;
-};
 
-/*
-typedef struct tWAVEFORMATEX {
-  WORD  wFormatTag;
-  WORD  nChannels;
-  DWORD nSamplesPerSec;
-  DWORD nAvgBytesPerSec;
-  WORD  nBlockAlign;
-  WORD  wBitsPerSample;
-  WORD  cbSize;
-}
-*/
+struct Audio_XAudio2;
 
+class Voice_Callback : public IXAudio2VoiceCallback {
+public:
+    Audio_XAudio2 *audio = nullptr;
 
-// class Voice_Callback : public IXAudio2VoiceCallback {
-// public:
-//     Voice_Callback()  {}
-//     ~Voice_Callback() {}
+    // Called on the XAudio2 thread when the voice is done with a buffer
+    void STDMETHODCALLTYPE OnBufferEnd(void *buffer_context) override;
+
+    // Unused methods are stubs
+    void STDMETHODCALLTYPE OnStreamEnd() override                                   {}
+    void STDMETHODCALLTYPE OnVoiceProcessingPassEnd() override                      {}
+    void STDMETHODCALLTYPE OnVoiceProcessingPassStart(UINT32 samples_required) override {}
+    void STDMETHODCALLTYPE OnBufferStart(void *buffer_context) override             {}
+    void STDMETHODCALLTYPE OnLoopEnd(void *buffer_context) override                 {}
+    void STDMETHODCALLTYPE OnVoiceError(void *buffer_context, HRESULT error) override {}
+};
 
-//     // Called when the voice has just finished playing a contiguous audio stream.
-//     void OnStreamEnd() {}
 
-//     // Unused methods are stubs
-//     void OnVoiceProcessingPassEnd()                        {}
-//     void OnVoiceProcessingPassStart(u32 samples_required)  {}    
-//     void OnLoopEnd(void *buffer_context)                   {}
-//     void OnVoiceError(void *buffer_context, HRESULT error) {}
+struct Audio_XAudio2 : public Audio {
+    //
+    // Methods
+    Audio_XAudio2() {};
+    ~Audio_XAudio2();
+    b32 init(Log *log) final override;
 
-//     void OnBufferEnd(void *buffer_context) {
-//         Audio_Source *source = static_cast<Audio_Source *>(buffer_context);
-//         source->is_playing = false;
-//     }
-    
-//     void OnBufferStart(void *buffer_context) {
-//         Audio_Source *source = static_cast<Audio_Source *>(buffer_context);
-//         source->is_playing = true;
-//     }
-// };
+    void update(u32 microseconds) final override {}; // The voice asks for more frames when it needs them
 
+    void fini();
+    b32 critical_error(HRESULT hresult, char const *error_message);
+    b32 submit_buffer(f32 *buffer);
 
-struct Audio {
+    //
+    // Members
     IXAudio2 *xaudio = nullptr;
     IXAudio2MasteringVoice *mastering_voice = nullptr;
-    IXAudio2SubmixVoice *submix_voice = nullptr;
-    Audio_Source sources[kAudio_Total_Voice_Count];
-    Log *log = nullptr;
-    //Voice_Callback callback;
+    IXAudio2SourceVoice *source_voice = nullptr;
+    Voice_Callback callback;
+    f32 buffers[kAudio_Buffer_Count][kAudio_Buffer_Frames * kMixer_Channel_Count];
 };
 
 
 
 
 //
-// Init and fini
+// #_Initialization and destructor
 //
-void static fini_source(Audio_Source *source) {
-    if (source) {
-        source->voice->DestroyVoice();
-        source->voice = nullptr;
-    }
-}
+void Audio_XAudio2::fini() {
+    this->is_playing = false;
 
+    // Blocks until the callback has returned, after this nothing mixes
+    if (this->source_voice) {
+        this->source_voice->DestroyVoice();
+        this->source_voice = nullptr;
+    }
 
-void static fini_audio(Audio *audio) {
-    if (audio) {
-        for (u32 index = 0; index < kAudio_Total_Voice_Count; ++index) {
-            if (audio->sources[index].voice) {
-                fini_source(&audio->sources[index]);
-            }
-        }
-        
-        if (audio->mastering_voice) {
-            audio->mastering_voice->DestroyVoice();
-            audio->mastering_voice = nullptr;
-        }
+    if (this->mastering_voice) {
+        this->mastering_voice->DestroyVoice();
+        this->mastering_voice = nullptr;
+    }
 
-        if (audio->xaudio) {
-            audio->xaudio->Release();
-            audio->xaudio = nullptr;
-        }
+    if (this->xaudio) {
+        this->xaudio->Release();
+        this->xaudio = nullptr;
     }
+
+    fini_mixer(&this->mixer);
 }
 
 
-b32 static critical_error(Audio *audio, HRESULT hresult, char const *error_message) {
+Audio_XAudio2::~Audio_XAudio2() {
+    this->fini();
+}
+
+
+// Returns true if hresult is an error, the audio is shut down in that case
+b32 Audio_XAudio2::critical_error(HRESULT hresult, char const *error_message) {
     b32 result = false;
-    
+
     if (FAILED(hresult)) {
-        LOG_ERROR(audio->log, error_message, hresult);        
-        result = false;
-        fini_audio(audio);
+        LOG_ERROR(this->log, error_message, hresult);
+        result = true;
+        this->fini();
     }
 
     return result;
 }
 
 
-b32 static init_audio(Audio *audio, Log *log) {
-    audio->log = log;
-    HRESULT hresult = XAudio2Create(&audio->xaudio, 0, XAUDIO2_DEFAULT_PROCESSOR);
-    if (critical_error(audio, hresult, "failed to create the xaudio object"))  return false;
+b32 Audio_XAudio2::init(Log *_log) {
+    this->log = _log;
+    init_mixer(&this->mixer, kMixer_Sample_Rate);
 
-    hresult = audio->xaudio->CreateMasteringVoice(&audio->mastering_voice);
-    if (critical_error(audio, hresult, "failed to create the mastering voice"))  return false;
+    HRESULT hresult = XAudio2Create(&this->xaudio, 0, XAUDIO2_DEFAULT_PROCESSOR);
+    if (this->critical_error(hresult, "failed to create the xaudio object"))  return false;
 
-    audio->submix_voice = nullptr;
+    hresult = this->xaudio->CreateMasteringVoice(&this->mastering_voice);
+    if (this->critical_error(hresult, "failed to create the mastering voice"))  return false;
 
-    for (u32 index = 0; index < kAudio_Total_Voice_Count; ++index) {
-        audio->sources[index].voice = nullptr;
-        //audio->sources[index].is_playing = false;
-    }
-        
-    return true;
-}
+    //
+    // The voice that plays the mixer's output
+    WAVEFORMATEX format = {};
+    format.wFormatTag      = WAVE_FORMAT_IEEE_FLOAT;
+    format.nChannels       = kMixer_Channel_Count;
+    format.nSamplesPerSec  = kMixer_Sample_Rate;
+    format.wBitsPerSample  = 8 * sizeof(f32);
+    format.nBlockAlign     = kMixer_Channel_Count * sizeof(f32);
+    format.nAvgBytesPerSec = format.nSamplesPerSec * format.nBlockAlign;
+    format.cbSize          = 0;
 
+    this->callback.audio = this;
+    hresult = this->xaudio->CreateSourceVoice(&this->source_voice, &format, 0, XAUDIO2_DEFAULT_FREQ_RATIO, &this->callback);
+    if (this->critical_error(hresult, "failed to create the source voice"))  return false;
 
+    for (u32 index = 0; index < kAudio_Buffer_Count; ++index) {
+        if (!this->submit_buffer(this->buffers[index])) {
+            this->critical_error(E_FAIL, "failed to submit the audio buffers");
+            return false;
+        }
+    }
 
+    hresult = this->source_voice->Start();
+    if (this->critical_error(hresult, "failed to start the source voice"))  return false;
 
-//
-// Voices
-//
+    this->is_playing = true;
 
-void static set_format_from_wav(Audio_Source *source, Wav *wav) {
-    if (source && wav) {
-        source->format.wFormatTag = WAVE_FORMAT_PCM;
-        source->format.nChannels = wav->format.number_of_channels;
-        source->format.nSamplesPerSec = wav->format.sample_rate;
-        source->format.nAvgBytesPerSec = wav->format.average_bytes_per_second;
-        source->format.nBlockAlign = wav->format.block_align;
-        source->format.wBitsPerSample = wav->format.bits_per_sample;
-        source->format.cbSize = wav->format.extra_format_size;        
-    }
+    return true;
 }
 
 
-b32 static init_voice(Audio *audio, Audio_Source *source, Wav *wav) {
-    set_format_from_wav(source, wav);
-    XAUDIO2_SEND_DESCRIPTOR send_desc;
-    send_desc.Flags = 0;
-    send_desc.pOutputVoice = audio->submix_voice;
-    XAUDIO2_VOICE_SENDS voice_sends;
-    voice_sends.SendCount = 1;
-    voice_sends.pSends = &send_desc;
 
-    HRESULT hresult = audio->xaudio->CreateSourceVoice(&source->voice, &source->format, 0, XAUDIO2_DEFAULT_FREQ_RATIO,
-                                                       0, &voice_sends, 0);//&audio->callback, &voice_sends, 0);
-    if (critical_error(audio, hresult, "failed to create voice"))  return false;
 
-    return true;
-}
+//
+// #_Streaming
+//
 
+// Mixes the next frames into buffer and queues it on the voice
+b32 Audio_XAudio2::submit_buffer(f32 *buffer) {
+    mix_audio(&this->mixer, buffer, kAudio_Buffer_Frames);
 
-b32 static init_voices(Audio *audio, Wav *wav) {
-    b32 result = false;
+    XAUDIO2_BUFFER xaudio_buffer = {};
+    xaudio_buffer.AudioBytes = kAudio_Buffer_Frames * kMixer_Channel_Count * sizeof(f32);
+    xaudio_buffer.pAudioData = reinterpret_cast<BYTE *>(buffer);
+    xaudio_buffer.pContext = buffer;
 
-    if (audio && wav) {
-        //
-        // Create submix voice
-        XAUDIO2_SEND_DESCRIPTOR send_desc;
-        send_desc.Flags = 0;
-        send_desc.pOutputVoice = audio->mastering_voice;
-        XAUDIO2_VOICE_SENDS voice_sends;
-        voice_sends.SendCount = 1;
-        voice_sends.pSends = &send_desc;
-        
-        HRESULT hresult = audio->xaudio->CreateSubmixVoice(&audio->submix_voice, wav->format.number_of_channels, wav->format.sample_rate,
-                                                           0, 0, &voice_sends, 0);
-        if (critical_error(audio, hresult, "failed to create the submix voice"))  return false;
-
-        //
-        // Create source voices
-        for (u32 index = 0; index < kAudio_Total_Voice_Count; ++index) {
-            result = init_voice(audio, &audio->sources[index], wav);
-            if (!result)  break;
-        }
-    }
+    HRESULT hresult = this->source_voice->SubmitSourceBuffer(&xaudio_buffer);
+    b32 result = SUCCEEDED(hresult);
 
     return result;
 }
 
 
-b32 static play_wav(Audio *audio, Wav *wav) {
-    b32 result = false;
-    
-    if (audio && wav) {
-        for (u32 index = 0; index < kAudio_Total_Voice_Count; ++index) {
-            Audio_Source *source = &audio->sources[index];
-            if (!source)             continue;
-
-            XAUDIO2_VOICE_STATE voice_audio;
-            source->voice->GetState(&voice_audio);
-            if (voice_audio.pCurrentBufferContext || voice_audio.BuffersQueued > 0)  continue;
-
-            
-            //
-            // Check formats
-            if ((source->format.nChannels != wav->format.number_of_channels) ||
-                (source->format.nSamplesPerSec != wav->format.sample_rate) ||
-                (source->format.nAvgBytesPerSec!= wav->format.average_bytes_per_second) ||
-                (source->format.nBlockAlign != wav->format.block_align) ||
-                (source->format.wBitsPerSample != wav->format.bits_per_sample))
-            {
-                fini_source(source);
-                result = init_voice(audio, source, wav);
-                assert(result);
-            }
-            
-
-            // setup buffer
-            source->buffer.Flags = XAUDIO2_END_OF_STREAM;
-            source->buffer.AudioBytes = static_cast<u32>(wav->data_size);
-            source->buffer.pAudioData = wav->data;
-            source->buffer.PlayBegin = 0;
-            source->buffer.PlayLength = 0;
-            source->buffer.LoopBegin = 0;
-            source->buffer.LoopLength = 0;
-            source->buffer.LoopCount = 0;
-            source->buffer.pContext = nullptr;
-
-            HRESULT hresult = source->voice->SubmitSourceBuffer(&source->buffer);
-            if (FAILED(hresult)) {                
-                char buffer[512];
-                _snprintf_s(buffer, 512, _TRUNCATE, "failed to submit source buffer, error: %d", hresult);
-                critical_error(audio, hresult, buffer);
-            }
-
-            source->voice->Start();
-            break;
-        }
+void STDMETHODCALLTYPE Voice_Callback::OnBufferEnd(void *buffer_context) {
+    if (audio && audio->source_voice && buffer_context) {
+        audio->submit_buffer(static_cast<f32 *>(buffer_context));
     }
-
-    return result;
 }
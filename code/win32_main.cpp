@@ -3,24 +3,8 @@
 // (c) Marcus Larsson
 //
 
-#define kFrame_Time 16667 // in microseconds (for some reason)
 //#define kPrintFPS
-
-#define kCell_Size 64
-#define kLevel_Size 11
-
-// TODO: make this dynamic
-#define kWindow_Client_Area_Width  11 * kCell_Size
-#define kWindow_Client_Area_Height kWindow_Client_Area_Width
-
-#define kLevel_Name_Max_Length 31
-#define kLevel_Max_Actors 100 // DEBUG
-
-#define kDot_Small_Value 10
-#define kDot_Large_Value 50
-#define kGhost_Value 200
-
-#define kPredator_Mode_Duration 10
+//#define kProfiler // See profiler.h
 
 #ifndef UNICODE
 #define UNICODE
@@ -28,11 +12,13 @@
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
-#include <stdint.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <time.h>
-#include <assert.h>
+#include <shellapi.h> // CommandLineToArgvW
+
+#include "common.h"
+
+// TODO: make this dynamic
+#define kWindow_Client_Area_Width  11 * kCell_Size
+#define kWindow_Client_Area_Height kWindow_Client_Area_Width
 
 
 //
@@ -47,35 +33,6 @@
 
 
 
-//
-// Types
-//
-
-//
-// Scalars
-typedef uint8_t  u8;
-typedef uint16_t u16;
-typedef uint32_t u32;
-typedef uint64_t u64;
-
-typedef int8_t  s8;
-typedef int16_t s16;
-typedef int32_t s32;
-typedef int64_t s64;
-
-typedef u32 b32;
-
-typedef float f32;
-
-f32 clamp_01(f32 a) {
-    f32 result = (a < 0.0f ? 0.0f : (a > 1.0f ? 1.0f : a));
-    return result;
-}
-
-#define Array_Count(x) sizeof(x) / sizeof(x[0])
-
-
-
 
 //
 // Utilities, win32
@@ -158,6 +115,58 @@ HANDLE win32_open_file_for_reading(char const *path_and_name) {
 }
 
 
+// Maps the whole file read-only, the mapping outlives the file handle. Unmap with win32_unmap_file().
+b32 win32_map_file(char const *path_and_name, u8 **data, u32 *size, HANDLE *mapping) {
+    b32 result = false;
+    *data = nullptr;
+    *size = 0;
+    *mapping = nullptr;
+
+    size_t length = strlen(path_and_name) + 1;
+    assert(length < MAX_PATH);
+    wchar_t text_buffer[MAX_PATH];
+    size_t converted;
+    mbstowcs_s(&converted, text_buffer, sizeof(text_buffer) / sizeof(wchar_t), path_and_name, length);
+    assert(converted == length);
+
+    HANDLE file = CreateFile(text_buffer, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return result; // Not an error, the caller decides what a missing file means
+    }
+
+    DWORD file_size = GetFileSize(file, nullptr);
+    if (file_size > 0 && file_size != INVALID_FILE_SIZE) {
+        *mapping = CreateFileMapping(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (*mapping) {
+            *data = static_cast<u8 *>(MapViewOfFile(*mapping, FILE_MAP_READ, 0, 0, 0));
+            if (*data) {
+                *size = file_size;
+                result = true;
+            }
+            else {
+                CloseHandle(*mapping);
+                *mapping = nullptr;
+            }
+        }
+
+        if (!result) {
+            u32 error = GetLastError();
+            printf("%s() failed to map file %s, error = %u\n", __FUNCTION__, path_and_name, error);
+        }
+    }
+
+    CloseHandle(file);
+
+    return result;
+}
+
+
+void win32_unmap_file(u8 *data, u32 size, HANDLE mapping) {
+    if (data)     UnmapViewOfFile(data);
+    if (mapping)  CloseHandle(mapping);
+}
+
+
 
 
 //
@@ -165,18 +174,33 @@ HANDLE win32_open_file_for_reading(char const *path_and_name) {
 //
 
 #include "log.h"
+#include "profiler.h"
 #include "wav.cpp"
+#include "mixer.cpp"
+#include "audio_frontend.h"
 #include "win32_audio.cpp"
+#include "headless_audio.cpp"
 #include "tokenizer.cpp"
 #include "mathematics.cpp"
 #include "bitmap.cpp"
 #include "font.cpp"
+#include "software_renderer.cpp"
+#include "scaler.cpp"
 #include "win32_software_renderer.cpp"
+#include "render_thread.cpp"
+#include "atlas.cpp"
+#include "wav_convert.cpp"
+#include "pak.cpp"
 #include "resources.cpp"
 #include "actor.cpp"
 #include "tile_and_item.cpp"
+#include "distance_oracle.cpp"
 #include "level.cpp"
 #include "movement.cpp"
+#include "solver.cpp"
+#include "hint.cpp"
+#include "solutions.cpp"
+#include "replay.cpp"
 #include "editor.cpp"
 #include "game_main.cpp"
 
@@ -349,6 +373,12 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM w_param, LPARAM l_param)
                     }
                     *render_mode ^= Level_Render_Mode_Grid;
                 }
+                else if (w_param == 0x48) { // H
+                    game->show_hint = !game->show_hint;
+                }
+                else if (w_param == 0x53) { // S
+                    game->show_solution = !game->show_solution;
+                }
                 else if (w_param == 0x52) { // R
                     reset(game);
                 }
@@ -372,6 +402,32 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM w_param, LPARAM l_param)
                     // Load
                     //read_player_profiles_from_disc(game->player_profiles);
                 }
+#ifdef kProfiler
+                else if (w_param == VK_F9) {
+                    toggle_profiler_recording(&game->log);
+                }
+                else if (w_param == VK_F10) {
+                    write_profile_to_disc(&game->log);
+                }
+#endif
+                else if (w_param == VK_F7 && game->render_thread) {
+                    // Cycle through the ways of scaling the frame to the window
+                    Renderer_Software_win32 *renderer = static_cast<Renderer_Software_win32 *>(game->render_thread->renderer);
+                    renderer->scale_mode.store((renderer->scale_mode.load() + 1) % Scale_Mode_Count);
+                }
+                else if (w_param == VK_F8) {
+                    // Save the current attempt as a replay, e.g. for attaching to a bug report
+                    if (game->state != Game_State_Editing) {
+                        Replay_Outcome outcome = game->state == Game_State_Won  ? Replay_Outcome_Won :
+                                                 game->state == Game_State_Lost ? Replay_Outcome_Lost : Replay_Outcome_None;
+                        if (save_replay_recording(&game->replay_recorder, &game->current_level, outcome)) {
+                            log_str(&game->log, "Replay saved");
+                        }
+                        else {
+                            LOG_ERROR_STR(&game->log, "failed to save the replay", 0);
+                        }
+                    }
+                }
                 else if (game->state == Game_State_Lost && w_param == VK_RETURN) {
                     if (game->state != Game_State_Editing) {
                         reset(game);
@@ -423,6 +479,9 @@ LRESULT CALLBACK WindowProc(HWND hwnd, UINT msg, WPARAM w_param, LPARAM l_param)
 int WINAPI wWinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PWSTR CmdLine, int CmdShow)
 {
     Game game;
+    Render_Thread render_thread;
+    Hint_Engine hint_engine;
+    Renderer_Software_win32 *software_renderer = nullptr;
     open_log(&game.log);
 
     wchar_t const *class_name = L"puzzle-man";
@@ -446,6 +505,45 @@ int WINAPI wWinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PWSTR CmdLine, i
     game.log.print_log = true;
     game.log.flush_immediately = true;
 
+#ifdef kProfiler
+    init_profiler();
+#endif
+
+
+    //
+    // Play a replay without opening a window: puzzle-man.exe -replay data\replays\<name>.replay
+    // The exit code is 0 if the replay ended with the same score and outcome as when it was recorded.
+    {
+        s32 arg_count = 0;
+        wchar_t **args = CommandLineToArgvW(GetCommandLineW(), &arg_count);
+        if (args && arg_count >= 3 && wcscmp(args[1], L"-replay") == 0) {
+            char path_and_name[MAX_PATH];
+            size_t converted = 0;
+            wcstombs_s(&converted, path_and_name, sizeof(path_and_name), args[2], _TRUNCATE);
+            LocalFree(args);
+
+            error_code = run_replay_headless(&game.log, path_and_name);
+            close_log(&game.log);
+            return error_code;
+        }
+
+        // Pack the resources into data\resources.pak: puzzle-man.exe -pack_resources
+        if (args && arg_count >= 2 && wcscmp(args[1], L"-pack_resources") == 0) {
+            LocalFree(args);
+
+            error_code = pack_resources(&game.log) ? 0 : 1;
+            close_log(&game.log);
+            return error_code;
+        }
+
+        // Save a replay of every level that is won or lost: puzzle-man.exe -save_replays
+        for (s32 index = 1; args && index < arg_count; ++index) {
+            if (wcscmp(args[index], L"-save_replays") == 0)  game.save_replays = true;
+        }
+
+        if (args)  LocalFree(args);
+    }
+
 
     log_str(&game.log, "Starting initializations...");
 
@@ -512,8 +610,8 @@ int WINAPI wWinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PWSTR CmdLine, i
     // Init renderer and audio
     if (error_code == 0)
     {
-        game.renderer = new Renderer_Software_win32();
-        b32 result = static_cast<Renderer_Software_win32 *>(game.renderer)->init_win32(hwnd, &game.log, kWindow_Client_Area_Width, kWindow_Client_Area_Height);
+        software_renderer = new Renderer_Software_win32();
+        b32 result = software_renderer->init_win32(hwnd, &game.log, kWindow_Client_Area_Width, kWindow_Client_Area_Height);
         if (!result) {
             LOG_ERROR(&game.log, "failed to initialize the software renderer", result);
             error_code = 3;
@@ -521,13 +619,21 @@ int WINAPI wWinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PWSTR CmdLine, i
         else {
             log_str(&game.log, "Renderer initialized");
 
-            result = init_audio(&game.audio, &game.log);
-            if (!result) {
-                LOG_ERROR(&game.log, "failed to initialize the audio system", result);
-                error_code = 4;
+            // The game records every frame and the render thread draws and presents it, see render_thread.cpp
+            start_render_thread(&render_thread, software_renderer, &game.log);
+            game.render_thread = &render_thread;
+            game.renderer = begin_render_frame(&render_thread);
+
+            // The game is playable without sound, fall back to no audio at all
+            game.audio = new Audio_XAudio2();
+            if (game.audio->init(&game.log)) {
+                log_str(&game.log, "XAudio2 initilized");
             }
             else {
-                log_str(&game.log, "XAudio2 initilized");
+                LOG_ERROR(&game.log, "failed to initialize the audio system, continuing without audio", 0);
+                delete game.audio;
+                game.audio = new Audio_Null();
+                game.audio->init(&game.log);
             }
         }
     }
@@ -540,6 +646,14 @@ int WINAPI wWinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PWSTR CmdLine, i
     {
         if (init_game(&game)) {
             log_str(&game.log, "Game initilized");
+
+            // The game plays on without hints if this fails, see hint.cpp
+            if (start_hint_engine(&hint_engine, kHint_Default_Milliseconds)) {
+                game.hint_engine = &hint_engine;
+            }
+            else {
+                LOG_ERROR_STR(&game.log, "failed to start the hint engine", 0);
+            }
         }
         else {
             LOG_ERROR(&game.log, "failed to initialized game", 0);
@@ -563,16 +677,20 @@ int WINAPI wWinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PWSTR CmdLine, i
     b32 running = error_code == 0;
     while (running) {
         QueryPerformanceCounter(&frame_start_time);
+        PROFILE_SCOPE("Frame");
 
 
         //
         // Message pump
-        while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
+        {
+            PROFILE_SCOPE("Message pump");
+            while (PeekMessage(&msg, nullptr, 0, 0, PM_REMOVE)) {
+                TranslateMessage(&msg);
+                DispatchMessage(&msg);
 
-            if (msg.message == WM_QUIT) {
-            running = false;
+                if (msg.message == WM_QUIT) {
+                running = false;
+                }
             }
         }
 
@@ -630,8 +748,9 @@ int WINAPI wWinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PWSTR CmdLine, i
 
 
         //
-        // Update and render game
+        // Update and record the frame
         b32 should_quit = false;
+        game.renderer = begin_render_frame(&render_thread);
         update_and_render(&game, kFrame_Time, &should_quit);
         if (should_quit) {
             PostMessage(hwnd, WM_CLOSE, 0, 0);
@@ -639,8 +758,8 @@ int WINAPI wWinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PWSTR CmdLine, i
 
 
         //
-        // Draw backbuffer to screen
-        game.renderer->draw_to_screen();
+        // Hand the frame to the render thread, which draws and presents it while we simulate the next one
+        end_render_frame(&render_thread);
 
 
         //
@@ -673,9 +792,11 @@ int WINAPI wWinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PWSTR CmdLine, i
 
     //
     // Quit the program
+    stop_render_thread(&render_thread); // Before the resources the frames point at are freed
+    stop_hint_engine(&hint_engine);
     fini_game(&game);
-    fini_audio(&game.audio);
-    delete game.renderer;
+    delete game.audio;
+    delete software_renderer;
 
 #ifdef DEBUG
     _CrtDumpMemoryLeaks();
@@ -686,6 +807,10 @@ int WINAPI wWinMain(HINSTANCE Instance, HINSTANCE PrevInstance, PWSTR CmdLine, i
     //CoUninitialize();
 #endif
 
+#ifdef kProfiler
+    fini_profiler();
+#endif
+
     close_log(&game.log);
 
     return error_code;
@@ -1,11 +1,12 @@
 //
-// Renderer back-end, software
+// Renderer back-end, software, win32
+//
+// Presents the backbuffer of Renderer_Software (see software_renderer.cpp) using GDI. The backbuffer is
+// scaled to the window by us (see scaler.cpp) into a window sized DIB section, which GDI then only copies.
 //
-
-#include "renderer_frontend.h"
 
 
-struct Renderer_Software_win32 : public Renderer {
+struct Renderer_Software_win32 : public Renderer_Software {
     //
     // Methods
     Renderer_Software_win32() {};
@@ -13,32 +14,23 @@ struct Renderer_Software_win32 : public Renderer {
     b32 init(Log *log, u32 width, u32 height) final override;
     b32 init_win32(HWND hwnd, Log *log, u32 width, u32 height);
 
-    void clear(v4u8 clear_colour) final override;
-
-    void draw_filled_rectangle(v2u P, u32 w, u32 h, v4u8 colour) final override;
-    void draw_rectangle_outline(v2u P, u32 w, u32 h, v4u8 colour) final override;
-
-    //void create_bitmap();
-    void draw_bitmap(v2u P, Bmp *bitmap) final override;
-    void draw_bitmap(v2u P, Bmp *bitmap, u32 x0, u32 y0, u32 x1, u32 y1) final override;
-    void draw_coloured_bitmap(v2u P, Bmp *bitmap, u32 x0, u32 y0, u32 x1, u32 y1, v4u8 colour) final override;
-    
-    v2u print(Font *font, v2u Po, char const *text, v4u8 colour_v4u8 = v4u8_white) final override;
-
-    void draw_to_screen();
-
-    u32 get_backbuffer_width()  final override {return backbuffer_width;}
-    u32 get_backbuffer_height() final override {return backbuffer_height;}
+    void draw_to_screen() final override;
+    b32 resize_window_buffer(u32 width, u32 height);
 
     //
     // Members
-    v4u8  *backbuffer_memory = nullptr;        
     HBITMAP backbuffer_bitmap = nullptr;
     HDC     backbuffer_hdc    = nullptr;
-    u32     backbuffer_width = 0;
-    u32     backbuffer_height = 0;
     HWND hwnd = nullptr;
-    Log *log = nullptr;
+
+    // The backbuffer scaled to the size of the client area
+    std::atomic<u32> scale_mode{Scale_Mode_Fit_Nearest}; // Set by the game thread, see render_thread.cpp
+    Scaler  scaler;
+    HBITMAP window_bitmap = nullptr;
+    HDC     window_hdc    = nullptr;
+    u32    *window_memory = nullptr;
+    u32     window_width  = 0;
+    u32     window_height = 0;
 };
 
 
@@ -46,7 +38,27 @@ struct Renderer_Software_win32 : public Renderer {
 
 //
 // #_Initialization and destructor
+static void free_window_buffer(Renderer_Software_win32 *renderer) {
+    if (renderer->window_hdc) {
+        DeleteDC(renderer->window_hdc);
+        renderer->window_hdc = nullptr;
+    }
+
+    if (renderer->window_bitmap) {
+        DeleteObject(renderer->window_bitmap);
+        renderer->window_bitmap = nullptr;
+    }
+
+    renderer->window_memory = nullptr;
+    renderer->window_width  = 0;
+    renderer->window_height = 0;
+}
+
+
 void Renderer_Software_win32_fini(Renderer_Software_win32 *renderer) {
+    free_window_buffer(renderer);
+    free_scaler(&renderer->scaler);
+
     if (renderer->backbuffer_bitmap) {
         DeleteObject(renderer->backbuffer_bitmap); // Renderer will free the memory used for the pixel data
     }
@@ -126,205 +138,76 @@ Renderer_Software_win32::~Renderer_Software_win32() {
 
 
 //
-// #_Rendering
+// #_Present
 //
 
-void Renderer_Software_win32::clear(v4u8 clear_colour) {
-    if (this->backbuffer_memory) {
-        for (u32 Index = 0; Index < (this->backbuffer_width * this->backbuffer_height); ++Index) {
-            this->backbuffer_memory[Index] = clear_colour;
-        }
-    }
-}
-
+b32 Renderer_Software_win32::resize_window_buffer(u32 width, u32 height) {
+    b32 result = true;
 
-void Renderer_Software_win32::draw_filled_rectangle(v2u P, u32 w, u32 h, v4u8 colour) {
-    for (u32 y = P.y; y < (P.y + h); ++y) {
-        for (u32 x = P.x; x < (P.x + w); ++x) {
-            u32 *dst = reinterpret_cast<u32 *>(&this->backbuffer_memory[(y * this->backbuffer_width) + x]);
-            *dst = fp_lerp_non_premul_src(*dst, colour._u32);
-        }
-    }
-}
+    free_window_buffer(this);
 
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biWidth = width;
+    bmi.bmiHeader.biHeight = height;
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    bmi.bmiHeader.biSizeImage = 0;
+    bmi.bmiHeader.biSize = sizeof(bmi);
 
-void Renderer_Software_win32::draw_rectangle_outline(v2u P, u32 w, u32 h, v4u8 colour) {
-    u32 width = this->backbuffer_width;
-    
-    for (u32 x = P.x; x < (P.x + w); ++x) {
-        u32 *dst = reinterpret_cast<u32 *>(&this->backbuffer_memory[(P.y * width) + x]);
-        *dst = fp_lerp_non_premul_src(*dst, colour._u32);
-        
-        dst = reinterpret_cast<u32 *>(&this->backbuffer_memory[((P.y + h - 1) * width) + x]);
-        *dst = fp_lerp_non_premul_src(*dst, colour._u32);
-    }
-    
-    for (u32 y = P.y; y < (P.y + h); ++y) {
-        u32 *dst = reinterpret_cast<u32 *>(&this->backbuffer_memory[(y * width) + P.x]);
-        *dst = fp_lerp_non_premul_src(*dst, colour._u32);
-        
-        dst = reinterpret_cast<u32 *>(&this->backbuffer_memory[(y * width) + (P.x + w - 1)]);
-        *dst = fp_lerp_non_premul_src(*dst, colour._u32);
+    HDC hdc = GetDC(hwnd);
+    this->window_bitmap = CreateDIBSection(hdc, &bmi, DIB_RGB_COLORS, reinterpret_cast<void **>(&this->window_memory), nullptr, 0);
+    if (!this->window_bitmap) {
+        u32 error = GetLastError();
+        LOG_ERROR(log, "failed to create the window buffer", error);
+        result = false;
     }
-}
 
-
-// we assume that bitmap is premultiplied with its alpha
-// P location to draw at
-// (x0, y0) starting point in source bitmap
-// (x1, y1) ending point in source bitmap
-//      [x0, ..., x1[  and [y0, ..., y1[  (that is, x1 and y1 is excluded from the range)
-void Renderer_Software_win32::draw_bitmap(v2u P, Bmp *bitmap, u32 x0, u32 y0, u32 x1, u32 y1) {
-        if (x0 < x1 && y0 < y1) {
-        u32 stop_y = min(static_cast<u32>(bitmap->header.height), y1 - y0);
-        u32 stop_x = min(static_cast<u32>(bitmap->header.width) , x1 - x0);
-        
-        //
-        // Using fixed-point, 0.8
-        for (u32 y = 0; y < stop_y; ++y) {
-            for (u32 x = 0; x < stop_x; ++x) {
-                u32 index = (bitmap->header.width * (y0 + y)) + (x0 + x);
-                u32 *src = reinterpret_cast<u32 *>(bitmap->data) + index;
-
-                u32 dst_x = P.x + x;
-                u32 dst_y = P.y + y;
-                if (dst_x < this->backbuffer_width && dst_y < this->backbuffer_height) { 
-                    index = (this->backbuffer_width * dst_y) + dst_x;
-                    u32 *dst = reinterpret_cast<u32 *>(&this->backbuffer_memory[index]);
-                    *dst = fp_lerp_premul(*dst, *src);
-
-                }
-            }
+    if (result) {
+        this->window_hdc = CreateCompatibleDC(hdc);
+        if (!this->window_hdc) {
+            u32 error = GetLastError();
+            LOG_ERROR(log, "failed to create the window buffer's hdc", error);
+            result = false;
         }
     }
-}
 
-
-// we assume that bitmap is premultiplied with its alpha
-// P location to draw at
-// (x0, y0) starting point in source bitmap
-// (x1, y1) ending point in source bitmap
-//      [x0, ..., x1[  and [y0, ..., y1[  (that is, x1 and y1 is excluded from the range)
-void Renderer_Software_win32::draw_coloured_bitmap(v2u P, Bmp *bitmap, u32 x0, u32 y0, u32 x1, u32 y1, v4u8 colour) {
-     if (x0 < x1 && y0 < y1) {
-        u32 stop_y = min(static_cast<u32>(bitmap->header.height), y1 - y0);
-        u32 stop_x = min(static_cast<u32>(bitmap->header.width) , x1 - x0);
-        
-        //
-        // Using fixed-point, 0.8
-        for (u32 y = 0; y < stop_y; ++y) {
-            for (u32 x = 0; x < stop_x; ++x) {
-                u32 index = (bitmap->header.width * (y0 + y)) + (x0 + x);
-                u32 src = *(reinterpret_cast<u32 *>(bitmap->data) + index);
-
-                u32 dst_x = P.x + x;
-                u32 dst_y = P.y + y;
-                if (dst_x < this->backbuffer_width && dst_y < this->backbuffer_height) { 
-                    index = (this->backbuffer_width * dst_y) + dst_x;
-                    u32 *dst = reinterpret_cast<u32 *>(&this->backbuffer_memory[index]);
-                    src = fp_mul_non_premul_src(src, colour._u32);
-                    *dst = fp_lerp_premul(*dst, src);
-                    //*dst = fp_mul_non_premul_src(*dst, colour._u32);
-                }
-            }
-        }
+    if (result) {
+        SelectObject(this->window_hdc, this->window_bitmap);
+        this->window_width  = width;
+        this->window_height = height;
     }
-}
-
-
-// we assume that bitmap is premultiplied with its alpha
-void Renderer_Software_win32::draw_bitmap(v2u P, Bmp *bitmap) {
-    u32 width = this->backbuffer_width;
-    u32 height = this->backbuffer_height;
-    
-    u32 left_x = P.x <= width  ? width  - P.x : 0;
-    u32 left_y = P.y <= height ? height - P.y : 0;
-    
-    u32 stop_x = min(static_cast<u32>(bitmap->header.width) , left_x);
-    u32 stop_y = min(static_cast<u32>(bitmap->header.height), left_y);
-
-    //
-    // Using fixed-point
-    for (u32 y = 0; y < stop_y; ++y) {
-        for (u32 x = 0; x < stop_x; ++x) {
-            u32 index = (width * (P.y + y)) + P.x + x;
-            u32 *dst = reinterpret_cast<u32 *>(&this->backbuffer_memory[index]);
-            
-            index = (bitmap->header.width * y) + x;
-            u32 *src = reinterpret_cast<u32 *>(bitmap->data) + index;
-            *dst = fp_lerp_premul(*dst, *src);
-        }
+    else {
+        free_window_buffer(this);
     }
-}
-
 
-v2u Renderer_Software_win32::print(Font *font, v2u Po, char const *text, v4u8 colour_v4u8) {
-    v2u P = Po;    
-    for (char const *ptr = text; *ptr; ++ptr) {        
-        u32 char_index = *ptr - 32;
-        if (char_index < font->char_count) {
-            Char_Data *c = &font->char_data[char_index];
-            u32 bx = c->x;
-            u32 by = font->bitmap.header.height - c->y - c->height;
-            u32 x = P.x + c->offset_x;
-            u32 y = P.y + (font->base - c->offset_y - c->height);
-            //draw_coloured_bitmap(this, V2u(x, y), &font->bitmap, bx, by, bx + c->width, by + c->height, colour_v4u8);
-            this->draw_coloured_bitmap(V2u(x, y), &font->bitmap, bx, by, bx + c->width, by + c->height, colour_v4u8);
-            P.x += c->advance_x;
-        }
-    }
+    ReleaseDC(hwnd, hdc);
 
-    return P;
+    return result;
 }
 
 
 void Renderer_Software_win32::draw_to_screen() {
+    PROFILE_FUNCTION();
     RECT client_rect;
     GetClientRect(this->hwnd, &client_rect);
-    s32 window_w = client_rect.right - client_rect.left;
-    s32 window_h = client_rect.bottom - client_rect.top;
-    
-    s32 dst_w = window_w;
-    s32 dst_h = window_h;
+    u32 window_w = static_cast<u32>(client_rect.right - client_rect.left);
+    u32 window_h = static_cast<u32>(client_rect.bottom - client_rect.top);
 
-    s32 src_w = this->backbuffer_width;
-    s32 src_h = this->backbuffer_height;
+    if (window_w == 0 || window_h == 0)  return; // Minimized
 
-    //
-    // "float-space"
-    f32 aspect_ratio = static_cast<f32>(src_w) / static_cast<f32>(src_h);
-    f32 w0 = static_cast<f32>(dst_w);
-    f32 h0 = static_cast<f32>(dst_h);
-    f32 w = w0;
-    f32 h = h0;
-
-    h = w / aspect_ratio;
-    if (h > h0) {
-        h = h0;
-        w = aspect_ratio * h;
+    if (window_w != this->window_width || window_h != this->window_height) {
+        if (!resize_window_buffer(window_w, window_h))  return;
     }
 
-    dst_w = static_cast<s32>(w);
-    dst_h = static_cast<s32>(h);
-                    
     //
-    // "s32-space"
-    s32 dx = (window_w - dst_w) / 2;
-    s32 dy = (window_h - dst_h) / 2;
+    // Scale, then a 1:1 copy
+    GdiFlush(); // GDI must be done with the DIB section before we write to it
+    this->scaler.mode = static_cast<Scale_Mode>(this->scale_mode.load(std::memory_order_relaxed));
+    scale_frame(&this->scaler, reinterpret_cast<u32 *>(this->backbuffer_memory), this->backbuffer_width, this->backbuffer_height,
+                this->window_memory, this->window_width, this->window_height);
 
     HDC hdc = GetDC(hwnd);
-#if 1
-    b32 result = StretchBlt(hdc,
-                            dx, dy, dst_w, dst_h,
-                            this->backbuffer_hdc,
-                            0, 0, src_w, src_h,
-                            SRCCOPY);
-#else
-    b32 result = BitBlt(hdc, 0, 0, renderer->backbuffer_width, renderer->backbuffer_height,
-                        renderer->backbuffer_hdc, 0, 0, SRCCOPY);
-    result;
-#endif
-                    
-    result;
+    BitBlt(hdc, 0, 0, this->window_width, this->window_height, this->window_hdc, 0, 0, SRCCOPY);
     ReleaseDC(hwnd, hdc);
 }